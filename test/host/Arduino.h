@@ -0,0 +1 @@
+//stands in for the ESP32 core header included by ESPAsyncE131.h (see e131_host.h)
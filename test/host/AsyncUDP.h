@@ -0,0 +1,6 @@
+#ifndef WLED_HOST_ASYNCUDP_H
+#define WLED_HOST_ASYNCUDP_H
+//stands in for the ESP32 core headers included by ESPAsyncE131.h (see e131_host.h)
+class AsyncUDP {};
+class AsyncUDPPacket {};
+#endif
@@ -0,0 +1,158 @@
+#ifndef WLED_HOST_FASTLED_H
+#define WLED_HOST_FASTLED_H
+/*
+ * The part of FastLED used by FX.h and FX_fcn.cpp, for the host build of the unit tests.
+ * Same integer math as FastLED where the result matters (scale8, palettes), not optimized.
+ * The builtin effects (FX.cpp) need much more of it and are not part of the host build.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+inline uint8_t scale8(uint8_t i, uint8_t scale) { return ((uint16_t)i * (1 + (uint16_t)scale)) >> 8; }
+inline uint8_t scale8_video(uint8_t i, uint8_t scale) { return (((int)i * (int)scale) >> 8) + ((i && scale) ? 1 : 0); }
+inline uint8_t qadd8(uint8_t i, uint8_t j) { unsigned t = i + j; return (t > 255) ? 255 : t; }
+inline uint8_t qsub8(uint8_t i, uint8_t j) { int t = i - j; return (t < 0) ? 0 : t; }
+inline uint8_t lerp8by8(uint8_t a, uint8_t b, uint8_t frac) {
+  return (b > a) ? a + scale8(b - a, frac) : a - scale8(a - b, frac);
+}
+
+inline uint16_t hostRand16Seed = 1337;
+inline uint8_t random8() { hostRand16Seed = hostRand16Seed * 2053 + 13849; return (uint8_t)(hostRand16Seed + (hostRand16Seed >> 8)); }
+inline uint8_t random8(uint8_t lim) { return (random8() * lim) >> 8; }
+inline uint8_t random8(uint8_t min, uint8_t lim) { return min + random8(lim - min); }
+inline uint16_t random16() { hostRand16Seed = hostRand16Seed * 2053 + 13849; return hostRand16Seed; }
+inline uint16_t random16(uint16_t lim) { return ((uint32_t)random16() * lim) >> 16; }
+inline uint16_t random16(uint16_t min, uint16_t lim) { return min + random16(lim - min); }
+
+struct CHSV {
+  uint8_t h, s, v;
+  CHSV() : h(0), s(0), v(0) {}
+  CHSV(uint8_t ih, uint8_t is, uint8_t iv) : h(ih), s(is), v(iv) {}
+};
+
+struct CRGB {
+  union {
+    struct { union { uint8_t r; uint8_t red; }; union { uint8_t g; uint8_t green; }; union { uint8_t b; uint8_t blue; }; };
+    uint8_t raw[3];
+  };
+  CRGB() : r(0), g(0), b(0) {}
+  CRGB(uint8_t ir, uint8_t ig, uint8_t ib) : r(ir), g(ig), b(ib) {}
+  CRGB(uint32_t c) : r(c >> 16), g(c >> 8), b(c) {}
+  CRGB(const CHSV& hsv) {
+    //hue in 6 sectors, not the FastLED rainbow, close enough for the tests
+    uint8_t region = hsv.h / 43, rem = (hsv.h - region * 43) * 6;
+    uint8_t p = scale8(hsv.v, 255 - hsv.s), q = scale8(hsv.v, 255 - scale8(hsv.s, rem)), t = scale8(hsv.v, 255 - scale8(hsv.s, 255 - rem));
+    switch (region) {
+      case 0:  r = hsv.v; g = t; b = p; break;
+      case 1:  r = q; g = hsv.v; b = p; break;
+      case 2:  r = p; g = hsv.v; b = t; break;
+      case 3:  r = p; g = q; b = hsv.v; break;
+      case 4:  r = t; g = p; b = hsv.v; break;
+      default: r = hsv.v; g = p; b = q;
+    }
+  }
+  CRGB& nscale8_video(uint8_t scale) { r = scale8_video(r, scale); g = scale8_video(g, scale); b = scale8_video(b, scale); return *this; }
+  CRGB& nscale8(uint8_t scale) { r = scale8(r, scale); g = scale8(g, scale); b = scale8(b, scale); return *this; }
+  CRGB& operator+=(const CRGB& o) { r = qadd8(r, o.r); g = qadd8(g, o.g); b = qadd8(b, o.b); return *this; }
+  bool operator==(const CRGB& o) const { return r == o.r && g == o.g && b == o.b; }
+  enum HTMLColorCode : uint32_t { Black = 0x000000, White = 0xFFFFFF };
+  bool operator!=(const CRGB& o) const { return !(*this == o); }
+};
+
+typedef uint32_t TProgmemRGBPalette16[16];
+typedef uint8_t TDynamicRGBGradientPalette_byte;
+typedef union {
+  struct { uint8_t index, r, g, b; };
+  uint32_t dword;
+  uint8_t bytes[4];
+} TRGBGradientPaletteEntryUnion;
+typedef const TDynamicRGBGradientPalette_byte* TDynamicRGBGradientPalette_bytes;
+
+enum TBlendType { NOBLEND = 0, LINEARBLEND = 1 };
+
+class CRGBPalette16 {
+  public:
+    CRGB entries[16];
+    CRGBPalette16() {}
+    CRGBPalette16(const TProgmemRGBPalette16& rhs) { for (uint8_t i = 0; i < 16; i++) entries[i] = CRGB(rhs[i]); }
+    CRGBPalette16(const CRGB& c1) { fill(&c1, 1); }
+    CRGBPalette16(const CRGB& c1, const CRGB& c2) { CRGB c[] = {c1, c2}; fill(c, 2); }
+    CRGBPalette16(const CRGB& c1, const CRGB& c2, const CRGB& c3) { CRGB c[] = {c1, c2, c3}; fill(c, 3); }
+    CRGBPalette16(const CRGB& c1, const CRGB& c2, const CRGB& c3, const CRGB& c4) { CRGB c[] = {c1, c2, c3, c4}; fill(c, 4); }
+    CRGBPalette16(const CHSV& c1, const CHSV& c2, const CHSV& c3, const CHSV& c4) { CRGB c[] = {c1, c2, c3, c4}; fill(c, 4); }
+    CRGBPalette16(const CRGB& c01, const CRGB& c02, const CRGB& c03, const CRGB& c04, const CRGB& c05, const CRGB& c06,
+                  const CRGB& c07, const CRGB& c08, const CRGB& c09, const CRGB& c10, const CRGB& c11, const CRGB& c12,
+                  const CRGB& c13, const CRGB& c14, const CRGB& c15, const CRGB& c16) {
+      CRGB c[] = {c01, c02, c03, c04, c05, c06, c07, c08, c09, c10, c11, c12, c13, c14, c15, c16};
+      for (uint8_t i = 0; i < 16; i++) entries[i] = c[i];
+    }
+    CRGB& operator[](uint8_t i) { return entries[i]; }
+    const CRGB& operator[](uint8_t i) const { return entries[i]; }
+    bool operator==(const CRGBPalette16& o) const { return !memcmp(entries, o.entries, sizeof(entries)); }
+    bool operator!=(const CRGBPalette16& o) const { return !(*this == o); }
+
+    //gradient of (index, r, g, b) entries, the last one has index 255
+    CRGBPalette16& loadDynamicGradientPalette(TDynamicRGBGradientPalette_bytes gpal) {
+      const uint8_t* p = gpal;
+      uint8_t n = 0;
+      while (n < 18 && p[n * 4] != 255) n++;
+      for (uint8_t i = 0; i < 16; i++) {
+        uint8_t x = i * 17, k = 0;
+        while (k < n && p[(k + 1) * 4] < x) k++;
+        const uint8_t* a = p + k * 4;
+        const uint8_t* b = (k < n) ? a + 4 : a;
+        uint8_t span = b[0] - a[0], f = span ? ((x - a[0]) * 255) / span : 0;
+        entries[i] = CRGB(lerp8by8(a[1], b[1], f), lerp8by8(a[2], b[2], f), lerp8by8(a[3], b[3], f));
+      }
+      return *this;
+    }
+  private:
+    void fill(const CRGB* c, uint8_t n) {
+      for (uint8_t i = 0; i < 16; i++) entries[i] = c[(i * n) / 16];
+    }
+};
+
+inline CRGB ColorFromPalette(const CRGBPalette16& pal, uint8_t index, uint8_t brightness = 255, TBlendType blendType = LINEARBLEND) {
+  uint8_t hi4 = index >> 4, lo4 = index & 0x0F;
+  CRGB c = pal[hi4];
+  if (lo4 && blendType != NOBLEND) {
+    const CRGB& n = pal[(hi4 + 1) & 0x0F];
+    uint8_t f = lo4 << 4;
+    c = CRGB(lerp8by8(c.r, n.r, f), lerp8by8(c.g, n.g, f), lerp8by8(c.b, n.b, f));
+  }
+  if (brightness != 255) c.nscale8_video(brightness);
+  return c;
+}
+
+//moves each channel of the current palette up to maxChanges steps towards the target palette
+inline void nblendPaletteTowardPalette(CRGBPalette16& current, CRGBPalette16& target, uint16_t maxChanges) {
+  uint16_t changes = 0;
+  for (uint8_t i = 0; i < 16; i++) {
+    for (uint8_t c = 0; c < 3; c++) {
+      uint8_t& cur = current[i].raw[c];
+      uint8_t tgt = target[i].raw[c];
+      if (cur == tgt || changes >= maxChanges) continue;
+      cur += (cur < tgt) ? 1 : -1;
+      changes++;
+    }
+  }
+}
+
+const TProgmemRGBPalette16 CloudColors_p = {0x0000FF, 0x00008B, 0x00008B, 0x00008B, 0x00008B, 0x00008B, 0x00008B, 0x00008B,
+                                            0x0000FF, 0x00008B, 0x87CEEB, 0x87CEEB, 0xADD8E6, 0xFFFFFF, 0xADD8E6, 0x87CEEB};
+const TProgmemRGBPalette16 LavaColors_p = {0x000000, 0x800000, 0x000000, 0x800000, 0x8B0000, 0x800000, 0x8B0000, 0x8B0000,
+                                           0x8B0000, 0xFF0000, 0xFFA500, 0xFFFFFF, 0xFFA500, 0xFF0000, 0x8B0000, 0x000000};
+const TProgmemRGBPalette16 OceanColors_p = {0x191970, 0x00008B, 0x191970, 0x000080, 0x00008B, 0x0000CD, 0x2E8B57, 0x008080,
+                                            0x5F9EA0, 0x0000FF, 0x008B8B, 0x6495ED, 0x7FFFD4, 0x2E8B57, 0x00FFFF, 0x87CEFA};
+const TProgmemRGBPalette16 ForestColors_p = {0x006400, 0x006400, 0x556B2F, 0x006400, 0x008000, 0x228B22, 0x6B8E23, 0x008000,
+                                             0x2E8B57, 0x66CDAA, 0x32CD32, 0x9ACD32, 0x90EE90, 0x7CFC00, 0x66CDAA, 0x228B22};
+const TProgmemRGBPalette16 RainbowColors_p = {0xFF0000, 0xD52A00, 0xAB5500, 0xAB7F00, 0xABAB00, 0x56D500, 0x00FF00, 0x00D52A,
+                                              0x00AB55, 0x0056AA, 0x0000FF, 0x2A00D5, 0x5500AB, 0x7F0081, 0xAB0055, 0xD5002B};
+const TProgmemRGBPalette16 RainbowStripeColors_p = {0xFF0000, 0x000000, 0xAB5500, 0x000000, 0xABAB00, 0x000000, 0x00FF00, 0x000000,
+                                                    0x00AB55, 0x000000, 0x0000FF, 0x000000, 0x5500AB, 0x000000, 0xAB0055, 0x000000};
+const TProgmemRGBPalette16 PartyColors_p = {0x5500AB, 0x84007C, 0xB5004B, 0xE5001B, 0xE81700, 0xB84700, 0xAB7700, 0xABAB00,
+                                            0xAB5500, 0xDD2200, 0xF2000E, 0xC2003E, 0x8F0071, 0x5F00A1, 0x2F00D0, 0x0007F9};
+
+#endif
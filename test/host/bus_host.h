@@ -0,0 +1,97 @@
+#ifndef WLED_HOST_BUS_H
+#define WLED_HOST_BUS_H
+/*
+ * Simulated LED output for the host build of FX_fcn.cpp, replacing bus_manager.h.
+ * All LEDs are on one bus. show() hands the edit buffer to a thread that "transmits" it for
+ * transferUs (sleeping), like the asynchronous RMT/DMA methods of NeoPixelBus: a show() while
+ * the previous frame is still being sent blocks until it is done, canAllShow() tells if it would.
+ * Every transmitted frame is passed to onFrame (from the transmit thread) to be checked.
+ */
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+struct BusConfig {
+  uint8_t type = TYPE_WS2812_RGB;
+  uint16_t count = 1;
+  uint16_t start = 0;
+  uint8_t colorOrder = COL_ORDER_GRB;
+  bool reversed = false;
+  uint8_t pins[5] = {2, 255, 255, 255, 255};
+  BusConfig(uint8_t busType, uint8_t* ppins, uint16_t pstart, uint16_t len = 1, uint8_t pcolorOrder = COL_ORDER_GRB, bool rev = false) {
+    type = busType; count = len; start = pstart; colorOrder = pcolorOrder; reversed = rev;
+    pins[0] = ppins[0];
+  }
+};
+
+class Bus {
+  public:
+    Bus(uint8_t type, uint16_t start, uint16_t len) : _type(type), _start(start), _len(len) {}
+    uint16_t getStart() { return _start; }
+    uint16_t getLength() { return _len; }
+    uint8_t getType() { return _type; }
+    uint8_t getPins(uint8_t* pins) { pins[0] = 2; return 1; }
+  private:
+    uint8_t _type;
+    uint16_t _start, _len;
+};
+
+class BusManager {
+  public:
+    uint32_t transferUs = 0;              //time a frame takes to be sent
+    std::atomic<uint32_t> framesSent{0};
+    uint64_t blockedUs = 0;               //time show() waited for the previous frame
+    std::function<void(const std::vector<uint32_t>&)> onFrame;
+
+    ~BusManager() { waitIdle(); }
+
+    uint32_t memUsage(BusConfig& bc) { return bc.count * 3; }
+    int add(BusConfig& bc) {
+      if (_bus) return -1;
+      _bus = new Bus(bc.type, bc.start, bc.count);
+      _edit.assign(bc.start + bc.count, 0);
+      return 0;
+    }
+    void removeAll() {
+      waitIdle();
+      delete _bus;
+      _bus = nullptr;
+    }
+    uint8_t getNumBusses() { return _bus ? 1 : 0; }
+    Bus* getBus(uint8_t n) { return (n == 0) ? _bus : nullptr; }
+
+    void setPixelColor(uint16_t pix, uint32_t c) { if (pix < _edit.size()) _edit[pix] = c; }
+    uint32_t getPixelColor(uint16_t pix) { return (pix < _edit.size()) ? _edit[pix] : 0; }
+    void setBrightness(uint8_t b) { _bri = b; }
+    uint8_t getBrightness() { return _bri; }
+
+    bool canAllShow() { return !_busy.load(); }
+
+    void show() {
+      uint64_t start = hostRealMicros();
+      waitIdle();
+      blockedUs += hostRealMicros() - start;
+      std::vector<uint32_t> frame = _edit;
+      _busy = true;
+      _tx = std::thread([this, frame]() {
+        std::this_thread::sleep_for(std::chrono::microseconds(transferUs));
+        if (onFrame) onFrame(frame);
+        framesSent++;
+        _busy = false;
+      });
+    }
+
+    void waitIdle() {
+      if (_tx.joinable()) _tx.join();
+    }
+
+  private:
+    Bus* _bus = nullptr;
+    std::vector<uint32_t> _edit;
+    std::thread _tx;
+    std::atomic<bool> _busy{false};
+    uint8_t _bri = 255;
+};
+
+#endif
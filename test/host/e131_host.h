@@ -0,0 +1,15 @@
+#ifndef WLED_HOST_E131_H
+#define WLED_HOST_E131_H
+/*
+ * The E1.31/Art-Net/DDP packet layout of ESPAsyncE131.h for the host build of e131.cpp.
+ * The library header only knows the ESP platforms, the empty core headers in this directory
+ * stand in for the ESP32 ones it includes.
+ */
+
+#include "wled_host.h"
+
+#define ESP32
+#include "../../wled00/src/dependencies/e131/ESPAsyncE131.h"
+#undef ESP32
+
+#endif
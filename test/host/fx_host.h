@@ -0,0 +1,21 @@
+#ifndef WLED_HOST_FX_H
+#define WLED_HOST_FX_H
+/*
+ * Host build of the effect engine (FX_fcn.cpp) on the simulated bus of bus_host.h.
+ * The builtin effects (FX.cpp) are not built, every one of them renders like "Solid" instead.
+ * Tests use usermod effects (WS2812FX::addEffect()) for anything else.
+ */
+
+#include "wled_host.h"
+#include "bus_host.h"
+
+void heapAllocFailed(uint8_t site) {}
+
+BusManager busses;
+
+#include "../../wled00/FX_fcn.cpp"
+
+#define HOST_FX_STUB(id, fn, name, pal, flags) uint16_t WS2812FX::fn(void) { fill(SEGCOLOR(0)); return FRAMETIME; }
+WLED_EFFECTS(HOST_FX_STUB, HOST_FX_STUB)
+
+#endif
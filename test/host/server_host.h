@@ -0,0 +1,158 @@
+#ifndef WLED_HOST_SERVER_H
+#define WLED_HOST_SERVER_H
+/*
+ * The part of ESPAsyncWebServer used by the request handlers of file.cpp, for the host build.
+ * A request carries its headers and parameters, send() keeps the response (status, headers and
+ * the body, read from the file or callback right away) for the test to check.
+ * Below, what the handlers call of the web server and command queue of WLED.
+ */
+
+#include <functional>
+
+class AsyncWebHeader {
+  public:
+    AsyncWebHeader(const String& name, const String& value) : _name(name), _value(value) {}
+    const String& name() const { return _name; }
+    const String& value() const { return _value; }
+  private:
+    String _name, _value;
+};
+
+typedef AsyncWebHeader AsyncWebParameter;
+
+typedef std::function<size_t(uint8_t*, size_t, size_t)> AwsResponseFiller;
+
+class AsyncWebServerResponse {
+  public:
+    virtual ~AsyncWebServerResponse() {}
+    int code = 200;
+    String contentType;
+    std::vector<AsyncWebHeader> headers;
+    std::string body;
+
+    void setCode(int c) { code = c; }
+    void addHeader(const String& name, const String& value) { headers.push_back(AsyncWebHeader(name, value)); }
+    const AsyncWebHeader* header(const char* name) const {
+      for (const AsyncWebHeader& h : headers) if (h.name() == name) return &h;
+      return nullptr;
+    }
+};
+
+class AsyncWebServerRequest {
+  public:
+    File _tempFile;
+    void* _tempObject = nullptr;
+    String _url;
+    std::vector<AsyncWebHeader> requestHeaders;
+    std::vector<AsyncWebParameter> args;        //query and form parameters
+    AsyncWebServerResponse* response = nullptr; //the response sent
+    std::function<void()> disconnected;
+
+    ~AsyncWebServerRequest() {
+      delete response;
+      free(_tempObject);
+    }
+
+    void addHeader(const char* name, const char* value) { requestHeaders.push_back(AsyncWebHeader(name, value)); }
+    void addArg(const char* name, const char* value) { args.push_back(AsyncWebParameter(name, value)); }
+    const String& url() const { return _url; }
+
+    AsyncWebHeader* getHeader(const char* name) {
+      for (AsyncWebHeader& h : requestHeaders) if (h.name() == name) return &h;
+      return nullptr;
+    }
+    bool hasHeader(const char* name) { return getHeader(name) != nullptr; }
+    String header(const char* name) { AsyncWebHeader* h = getHeader(name); return h ? h->value() : String(); }
+    bool hasArg(const char* name) { return getParam(name) != nullptr; }
+    String arg(const char* name) { AsyncWebParameter* p = getParam(name); return p ? p->value() : String(); }
+    bool hasParam(const char* name, bool post = false) { return getParam(name, post) != nullptr; }
+    AsyncWebParameter* getParam(const char* name, bool post = false) {
+      for (AsyncWebParameter& p : args) if (p.name() == name) return &p;
+      return nullptr;
+    }
+    void onDisconnect(std::function<void()> fn) { disconnected = fn; }
+
+    AsyncWebServerResponse* beginResponse(int code, const String& contentType = String(), const String& content = String()) {
+      AsyncWebServerResponse* r = new AsyncWebServerResponse();
+      r->code = code;
+      r->contentType = contentType;
+      r->body = content.str();
+      return r;
+    }
+    AsyncWebServerResponse* beginResponse(File file, const String& path, const String& contentType) {
+      AsyncWebServerResponse* r = beginResponse(200, contentType);
+      int c;
+      while ((c = file.read()) >= 0) r->body += (char)c;
+      return r;
+    }
+    AsyncWebServerResponse* beginResponse(const String& contentType, size_t len, AwsResponseFiller filler) {
+      AsyncWebServerResponse* r = beginResponse(200, contentType);
+      uint8_t buf[64];
+      size_t n;
+      while (r->body.size() < len && (n = filler(buf, sizeof(buf), r->body.size())) > 0) r->body.append((const char*)buf, n);
+      return r;
+    }
+    void send(AsyncWebServerResponse* r) {
+      delete response;
+      response = r;
+    }
+    void send(int code, const String& contentType = String(), const String& content = String()) {
+      send(beginResponse(code, contentType, content));
+    }
+    void send_P(int code, const String& contentType, const char* content) { send(code, contentType, content); }
+};
+
+//AsyncJson.h, the body is serialized by setLength()
+class AsyncJsonResponse : public AsyncWebServerResponse {
+  public:
+    DynamicJsonDocument doc;
+    AsyncJsonResponse(size_t size) : doc(size) { contentType = "application/json"; doc.to<JsonObject>(); }
+    JsonVariant getRoot() { return doc.as<JsonVariant>(); }
+    size_t setLength() { body.clear(); serializeJson(doc, body); return body.size(); }
+};
+
+//the part of WLED's request admission (wled_server.cpp) the file handlers use, admitRequest() is the test's
+bool requestAdmitted(AsyncWebServerRequest* request) { return true; }
+void sendUnavailable(AsyncWebServerRequest* request)
+{
+  AsyncWebServerResponse* response = request->beginResponse(503, "application/json", "{\"error\":\"Busy\"}");
+  response->addHeader("Retry-After", "1");
+  request->send(response);
+}
+
+/*
+ * The file responses of the command queue (cmdqueue.cpp): queueFileResponse() keeps them, hostLoopFileResponses()
+ * answers them like the loop does, after writing what is pending. With hostFileQueueFull, queueing fails.
+ */
+void flushPersistence();
+void commitFileOp();
+bool handleFileRead(AsyncWebServerRequest* request, String path);
+
+struct HostFileResponse {
+  AsyncWebServerRequest* request;
+  std::string payload;
+  bool serve;
+};
+static std::vector<HostFileResponse> hostFileResponses;
+static bool hostFileQueueFull = false;
+
+bool queueFileResponse(AsyncWebServerRequest* request, const char* path, const char* text = nullptr)
+{
+  if (hostFileQueueFull) return false;
+  hostFileResponses.push_back({request, text ? text : path, !text});
+  return true;
+}
+
+static void hostLoopFileResponses()
+{
+  flushPersistence();
+  commitFileOp();
+  std::vector<HostFileResponse> queued;
+  queued.swap(hostFileResponses);
+  for (HostFileResponse& r : queued) {
+    if (!r.serve) r.request->send(200, "text/plain", r.payload);
+    else if (!handleFileRead(r.request, r.payload)) r.request->send(404, "text/plain", "Not found");
+  }
+}
+
+#endif
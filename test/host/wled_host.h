@@ -0,0 +1,323 @@
+#ifndef WLED_HOST_H
+#define WLED_HOST_H
+/*
+ * Host build support for the unit tests (pio test -e native)
+ * Defining WLED_H makes the wled00 sources included by a test skip the real wled.h (Arduino core,
+ * network stack), this header provides the parts of the core they use instead:
+ * a clock that can be advanced, String, and an in-memory file system with power-cut injection.
+ * Globals of wled.h are defined by each test for the module it includes.
+ */
+
+#define WLED_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <new>
+#include <map>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <type_traits>
+
+#define ARDUINOJSON_DECODE_UNICODE 0
+#include "../../wled00/src/dependencies/json/ArduinoJson-v6.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define PROGMEM
+typedef char __FlashStringHelper; //F() strings are plain strings
+#define PSTR(s) (s)
+#define F(s) (s)
+#define FPSTR(s) (s)
+#define pgm_read_byte(p)  (*(const uint8_t*)(p))
+#define pgm_read_word(p)  (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(p))  //also used to read pointers, which are 64 bit here
+#define pgm_read_ptr(p)   (*(void* const*)(p))
+#define memcpy_P  memcpy
+#define strcpy_P  strcpy
+#define strcat_P  strcat
+#define strlen_P  strlen
+#define strncmp_P strncmp
+#define strcmp_P  strcmp
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+#if defined(__GLIBC__) && (__GLIBC__ == 2 && __GLIBC_MINOR__ < 38) //part of newlib and the ESP8266 core
+inline size_t strlcpy(char* dst, const char* src, size_t size)
+{
+  size_t len = strlen(src);
+  if (size) {
+    size_t n = (len < size) ? len : size - 1;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+  }
+  return len;
+}
+#endif
+
+#define DEBUG_PRINT(x)
+#define DEBUG_PRINTLN(x)
+#define DEBUG_PRINTF(...)
+#define DEBUGFS_PRINT(x)
+#define DEBUGFS_PRINTLN(x)
+#define DEBUGFS_PRINTF(...)
+
+//by value, decltype(a < b ? a : b) is a reference to the argument if both have the same type
+template <typename A, typename B> inline auto min(A a, B b) -> typename std::common_type<A, B>::type { return (a < b) ? a : b; }
+template <typename A, typename B> inline auto max(A a, B b) -> typename std::common_type<A, B>::type { return (a < b) ? b : a; }
+#define constrain(x, lo, hi) ((x) < (lo) ? (lo) : ((x) > (hi) ? (hi) : (x)))
+
+/*
+ * Clock
+ * Runs with the real time (benchmarks, tests with threads), plus what a test added with hostAdvance().
+ * hostFreezeClock() stops the real time part, so time only passes when the test says so.
+ */
+inline std::chrono::steady_clock::time_point hostClockStart = std::chrono::steady_clock::now();
+inline uint64_t hostClockAdded = 0;    //us
+inline bool hostClockFrozen = false;
+inline uint64_t hostClockFrozenAt = 0; //real us when frozen
+
+inline uint64_t hostRealMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - hostClockStart).count();
+}
+inline uint64_t hostMicros64() { return (hostClockFrozen ? hostClockFrozenAt : hostRealMicros()) + hostClockAdded; }
+inline void hostAdvance(uint32_t ms) { hostClockAdded += (uint64_t)ms * 1000; }
+inline void hostAdvanceMicros(uint32_t us) { hostClockAdded += us; }
+inline void hostFreezeClock() { if (!hostClockFrozen) hostClockFrozenAt = hostRealMicros(); hostClockFrozen = true; }
+inline void hostUnfreezeClock() {
+  if (hostClockFrozen) hostClockAdded += hostClockFrozenAt - hostRealMicros();
+  hostClockFrozen = false;
+}
+
+inline unsigned long millis() { return hostMicros64() / 1000; }
+inline unsigned long micros() { return hostMicros64(); }
+inline void delay(unsigned long ms) { if (hostClockFrozen) hostAdvance(ms); else std::this_thread::sleep_for(std::chrono::milliseconds(ms)); }
+inline void yield() {}
+
+/*
+ * Network byte order and IPAddress
+ */
+#include <arpa/inet.h>
+
+class IPAddress {
+  public:
+    IPAddress() {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _a{a, b, c, d} {}
+    IPAddress(uint32_t ip) { memcpy(_a, &ip, 4); }
+    operator uint32_t() const { uint32_t ip; memcpy(&ip, _a, 4); return ip; }
+    uint8_t operator[](int i) const { return _a[i]; }
+    uint8_t& operator[](int i) { return _a[i]; }
+    bool operator==(const IPAddress& o) const { return !memcmp(_a, o._a, 4); }
+    inline class String toString() const;
+  private:
+    uint8_t _a[4] = {0, 0, 0, 0};
+};
+
+inline long random(long howbig) { return howbig ? rand() % howbig : 0; }
+inline long random(long howsmall, long howbig) { return (howsmall >= howbig) ? howsmall : howsmall + rand() % (howbig - howsmall); }
+
+/*
+ * Arduino String, only what the included sources use
+ */
+class String {
+  public:
+    String() {}
+    String(const char* s) : _s(s ? s : "") {}
+    String(const std::string& s) : _s(s) {}
+    explicit String(char c) : _s(1, c) {}
+    explicit String(int v) : _s(std::to_string(v)) {}
+    explicit String(unsigned int v) : _s(std::to_string(v)) {}
+    explicit String(long v) : _s(std::to_string(v)) {}
+    explicit String(unsigned long v) : _s(std::to_string(v)) {}
+    const char* c_str() const { return _s.c_str(); }
+    unsigned int length() const { return _s.length(); }
+    char charAt(unsigned int i) const { return (i < _s.length()) ? _s[i] : 0; }
+    char operator[](unsigned int i) const { return charAt(i); }
+    int indexOf(const char* s) const { size_t p = _s.find(s); return (p == std::string::npos) ? -1 : (int)p; }
+    int indexOf(const String& s) const { return indexOf(s.c_str()); }
+    int indexOf(char c, unsigned int from = 0) const { size_t p = _s.find(c, from); return (p == std::string::npos) ? -1 : (int)p; }
+    bool startsWith(const char* s) const { return _s.compare(0, strlen(s), s) == 0; }
+    bool endsWith(const char* s) const { size_t l = strlen(s); return _s.length() >= l && _s.compare(_s.length() - l, l, s) == 0; }
+    String substring(unsigned int from) const { return (from < _s.length()) ? String(_s.substr(from)) : String(); }
+    String substring(unsigned int from, unsigned int to) const { return (from < to && from < _s.length()) ? String(_s.substr(from, to - from)) : String(); }
+    long toInt() const { return atol(_s.c_str()); }
+    void remove(unsigned int from, unsigned int count = UINT_MAX) { if (from < _s.length()) _s.erase(from, count); }
+    String& operator+=(const String& o) { _s += o._s; return *this; }
+    String& operator+=(const char* o) { _s += o; return *this; }
+    String& operator+=(char c) { _s += c; return *this; }
+    bool equals(const char* s) const { return _s == s; }
+    bool operator==(const String& o) const { return _s == o._s; }
+    bool operator==(const char* o) const { return _s == o; }
+    bool operator!=(const char* o) const { return _s != o; }
+    bool operator<(const String& o) const { return _s < o._s; }
+    const std::string& str() const { return _s; }
+  private:
+    std::string _s;
+};
+inline String operator+(const String& a, const String& b) { String r(a); r += b; return r; }
+inline String operator+(const String& a, const char* b) { String r(a); r += b; return r; }
+inline String operator+(const char* a, const String& b) { String r(a); r += b; return r; }
+
+String IPAddress::toString() const
+{
+  char s[16];
+  snprintf(s, sizeof(s), "%u.%u.%u.%u", _a[0], _a[1], _a[2], _a[3]);
+  return String(s);
+}
+
+//String keys and values in JSON documents, like ARDUINOJSON_ENABLE_ARDUINO_STRING on the device (found by ADL)
+namespace ARDUINOJSON_NAMESPACE {
+template <> struct IsString< ::String> : true_type {};
+}
+inline ARDUINOJSON_NAMESPACE::SizedRamStringAdapter adaptString(const String& s)
+{
+  return ARDUINOJSON_NAMESPACE::SizedRamStringAdapter(s.c_str(), s.length());
+}
+
+/*
+ * In-memory file system
+ * hostFS.powerBudget limits the number of write operations (open for writing, write, remove, rename) until the
+ * power is "cut": the operation throws HostPowerCut, the files keep the state they had before it.
+ * With hostFS.spiffs, rename() fails if the destination exists, like on SPIFFS.
+ * bytesRead and bytesWritten count the file traffic, e.g. what a loop pass reads.
+ */
+struct HostPowerCut {};
+
+struct HostFS {
+  std::map<std::string, std::vector<uint8_t>> files;
+  long powerBudget = -1;   //write operations until the power is cut, <0 unlimited
+  bool spiffs = false;
+  uint32_t writeOps = 0;
+  uint32_t bytesWritten = 0;
+  uint32_t bytesRead = 0;
+
+  void op() {
+    if (powerBudget == 0) throw HostPowerCut();
+    if (powerBudget > 0) powerBudget--;
+    writeOps++;
+  }
+  void reset() { files.clear(); powerBudget = -1; spiffs = false; writeOps = 0; bytesWritten = 0; bytesRead = 0; }
+  bool has(const std::string& p) const { return files.count(p) > 0; }
+  std::string content(const std::string& p) const {
+    auto it = files.find(p);
+    return (it == files.end()) ? std::string() : std::string(it->second.begin(), it->second.end());
+  }
+  void put(const std::string& p, const std::string& s) { files[p] = std::vector<uint8_t>(s.begin(), s.end()); }
+};
+inline HostFS hostFS;
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File {
+  public:
+    File() {}
+    File(const std::string& path, bool write) : _path(path), _open(true), _write(write) {}
+    operator bool() const { return _open; }
+    size_t size() const { return _open ? data().size() : 0; }
+    size_t position() const { return _pos; }
+    const char* name() const { return _path.c_str(); }
+    bool seek(uint32_t pos, SeekMode mode = SeekSet) {
+      if (!_open) return false;
+      if (mode == SeekCur) pos += _pos;
+      else if (mode == SeekEnd) pos += data().size();
+      _pos = pos; return true;
+    }
+    int available() { return _open && _pos < data().size() ? data().size() - _pos : 0; }
+    int peek() { return (_open && _pos < data().size()) ? data()[_pos] : -1; }
+    int read() {
+      if (!_open || _pos >= data().size()) return -1;
+      hostFS.bytesRead++;
+      return data()[_pos++];
+    }
+    size_t read(uint8_t* buf, size_t len) {
+      size_t n = 0;
+      while (_open && n < len && _pos < data().size()) buf[n++] = data()[_pos++];
+      hostFS.bytesRead += n;
+      return n;
+    }
+    size_t readBytes(char* buf, size_t len) { return read((uint8_t*)buf, len); }
+    size_t write(uint8_t c) { return write(&c, 1); }
+    size_t write(const uint8_t* buf, size_t len) {
+      if (!_open || !_write) return 0;
+      hostFS.op();
+      std::vector<uint8_t>& d = hostFS.files[_path];
+      if (_pos + len > d.size()) d.resize(_pos + len);
+      memcpy(d.data() + _pos, buf, len);
+      _pos += len;
+      hostFS.bytesWritten += len;
+      return len;
+    }
+    size_t print(const char* s) { return write((const uint8_t*)s, strlen(s)); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(const String& s) { return print(s.c_str()); }
+    bool find(const char* target) {
+      size_t l = strlen(target), m = 0;
+      int c;
+      while ((c = read()) >= 0) {
+        m = (c == target[m]) ? m + 1 : (c == target[0]);
+        if (m == l) return true;
+      }
+      return false;
+    }
+    void flush() {}
+    void close() { _open = false; }
+  private:
+    const std::vector<uint8_t>& data() const { return hostFS.files[_path]; }
+    std::string _path;
+    size_t _pos = 0;
+    bool _open = false, _write = false;
+};
+
+struct FSInfo {
+  size_t totalBytes, usedBytes;
+};
+
+class HostFSWrapper {
+  public:
+    File open(const String& path, const char* mode) { return open(path.c_str(), mode); }
+    File open(const char* path, const char* mode) {
+      std::string p(path);
+      if (mode[0] == 'r' && !hostFS.has(p)) return File();
+      if (mode[0] == 'w') {
+        hostFS.op();
+        hostFS.files[p].clear();
+      } else if (mode[0] == 'a') {
+        hostFS.op();
+        File f(p, true);
+        f.seek(0, SeekEnd);
+        return f;
+      }
+      return File(p, mode[0] != 'r' || mode[1] == '+');
+    }
+    bool exists(const String& path) { return hostFS.has(path.c_str()); }
+    bool exists(const char* path) { return hostFS.has(path); }
+    bool remove(const String& path) { return remove(path.c_str()); }
+    bool remove(const char* path) {
+      if (!hostFS.has(path)) return false;
+      hostFS.op();
+      return hostFS.files.erase(path);
+    }
+    bool rename(const char* from, const char* to) {
+      if (!hostFS.has(from) || (hostFS.spiffs && hostFS.has(to))) return false;
+      hostFS.op();
+      hostFS.files[to] = hostFS.files[from];
+      hostFS.files.erase(from);
+      return true;
+    }
+    bool info(FSInfo& info) {
+      info.totalBytes = 1024 * 1024;
+      info.usedBytes = 0;
+      for (auto& f : hostFS.files) info.usedBytes += f.second.size();
+      return true;
+    }
+};
+inline HostFSWrapper WLED_FS;
+
+#include "../../wled00/const.h"
+
+#endif
@@ -0,0 +1,150 @@
+/*
+ * ClockSyncFilter (clock_sync.h) with a simulated remote node: network latency with random queueing
+ * delays, asymmetric paths and clock skew, polled like handleClockSync() does.
+ * Checks how close offset() gets to the true offset, the drift estimate, and recovery from a clock jump.
+ */
+#include <unity.h>
+#include <random>
+#include "../../wled00/clock_sync.h"
+
+#define FAST_INTERVAL_US  250000  //CLOCK_SYNC_FAST_INTERVAL
+#define INTERVAL_US      2000000  //CLOCK_SYNC_INTERVAL
+#define PROCESSING_US        300  //remote, between t2 and t3
+
+struct SimLink {
+  int64_t offset0;       //remote minus local clock at local time 0, us
+  double skewPpm;        //remote clock runs this much faster
+  uint32_t baseUs;       //one way latency
+  uint32_t asymUs;       //added to the request path only
+  double jitterMeanUs;   //mean of the exponential queueing delay, each way
+  std::mt19937 rng{42};
+
+  int64_t remote(int64_t local) { return offset0 + local + (int64_t)(local * skewPpm / 1e6); }
+  int64_t trueOffset(int64_t local) { return remote(local) - local; }
+  uint32_t oneWay(bool request) {
+    std::exponential_distribution<double> queue(1.0 / jitterMeanUs);
+    return baseUs + (request ? asymUs : 0) + (jitterMeanUs > 0 ? (uint32_t)queue(rng) : 0);
+  }
+};
+
+struct SimResult {
+  double maxErrUs;    //of offset() after convergence
+  double rmsErrUs;
+  double maxNaiveUs;  //error of the raw offset of each single exchange
+  uint32_t errorBoundViolations;
+};
+
+//runs exchanges for durationS seconds of local time, errors are collected after settleS
+static SimResult run(ClockSyncFilter& f, SimLink& link, int64_t& local, uint32_t durationS, uint32_t settleS)
+{
+  SimResult r = {0, 0, 0, 0};
+  uint32_t n = 0, exchanges = 0;
+  double sq = 0;
+  int64_t end = local + (int64_t)durationS * 1000000, settle = local + (int64_t)settleS * 1000000;
+  while (local < end) {
+    int64_t t1 = local;
+    int64_t dReq = link.oneWay(true), dResp = link.oneWay(false);
+    int64_t t2 = link.remote(t1 + dReq);
+    int64_t t3 = t2 + PROCESSING_US;
+    int64_t t4 = t1 + dReq + PROCESSING_US + dResp;
+    f.addSample(t1, t2, t3, t4);
+    exchanges++;
+
+    if (t4 > settle) {
+      double err = fabs((double)(f.offset(t4) - link.trueOffset(t4)));
+      double naive = fabs((double)(((t2 - t1) + (t3 - t4)) / 2 - link.trueOffset(t4)));
+      if (err > r.maxErrUs) r.maxErrUs = err;
+      if (naive > r.maxNaiveUs) r.maxNaiveUs = naive;
+      if (err > f.error() + link.asymUs) r.errorBoundViolations++;
+      sq += err * err; n++;
+    }
+    local += (exchanges < CLOCK_SYNC_WINDOW) ? FAST_INTERVAL_US : INTERVAL_US;
+  }
+  r.rmsErrUs = n ? sqrt(sq / n) : 0;
+  return r;
+}
+
+static void report(const char* name, ClockSyncFilter& f, const SimResult& r)
+{
+  char msg[192];
+  snprintf(msg, sizeof(msg), "%s: offset error max %.0f us rms %.0f us (single exchange max %.0f us), drift %.1f ppm, reported error %d us",
+    name, r.maxErrUs, r.rmsErrUs, r.maxNaiveUs, f.drift(), f.error());
+  TEST_MESSAGE(msg);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_constant_offset_symmetric_latency()
+{
+  ClockSyncFilter f; f.reset();
+  SimLink link = {123456789, 0, 2000, 0, 500};
+  int64_t local = 1000000;
+  SimResult r = run(f, link, local, 120, 10);
+  report("LAN", f, r);
+  TEST_ASSERT_TRUE(f.synced());
+  TEST_ASSERT_TRUE(r.maxErrUs < 500);
+  TEST_ASSERT_EQUAL_UINT32(0, r.errorBoundViolations);
+}
+
+void test_queueing_delays_are_filtered()
+{
+  ClockSyncFilter f; f.reset();
+  SimLink link = {-5000000, 0, 3000, 0, 15000}; //busy WiFi, 15 ms mean queueing each way
+  int64_t local = 1000000;
+  SimResult r = run(f, link, local, 300, 20);
+  report("busy WiFi", f, r);
+  TEST_ASSERT_TRUE(r.maxErrUs < 12000);         //below half a frame (24 ms)
+  TEST_ASSERT_TRUE(r.maxErrUs * 4 < r.maxNaiveUs); //much better than a single exchange
+}
+
+void test_skew_is_followed()
+{
+  ClockSyncFilter f; f.reset();
+  SimLink link = {1000, 100, 2000, 0, 1000}; //100 ppm, a bad crystal
+  int64_t local = 1000000;
+  SimResult r = run(f, link, local, 600, 60);
+  report("100 ppm skew", f, r);
+  TEST_ASSERT_FLOAT_WITHIN(15.0f, 100.0f, f.drift());
+  TEST_ASSERT_TRUE(r.maxErrUs < 1000);
+
+  //without drift compensation the offset would be 200 us off after one poll interval
+  int64_t later = local + INTERVAL_US;
+  TEST_ASSERT_TRUE(fabs((double)(f.offset(later) - link.trueOffset(later))) < 1000);
+}
+
+void test_negative_skew_and_asymmetric_path()
+{
+  ClockSyncFilter f; f.reset();
+  SimLink link = {7777777, -50, 2000, 4000, 1000}; //request path 4 ms slower (e.g. through a mesh node)
+  int64_t local = 1000000;
+  SimResult r = run(f, link, local, 600, 60);
+  report("-50 ppm, 4 ms asymmetry", f, r);
+  TEST_ASSERT_FLOAT_WITHIN(15.0f, -50.0f, f.drift());
+  //asymmetry can not be measured, half of it ends up in the offset
+  TEST_ASSERT_TRUE(r.maxErrUs < 2000 + 1000);
+  TEST_ASSERT_EQUAL_UINT32(0, r.errorBoundViolations);
+}
+
+void test_remote_clock_jump_restarts_estimate()
+{
+  ClockSyncFilter f; f.reset();
+  SimLink link = {50000000, 20, 2000, 0, 500};
+  int64_t local = 1000000;
+  run(f, link, local, 120, 10);
+  link.offset0 -= 40000000; //remote node rebooted
+  SimResult r = run(f, link, local, 120, 30);
+  report("after clock jump", f, r);
+  TEST_ASSERT_TRUE(r.maxErrUs < 1000);
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_constant_offset_symmetric_latency);
+  RUN_TEST(test_queueing_delays_are_filtered);
+  RUN_TEST(test_skew_is_followed);
+  RUN_TEST(test_negative_skew_and_asymmetric_path);
+  RUN_TEST(test_remote_clock_jump_restarts_estimate);
+  return UNITY_END();
+}
@@ -0,0 +1,124 @@
+/*
+ * Compositing of overlapping segments: the set bitmap follows the segment geometry of each frame,
+ * and the time composeSegments() takes for 1, 4 and 16 segments covering the same LEDs.
+ */
+#include <unity.h>
+#include "fx_host.h"
+
+#define LEDS   450 //16 full length buffers fit in MAX_COMPOSITE_DATA
+#define FRAMES 60
+
+WS2812FX strip;
+
+void setUp()
+{
+  busses.removeAll();
+  busses.transferUs = 0;
+  strip.resetSegments();
+  strip.finalizeInit(LEDS, false);
+  strip.setBrightness(255);
+}
+
+void tearDown() {}
+
+static void setupSegment(uint8_t n, uint16_t start, uint16_t stop, uint32_t color)
+{
+  strip.setSegment(n, start, stop, 1, 0);
+  WS2812FX::Segment& seg = strip.getSegment(n);
+  seg.setOption(SEG_OPTION_ON, true);
+  seg.mode = FX_MODE_STATIC;
+  seg.colors[0] = color;
+  seg.opacity = 255;
+  seg.blendMode = BLEND_MODE_NORMAL;
+}
+
+static void renderFrame()
+{
+  hostAdvance(MIN_SHOW_DELAY + 1);
+  strip.trigger();
+  strip.service();
+  busses.waitIdle();
+}
+
+//a segment that gets spacing must show the segment below in the gaps, not its own pixels of before
+void test_gaps_follow_spacing_change()
+{
+  setupSegment(0, 0, 100, 0x0000FF);
+  setupSegment(1, 0, 100, 0xFF0000);
+  renderFrame();
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, busses.getPixelColor(1));
+
+  strip.setSegment(1, 0, 100, 1, 1); //every other LED
+  renderFrame();
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, busses.getPixelColor(0));
+  TEST_ASSERT_EQUAL_HEX32(0x0000FF, busses.getPixelColor(1));
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, busses.getPixelColor(2));
+  TEST_ASSERT_EQUAL_HEX32(0x0000FF, busses.getPixelColor(3));
+
+  strip.setSegment(1, 0, 100, 1, 0); //and back
+  renderFrame();
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, busses.getPixelColor(1));
+}
+
+void test_gaps_follow_mirror_change()
+{
+  setupSegment(0, 0, 100, 0x0000FF);
+  setupSegment(1, 0, 100, 0xFF0000);
+  strip.setSegment(1, 0, 100, 1, 1);
+  strip.getSegment(1).setOption(SEG_OPTION_MIRROR, true);
+  renderFrame();
+  //mirrored from the end, LED 99 is drawn, 98 is a gap
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, busses.getPixelColor(99));
+  TEST_ASSERT_EQUAL_HEX32(0x0000FF, busses.getPixelColor(98));
+
+  strip.getSegment(1).setOption(SEG_OPTION_MIRROR, false);
+  renderFrame();
+  TEST_ASSERT_EQUAL_HEX32(0x0000FF, busses.getPixelColor(99));
+}
+
+static void benchmark(uint8_t segments)
+{
+  for (uint8_t n = 0; n < segments; n++) {
+    setupSegment(n, 0, LEDS, 0x010101 * (n * 15 + 1));
+    strip.getSegment(n).opacity = 128;
+    strip.getSegment(n).blendMode = n % BLEND_MODE_COUNT;
+  }
+  hostAdvance(RENDER_TIMING_WINDOW);
+  renderFrame(); //allocates the buffers, starts a new timing window for the frames below
+
+  WS2812FX::RenderTiming& compose = strip.getRenderTiming(RENDER_TIMING_COMPOSE);
+  uint32_t composeSum = compose.sum, composeCount = compose.count;
+  uint64_t frameUs = 0;
+  for (uint16_t f = 0; f < FRAMES; f++) {
+    hostAdvance(MIN_SHOW_DELAY + 1);
+    strip.trigger();
+    uint64_t t = hostRealMicros();
+    strip.service();
+    frameUs += hostRealMicros() - t;
+    busses.waitIdle();
+  }
+  composeSum = compose.sum - composeSum;
+  composeCount = compose.count - composeCount;
+
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%2u segments, %u LEDs: frame %5u us, compose %5u us",
+    segments, LEDS, (unsigned)(frameUs / FRAMES), composeCount ? composeSum / composeCount : 0);
+  TEST_MESSAGE(msg);
+  if (segments > 1) TEST_ASSERT_EQUAL_UINT32(FRAMES, composeCount);
+  else TEST_ASSERT_EQUAL_UINT32(0, composeCount); //no overlap, no buffer
+}
+
+void test_benchmark_1_segment()   { benchmark(1); }
+void test_benchmark_4_segments()  { benchmark(4); }
+void test_benchmark_16_segments() { benchmark(16); }
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_gaps_follow_spacing_change);
+  RUN_TEST(test_gaps_follow_mirror_change);
+  RUN_TEST(test_benchmark_1_segment);
+  RUN_TEST(test_benchmark_4_segments);
+  RUN_TEST(test_benchmark_16_segments);
+  return UNITY_END();
+}
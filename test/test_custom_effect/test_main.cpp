@@ -0,0 +1,107 @@
+/*
+ * Twin Comets, the effect of usermod_v2_custom_effect: rendered frame by frame, every pixel the
+ * comet passed since the last frame is drawn, also in the frame it wraps around to the start.
+ */
+#include <unity.h>
+#include "fx_host.h"
+#include "../../wled00/um_manager.h"
+
+WS2812FX strip;
+
+#include "../../usermods/usermod_v2_custom_effect/usermod_v2_custom_effect.h"
+
+#define LEDS 60
+
+//the first comet is RED, full red only in the frame it was drawn, it fades after,
+//the second one BLUE, also the color the tails fade to
+
+CustomEffectUsermod usermod;
+uint8_t twinComets = 255;
+
+//the position of the first comet like the effect computes it
+static uint16_t cometPos(uint16_t speed)
+{
+  uint16_t counter = strip.now * ((speed >> 2) + 8);
+  return ((uint32_t)counter * LEDS) >> 16;
+}
+
+static void renderFrame(uint16_t ms)
+{
+  hostAdvance(ms);
+  strip.trigger();
+  strip.service();
+  busses.waitIdle();
+}
+
+void setUp()
+{
+  hostFreezeClock();
+  busses.removeAll();
+  strip.resetSegments();
+  strip.finalizeInit(LEDS, false);
+  strip.setBrightness(255);
+  if (twinComets == 255) {
+    usermod.addEffects();
+    twinComets = strip.getModeCount() - 1;
+  }
+  WS2812FX::Segment& seg = strip.getSegment(0);
+  seg.mode = twinComets;
+  seg.palette = 0;
+  seg.colors[0] = RED;
+  seg.colors[1] = BLUE;
+  seg.intensity = 0; //longest tails
+}
+void tearDown() {}
+
+void test_registered()
+{
+  TEST_ASSERT_EQUAL(MODE_COUNT + 1, strip.getModeCount());
+  TEST_ASSERT_EQUAL_STRING("Twin Comets", strip.getModeName(twinComets));
+}
+
+//renders frames ms apart, checks the fresh pixels of the first comet are exactly the ones passed
+static uint16_t checkFrames(uint16_t speed, uint16_t ms, uint16_t frames)
+{
+  strip.getSegment(0).speed = speed;
+  renderFrame(ms);
+  uint16_t last = cometPos(speed), wraps = 0;
+  for (uint16_t f = 0; f < frames; f++) {
+    renderFrame(ms);
+    uint16_t pos = cometPos(speed);
+    if (pos < last) wraps++;
+    bool passed[LEDS] = {false};
+    for (uint16_t i = last; ; i = (i + 1) % LEDS) {
+      passed[i] = true;
+      if (i == pos) break;
+    }
+    for (uint16_t i = 0; i < LEDS; i++) {
+      bool second = passed[LEDS - 1 - i]; //the second comet drew here as well
+      char msg[64];
+      snprintf(msg, sizeof(msg), "frame %u, pixel %u, comet from %u to %u", f, i, last, pos);
+      if (passed[i] && !second) TEST_ASSERT_EQUAL_HEX32_MESSAGE(RED, busses.getPixelColor(i), msg);
+      if (!passed[i]) TEST_ASSERT_NOT_EQUAL_MESSAGE(RED, busses.getPixelColor(i), msg);
+    }
+    last = pos;
+  }
+  return wraps;
+}
+
+void test_slow_comet()
+{
+  TEST_ASSERT_TRUE(checkFrames(0, FRAMETIME, 400) > 0);
+}
+
+//more than one pixel per frame, the frame it wraps around in draws the end and the start of the segment
+void test_fast_comet_wraps()
+{
+  TEST_ASSERT_TRUE(checkFrames(255, 100, 60) >= 5);
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_registered);
+  RUN_TEST(test_slow_comet);
+  RUN_TEST(test_fast_comet_wraps);
+  return UNITY_END();
+}
@@ -0,0 +1,206 @@
+/*
+ * DMX output (dmx.cpp): the channel buffer built from the LED colors for sample fixture maps,
+ * the fixtures cut off at the end of the universe, and the bus only being written when
+ * something changed, rate limited, with the keepalive.
+ */
+#include <unity.h>
+#include "wled_host.h"
+
+#define WLED_ENABLE_DMX
+
+//what handleDMX() uses of the strip
+struct HostStrip {
+  std::vector<uint32_t> pixels;
+  uint8_t bri = 255;
+  uint32_t lastShow = 0;
+  uint32_t getPixelColor(uint16_t i) { return (i < pixels.size()) ? pixels[i] : 0; }
+  uint8_t getBrightness() { return bri; }
+  uint32_t getLastShow() { return lastShow; }
+  void show() { lastShow++; }
+};
+
+//ESPDMX, records the bus
+class DMXESPSerial {
+  public:
+    uint8_t channels[512];
+    int length = 0;
+    uint32_t writes = 0, updates = 0;
+    void init(int maxChan) { length = maxChan; memset(channels, 0, sizeof(channels)); }
+    void write(int ch, uint8_t v) {
+      TEST_ASSERT_TRUE(ch >= 1 && ch < length);
+      channels[ch] = v; writes++;
+    }
+    void update() { updates++; }
+};
+
+HostStrip strip;
+DMXESPSerial dmx;
+uint16_t ledCount = 0;
+uint16_t e131ProxyUniverse = 0;
+byte DMXChannels = 7;
+byte DMXFixtureMap[15] = {0};
+uint16_t DMXGap = 10, DMXStart = 10, DMXStartLED = 0;
+byte DMXRefreshRate = 30;
+bool doInitDMX = false;
+
+#include "../../wled00/dmx.cpp"
+
+//map values: 0 zero, 1 red, 2 green, 3 blue, 4 white, 5 shutter (brightness), 6 full
+static const byte mapRGB[] = {1, 2, 3};
+static const byte mapMovingHead[] = {5, 1, 2, 3, 4, 0, 6}; //dimmer, R, G, B, W, unused, strobe open
+
+static void configure(uint16_t leds, const byte* map, byte channels, uint16_t start, uint16_t gap, uint16_t startLED = 0)
+{
+  strip.pixels.assign(leds, 0);
+  for (uint16_t i = 0; i < leds; i++) strip.pixels[i] = ((uint32_t)(i & 0xFF) << 24) | (i << 16) | ((255 - i) << 8) | 0x40;
+  ledCount = leds;
+  memset(DMXFixtureMap, 0, sizeof(DMXFixtureMap));
+  memcpy(DMXFixtureMap, map, channels);
+  DMXChannels = channels;
+  DMXStart = start;
+  DMXGap = gap;
+  DMXStartLED = startLED;
+  doInitDMX = true;
+}
+
+//shows a frame and lets handleDMX() send it
+static void sendFrame()
+{
+  strip.show();
+  hostAdvance(1000);
+  handleDMX();
+}
+
+void setUp() { hostFreezeClock(); strip.bri = 255; }
+void tearDown() {}
+
+void test_rgb_pars()
+{
+  configure(20, mapRGB, 3, 1, 3);
+  sendFrame();
+  TEST_ASSERT_EQUAL_INT(60 + 1, dmx.length);
+  for (uint16_t f = 0; f < 20; f++) {
+    uint32_t c = strip.pixels[f];
+    TEST_ASSERT_EQUAL_UINT8((c >> 16) & 0xFF, dmx.channels[1 + 3 * f]);
+    TEST_ASSERT_EQUAL_UINT8((c >> 8) & 0xFF, dmx.channels[2 + 3 * f]);
+    TEST_ASSERT_EQUAL_UINT8(c & 0xFF, dmx.channels[3 + 3 * f]);
+  }
+}
+
+void test_moving_heads()
+{
+  configure(8, mapMovingHead, 7, 10, 10, 2);
+  strip.bri = 77;
+  sendFrame();
+  TEST_ASSERT_EQUAL_INT(66 + 1, dmx.length); //6 fixtures from LED 2, the last one ends on channel 10 + 50 + 6
+  for (uint16_t f = 0; f < 6; f++) {
+    uint32_t c = strip.pixels[2 + f];
+    const uint8_t* ch = &dmx.channels[10 + 10 * f];
+    TEST_ASSERT_EQUAL_UINT8(77, ch[0]);
+    TEST_ASSERT_EQUAL_UINT8((c >> 16) & 0xFF, ch[1]);
+    TEST_ASSERT_EQUAL_UINT8((c >> 8) & 0xFF, ch[2]);
+    TEST_ASSERT_EQUAL_UINT8(c & 0xFF, ch[3]);
+    TEST_ASSERT_EQUAL_UINT8(c >> 24, ch[4]);
+    TEST_ASSERT_EQUAL_UINT8(0, ch[5]);
+    TEST_ASSERT_EQUAL_UINT8(255, ch[6]);
+    for (uint8_t j = 7; j < 10 && 10 + 10 * f + j <= 66; j++) TEST_ASSERT_EQUAL_UINT8(0, ch[j]); //gap
+  }
+  for (uint8_t i = 1; i < 10; i++) TEST_ASSERT_EQUAL_UINT8(0, dmx.channels[i]);
+}
+
+void test_invalid_map_values_are_zero()
+{
+  const byte bad[] = {1, 7, 200};
+  configure(4, bad, 3, 1, 3);
+  sendFrame();
+  for (uint16_t f = 0; f < 4; f++) {
+    TEST_ASSERT_EQUAL_UINT8(f, dmx.channels[1 + 3 * f]);
+    TEST_ASSERT_EQUAL_UINT8(0, dmx.channels[2 + 3 * f]);
+    TEST_ASSERT_EQUAL_UINT8(0, dmx.channels[3 + 3 * f]);
+  }
+}
+
+void test_fixtures_end_with_the_universe()
+{
+  configure(300, mapMovingHead, 7, 10, 10);
+  sendFrame(); //write() asserts every channel is within the bus
+  TEST_ASSERT_EQUAL_INT(506 + 1, dmx.length); //50 fixtures, the 51st would end on channel 516
+  TEST_ASSERT_EQUAL_UINT8(strip.pixels[49] >> 16, dmx.channels[500 + 1]);
+
+  configure(4, mapRGB, 3, 1, 3); //short rig, short frame
+  sendFrame();
+  TEST_ASSERT_EQUAL_INT(DMX_MIN_CHANNELS + 1, dmx.length);
+}
+
+void test_settings_apply_in_the_loop()
+{
+  configure(20, mapRGB, 3, 1, 3);
+  sendFrame();
+  //the settings handler changes the settings, the next frame may be built before the flag is seen
+  DMXChannels = 15; DMXGap = 400; DMXStart = 500;
+  buildDMXFrame(); //still with the settings of the last init, stays within dmxFrame
+  TEST_ASSERT_EQUAL_UINT8(strip.pixels[19] >> 16, dmxFrame[1 + 3 * 19]);
+
+  const byte swapped[] = {3, 2, 1};
+  configure(20, swapped, 3, 1, 3);
+  sendFrame();
+  TEST_ASSERT_FALSE(doInitDMX);
+  TEST_ASSERT_EQUAL_UINT8(strip.pixels[5] & 0xFF, dmx.channels[1 + 3 * 5]);
+}
+
+void test_bus_only_updated_on_change()
+{
+  configure(20, mapRGB, 3, 1, 3);
+  sendFrame();
+  uint32_t updates = dmx.updates, writes = dmx.writes;
+
+  //same colors: nothing to send until the keepalive
+  strip.show();
+  hostAdvance(100);
+  handleDMX();
+  TEST_ASSERT_EQUAL_UINT32(updates, dmx.updates);
+  hostAdvance(DMX_KEEPALIVE_MS);
+  handleDMX();
+  TEST_ASSERT_EQUAL_UINT32(updates + 1, dmx.updates);
+  TEST_ASSERT_EQUAL_UINT32(writes, dmx.writes);
+
+  //one LED changed: only its channels are written, at most DMXRefreshRate times per second
+  strip.pixels[7] = 0x123456;
+  strip.show();
+  hostAdvance(1);
+  handleDMX();
+  TEST_ASSERT_EQUAL_UINT32(updates + 1, dmx.updates); //1ms after the keepalive, rate limited
+  hostAdvance(1000 / DMXRefreshRate);
+  handleDMX();
+  TEST_ASSERT_EQUAL_UINT32(updates + 2, dmx.updates);
+  TEST_ASSERT_EQUAL_UINT32(writes + 3, dmx.writes);
+  TEST_ASSERT_EQUAL_UINT8(0x34, dmx.channels[2 + 3 * 7]);
+}
+
+void test_proxy_mode_does_not_send()
+{
+  configure(20, mapRGB, 3, 1, 3);
+  sendFrame();
+  uint32_t updates = dmx.updates;
+  e131ProxyUniverse = 1;
+  strip.pixels[0] = 0xFFFFFF;
+  sendFrame();
+  TEST_ASSERT_EQUAL_UINT32(updates, dmx.updates);
+  e131ProxyUniverse = 0;
+  sendFrame();
+  TEST_ASSERT_EQUAL_UINT32(updates + 1, dmx.updates);
+  TEST_ASSERT_EQUAL_UINT8(0xFF, dmx.channels[1]);
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_rgb_pars);
+  RUN_TEST(test_moving_heads);
+  RUN_TEST(test_invalid_map_values_are_zero);
+  RUN_TEST(test_fixtures_end_with_the_universe);
+  RUN_TEST(test_settings_apply_in_the_loop);
+  RUN_TEST(test_bus_only_updated_on_change);
+  RUN_TEST(test_proxy_mode_does_not_send);
+  return UNITY_END();
+}
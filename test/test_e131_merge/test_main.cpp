@@ -0,0 +1,266 @@
+/*
+ * E1.31/Art-Net sources sending the same universe (e131.cpp): two interleaved senders replayed
+ * through handleE131Packet() with each merge mode, priorities, stream termination, the source
+ * timeout and the per source sequence check.
+ */
+#include <unity.h>
+#include "e131_host.h"
+
+//what applyE131Packet() uses of the strip
+struct HostStrip {
+  uint8_t bri = 255;
+  void setBrightness(uint8_t b) { bri = b; }
+  uint8_t getModeCount() { return 118; }
+};
+
+HostStrip strip;
+uint16_t e131Universe = 1;
+byte DMXMode = DMX_MODE_MULTIPLE_RGB;
+uint16_t DMXAddress = 1;
+byte DMXOldDimmer = 0;
+bool e131SkipOutOfSequence = false;
+byte e131MergeMode = E131_MERGE_LTP;
+bool e131NewData = false;
+IPAddress realtimeIP;
+uint16_t realtimeTimeoutMs = 2500;
+byte realtimeOverride = REALTIME_OVERRIDE_NONE;
+byte bri = 128, effectCurrent = 0, effectSpeed = 0, effectIntensity = 0, effectPalette = 0, transitionDelayTemp = 0;
+byte col[4], colSec[4];
+uint16_t ledCount = 4;
+uint32_t pixels[4];
+uint32_t applied = 0;
+
+void lockStrip() {}
+void unlockStrip() {}
+void colorUpdated(int callMode) {}
+void realtimeLock(uint32_t timeoutMs, byte md) {}
+void setRealtimePixel(uint16_t i, byte r, byte g, byte b, byte w)
+{
+  if (i < ledCount) pixels[i] = ((uint32_t)r << 16) | (g << 8) | b;
+  if (i == 0) applied++;
+}
+
+#include "../../wled00/e131.cpp"
+
+struct Sender {
+  uint8_t cid;
+  uint8_t priority;
+  uint8_t seq;
+  IPAddress ip;
+};
+
+//sends one E1.31 frame: the first LED gets color c, the others the sender's CID
+static void sendE131(Sender& s, uint32_t c, bool terminate = false)
+{
+  static e131_packet_t p;
+  memset(&p, 0, sizeof(p));
+  memset(p.cid, s.cid, 16);
+  p.priority = s.priority;
+  p.sequence_number = s.seq++;
+  p.options = terminate ? E131_OPTION_TERMINATED : 0;
+  p.universe = htons(e131Universe);
+  p.property_value_count = htons(ledCount * 3 + 1);
+  for (uint16_t i = 0; i < ledCount; i++) {
+    uint32_t v = i ? s.cid : c;
+    p.property_values[1 + i * 3] = v >> 16;
+    p.property_values[2 + i * 3] = v >> 8;
+    p.property_values[3 + i * 3] = v;
+  }
+  handleE131Packet(&p, s.ip, P_E131);
+}
+
+static void sendArtNet(Sender& s, uint32_t c)
+{
+  static e131_packet_t p;
+  memset(&p, 0, sizeof(p));
+  p.art_sequence_number = s.seq++;
+  p.art_universe = e131Universe;
+  p.art_length = htons(ledCount * 3 + 1); //the LEDs start at DMXAddress (1) like with E1.31
+  for (uint16_t i = 0; i < ledCount; i++) {
+    uint32_t v = i ? s.cid : c;
+    p.art_data[1 + i * 3] = v >> 16;
+    p.art_data[2 + i * 3] = v >> 8;
+    p.art_data[3 + i * 3] = v;
+  }
+  handleE131Packet(&p, s.ip, P_ARTNET);
+}
+
+/*
+ * Replays A and B at 40 fps, B starting 12ms after A, for the given time.
+ * Counts the packets each of them got applied (by the color of the other LEDs after the packet).
+ */
+struct Replay { uint32_t fromA = 0, fromB = 0, dropped = 0; };
+
+static Replay replay(Sender& a, uint32_t colA, Sender& b, uint32_t colB, uint32_t ms)
+{
+  Replay r;
+  for (uint32_t t = 0; t < ms; t += 25) {
+    for (uint8_t k = 0; k < 2; k++) {
+      Sender& s = k ? b : a;
+      uint32_t before = applied;
+      sendE131(s, k ? colB : colA);
+      if (applied == before) r.dropped++;
+      else if (pixels[1] == a.cid) r.fromA++;
+      else r.fromB++;
+      hostAdvance(k ? 13 : 12);
+    }
+  }
+  return r;
+}
+
+static void forgetSources()
+{
+  hostAdvance(E131_SOURCE_TIMEOUT + 1);
+  for (uint8_t u = 0; u < E131_MAX_UNIVERSE_COUNT; u++) {
+    for (uint8_t i = 0; i < E131_MAX_SOURCES; i++) isE131SourceActive(e131Sources[u][i], millis());
+  }
+}
+
+void setUp()
+{
+  hostFreezeClock();
+  forgetSources();
+  e131MergeMode = E131_MERGE_LTP;
+  e131SkipOutOfSequence = false;
+  applied = 0;
+}
+void tearDown() {}
+
+void test_single_source()
+{
+  Sender a = {0xA1, 100, 0};
+  Sender b = {0xB2, 100, 0};
+  static const uint8_t modes[] = {E131_MERGE_LTP, E131_MERGE_HTP, E131_MERGE_PRIORITY};
+  for (uint8_t m : modes) {
+    setUp();
+    e131MergeMode = m;
+    for (uint8_t i = 0; i < 10; i++) { sendE131(a, 0x100000 * i); hostAdvance(25); }
+    TEST_ASSERT_EQUAL_UINT32(10, applied);
+    TEST_ASSERT_EQUAL_HEX32(0x900000, pixels[0]);
+    //B takes over once A went quiet
+    hostAdvance(E131_SOURCE_TIMEOUT);
+    sendE131(b, 0x0000FF);
+    TEST_ASSERT_EQUAL_HEX32(0x0000FF, pixels[0]);
+  }
+}
+
+void test_ltp_is_default()
+{
+  TEST_ASSERT_EQUAL(0, E131_MERGE_LTP); //an unset cfg value means LTP
+  Sender a = {0xA1, 100, 0};
+  Sender b = {0xB2, 100, 0};
+  Replay r = replay(a, 0xFF0000, b, 0x00FF00, 2000);
+  TEST_ASSERT_EQUAL_UINT32(80, r.fromA);
+  TEST_ASSERT_EQUAL_UINT32(80, r.fromB);
+  TEST_ASSERT_EQUAL_UINT32(0, r.dropped);
+  TEST_ASSERT_EQUAL_HEX32(0x00FF00, pixels[0]);
+}
+
+void test_htp()
+{
+  e131MergeMode = E131_MERGE_HTP;
+  Sender a = {0xA1, 100, 0};
+  Sender b = {0xB2, 100, 0};
+  Replay r = replay(a, 0xFF0010, b, 0x00FF20, 1000);
+  TEST_ASSERT_EQUAL_UINT32(0, r.dropped);
+  TEST_ASSERT_EQUAL_HEX32(0xFFFF20, pixels[0]); //highest value per channel
+  TEST_ASSERT_EQUAL_HEX32(0x0000B2, pixels[1]);
+
+  //A stops sending, only B is left after the timeout
+  for (uint32_t t = 0; t <= E131_SOURCE_TIMEOUT; t += 25) { sendE131(b, 0x00FF20); hostAdvance(25); }
+  TEST_ASSERT_EQUAL_HEX32(0x00FF20, pixels[0]);
+}
+
+void test_priority_mode_first_source_keeps_control()
+{
+  e131MergeMode = E131_MERGE_PRIORITY;
+  Sender a = {0xA1, 100, 0};
+  Sender b = {0xB2, 100, 0};
+  Replay r = replay(a, 0xFF0000, b, 0x00FF00, 1000);
+  TEST_ASSERT_EQUAL_UINT32(40, r.fromA);
+  TEST_ASSERT_EQUAL_UINT32(0, r.fromB);
+  TEST_ASSERT_EQUAL_UINT32(40, r.dropped);
+
+  //A terminates its stream, B takes over at once
+  sendE131(a, 0, true);
+  sendE131(b, 0x00FF00);
+  TEST_ASSERT_EQUAL_HEX32(0x00FF00, pixels[0]);
+  sendE131(a, 0xFF0000); //A is back, B stays in control
+  TEST_ASSERT_EQUAL_HEX32(0x00FF00, pixels[0]);
+}
+
+void test_higher_priority_wins_in_every_mode()
+{
+  static const uint8_t modes[] = {E131_MERGE_LTP, E131_MERGE_HTP, E131_MERGE_PRIORITY};
+  for (uint8_t m : modes) {
+    setUp();
+    e131MergeMode = m;
+    Sender a = {0xA1, 100, 0};
+    Sender b = {0xB2, 150, 0};
+    Replay r = replay(a, 0xFF0000, b, 0x00FF00, 1000);
+    TEST_ASSERT_EQUAL_UINT32(1, r.fromA); //before B started
+    TEST_ASSERT_EQUAL_UINT32(40, r.fromB);
+    TEST_ASSERT_EQUAL_HEX32(0x00FF00, pixels[0]);
+
+    //B lost, A takes over after the timeout
+    for (uint32_t t = 0; t <= E131_SOURCE_TIMEOUT + 25; t += 25) { sendE131(a, 0xFF0000); hostAdvance(25); }
+    TEST_ASSERT_EQUAL_HEX32(0xFF0000, pixels[0]);
+  }
+}
+
+void test_third_source_rejected()
+{
+  Sender a = {0xA1, 100, 0};
+  Sender b = {0xB2, 100, 0};
+  Sender c = {0xC3, 100, 0};
+  sendE131(a, 0xFF0000);
+  sendE131(b, 0x00FF00);
+  uint32_t before = applied;
+  sendE131(c, 0x0000FF);
+  TEST_ASSERT_EQUAL_UINT32(before, applied);
+  Sender d = {0xD4, 120, 0}; //unless it has a higher priority
+  sendE131(d, 0x0000FF);
+  TEST_ASSERT_EQUAL_HEX32(0x0000FF, pixels[0]);
+}
+
+void test_sequence_checked_per_source()
+{
+  e131SkipOutOfSequence = true;
+  Sender a = {0xA1, 100, 0};
+  Sender b = {0xB2, 100, 200}; //far apart sequence numbers must not make either look late
+  Replay r = replay(a, 0xFF0000, b, 0x00FF00, 2000);
+  TEST_ASSERT_EQUAL_UINT32(0, r.dropped);
+
+  //a late packet of A is still skipped
+  a.seq -= 5;
+  uint32_t before = applied;
+  sendE131(a, 0xFF0000);
+  TEST_ASSERT_EQUAL_UINT32(before, applied);
+}
+
+void test_artnet_sources_by_ip()
+{
+  e131MergeMode = E131_MERGE_PRIORITY;
+  Sender a = {0, 0, 0, IPAddress(10, 0, 0, 1)};
+  Sender b = {0, 0, 0, IPAddress(10, 0, 0, 2)};
+  sendArtNet(a, 0xFF0000);
+  sendArtNet(b, 0x00FF00);
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, pixels[0]);
+  sendArtNet(a, 0x800000);
+  TEST_ASSERT_EQUAL_HEX32(0x800000, pixels[0]);
+  TEST_ASSERT_TRUE(realtimeIP == IPAddress(10, 0, 0, 1));
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_single_source);
+  RUN_TEST(test_ltp_is_default);
+  RUN_TEST(test_htp);
+  RUN_TEST(test_priority_mode_first_source_keeps_control);
+  RUN_TEST(test_higher_priority_wins_in_every_mode);
+  RUN_TEST(test_third_source_rejected);
+  RUN_TEST(test_sequence_checked_per_source);
+  RUN_TEST(test_artnet_sources_by_ip);
+  return UNITY_END();
+}
@@ -0,0 +1,177 @@
+/*
+ * Effect registry (WLED_EFFECTS in FX.h): the IDs, UI names and default palettes generated from the
+ * list are identical to the FX_MODE_* defines, JSON_mode_names and palette switch they replaced,
+ * so presets, the API and the UI keep addressing the same effects.
+ */
+#include <unity.h>
+#include "fx_host.h"
+
+WS2812FX strip;
+
+//as before the registry: define, its value, name in JSON_mode_names, default palette (switch in handle_palette())
+struct Effect { uint8_t id, value; const char* name; uint8_t palette; };
+
+static const Effect effects[] = {
+  {FX_MODE_STATIC,                  0, "Solid",                0},
+  {FX_MODE_BLINK,                   1, "Blink",                0},
+  {FX_MODE_BREATH,                  2, "Breathe",              0},
+  {FX_MODE_COLOR_WIPE,              3, "Wipe",                 0},
+  {FX_MODE_COLOR_WIPE_RANDOM,       4, "Wipe Random",          0},
+  {FX_MODE_RANDOM_COLOR,            5, "Random Colors",        0},
+  {FX_MODE_COLOR_SWEEP,             6, "Sweep",                0},
+  {FX_MODE_DYNAMIC,                 7, "Dynamic",              0},
+  {FX_MODE_RAINBOW,                 8, "Colorloop",            0},
+  {FX_MODE_RAINBOW_CYCLE,           9, "Rainbow",              0},
+  {FX_MODE_SCAN,                   10, "Scan",                 0},
+  {FX_MODE_DUAL_SCAN,              11, "Scan Dual",            0},
+  {FX_MODE_FADE,                   12, "Fade",                 0},
+  {FX_MODE_THEATER_CHASE,          13, "Theater",              0},
+  {FX_MODE_THEATER_CHASE_RAINBOW,  14, "Theater Rainbow",      0},
+  {FX_MODE_RUNNING_LIGHTS,         15, "Running",              0},
+  {FX_MODE_SAW,                    16, "Saw",                  0},
+  {FX_MODE_TWINKLE,                17, "Twinkle",              0},
+  {FX_MODE_DISSOLVE,               18, "Dissolve",             0},
+  {FX_MODE_DISSOLVE_RANDOM,        19, "Dissolve Rnd",         0},
+  {FX_MODE_SPARKLE,                20, "Sparkle",              0},
+  {FX_MODE_FLASH_SPARKLE,          21, "Sparkle Dark",         0},
+  {FX_MODE_HYPER_SPARKLE,          22, "Sparkle+",             0},
+  {FX_MODE_STROBE,                 23, "Strobe",               0},
+  {FX_MODE_STROBE_RAINBOW,         24, "Strobe Rainbow",       0},
+  {FX_MODE_MULTI_STROBE,           25, "Strobe Mega",          0},
+  {FX_MODE_BLINK_RAINBOW,          26, "Blink Rainbow",        0},
+  {FX_MODE_ANDROID,                27, "Android",              0},
+  {FX_MODE_CHASE_COLOR,            28, "Chase",                0},
+  {FX_MODE_CHASE_RANDOM,           29, "Chase Random",         0},
+  {FX_MODE_CHASE_RAINBOW,          30, "Chase Rainbow",        0},
+  {FX_MODE_CHASE_FLASH,            31, "Chase Flash",          0},
+  {FX_MODE_CHASE_FLASH_RANDOM,     32, "Chase Flash Rnd",      0},
+  {FX_MODE_CHASE_RAINBOW_WHITE,    33, "Rainbow Runner",       0},
+  {FX_MODE_COLORFUL,               34, "Colorful",             0},
+  {FX_MODE_TRAFFIC_LIGHT,          35, "Traffic Light",        0},
+  {FX_MODE_COLOR_SWEEP_RANDOM,     36, "Sweep Random",         0},
+  {FX_MODE_RUNNING_COLOR,          37, "Running 2",            0},
+  {FX_MODE_AURORA,                 38, "Aurora",               0},
+  {FX_MODE_RUNNING_RANDOM,         39, "Stream",               0},
+  {FX_MODE_LARSON_SCANNER,         40, "Scanner",              0},
+  {FX_MODE_COMET,                  41, "Lighthouse",           0},
+  {FX_MODE_FIREWORKS,              42, "Fireworks",            0},
+  {FX_MODE_RAIN,                   43, "Rain",                 0},
+  {FX_MODE_TETRIX,                 44, "Tetrix",               0},
+  {FX_MODE_FIRE_FLICKER,           45, "Fire Flicker",         0},
+  {FX_MODE_GRADIENT,               46, "Gradient",             0},
+  {FX_MODE_LOADING,                47, "Loading",              0},
+  {FX_MODE_POLICE,                 48, "Police",               0},
+  {FX_MODE_POLICE_ALL,             49, "Police All",           0},
+  {FX_MODE_TWO_DOTS,               50, "Two Dots",             0},
+  {FX_MODE_TWO_AREAS,              51, "Two Areas",            0},
+  {FX_MODE_CIRCUS_COMBUSTUS,       52, "Circus",               0},
+  {FX_MODE_HALLOWEEN,              53, "Halloween",            0},
+  {FX_MODE_TRICOLOR_CHASE,         54, "Tri Chase",            0},
+  {FX_MODE_TRICOLOR_WIPE,          55, "Tri Wipe",             0},
+  {FX_MODE_TRICOLOR_FADE,          56, "Tri Fade",             0},
+  {FX_MODE_LIGHTNING,              57, "Lightning",            0},
+  {FX_MODE_ICU,                    58, "ICU",                  0},
+  {FX_MODE_MULTI_COMET,            59, "Multi Comet",          0},
+  {FX_MODE_DUAL_LARSON_SCANNER,    60, "Scanner Dual",         0},
+  {FX_MODE_RANDOM_CHASE,           61, "Stream 2",             0},
+  {FX_MODE_OSCILLATE,              62, "Oscillate",            0},
+  {FX_MODE_PRIDE_2015,             63, "Pride 2015",           0},
+  {FX_MODE_JUGGLE,                 64, "Juggle",               0},
+  {FX_MODE_PALETTE,                65, "Palette",              0},
+  {FX_MODE_FIRE_2012,              66, "Fire 2012",           35},
+  {FX_MODE_COLORWAVES,             67, "Colorwaves",          26},
+  {FX_MODE_BPM,                    68, "Bpm",                  0},
+  {FX_MODE_FILLNOISE8,             69, "Fill Noise",           9},
+  {FX_MODE_NOISE16_1,              70, "Noise 1",             20},
+  {FX_MODE_NOISE16_2,              71, "Noise 2",             43},
+  {FX_MODE_NOISE16_3,              72, "Noise 3",             35},
+  {FX_MODE_NOISE16_4,              73, "Noise 4",             26},
+  {FX_MODE_COLORTWINKLE,           74, "Colortwinkles",        0},
+  {FX_MODE_LAKE,                   75, "Lake",                 0},
+  {FX_MODE_METEOR,                 76, "Meteor",               4},
+  {FX_MODE_METEOR_SMOOTH,          77, "Meteor Smooth",        4},
+  {FX_MODE_RAILWAY,                78, "Railway",              4},
+  {FX_MODE_RIPPLE,                 79, "Ripple",               4},
+  {FX_MODE_TWINKLEFOX,             80, "Twinklefox",           4},
+  {FX_MODE_TWINKLECAT,             81, "Twinklecat",           4},
+  {FX_MODE_HALLOWEEN_EYES,         82, "Halloween Eyes",       4},
+  {FX_MODE_STATIC_PATTERN,         83, "Solid Pattern",        4},
+  {FX_MODE_TRI_STATIC_PATTERN,     84, "Solid Pattern Tri",    4},
+  {FX_MODE_SPOTS,                  85, "Spots",                4},
+  {FX_MODE_SPOTS_FADE,             86, "Spots Fade",           4},
+  {FX_MODE_GLITTER,                87, "Glitter",             11},
+  {FX_MODE_CANDLE,                 88, "Candle",               4},
+  {FX_MODE_STARBURST,              89, "Fireworks Starburst",  4},
+  {FX_MODE_EXPLODING_FIREWORKS,    90, "Fireworks 1D",         4},
+  {FX_MODE_BOUNCINGBALLS,          91, "Bouncing Balls",       4},
+  {FX_MODE_SINELON,                92, "Sinelon",              4},
+  {FX_MODE_SINELON_DUAL,           93, "Sinelon Dual",         4},
+  {FX_MODE_SINELON_RAINBOW,        94, "Sinelon Rainbow",      4},
+  {FX_MODE_POPCORN,                95, "Popcorn",              4},
+  {FX_MODE_DRIP,                   96, "Drip",                 4},
+  {FX_MODE_PLASMA,                 97, "Plasma",               4},
+  {FX_MODE_PERCENT,                98, "Percent",              4},
+  {FX_MODE_RIPPLE_RAINBOW,         99, "Ripple Rainbow",       4},
+  {FX_MODE_HEARTBEAT,             100, "Heartbeat",            4},
+  {FX_MODE_PACIFICA,              101, "Pacifica",             4},
+  {FX_MODE_CANDLE_MULTI,          102, "Candle Multi",         4},
+  {FX_MODE_SOLID_GLITTER,         103, "Solid Glitter",        4},
+  {FX_MODE_SUNRISE,               104, "Sunrise",             35},
+  {FX_MODE_PHASED,                105, "Phased",               4},
+  {FX_MODE_TWINKLEUP,             106, "Twinkleup",            4},
+  {FX_MODE_NOISEPAL,              107, "Noise Pal",            4},
+  {FX_MODE_SINEWAVE,              108, "Sine",                 4},
+  {FX_MODE_PHASEDNOISE,           109, "Phased Noise",         4},
+  {FX_MODE_FLOW,                  110, "Flow",                 6},
+  {FX_MODE_CHUNCHUN,              111, "Chunchun",             4},
+  {FX_MODE_DANCING_SHADOWS,       112, "Dancing Shadows",      4},
+  {FX_MODE_WASHING_MACHINE,       113, "Washing Machine",      4},
+  {FX_MODE_CANDY_CANE,            114, "Candy Cane",           4},
+  {FX_MODE_BLENDS,                115, "Blends",               4},
+  {FX_MODE_TV_SIMULATOR,          116, "TV Simulator",         4},
+  {FX_MODE_DYNAMIC_SMOOTH,        117, "Dynamic Smooth",       4},
+};
+#define EFFECTS (sizeof(effects) / sizeof(effects[0]))
+
+void setUp() {}
+void tearDown() {}
+
+void test_ids()
+{
+  TEST_ASSERT_EQUAL(118, EFFECTS);
+  TEST_ASSERT_EQUAL(EFFECTS, MODE_COUNT);
+  TEST_ASSERT_EQUAL(MODE_COUNT, strip.getModeCount());
+  for (uint8_t i = 0; i < EFFECTS; i++) {
+    TEST_ASSERT_EQUAL_UINT8(effects[i].value, effects[i].id);
+    TEST_ASSERT_EQUAL_UINT8(i, effects[i].id);
+  }
+}
+
+void test_names()
+{
+  DynamicJsonDocument doc(8192);
+  TEST_ASSERT_TRUE(deserializeJson(doc, JSON_mode_names) == DeserializationError::Ok);
+  JsonArray names = doc.as<JsonArray>();
+  TEST_ASSERT_EQUAL(EFFECTS, names.size());
+  for (uint8_t i = 0; i < EFFECTS; i++) {
+    TEST_ASSERT_EQUAL_STRING(effects[i].name, names[i].as<const char*>());
+    TEST_ASSERT_EQUAL_STRING(effects[i].name, strip.getModeName(effects[i].id));
+  }
+  TEST_ASSERT_NULL(strip.getModeName(MODE_COUNT));
+}
+
+void test_default_palettes()
+{
+  for (uint8_t i = 0; i < EFFECTS; i++) {
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(effects[i].palette, strip.getModeDefaultPalette(effects[i].id), effects[i].name);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_ids);
+  RUN_TEST(test_names);
+  RUN_TEST(test_default_palettes);
+  return UNITY_END();
+}
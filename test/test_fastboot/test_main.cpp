@@ -0,0 +1,206 @@
+/*
+ * Fast boot cache (boot.cpp): it is used for the boot preset it was saved for, it is not used after
+ * presets.json was uploaded or deleted through the web server (file.cpp), also if the new file has
+ * the same size, not for a preset that sets more than it restores or a cache of another layout, and the time
+ * restoring it takes next to finding the boot preset in presets.json.
+ */
+#include <unity.h>
+#include "fx_host.h"
+#include "server_host.h"
+
+#define PRESETS 50
+#define RUNS    20
+
+#define VERSION 2104020
+
+WS2812FX strip;
+bool fastBoot = true;
+byte bootPreset = 7;
+uint16_t ledCount = 30;
+byte bri = 128, effectCurrent = 0, effectSpeed = 128, effectIntensity = 128, effectPalette = 0;
+byte col[4] = {255, 160, 0, 0}, colSec[4] = {0, 0, 0, 0};
+int16_t currentPreset = -1, currentPlaylist = -1;
+bool isPreset = false;
+bool doCloseFile = false;
+byte errorFlag = 0;
+size_t fsBytesUsed = 0, fsBytesTotal = 0;
+
+void updateFSInfo();
+void invalidateFileETag(const char* path);
+bool writeObjectToFile(const char* file, const char* key, JsonDocument* content);
+bool readObjectFromFileUsingId(const char* file, uint16_t id, JsonDocument* dest);
+void invalidateFastBootState();
+bool readObjectFromFile(const char* file, const char* key, JsonDocument* dest);
+void serializeConfig() {}
+void invalidatePlaylistPrefetch() {}
+void flushPresets();
+void flushPersistence();
+bool presetsPending();
+bool commitTempFile(const char* tmp, const char* path);
+bool admitRequest(AsyncWebServerRequest* request, uint8_t lane, bool respond) { return true; }
+bool handleIfNoneMatchCacheHeader(AsyncWebServerRequest* request, const char* etag) { return false; }
+void setStaticContentCacheHeaders(AsyncWebServerResponse* response, const char* etag) {}
+
+#include "../../wled00/boot.cpp"
+#include "../../wled00/file.cpp"
+#include "../../wled00/persist.cpp"
+
+//a presets.json like the UI writes, preset n with brightness b, the boot preset also with bootExtra
+static std::string presetsJson(uint8_t b, const char* bootExtra = "")
+{
+  std::string s = "{\"0\":{}";
+  char buf[200];
+  for (uint16_t i = 1; i <= PRESETS; i++) {
+    snprintf(buf, sizeof(buf), ",\"%u\":{\"n\":\"Preset %02u\",\"on\":true,\"bri\":%03u,%s"
+      "\"seg\":[{\"id\":0,\"start\":0,\"stop\":30,\"col\":[[255,160,0],[0,0,0],[0,0,0]],\"fx\":%u,\"sx\":128,\"ix\":128}]}",
+      i, i, b, (i == bootPreset) ? bootExtra : "", i % 10);
+    s += buf;
+  }
+  return s + "}";
+}
+
+//uploads a file in pieces like the web server hands them over
+static void upload(const char* name, const std::string& content)
+{
+  AsyncWebServerRequest request;
+  size_t index = 0;
+  do {
+    size_t len = (content.size() - index < 1460) ? content.size() - index : 1460;
+    handleFileUpload(&request, name, index, (uint8_t*)content.data() + index, len, index + len == content.size());
+    index += len;
+  } while (index < content.size());
+  handleFileUploadDone(&request);
+  hostLoopFileResponses();
+}
+
+static void boot()
+{
+  bri = 0;
+  currentPreset = -1;
+  isPreset = false;
+}
+
+void setUp()
+{
+  hostFS.reset();
+  hostFS.put("/presets.json", presetsJson(100));
+  busses.removeAll();
+  strip.resetSegments();
+  strip.finalizeInit(ledCount, false);
+  bri = 128;
+  saveFastBootState();
+}
+void tearDown() {}
+
+void test_cache_restores_boot_preset()
+{
+  boot();
+  TEST_ASSERT_TRUE(loadFastBootState());
+  TEST_ASSERT_EQUAL_UINT8(128, bri);
+  TEST_ASSERT_EQUAL_INT16(7, currentPreset);
+  TEST_ASSERT_TRUE(isPreset);
+
+  bootPreset = 8; //another boot preset
+  boot();
+  TEST_ASSERT_FALSE(loadFastBootState());
+  bootPreset = 7;
+}
+
+void test_upload_same_size_invalidates()
+{
+  std::string replaced = presetsJson(200);
+  TEST_ASSERT_EQUAL(hostFS.content("/presets.json").size(), replaced.size());
+  upload("presets.json", replaced);
+  TEST_ASSERT_EQUAL_STRING(replaced.c_str(), hostFS.content("/presets.json").c_str());
+  boot();
+  TEST_ASSERT_FALSE(loadFastBootState());
+}
+
+void test_other_upload_keeps_cache()
+{
+  upload("/ledmap.json", "{\"map\":[0,1,2]}");
+  boot();
+  TEST_ASSERT_TRUE(loadFastBootState());
+}
+
+void test_editor_delete_invalidates()
+{
+  hostFS.put("/presets.json", "{\"0\":{}}");
+  saveFastBootState();
+  AsyncWebServerRequest request;
+  request.addArg("path", "/presets.json");
+  handleFileDelete(&request);
+  hostLoopFileResponses();
+  TEST_ASSERT_EQUAL(200, request.response->code);
+  TEST_ASSERT_FALSE(hostFS.has("/presets.json"));
+  //the file is created again with the same content, and size, as before
+  hostFS.put("/presets.json", "{\"0\":{}}");
+  boot();
+  TEST_ASSERT_FALSE(loadFastBootState());
+}
+
+//a boot preset that also sets what the cache does not restore is applied from presets.json
+void test_preset_with_other_state_not_cached()
+{
+  const char* extras[] = {"\"transition\":7,", "\"nl\":{\"on\":true,\"dur\":30},", "\"udpn\":{\"send\":true},", "\"lor\":1,"};
+  for (const char* extra : extras) {
+    hostFS.put("/presets.json", presetsJson(100, extra));
+    saveFastBootState();
+    TEST_ASSERT_FALSE_MESSAGE(hostFS.has(FASTBOOT_FILE), extra);
+  }
+  hostFS.put("/presets.json", presetsJson(100, "\"mainseg\":0,"));
+  saveFastBootState();
+  TEST_ASSERT_TRUE(hostFS.has(FASTBOOT_FILE));
+}
+
+//a cache written by a build with another segment layout (same VERSION) is not used
+void test_layout_in_key()
+{
+  std::string cache = hostFS.content(FASTBOOT_FILE);
+  TEST_ASSERT_EQUAL(sizeof(FastBootState), cache.size());
+  FastBootState* s = (FastBootState*)&cache[0];
+  s->layout -= 4;
+  s->check = fastBootChecksum(*s);
+  hostFS.put(FASTBOOT_FILE, cache);
+  boot();
+  TEST_ASSERT_FALSE(loadFastBootState());
+}
+
+//time to first light: restoring the cache, or finding and parsing the boot preset in presets.json
+void test_boot_time()
+{
+  double cached = 1e9, parsed = 1e9;
+  DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+  for (uint8_t r = 0; r < RUNS; r++) {
+    boot();
+    uint64_t t = hostRealMicros();
+    bool ok = loadFastBootState();
+    double us = hostRealMicros() - t;
+    TEST_ASSERT_TRUE(ok);
+    if (us < cached) cached = us;
+
+    t = hostRealMicros();
+    ok = readObjectFromFileUsingId("/presets.json", bootPreset, &doc);
+    us = hostRealMicros() - t;
+    TEST_ASSERT_TRUE(ok);
+    TEST_ASSERT_EQUAL(100, doc["bri"].as<int>());
+    if (us < parsed) parsed = us;
+  }
+  char msg[128];
+  snprintf(msg, sizeof(msg), "boot preset %u of %u (presets.json %u bytes): cache %.1f us, presets.json %.1f us",
+    bootPreset, PRESETS, (unsigned)hostFS.content("/presets.json").size(), cached, parsed);
+  TEST_MESSAGE(msg);
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_cache_restores_boot_preset);
+  RUN_TEST(test_upload_same_size_invalidates);
+  RUN_TEST(test_other_upload_keeps_cache);
+  RUN_TEST(test_editor_delete_invalidates);
+  RUN_TEST(test_preset_with_other_state_not_cached);
+  RUN_TEST(test_layout_in_key);
+  RUN_TEST(test_boot_time);
+  return UNITY_END();
+}
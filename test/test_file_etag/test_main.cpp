@@ -0,0 +1,155 @@
+/*
+ * ETags of static files (file.cpp): a file changed by any write path (upload, in place preset edit,
+ * atomic JSON write, power cut recovery, delete and recreate) is served with a new ETag, also if it
+ * kept its size, a cached one gets a 304 otherwise, and the .etag sidecars are never served.
+ */
+#include <unity.h>
+#include "wled_host.h"
+#include "server_host.h"
+
+bool doCloseFile = false;
+byte errorFlag = 0;
+size_t fsBytesUsed = 0, fsBytesTotal = 0;
+
+void heapAllocFailed(uint8_t site) {}
+void serializeConfig() {}
+void invalidatePlaylistPrefetch() {}
+void invalidateFastBootState() {}
+void closeFile();
+void updateFSInfo();
+void flushPresets();
+void flushPersistence();
+bool presetsPending();
+bool commitTempFile(const char* tmp, const char* path);
+void invalidateFileETag(const char* path);
+bool writeObjectToFileUsingId(const char* file, uint16_t id, JsonDocument* content);
+bool writeObjectToFile(const char* file, const char* key, JsonDocument* content);
+bool readObjectFromFile(const char* file, const char* key, JsonDocument* dest);
+bool admitRequest(AsyncWebServerRequest* request, uint8_t lane, bool respond) { return true; }
+bool handleIfNoneMatchCacheHeader(AsyncWebServerRequest* request, const char* etag)
+{
+  AsyncWebHeader* header = request->getHeader("If-None-Match");
+  if (!header || header->value() != etag) return false;
+  request->send(304);
+  return true;
+}
+void setStaticContentCacheHeaders(AsyncWebServerResponse* response, const char* etag) { response->addHeader("ETag", etag); }
+
+#include "../../wled00/file.cpp"
+#include "../../wled00/persist.cpp"
+
+struct Reply {
+  int code;
+  std::string etag, body;
+};
+
+static Reply get(const char* path, const char* etag = nullptr)
+{
+  AsyncWebServerRequest request;
+  if (etag) request.addHeader("If-None-Match", etag);
+  if (!handleFileRead(&request, path)) return {404, "", ""};
+  const AsyncWebHeader* tag = request.response->header("ETag");
+  return {request.response->code, tag ? tag->value().str() : "", request.response->body};
+}
+
+static void upload(const char* name, const std::string& content)
+{
+  AsyncWebServerRequest request;
+  handleFileUpload(&request, name, 0, (uint8_t*)content.data(), content.size(), true);
+  handleFileUploadDone(&request);
+  hostLoopFileResponses();
+}
+
+//a cached copy is revalidated with a 304 as long as the file did not change
+static std::string cached(const char* path)
+{
+  Reply r = get(path);
+  TEST_ASSERT_EQUAL(200, r.code);
+  TEST_ASSERT_EQUAL(304, get(path, r.etag.c_str()).code);
+  return r.etag;
+}
+
+void setUp() { hostFS.reset(); }
+void tearDown() {}
+
+void test_upload()
+{
+  upload("/index.js", "var a=1;");
+  TEST_ASSERT_TRUE(hostFS.has("/index.js.etag"));
+  std::string etag = cached("/index.js");
+  upload("/index.js", "var a=2;");
+  Reply r = get("/index.js", etag.c_str());
+  TEST_ASSERT_EQUAL(200, r.code);
+  TEST_ASSERT_EQUAL_STRING("var a=2;", r.body.c_str());
+}
+
+void test_preset_edit_in_place()
+{
+  hostFS.put("/presets.json", "{\"0\":{},\"1\":{\"n\":\"A\",\"bri\":100}}");
+  std::string etag = cached("/presets.json");
+  DynamicJsonDocument doc(256);
+  deserializeJson(doc, "{\"n\":\"A\",\"bri\":200}");
+  TEST_ASSERT_TRUE(writeObjectToFileUsingId("/presets.json", 1, &doc)); //same length
+  closeFile();
+  TEST_ASSERT_EQUAL(200, get("/presets.json", etag.c_str()).code);
+}
+
+void test_atomic_write()
+{
+  StaticJsonDocument<64> doc;
+  doc["v"] = 1;
+  writeJsonAtomic("/cfg.json", &doc);
+  std::string etag = cached("/cfg.json");
+  doc["v"] = 2;
+  writeJsonAtomic("/cfg.json", &doc);
+  TEST_ASSERT_EQUAL(200, get("/cfg.json", etag.c_str()).code);
+}
+
+void test_recovered_file()
+{
+  hostFS.put("/presets.json", "{\"0\":{}}");
+  std::string etag = cached("/presets.json");
+  //the power was cut after the old file was removed on SPIFFS
+  hostFS.files.erase("/presets.json");
+  hostFS.put("/presets.json.tmp", "{\"1\":{}}");
+  recoverFiles();
+  Reply r = get("/presets.json", etag.c_str());
+  TEST_ASSERT_EQUAL(200, r.code);
+  TEST_ASSERT_EQUAL_STRING("{\"1\":{}}", r.body.c_str());
+}
+
+void test_delete_and_recreate()
+{
+  upload("/ledmap.json", "{\"map\":[0,1]}");
+  std::string etag = cached("/ledmap.json");
+  AsyncWebServerRequest request;
+  request.addArg("path", "/ledmap.json");
+  handleFileDelete(&request);
+  hostLoopFileResponses();
+  TEST_ASSERT_EQUAL(200, request.response->code);
+  TEST_ASSERT_FALSE(hostFS.has("/ledmap.json.etag"));
+  hostFS.put("/ledmap.json", "{\"map\":[1,0]}"); //written other than by an upload
+  TEST_ASSERT_EQUAL(200, get("/ledmap.json", etag.c_str()).code);
+}
+
+void test_sidecar_not_served()
+{
+  upload("/index.js", "var a=1;");
+  TEST_ASSERT_EQUAL(404, get("/index.js.etag").code);
+  upload("/index.js.etag", "12345678"); //would replace the tag of index.js
+  std::string etag = cached("/index.js");
+  upload("/index.js", "var a=2;");
+  TEST_ASSERT_EQUAL(200, get("/index.js", etag.c_str()).code);
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_upload);
+  RUN_TEST(test_preset_edit_in_place);
+  RUN_TEST(test_atomic_write);
+  RUN_TEST(test_recovered_file);
+  RUN_TEST(test_delete_and_recreate);
+  RUN_TEST(test_sidecar_not_served);
+  return UNITY_END();
+}
@@ -0,0 +1,338 @@
+/*
+ * JSON state batches (deserializeStateBatch() in json.cpp): N state objects applied one by one, as N commands
+ * queued at once, next to one N-element array, the time and peak heap of each. The batch sets the same state
+ * and sends a single notification, also if one of its objects changes the main segment.
+ */
+#include <unity.h>
+#include "fx_host.h"
+#include "server_host.h"
+#include "../../wled00/NodeStruct.h"
+
+#define WLED_DISABLE_ALEXA
+#define RUNS 50
+
+#define VERSION 2104020
+#define LWIP_VERSION_MAJOR 2
+#define LWIP_VERSION_MINOR 1
+#define LWIP_VERSION_REVISION 2
+#define RANDOM_REG32 ((uint32_t)rand())
+#define RENDER_TIMING_WINDOW 2000
+
+#include "../../wled00/um_manager.h"
+#include "../../wled00/um_manager.cpp"
+
+//what json.cpp and led.cpp use of the core and the globals of wled.h
+struct HostESP {
+  uint32_t getFreeHeap() { return 1 << 16; }
+  uint32_t getMaxFreeBlockSize() { return 1 << 15; }
+  uint32_t getMaxAllocHeap() { return 1 << 15; }
+  const char* getSdkVersion() { return "host"; }
+  String getCoreVersion() { return "host"; }
+  void* getResetInfoPtr() { return nullptr; }
+} ESP;
+struct HostWiFi {
+  int8_t RSSI() { return -60; }
+  int32_t channel() { return 1; }
+  String BSSIDstr() { return "00:00:00:00:00:00"; }
+  int getTxPower() { return 78; }
+  bool getSleep() { return false; }
+} WiFi;
+class AsyncWebSocketClient {
+  public:
+    size_t queueLength() { return 0; }
+    void text(const char* data, size_t len) {}
+};
+struct HostWebSocket {
+  AsyncWebSocketClient* client(uint32_t id) { return nullptr; }
+  size_t count() { return 0; }
+} ws;
+
+WS2812FX strip;
+uint16_t ledCount = 60;
+byte bri = 128, briS = 128, briLast = 128, briOld = 0, briT = 0, briIT = 0, briNlT = 0, briMultiplier = 100;
+byte col[4] = {255, 160, 0, 0}, colSec[4] = {0, 0, 0, 0};
+byte colIT[4] = {0, 0, 0, 0}, colSecIT[4] = {0, 0, 0, 0}, colNlT[4] = {0, 0, 0, 0};
+byte effectCurrent = 0, effectSpeed = 128, effectIntensity = 128, effectPalette = 0;
+bool effectChanged = false, fadeTransition = true, arlsForceMaxBri = false;
+bool transitionActive = false, jsonTransitionOnce = false;
+uint16_t transitionDelay = 0, transitionDelayTemp = 0;
+unsigned long transitionStartTime = 0;
+float tperLast = 0;
+bool nightlightActive = false, nightlightActiveOld = false;
+byte nightlightDelayMins = 60, nightlightMode = NL_MODE_FADE, nightlightTargetBri = 0;
+uint32_t nightlightDelayMs = 10;
+unsigned long nightlightStartTime = 0;
+byte macroNl = 0;
+bool presetCyclingEnabled = false;
+byte presetCycleMin = 1, presetCycleMax = 5, presetCycCurr = 1;
+uint16_t presetCycleTime = 12;
+unsigned long presetCycledTime = 0, presetsModifiedTime = 0;
+int16_t currentPreset = -1;
+bool isPreset = false;
+bool notifyDirect = true, receiveNotifications = true, syncToggleReceive = false;
+bool receiveNotificationBrightness = true, receiveNotificationColor = true, receiveNotificationEffects = true;
+byte interfaceUpdateCallMode = NOTIFIER_CALL_MODE_INIT;
+unsigned long lastInterfaceUpdate = 0;
+bool stateCheckRequested = false, doPublishMqtt = false, doReboot = false;
+uint32_t stateRevision = 0;
+unsigned long ntpLastSyncTime = 999000000L;
+byte realtimeMode = REALTIME_MODE_INACTIVE, realtimeOverride = REALTIME_OVERRIDE_NONE;
+unsigned long realtimeTimeout = 0;
+IPAddress realtimeIP;
+uint16_t rolloverMillis = 0, udpPort = 21324;
+byte errorFlag = 0;
+size_t fsBytesUsed = 0, fsBytesTotal = 0;
+char serverDescription[33] = "WLED";
+char versionString[] = "0.12.0";
+String escapedMac = "000000000000";
+bool nodeListEnabled = false;
+char* obuf = nullptr;
+uint16_t olen = 0;
+JsonDocument* fileDoc = nullptr;
+NodeTable Nodes(WLED_NODE_TABLE_SIZE, WLED_MAX_NODES);
+UsermodManager usermods;
+
+uint32_t notifications = 0; //notifications a change sends (notify() in udp.cpp)
+void notify(byte callMode, bool followUp = false) { if (callMode != NOTIFIER_CALL_MODE_NO_NOTIFY) notifications++; }
+void sendDataWs(AsyncWebSocketClient* client = nullptr) {}
+void updateBlynk() {}
+void publishMqtt() {}
+void unloadPlaylist() {}
+void loadPlaylist(JsonObject playlistObject) {}
+void applyPreset(byte index, byte callMode = NOTIFIER_CALL_MODE_DIRECT_CHANGE) {}
+void savePreset(byte index, bool persist = true, const char* pname = nullptr, JsonObject saveobj = JsonObject()) {}
+void deletePreset(byte index) {}
+bool handleSet(AsyncWebServerRequest* request, const String& req, bool apply = true) { return true; }
+void realtimeLock(uint32_t timeoutMs, byte md = REALTIME_MODE_GENERIC) {}
+void lockStrip() {}
+void unlockStrip() {}
+void setTime(unsigned long t) {}
+void colorFromUint32(uint32_t in, bool secondary = false)
+{
+  byte* c = secondary ? colSec : col;
+  c[0] = in >> 16; c[1] = in >> 8; c[2] = in; c[3] = in >> 24;
+}
+void colorKtoRGB(uint16_t kelvin, byte* rgb) {}
+void colorRGBtoRGBW(byte* rgb) {}
+bool colorFromHexString(byte* rgb, const char* in) { return false; }
+void serializeClockSync(JsonObject root) {}
+void serializeBootTimes(JsonObject root) {}
+void serializeHeap(JsonObject root) {}
+void serializePersistence(JsonObject root) {}
+void serializeServerLoad(JsonObject root) {}
+void serveStateSince(AsyncWebServerRequest* request, uint32_t since) {}
+void serializeState(JsonObject root, bool forPreset = false, bool includeBri = true, bool segmentBounds = true);
+void serializePerf(JsonObject root, bool segments = true);
+bool serveLiveLeds(AsyncWebServerRequest* request, uint32_t wsClient = 0);
+bool oappend(const char* txt) { return true; }
+bool oappendi(int i) { return true; }
+
+#include "../../wled00/led.cpp"
+#include "../../wled00/json.cpp"
+
+//heap used by the command payloads and JSON documents, allocated like cmdqueue.cpp does
+static size_t heapNow = 0, heapPeak = 0;
+
+static void* trackedAlloc(size_t n)
+{
+  size_t* p = (size_t*)malloc(n + sizeof(size_t));
+  if (!p) return nullptr;
+  *p = n;
+  heapNow += n;
+  if (heapNow > heapPeak) heapPeak = heapNow;
+  return p + 1;
+}
+static void trackedFree(void* ptr)
+{
+  if (!ptr) return;
+  size_t* p = (size_t*)ptr - 1;
+  heapNow -= *p;
+  free(p);
+}
+struct TrackedAllocator {
+  void* allocate(size_t n) { return trackedAlloc(n); }
+  void deallocate(void* p) { trackedFree(p); }
+  void* reallocate(void* p, size_t n) { void* r = trackedAlloc(n); if (r && p) memcpy(r, p, n); trackedFree(p); return r; }
+};
+typedef BasicJsonDocument<TrackedAllocator> TrackedJsonDocument;
+
+//command i of a scene: brightness, color and effect of one of 4 segments
+static std::string command(uint16_t i)
+{
+  char buf[96];
+  snprintf(buf, sizeof(buf), "{\"bri\":%u,\"seg\":{\"id\":%u,\"col\":[[%u,%u,0]],\"fx\":%u,\"sx\":%u}}",
+    100 + i, i % 4, (i * 37) & 0xFF, (i * 91) & 0xFF, i % 3, 64 + i);
+  return buf;
+}
+
+//queued at once, then applied one after the other (applyCommand())
+static void applySingles(const std::vector<std::string>& cmds)
+{
+  std::vector<char*> queued;
+  for (const std::string& c : cmds) {
+    char* payload = (char*)trackedAlloc(c.size() + 1);
+    memcpy(payload, c.c_str(), c.size() + 1);
+    queued.push_back(payload);
+  }
+  for (char* payload : queued) {
+    TrackedJsonDocument doc(JSON_BUFFER_SIZE);
+    deserializeJson(doc, payload, strlen(payload));
+    deserializeState(doc.as<JsonObject>());
+    trackedFree(payload);
+  }
+}
+
+static void applyBatch(const std::string& batch)
+{
+  char* payload = (char*)trackedAlloc(batch.size() + 1);
+  memcpy(payload, batch.c_str(), batch.size() + 1);
+  {
+    TrackedJsonDocument doc(JSON_BUFFER_SIZE);
+    deserializeJson(doc, payload, batch.size());
+    deserializeStateBatch(doc.as<JsonArray>());
+  }
+  trackedFree(payload);
+}
+
+static std::string batchOf(const std::vector<std::string>& cmds)
+{
+  std::string s = "[";
+  for (const std::string& c : cmds) s += (s.size() > 1 ? "," : "") + c;
+  return s + "]";
+}
+
+static void applyBatch(const std::vector<std::string>& cmds) { applyBatch(batchOf(cmds)); }
+
+static void resetState()
+{
+  busses.removeAll();
+  strip.resetSegments();
+  strip.finalizeInit(ledCount, false);
+  for (uint8_t i = 0; i < 4; i++) {
+    strip.setSegment(i, i * 15, (i + 1) * 15);
+    strip.getSegment(i).colors[0] = 0;
+  }
+  strip.mainSegment = 0;
+  bri = briIT = 128;
+  setValuesFromMainSeg();
+  for (uint8_t i = 0; i < 4; i++) { colIT[i] = col[i]; colSecIT[i] = colSec[i]; }
+  effectChanged = false;
+  interfaceUpdateCallMode = 0;
+  notifications = 0;
+}
+
+//the state all segments are in, to compare
+static std::string segmentState()
+{
+  std::string s;
+  char buf[48];
+  for (uint8_t i = 0; i < 4; i++) {
+    WS2812FX::Segment& seg = strip.getSegment(i);
+    snprintf(buf, sizeof(buf), "%06x/%u/%u ", (unsigned)seg.colors[0], seg.mode, seg.speed);
+    s += buf;
+  }
+  return s + std::to_string(bri);
+}
+
+void setUp() { resetState(); }
+void tearDown() {}
+
+//an array applies like its objects one by one, with one notification
+void test_batch_same_state()
+{
+  std::vector<std::string> cmds;
+  for (uint16_t i = 0; i < 8; i++) cmds.push_back(command(i));
+  applySingles(cmds);
+  std::string singles = segmentState();
+  TEST_ASSERT_EQUAL_UINT32(8, notifications);
+
+  resetState();
+  applyBatch(cmds);
+  TEST_ASSERT_EQUAL_STRING(singles.c_str(), segmentState().c_str());
+  TEST_ASSERT_EQUAL_UINT32(1, notifications);
+}
+
+struct ApplyCost { double us; size_t peak; uint32_t notifications; };
+
+template <typename Apply>
+static ApplyCost measure(Apply apply)
+{
+  ApplyCost best = {1e9, 0, 0};
+  for (uint8_t r = 0; r < RUNS; r++) {
+    resetState();
+    heapNow = heapPeak = 0;
+    uint64_t t = hostRealMicros();
+    apply();
+    double us = hostRealMicros() - t;
+    if (us < best.us) best.us = us;
+    best.peak = heapPeak;
+    best.notifications = notifications;
+  }
+  return best;
+}
+
+static void compare(uint16_t n)
+{
+  std::vector<std::string> cmds;
+  size_t bytes = 0;
+  for (uint16_t i = 0; i < n; i++) {
+    cmds.push_back(command(i));
+    bytes += cmds.back().size();
+  }
+  std::string batch = batchOf(cmds);
+  ApplyCost singles = measure([&] { applySingles(cmds); });
+  ApplyCost array = measure([&] { applyBatch(batch); });
+  //a document at a time, next to the payloads: all n queued ones, or the array
+  TEST_ASSERT_EQUAL_UINT32(JSON_BUFFER_SIZE + bytes + n, singles.peak);
+  TEST_ASSERT_EQUAL_UINT32(JSON_BUFFER_SIZE + batch.size() + 1, array.peak);
+
+  TEST_ASSERT_EQUAL_UINT32(n, singles.notifications);
+  TEST_ASSERT_EQUAL_UINT32(1, array.notifications);
+
+  char msg[240];
+  snprintf(msg, sizeof(msg), "%u objects (%u bytes): one by one %.1f us, peak heap %u bytes, %u notifications; "
+    "as an array %.1f us, peak heap %u bytes, %u notification",
+    n, (unsigned)bytes, singles.us, (unsigned)singles.peak, singles.notifications, array.us, (unsigned)array.peak, array.notifications);
+  TEST_MESSAGE(msg);
+}
+
+void test_cost_8() { compare(8); }
+void test_cost_16() { compare(16); }
+
+//the changes made before the main segment changes apply to the previous one, still one notification
+void test_mainseg_change_notifies_once()
+{
+  applyBatch(std::vector<std::string>{"{\"seg\":{\"id\":0,\"col\":[[255,0,0]]}}", "{\"mainseg\":1,\"seg\":{\"id\":1,\"col\":[[0,0,255]]}}"});
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, strip.getSegment(0).colors[0]);
+  TEST_ASSERT_EQUAL_HEX32(0x0000FF, strip.getSegment(1).colors[0]);
+  TEST_ASSERT_EQUAL_UINT8(1, strip.getMainSegmentId());
+  TEST_ASSERT_EQUAL_UINT32(1, notifications);
+}
+
+//also if nothing changes after it
+void test_mainseg_change_last()
+{
+  applyBatch(std::vector<std::string>{"{\"seg\":{\"id\":0,\"col\":[[255,0,0]]}}", "{\"mainseg\":1}"});
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, strip.getSegment(0).colors[0]);
+  TEST_ASSERT_EQUAL_UINT32(1, notifications);
+}
+
+//and none if no object wants one
+void test_mainseg_change_no_notification()
+{
+  applyBatch(std::vector<std::string>{"{\"udpn\":{\"nn\":true},\"seg\":{\"id\":0,\"col\":[[255,0,0]]}}", "{\"udpn\":{\"nn\":true},\"mainseg\":1}"});
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, strip.getSegment(0).colors[0]);
+  TEST_ASSERT_EQUAL_UINT32(0, notifications);
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_batch_same_state);
+  RUN_TEST(test_cost_8);
+  RUN_TEST(test_cost_16);
+  RUN_TEST(test_mainseg_change_notifies_once);
+  RUN_TEST(test_mainseg_change_last);
+  RUN_TEST(test_mainseg_change_no_notification);
+  return UNITY_END();
+}
@@ -0,0 +1,214 @@
+/*
+ * Custom LED maps (deserializeMap() in FX_fcn.cpp): ledmap.json and the binary ledmap.map give
+ * the same mapping, broken files are ignored, and the load time and peak heap for a 64x64
+ * serpentine matrix (4096 entries), next to what the ArduinoJson document used before needs.
+ */
+#include <unity.h>
+#include "fx_host.h"
+
+#define SIDE    64
+#define ENTRIES (SIDE * SIDE)
+#define RUNS    20
+
+//heap use of everything allocated with new
+static size_t heapNow = 0, heapPeak = 0;
+
+static void* trackedAlloc(size_t n)
+{
+  size_t* p = (size_t*)malloc(n + sizeof(size_t));
+  if (!p) return nullptr;
+  *p = n;
+  heapNow += n;
+  if (heapNow > heapPeak) heapPeak = heapNow;
+  return p + 1;
+}
+static void trackedFree(void* ptr)
+{
+  if (!ptr) return;
+  size_t* p = (size_t*)ptr - 1;
+  heapNow -= *p;
+  free(p);
+}
+void* operator new(size_t n) { void* p = trackedAlloc(n); if (!p) throw std::bad_alloc(); return p; }
+void* operator new[](size_t n) { void* p = trackedAlloc(n); if (!p) throw std::bad_alloc(); return p; }
+void* operator new(size_t n, const std::nothrow_t&) noexcept { return trackedAlloc(n); }
+void* operator new[](size_t n, const std::nothrow_t&) noexcept { return trackedAlloc(n); }
+void operator delete(void* p) noexcept { trackedFree(p); }
+void operator delete[](void* p) noexcept { trackedFree(p); }
+void operator delete(void* p, size_t) noexcept { trackedFree(p); }
+void operator delete[](void* p, size_t) noexcept { trackedFree(p); }
+
+WS2812FX strip;
+
+static uint16_t serpentine(uint16_t i)
+{
+  uint16_t row = i / SIDE, col = i % SIDE;
+  return row * SIDE + ((row & 1) ? SIDE - 1 - col : col);
+}
+
+static std::string mapJson(uint16_t (*fn)(uint16_t), uint16_t n)
+{
+  std::string s = "{\"n\":\"matrix\",\r\n\"map\":[";
+  for (uint16_t i = 0; i < n; i++) {
+    s += std::to_string(fn(i));
+    s += (i + 1 < n) ? ((i % SIDE == SIDE - 1) ? ",\r\n" : ", ") : "]}";
+  }
+  return s;
+}
+
+static void put16(std::string& s, uint16_t v) { s += (char)(v & 0xFF); s += (char)(v >> 8); }
+static void put32(std::string& s, uint32_t v) { put16(s, v); put16(s, v >> 16); }
+
+//one run per serpentine row
+static std::string mapBinary()
+{
+  std::string runs;
+  for (uint16_t r = 0; r < SIDE; r++) {
+    put16(runs, serpentine(r * SIDE));
+    put16(runs, (r & 1) ? -SIDE : SIDE);
+  }
+  uint32_t hash = 2166136261UL;
+  for (char c : runs) hash = (hash ^ (uint8_t)c) * 16777619UL;
+  std::string s;
+  put32(s, LEDMAP_BIN_MAGIC);
+  put16(s, ENTRIES);
+  put16(s, SIDE);
+  put32(s, hash);
+  return s + runs;
+}
+
+static void init(uint16_t leds = ENTRIES)
+{
+  busses.removeAll();
+  strip.resetSegments();
+  strip.finalizeInit(leds, false); //loads the map
+}
+
+//where each LED ends up on the bus
+static bool mappedLike(uint16_t (*fn)(uint16_t), uint16_t n)
+{
+  for (uint16_t i = 0; i < n; i++) strip.setPixelColor(i, 0, 0, 0, 0);
+  for (uint16_t i = 0; i < n; i++) {
+    strip.setPixelColor(i, (i >> 8) + 1, i & 0xFF, 0, 0);
+    if (busses.getPixelColor(fn(i)) != (((uint32_t)(i >> 8) + 1) << 16 | (i & 0xFF) << 8)) return false;
+  }
+  return true;
+}
+
+static uint16_t identity(uint16_t i) { return i; }
+static uint16_t reversed30(uint16_t i) { return 29 - i; }
+
+void setUp() { hostFS.reset(); }
+void tearDown() {}
+
+void test_json_map()
+{
+  hostFS.put("/ledmap.json", mapJson(serpentine, ENTRIES));
+  init();
+  TEST_ASSERT_TRUE(mappedLike(serpentine, ENTRIES));
+}
+
+void test_binary_map_preferred()
+{
+  hostFS.put("/ledmap.json", mapJson(reversed30, 30));
+  hostFS.put("/ledmap.map", mapBinary());
+  init();
+  TEST_ASSERT_TRUE(mappedLike(serpentine, ENTRIES));
+}
+
+void test_broken_binary_falls_back_to_json()
+{
+  hostFS.put("/ledmap.json", mapJson(reversed30, 30));
+  std::string bin = mapBinary();
+  bin[LEDMAP_BIN_HEADER + 5] ^= 1; //checksum mismatch
+  hostFS.put("/ledmap.map", bin);
+  init(30);
+  TEST_ASSERT_TRUE(mappedLike(reversed30, 30));
+
+  hostFS.put("/ledmap.map", mapBinary().substr(0, 100)); //truncated
+  init(30);
+  TEST_ASSERT_TRUE(mappedLike(reversed30, 30));
+}
+
+void test_broken_json_ignored()
+{
+  static const char* broken[] = {
+    "{\"map\":[0, 1, 2",          //truncated
+    "{\"map\":[0, 1.5, 2]}",      //decimals
+    "{\"map\":[]}",               //empty
+    "{\"nomap\":[2, 1, 0]}",
+    ""
+  };
+  for (const char* json : broken) {
+    hostFS.put("/ledmap.json", mapJson(reversed30, 30));
+    init(30);
+    TEST_ASSERT_TRUE(mappedLike(reversed30, 30));
+    hostFS.put("/ledmap.json", json); //a new broken file removes the old map
+    init(30);
+    TEST_ASSERT_TRUE(mappedLike(identity, 30));
+  }
+}
+
+//time and peak heap of loading the map: finalizeInit() with the file minus without it
+struct LoadCost { double us; size_t peak; };
+
+static LoadCost measureInit()
+{
+  LoadCost best = {1e9, 0};
+  for (uint8_t r = 0; r < RUNS; r++) {
+    auto files = hostFS.files;
+    hostFS.files.clear();
+    init(); //frees the map of the last run
+    hostFS.files = files;
+    busses.removeAll();
+    heapPeak = heapNow;
+    size_t base = heapNow;
+    uint64_t t = hostRealMicros();
+    init();
+    double us = hostRealMicros() - t;
+    if (us < best.us) best.us = us;
+    best.peak = heapPeak - base;
+  }
+  return best;
+}
+
+void test_load_cost_4096()
+{
+  LoadCost none = measureInit();
+  hostFS.put("/ledmap.json", mapJson(serpentine, ENTRIES));
+  LoadCost json = measureInit();
+  hostFS.put("/ledmap.map", mapBinary());
+  LoadCost bin = measureInit();
+
+  char msg[128];
+  snprintf(msg, sizeof(msg), "ledmap.json (%u bytes): %.0f us, peak heap %u bytes",
+    (unsigned)hostFS.content("/ledmap.json").size(), json.us - none.us, (unsigned)(json.peak - none.peak));
+  TEST_MESSAGE(msg);
+  snprintf(msg, sizeof(msg), "ledmap.map (%u bytes): %.0f us, peak heap %u bytes",
+    (unsigned)hostFS.content("/ledmap.map").size(), bin.us - none.us, (unsigned)(bin.peak - none.peak));
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL_UINT32(ENTRIES * sizeof(uint16_t), json.peak - none.peak); //only the table
+  TEST_ASSERT_EQUAL_UINT32(ENTRIES * sizeof(uint16_t), bin.peak - none.peak);
+
+  //the ArduinoJson document the map was parsed into before
+  std::string s = hostFS.content("/ledmap.json");
+  DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+  bool fits = deserializeJson(doc, s.c_str()) == DeserializationError::Ok;
+  DynamicJsonDocument big(256 * 1024);
+  deserializeJson(big, s.c_str());
+  snprintf(msg, sizeof(msg), "ArduinoJson document: needs %u bytes, JSON_BUFFER_SIZE %u %s",
+    (unsigned)big.memoryUsage(), (unsigned)JSON_BUFFER_SIZE, fits ? "fits" : "does not fit");
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_FALSE(fits);
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_json_map);
+  RUN_TEST(test_binary_map_preferred);
+  RUN_TEST(test_broken_binary_falls_back_to_json);
+  RUN_TEST(test_broken_json_ignored);
+  RUN_TEST(test_load_cost_4096);
+  return UNITY_END();
+}
@@ -0,0 +1,125 @@
+/*
+ * SpscQueue and Snapshot (lockfree.h) with a producer/writer and a consumer/reader thread,
+ * like the main loop and the render task. Items and snapshots are checked for loss, order and torn copies.
+ */
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "../../wled00/lockfree.h"
+
+#define STRESS_ITEMS 2000000UL
+#define STRESS_MIN_READS 10000
+
+typedef struct StressItem {
+  uint32_t seq;
+  uint32_t inv;   //~seq
+  uint32_t mul;   //seq * 2654435761
+} stress_item;
+
+static StressItem makeItem(uint32_t seq) { return {seq, ~seq, (uint32_t)(seq * 2654435761UL)}; }
+static bool isConsistent(const StressItem& s) { return s.inv == ~s.seq && s.mul == (uint32_t)(s.seq * 2654435761UL); }
+
+void setUp() {}
+void tearDown() {}
+
+void test_queue_fifo_full_empty()
+{
+  SpscQueue<uint32_t, 8> q;
+  uint32_t v;
+  TEST_ASSERT_TRUE(q.isEmpty());
+  TEST_ASSERT_FALSE(q.pop(v));
+  for (uint32_t i = 0; i < 7; i++) TEST_ASSERT_TRUE(q.push(i));
+  TEST_ASSERT_FALSE(q.push(7)); //one slot is kept free
+  for (uint32_t i = 0; i < 7; i++) {
+    TEST_ASSERT_TRUE(q.pop(v));
+    TEST_ASSERT_EQUAL_UINT32(i, v);
+  }
+  TEST_ASSERT_TRUE(q.isEmpty());
+  //indices wrap around
+  for (uint32_t i = 0; i < 100; i++) {
+    TEST_ASSERT_TRUE(q.push(i));
+    TEST_ASSERT_TRUE(q.pop(v));
+    TEST_ASSERT_EQUAL_UINT32(i, v);
+  }
+}
+
+void test_queue_threads_no_loss_in_order()
+{
+  static SpscQueue<StressItem, 16> q;
+  std::thread producer([&]() {
+    for (uint32_t i = 1; i <= STRESS_ITEMS; i++) {
+      while (!q.push(makeItem(i))) std::this_thread::yield(); //full
+    }
+  });
+
+  uint32_t expected = 1, torn = 0, outOfOrder = 0;
+  while (expected <= STRESS_ITEMS) {
+    StressItem s;
+    if (!q.pop(s)) { std::this_thread::yield(); continue; }
+    if (!isConsistent(s)) torn++;
+    if (s.seq != expected) outOfOrder++;
+    expected = s.seq + 1;
+  }
+  producer.join();
+
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_EQUAL_UINT32(0, outOfOrder);
+  TEST_ASSERT_TRUE(q.isEmpty());
+}
+
+void test_snapshot_empty()
+{
+  Snapshot<StressItem> s;
+  StressItem out;
+  TEST_ASSERT_FALSE(s.read(out)); //nothing written yet
+  s.write(makeItem(5));
+  TEST_ASSERT_TRUE(s.read(out));
+  TEST_ASSERT_EQUAL_UINT32(5, out.seq);
+}
+
+void test_snapshot_threads_never_torn()
+{
+  static Snapshot<StressItem> snap;
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> reads{0}, written{0};
+
+  //on a single core the writer could be done before the reader ran, it goes on until there were reads
+  std::thread writer([&]() {
+    uint32_t i = 0;
+    while (++i <= STRESS_ITEMS || reads < STRESS_MIN_READS) snap.write(makeItem(i));
+    written = i - 1;
+    done = true;
+  });
+
+  uint32_t busy = 0, torn = 0, backwards = 0, last = 0;
+  while (!done) {
+    StressItem s;
+    if (!snap.read(s)) { busy++; continue; }
+    reads++;
+    if (!isConsistent(s)) torn++;
+    if (s.seq < last) backwards++;
+    last = s.seq;
+  }
+  writer.join();
+
+  char msg[96];
+  snprintf(msg, sizeof(msg), "%u reads, %u gave up (writer busy)", reads.load(), busy);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL_UINT32(0, torn);
+  TEST_ASSERT_EQUAL_UINT32(0, backwards);
+  TEST_ASSERT_TRUE(reads >= STRESS_MIN_READS);
+
+  StressItem s;
+  TEST_ASSERT_TRUE(snap.read(s));
+  TEST_ASSERT_EQUAL_UINT32(written, s.seq);
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_queue_fifo_full_empty);
+  RUN_TEST(test_queue_threads_no_loss_in_order);
+  RUN_TEST(test_snapshot_empty);
+  RUN_TEST(test_snapshot_threads_never_torn);
+  return UNITY_END();
+}
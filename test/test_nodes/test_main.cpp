@@ -0,0 +1,215 @@
+/*
+ * Node discovery (NodeStruct.h) simulated with 150 nodes on one broadcast network:
+ * announce on boot and query, replies to simultaneous queries, aging, IP changes,
+ * and the time the node table takes for it.
+ */
+#include <unity.h>
+#include <deque>
+#include "wled_host.h"
+#include "../../wled00/NodeStruct.h"
+
+#define SIM_NODES 150
+#define ANNOUNCE_INTERVAL 30000 //sendSysInfoUDP() from the main loop
+
+typedef struct SimPacket {
+  uint32_t from;
+  uint32_t to;   //0 for broadcast
+  uint8_t type;  //1 announcement, 2 query
+} sim_packet;
+
+struct SimNode {
+  uint32_t ip;
+  bool online = true;
+  NodeTable table{WLED_NODE_TABLE_SIZE, WLED_MAX_NODES};
+  QueryRateLimit<WLED_NODE_QUERY_LIMIT_SLOTS> queryLimit;
+  uint32_t repliesSent = 0;
+};
+
+static SimNode* nodes[SIM_NODES];
+static std::deque<SimPacket> network;
+static uint32_t packetsSent = 0;
+static uint32_t simTime = 1000;
+
+static uint32_t simIP(uint16_t n) { return 0x0000A8C0 | ((uint32_t)(n / 250 + 1) << 16) | ((uint32_t)(n % 250 + 2) << 24); } //192.168.x.y
+
+static void send(uint32_t from, uint32_t to, uint8_t type)
+{
+  network.push_back({from, to, type});
+  packetsSent++;
+}
+
+//what handleNotifications() does with the packets of the second UDP port
+static void receive(SimNode& node, const SimPacket& p)
+{
+  if (p.from == node.ip) return; //own broadcast
+  if (p.type == 1) {
+    NodeStruct* n = node.table.insert(p.from);
+    if (n) {
+      n->lastSeen = simTime;
+      snprintf(n->nodeName, sizeof(n->nodeName), "Node %08x", p.from);
+    }
+  } else if (p.type == 2 && node.queryLimit.allow(p.from, simTime, WLED_NODE_QUERY_INTERVAL)) {
+    send(node.ip, p.from, 1);
+    node.repliesSent++;
+  }
+}
+
+static void deliverAll()
+{
+  while (!network.empty()) {
+    SimPacket p = network.front();
+    network.pop_front();
+    for (uint16_t i = 0; i < SIM_NODES; i++) {
+      if (!nodes[i]->online || (p.to && p.to != nodes[i]->ip)) continue;
+      receive(*nodes[i], p);
+    }
+  }
+}
+
+static void boot(SimNode& node)
+{
+  node.online = true;
+  send(node.ip, 0, 1); //announce right away
+  send(node.ip, 0, 2); //and ask the others
+}
+
+static uint16_t onlineCount()
+{
+  uint16_t n = 0;
+  for (uint16_t i = 0; i < SIM_NODES; i++) if (nodes[i]->online) n++;
+  return n;
+}
+
+void setUp()
+{
+  for (uint16_t i = 0; i < SIM_NODES; i++) {
+    nodes[i] = new SimNode();
+    nodes[i]->ip = simIP(i);
+  }
+  network.clear();
+  packetsSent = 0;
+  simTime = 1000;
+}
+
+void tearDown()
+{
+  for (uint16_t i = 0; i < SIM_NODES; i++) delete nodes[i];
+}
+
+//all nodes power up at once (same ms): everyone knows everyone after one round, without waiting for the periodic announcement
+void test_simultaneous_boot_converges_at_once()
+{
+  for (uint16_t i = 0; i < SIM_NODES; i++) boot(*nodes[i]);
+  uint64_t t = hostRealMicros();
+  deliverAll();
+  uint32_t us = hostRealMicros() - t;
+
+  for (uint16_t i = 0; i < SIM_NODES; i++) {
+    TEST_ASSERT_EQUAL_UINT16(SIM_NODES - 1, nodes[i]->table.size());
+    for (uint16_t j = 0; j < SIM_NODES; j++) {
+      if (i != j) TEST_ASSERT_NOT_NULL(nodes[i]->table.find(nodes[j]->ip));
+    }
+  }
+  char msg[128];
+  snprintf(msg, sizeof(msg), "%u nodes: %u packets, %u table updates in %u us, table %u bytes per node",
+    SIM_NODES, packetsSent, SIM_NODES * (SIM_NODES - 1) * 2, us, (unsigned)(sizeof(NodeStruct) * WLED_NODE_TABLE_SIZE));
+  TEST_MESSAGE(msg);
+}
+
+//a node answers the queries of all nodes asking at the same time, not only the first one
+void test_simultaneous_queries_are_all_answered()
+{
+  for (uint16_t i = 0; i < SIM_NODES; i++) send(nodes[i]->ip, 0, 2);
+  deliverAll();
+  for (uint16_t i = 0; i < SIM_NODES; i++) {
+    TEST_ASSERT_EQUAL_UINT32(SIM_NODES - 1, nodes[i]->repliesSent);
+    TEST_ASSERT_EQUAL_UINT16(SIM_NODES - 1, nodes[i]->table.size());
+  }
+}
+
+//a node flooding queries gets one reply per interval from each node
+void test_query_flood_is_limited_per_requester()
+{
+  for (uint16_t q = 0; q < 50; q++) {
+    send(nodes[0]->ip, 0, 2);
+    simTime += 10;
+    deliverAll();
+  }
+  //50 queries over 500 ms
+  uint32_t expected = 500 / WLED_NODE_QUERY_INTERVAL;
+  TEST_ASSERT_EQUAL_UINT32(expected, nodes[1]->repliesSent);
+
+  //other requesters are not affected
+  send(nodes[2]->ip, 0, 2);
+  deliverAll();
+  TEST_ASSERT_EQUAL_UINT32(expected + 1, nodes[1]->repliesSent);
+}
+
+//nodes that went offline age out, the others stay (aging by timestamp, deleting shifts entries)
+void test_offline_nodes_age_out()
+{
+  for (uint16_t i = 0; i < SIM_NODES; i++) boot(*nodes[i]);
+  deliverAll();
+  for (uint16_t i = 0; i < SIM_NODES; i += 7) nodes[i]->online = false;
+  uint16_t online = onlineCount();
+
+  for (uint32_t t = 0; t < WLED_NODE_MAX_AGE + 2 * ANNOUNCE_INTERVAL; t += ANNOUNCE_INTERVAL) {
+    simTime += ANNOUNCE_INTERVAL;
+    for (uint16_t i = 0; i < SIM_NODES; i++) if (nodes[i]->online) send(nodes[i]->ip, 0, 1);
+    deliverAll();
+    for (uint16_t i = 0; i < SIM_NODES; i++) nodes[i]->table.expire(simTime, WLED_NODE_MAX_AGE);
+  }
+
+  for (uint16_t i = 0; i < SIM_NODES; i++) {
+    if (!nodes[i]->online) continue;
+    TEST_ASSERT_EQUAL_UINT16(online - 1, nodes[i]->table.size());
+    for (uint16_t j = 0; j < SIM_NODES; j++) {
+      if (i == j) continue;
+      if (nodes[j]->online) TEST_ASSERT_NOT_NULL(nodes[i]->table.find(nodes[j]->ip));
+      else TEST_ASSERT_NULL(nodes[i]->table.find(nodes[j]->ip));
+    }
+  }
+}
+
+//a node getting a new IP (DHCP) announces itself again, its old entry ages out
+void test_ip_change()
+{
+  for (uint16_t i = 0; i < SIM_NODES; i++) boot(*nodes[i]);
+  deliverAll();
+  uint32_t oldIP = nodes[5]->ip;
+  nodes[5]->ip = simIP(SIM_NODES + 5);
+  boot(*nodes[5]);
+  deliverAll();
+  TEST_ASSERT_NOT_NULL(nodes[0]->table.find(nodes[5]->ip));
+  TEST_ASSERT_EQUAL_UINT16(SIM_NODES, nodes[0]->table.size()); //old entry still there
+
+  simTime += WLED_NODE_MAX_AGE + 1;
+  for (uint16_t i = 0; i < SIM_NODES; i++) send(nodes[i]->ip, 0, 1);
+  deliverAll();
+  nodes[0]->table.expire(simTime, WLED_NODE_MAX_AGE);
+  TEST_ASSERT_NULL(nodes[0]->table.find(oldIP));
+  TEST_ASSERT_NOT_NULL(nodes[0]->table.find(nodes[5]->ip));
+  TEST_ASSERT_EQUAL_UINT16(SIM_NODES - 1, nodes[0]->table.size());
+}
+
+//more nodes than WLED_MAX_NODES are not added, the table does not overflow
+void test_table_capacity()
+{
+  NodeTable table(WLED_NODE_TABLE_SIZE, WLED_MAX_NODES);
+  for (uint16_t i = 0; i < WLED_MAX_NODES; i++) TEST_ASSERT_NOT_NULL(table.insert(simIP(i)));
+  TEST_ASSERT_NULL(table.insert(simIP(WLED_MAX_NODES)));
+  TEST_ASSERT_NOT_NULL(table.insert(simIP(0))); //existing
+  TEST_ASSERT_EQUAL_UINT16(WLED_MAX_NODES, table.size());
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_simultaneous_boot_converges_at_once);
+  RUN_TEST(test_simultaneous_queries_are_all_answered);
+  RUN_TEST(test_query_flood_is_limited_per_requester);
+  RUN_TEST(test_offline_nodes_age_out);
+  RUN_TEST(test_ip_change);
+  RUN_TEST(test_table_capacity);
+  return UNITY_END();
+}
@@ -0,0 +1,267 @@
+/*
+ * Power cuts while files are written (persist.cpp, file.cpp): wherever the power is cut during a preset
+ * write, an atomic JSON write or an upload, the file is the old or the new one in full after recoverFiles(),
+ * on LittleFS and on SPIFFS (no atomic rename). An upload of presets.json is not overwritten by preset
+ * changes still pending when it was uploaded, only the loop writes. The web server handlers never wait for
+ * it: what waits for pending writes is answered by the loop, an upload or delete while another one waits gets 503.
+ */
+#include <unity.h>
+#include "wled_host.h"
+#include "server_host.h"
+
+bool doCloseFile = false;
+byte errorFlag = 0;
+size_t fsBytesUsed = 0, fsBytesTotal = 0;
+
+void heapAllocFailed(uint8_t site) {}
+void serializeConfig() {}
+void invalidatePlaylistPrefetch() {}
+void invalidateFastBootState() {}
+void closeFile();
+void updateFSInfo();
+void flushPresets();
+void flushPersistence();
+bool presetsPending();
+bool commitTempFile(const char* tmp, const char* path);
+void invalidateFileETag(const char* path);
+bool writeObjectToFileUsingId(const char* file, uint16_t id, JsonDocument* content);
+bool writeObjectToFile(const char* file, const char* key, JsonDocument* content);
+bool readObjectFromFile(const char* file, const char* key, JsonDocument* dest);
+bool admitRequest(AsyncWebServerRequest* request, uint8_t lane, bool respond) { return true; }
+bool handleIfNoneMatchCacheHeader(AsyncWebServerRequest* request, const char* etag) { return false; }
+void setStaticContentCacheHeaders(AsyncWebServerResponse* response, const char* etag) {}
+
+#include "../../wled00/file.cpp"
+#include "../../wled00/persist.cpp"
+
+#define OLD_PRESETS "{\"0\":{},\"1\":{\"n\":\"A\",\"bri\":100},\"2\":{\"n\":\"B\",\"bri\":120}}"
+#define NEW_PRESETS "{\"0\":{},\"3\":{\"n\":\"Uploaded\",\"bri\":10}}"
+
+//what is lost with the RAM when the power is cut
+static void reboot()
+{
+  hostFS.powerBudget = -1;
+  f = File();
+  doCloseFile = false;
+  clearPersistence();
+  fileOp.op = FILE_OP_NONE;
+  hostFileResponses.clear();
+  hostFileQueueFull = false;
+  recoverFiles();
+}
+
+//the file is one of the expected versions in full, no temporary file is left behind
+static void checkFile(const char* path, std::vector<std::string> versions, const char* msg)
+{
+  std::string content = hostFS.content(path);
+  DynamicJsonDocument doc(1024);
+  TEST_ASSERT_TRUE_MESSAGE(deserializeJson(doc, content) == DeserializationError::Ok, msg);
+  bool known = false;
+  for (const std::string& v : versions) {
+    DynamicJsonDocument expected(1024);
+    deserializeJson(expected, v);
+    if (doc == expected) known = true;
+  }
+  TEST_ASSERT_TRUE_MESSAGE(known, (std::string(msg) + ": " + content).c_str());
+  TEST_ASSERT_FALSE_MESSAGE(hostFS.has(std::string(path) + PERSIST_TMP_EXT), msg);
+  TEST_ASSERT_FALSE_MESSAGE(hostFS.has(std::string(path) + FILE_UPLOAD_EXT), msg);
+}
+
+static void editPreset(byte index, const char* json)
+{
+  DynamicJsonDocument doc(256);
+  deserializeJson(doc, json);
+  persistPreset(index, &doc);
+}
+
+static void upload(const char* name, const std::string& content)
+{
+  AsyncWebServerRequest request;
+  size_t index = 0;
+  do {
+    size_t len = (content.size() - index < 16) ? content.size() - index : 16;
+    handleFileUpload(&request, name, index, (uint8_t*)content.data() + index, len, index + len == content.size());
+    index += len;
+  } while (index < content.size());
+}
+
+/*
+ * Runs the scenario with the power cut after 0, 1, 2... write operations until it completes without a cut,
+ * the file must be one of the versions after each reboot. Returns the operations of a complete run.
+ */
+template <typename Scenario>
+static uint32_t cutEverywhere(bool spiffs, const char* path, std::vector<std::string> versions, Scenario run)
+{
+  for (long budget = 0; ; budget++) {
+    hostFS.reset();
+    hostFS.spiffs = spiffs;
+    hostFS.put("/presets.json", OLD_PRESETS);
+    hostFS.put("/cfg.json", "{\"v\":1}");
+    reboot();
+    hostFS.writeOps = 0;
+    hostFS.powerBudget = budget;
+    bool cut = false;
+    try {
+      run();
+    } catch (HostPowerCut&) {
+      cut = true;
+    }
+    uint32_t ops = hostFS.writeOps;
+    reboot();
+    char msg[64];
+    snprintf(msg, sizeof(msg), "%s, power cut after %ld writes", spiffs ? "SPIFFS" : "LittleFS", budget);
+    checkFile(path, versions, msg);
+    if (!cut) return ops;
+  }
+}
+
+void setUp() { hostFS.reset(); reboot(); }
+void tearDown() {}
+
+void test_preset_write()
+{
+  std::string edited = "{\"0\":{},\"1\":{\"n\":\"A\",\"bri\":100},\"2\":{\"n\":\"C\",\"bri\":50}}";
+  for (bool spiffs : {false, true}) {
+    uint32_t ops = cutEverywhere(spiffs, "/presets.json", {OLD_PRESETS, edited}, [] {
+      editPreset(2, "{\"n\":\"C\",\"bri\":50}");
+      flushPresets();
+    });
+    TEST_ASSERT_TRUE(ops > 2);
+    checkFile("/presets.json", {edited}, "no power cut");
+  }
+}
+
+void test_atomic_write()
+{
+  for (bool spiffs : {false, true}) {
+    cutEverywhere(spiffs, "/cfg.json", {"{\"v\":1}", "{\"v\":2}"}, [] {
+      StaticJsonDocument<64> doc;
+      doc["v"] = 2;
+      writeJsonAtomic("/cfg.json", &doc);
+    });
+    TEST_ASSERT_EQUAL_STRING("{\"v\":2}", hostFS.content("/cfg.json").c_str());
+  }
+}
+
+//uploaded while a preset change is pending: the old file (with or without the change) or the upload, never a mix
+void test_upload_presets()
+{
+  std::string edited = "{\"0\":{},\"1\":{\"n\":\"A\",\"bri\":100},\"2\":{\"n\":\"C\",\"bri\":50}}";
+  for (bool spiffs : {false, true}) {
+    cutEverywhere(spiffs, "/presets.json", {OLD_PRESETS, edited, NEW_PRESETS}, [] {
+      editPreset(2, "{\"n\":\"C\",\"bri\":50}");
+      upload("/presets.json", NEW_PRESETS);
+      handlePersistence();
+    });
+    TEST_ASSERT_EQUAL_STRING(NEW_PRESETS, hostFS.content("/presets.json").c_str());
+    TEST_ASSERT_FALSE(fileOpPending());
+  }
+}
+
+//the upload is written next to the file, which stays intact until the upload is complete
+void test_interrupted_upload()
+{
+  hostFS.put("/presets.json", OLD_PRESETS);
+  AsyncWebServerRequest request;
+  std::string content = NEW_PRESETS;
+  handleFileUpload(&request, "/presets.json", 0, (uint8_t*)content.data(), 16, false);
+  TEST_ASSERT_EQUAL_STRING(OLD_PRESETS, hostFS.content("/presets.json").c_str());
+  reboot(); //the connection dropped, or the power was cut
+  checkFile("/presets.json", {OLD_PRESETS}, "interrupted upload");
+}
+
+//a preset change pending while presets.json is uploaded is written before, to the old file
+void test_pending_preset_does_not_overwrite_upload()
+{
+  hostFS.put("/presets.json", OLD_PRESETS);
+  editPreset(1, "{\"n\":\"X\",\"bri\":1}");
+  upload("/presets.json", NEW_PRESETS);
+  hostAdvance(PERSIST_MAX_DELAY * 2);
+  handlePersistence();
+  handlePersistence();
+  TEST_ASSERT_EQUAL_STRING(NEW_PRESETS, hostFS.content("/presets.json").c_str());
+  editPreset(1, "{\"n\":\"X\",\"bri\":1}"); //the same change again is not skipped, the file was replaced
+  flushPresets();
+  TEST_ASSERT_TRUE(hostFS.content("/presets.json").find("\"X\"") != std::string::npos);
+}
+
+//the FS editor's delete is applied after pending writes, which would otherwise create the file again
+void test_delete_presets()
+{
+  hostFS.put("/presets.json", OLD_PRESETS);
+  editPreset(1, "{\"n\":\"X\",\"bri\":1}");
+  AsyncWebServerRequest request;
+  request.addArg("path", "/presets.json");
+  handleFileDelete(&request);
+  TEST_ASSERT_NULL(request.response); //answered once it was deleted
+  hostLoopFileResponses();
+  TEST_ASSERT_NOT_NULL(request.response);
+  TEST_ASSERT_EQUAL(200, request.response->code);
+  TEST_ASSERT_FALSE(hostFS.has("/presets.json"));
+}
+
+//an upload or delete while another one waits for the loop is answered with 503, the waiting one is kept
+void test_busy_while_op_pending()
+{
+  hostFS.put("/presets.json", OLD_PRESETS);
+  AsyncWebServerRequest del;
+  del.addArg("path", "/ledmap.json");
+  handleFileDelete(&del);
+
+  AsyncWebServerRequest request;
+  std::string content = NEW_PRESETS;
+  handleFileUpload(&request, "/presets.json", 0, (uint8_t*)content.data(), content.size(), true);
+  handleFileUploadDone(&request);
+  TEST_ASSERT_NOT_NULL(request.response);
+  TEST_ASSERT_EQUAL(503, request.response->code);
+  TEST_ASSERT_NOT_NULL(request.response->header("Retry-After"));
+  checkFile("/presets.json", {OLD_PRESETS}, "rejected upload");
+
+  AsyncWebServerRequest other;
+  other.addArg("path", "/presets.json");
+  handleFileDelete(&other);
+  TEST_ASSERT_NOT_NULL(other.response);
+  TEST_ASSERT_EQUAL(503, other.response->code);
+  TEST_ASSERT_NOT_NULL(other.response->header("Retry-After"));
+
+  hostLoopFileResponses();
+  TEST_ASSERT_NOT_NULL(del.response);
+  TEST_ASSERT_EQUAL(200, del.response->code);
+  TEST_ASSERT_TRUE(hostFS.has("/presets.json"));
+}
+
+//presets.json read with preset changes pending is served by the loop once it wrote them
+void test_presets_read_deferred()
+{
+  hostFS.put("/presets.json", OLD_PRESETS);
+  editPreset(2, "{\"n\":\"C\",\"bri\":50}");
+  AsyncWebServerRequest request;
+  TEST_ASSERT_TRUE(handleFileRead(&request, "/presets.json"));
+  TEST_ASSERT_NULL(request.response);
+  hostLoopFileResponses();
+  TEST_ASSERT_NOT_NULL(request.response);
+  TEST_ASSERT_EQUAL(200, request.response->code);
+  TEST_ASSERT_TRUE(request.response->body.find("\"C\"") != std::string::npos);
+
+  editPreset(2, "{\"n\":\"D\",\"bri\":50}");
+  hostFileQueueFull = true;
+  AsyncWebServerRequest busy;
+  TEST_ASSERT_TRUE(handleFileRead(&busy, "/presets.json"));
+  TEST_ASSERT_NOT_NULL(busy.response);
+  TEST_ASSERT_EQUAL(503, busy.response->code);
+  TEST_ASSERT_NOT_NULL(busy.response->header("Retry-After"));
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_preset_write);
+  RUN_TEST(test_atomic_write);
+  RUN_TEST(test_upload_presets);
+  RUN_TEST(test_interrupted_upload);
+  RUN_TEST(test_pending_preset_does_not_overwrite_upload);
+  RUN_TEST(test_delete_presets);
+  RUN_TEST(test_busy_while_op_pending);
+  RUN_TEST(test_presets_read_deferred);
+  return UNITY_END();
+}
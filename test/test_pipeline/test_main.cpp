@@ -0,0 +1,140 @@
+/*
+ * Pipelined LED output (WS2812FX::pipelineOutput) on a simulated bus that takes longer to send a frame
+ * than the effects take to render one: the frames sent out must be complete (no tearing, every pixel
+ * from the same frame, in order), at the same frame rate, without service() waiting for the bus.
+ */
+#include <unity.h>
+#include <mutex>
+#include "fx_host.h"
+
+#define LEDS        300
+#define TRANSFER_US 40000 //slow bus, about 1300 WS2812 LEDs
+#define RENDER_US   8000  //slow effect
+#define RUN_MS      1000
+
+WS2812FX strip;
+
+static uint32_t frameNo = 0;
+static std::mutex sentMux;
+static std::vector<uint32_t> sentFrames; //frame number of each frame sent, 0xFFFFFFFF if it was torn
+
+//fills the segment with the frame number, the first segment takes RENDER_US to do so
+static uint16_t mode_frame_number(WS2812FX& s, WS2812FX::Segment& seg, WS2812FX::Segment_runtime& env)
+{
+  if (&seg == &s.getSegment(0)) std::this_thread::sleep_for(std::chrono::microseconds(RENDER_US));
+  for (uint16_t i = 0; i < seg.virtualLength(); i++) s.setPixelColor(i, frameNo & 0xFFFFFF);
+  return 0;
+}
+
+static void recordFrame(const std::vector<uint32_t>& frame)
+{
+  uint32_t n = frame[0];
+  for (uint32_t c : frame) if (c != n) { n = 0xFFFFFFFF; break; }
+  std::lock_guard<std::mutex> l(sentMux);
+  sentFrames.push_back(n);
+}
+
+struct RunResult {
+  uint32_t frames;
+  uint32_t loops;       //main loop iterations, the time the loop had for everything else
+  uint64_t blockedUs;   //time service() waited for the bus
+};
+
+static RunResult run(bool pipelined)
+{
+  busses.removeAll();
+  busses.transferUs = TRANSFER_US;
+  busses.blockedUs = 0;
+  busses.framesSent = 0;
+  busses.onFrame = recordFrame;
+  sentFrames.clear();
+
+  strip.pipelineOutput = pipelined;
+  strip.effectTransitions = false;
+  strip.finalizeInit(LEDS, false);
+  strip.setSegment(0, 0, LEDS / 2);
+  strip.setSegment(1, LEDS / 2, LEDS);
+  static uint8_t fx = strip.addEffect(&mode_frame_number, "Frame Number");
+  strip.setMode(0, fx);
+  strip.setMode(1, fx);
+  strip.setBrightness(255);
+  strip.getSegment(0).setOption(SEG_OPTION_ON, true);
+  strip.getSegment(1).setOption(SEG_OPTION_ON, true);
+
+  RunResult r = {0, 0, 0};
+  uint32_t start = millis();
+  while (millis() - start < RUN_MS) {
+    frameNo++;
+    strip.service();
+    strip.flushShow(); //main loop, for a frame that became ready to hand off after the last service()
+    r.loops++;
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+  busses.waitIdle();
+  r.frames = busses.framesSent;
+  r.blockedUs = busses.blockedUs;
+  return r;
+}
+
+static void checkFrames()
+{
+  std::lock_guard<std::mutex> l(sentMux);
+  TEST_ASSERT_TRUE(sentFrames.size() > 10);
+  uint32_t last = 0;
+  for (uint32_t n : sentFrames) {
+    TEST_ASSERT_NOT_EQUAL(0xFFFFFFFF, n); //torn frame
+    TEST_ASSERT_TRUE(n > last);
+    last = n;
+  }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_blocking_output_sends_complete_frames()
+{
+  run(false);
+  checkFrames();
+}
+
+void test_pipelined_output_sends_complete_frames()
+{
+  run(true);
+  checkFrames();
+}
+
+void test_pipelined_output_does_not_wait_for_bus()
+{
+  RunResult blocking = run(false);
+  RunResult pipelined = run(true);
+
+  char msg[160];
+  snprintf(msg, sizeof(msg), "blocking: %u fps, %u loops, %u ms waited | pipelined: %u fps, %u loops, %u ms waited",
+    blocking.frames * 1000 / RUN_MS, blocking.loops, (unsigned)(blocking.blockedUs / 1000),
+    pipelined.frames * 1000 / RUN_MS, pipelined.loops, (unsigned)(pipelined.blockedUs / 1000));
+  TEST_MESSAGE(msg);
+
+  TEST_ASSERT_TRUE(pipelined.frames * 10 >= blocking.frames * 9); //same throughput
+  TEST_ASSERT_TRUE(pipelined.blockedUs * 10 < blocking.blockedUs);
+  TEST_ASSERT_TRUE(pipelined.loops > blocking.loops * 2);
+}
+
+void test_show_timing_includes_bus_time_of_held_back_frames()
+{
+  run(true);
+  WS2812FX::RenderTiming& show = strip.getRenderTiming(RENDER_TIMING_SHOW);
+  WS2812FX::RenderTiming& bus = strip.getRenderTiming(RENDER_TIMING_BUS);
+  //not published yet within the window, compare the running sums
+  TEST_ASSERT_TRUE(show.count > 0);
+  TEST_ASSERT_TRUE(show.sum >= bus.sum);
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_blocking_output_sends_complete_frames);
+  RUN_TEST(test_pipelined_output_sends_complete_frames);
+  RUN_TEST(test_pipelined_output_does_not_wait_for_bus);
+  RUN_TEST(test_show_timing_includes_bus_time_of_held_back_frames);
+  return UNITY_END();
+}
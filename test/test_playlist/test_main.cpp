@@ -0,0 +1,216 @@
+/*
+ * Playlists (playlist.cpp, presets.cpp): the preset of the next entry is read ahead a few hundred bytes
+ * of presets.json per loop pass, so no pass reads much more than that, also not the switch to the next
+ * entry, which used to find and parse the preset in presets.json in a single pass. Pending preset changes
+ * are not forced to flash for it, an upload of presets.json drops what was read ahead, and an error of
+ * the preset applied from memory is reported like one read when due.
+ */
+#include <unity.h>
+#include "wled_host.h"
+#include "server_host.h"
+
+#define PRESETS 250
+#define PASS_MS  10   //ms per loop pass
+
+bool doCloseFile = false;
+byte errorFlag = 0;
+size_t fsBytesUsed = 0, fsBytesTotal = 0;
+int16_t currentPreset = -1, currentPlaylist = -1;
+bool isPreset = false;
+byte bri = 128;
+bool nightlightActive = false, presetCyclingEnabled = false, jsonTransitionOnce = false;
+unsigned long presetCycledTime = 0, presetsModifiedTime = 0;
+uint16_t transitionDelay = 750, transitionDelayTemp = 750;
+JsonDocument* fileDoc = nullptr;
+
+bool pending = false;   //preset changes not written yet
+uint32_t flushes = 0;
+std::vector<std::string> applied; //names of the presets applied
+
+uint32_t getMaxFreeBlock() { return 1 << 20; }
+void heapAllocFailed(uint8_t site) {}
+void invalidateFastBootState() {}
+unsigned long now() { return 0; }
+bool presetsPending() { return pending; }
+void flushPresets() { flushes++; pending = false; }
+void persistPreset(byte index, JsonDocument* content) {}
+void serializeState(JsonObject root, bool forPreset = false, bool includeBri = true, bool segmentBounds = true) {}
+bool deserializeState(JsonObject root)
+{
+  applied.push_back(root["n"] | "");
+  if (root["err"]) errorFlag = ERR_JSON;
+  return true;
+}
+void closeFile();
+void updateFSInfo();
+void invalidateFileETag(const char* path);
+void invalidatePlaylistPrefetch();
+void commitFileOp();
+void flushPersistence() { flushPresets(); }
+bool commitTempFile(const char* tmp, const char* path)
+{
+  WLED_FS.remove(path);
+  return WLED_FS.rename(tmp, path);
+}
+bool writeObjectToFile(const char* file, const char* key, JsonDocument* content);
+bool readObjectFromFile(const char* file, const char* key, JsonDocument* dest);
+bool admitRequest(AsyncWebServerRequest* request, uint8_t lane, bool respond) { return true; }
+bool handleIfNoneMatchCacheHeader(AsyncWebServerRequest* request, const char* etag) { return false; }
+void setStaticContentCacheHeaders(AsyncWebServerResponse* response, const char* etag) {}
+
+#include "../../wled00/file.cpp"
+#include "../../wled00/presets.cpp"
+#include "../../wled00/playlist.cpp"
+
+//a presets.json like the UI writes, preset n named "P<n>", named with the suffix if in changed
+static std::string presetsJson(std::vector<uint16_t> changed = {}, const char* suffix = "")
+{
+  std::string s = "{\"0\":{}";
+  char buf[256];
+  for (uint16_t i = 1; i <= PRESETS; i++) {
+    bool c = std::find(changed.begin(), changed.end(), i) != changed.end();
+    snprintf(buf, sizeof(buf), ",\"%u\":{\"n\":\"P%u%s\",\"on\":true,\"bri\":%u,\"transition\":7,"
+      "\"seg\":[{\"id\":0,\"start\":0,\"stop\":30,\"col\":[[255,160,0],[0,0,0],[0,0,0]],\"fx\":%u,\"sx\":128,\"ix\":128}]}",
+      i, i, c ? suffix : "", i, i % 10);
+    s += buf;
+  }
+  return s + "}";
+}
+
+static void startPlaylist(const char* json)
+{
+  DynamicJsonDocument doc(1024);
+  deserializeJson(doc, json);
+  loadPlaylist(doc.as<JsonObject>());
+  presetCycledTime = millis();
+}
+
+//runs loop passes for ms, returns the most bytes of presets.json a single pass read
+static uint32_t run(uint32_t ms)
+{
+  uint32_t most = 0;
+  for (uint32_t t = 0; t < ms; t += PASS_MS) {
+    hostAdvance(PASS_MS);
+    uint32_t read = hostFS.bytesRead;
+    handlePlaylist();
+    if (hostFS.bytesRead - read > most) most = hostFS.bytesRead - read;
+  }
+  return most;
+}
+
+void setUp()
+{
+  hostFreezeClock();
+  hostFS.reset();
+  hostFS.put("/presets.json", presetsJson());
+  unloadPlaylist();
+  applied.clear();
+  pending = false;
+  flushes = 0;
+  errorFlag = ERR_NONE;
+  currentPreset = -1;
+}
+void tearDown() {}
+
+//entries of 2 s, the presets of the later ones are read ahead
+void test_entries_applied_in_order()
+{
+  startPlaylist("{\"ps\":[10,200,250,3],\"dur\":20,\"repeat\":2}");
+  run(2000 * 8 + 500);
+  std::vector<std::string> expected = {"P10", "P200", "P250", "P3", "P10", "P200", "P250", "P3"};
+  TEST_ASSERT_EQUAL(expected.size(), applied.size());
+  for (size_t i = 0; i < expected.size(); i++) TEST_ASSERT_EQUAL_STRING(expected[i].c_str(), applied[i].c_str());
+  TEST_ASSERT_EQUAL_INT16(3, currentPreset);
+}
+
+//the most a pass reads while the preset is searched and at the switch, next to reading it when due
+void test_switch_latency()
+{
+  std::string presets = hostFS.content("/presets.json");
+  DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+  uint32_t read = hostFS.bytesRead;
+  uint64_t t = hostRealMicros();
+  TEST_ASSERT_TRUE(readObjectFromFileUsingId("/presets.json", 250, &doc)); //what the switch, or the prefetch, read before
+  double beforeUs = hostRealMicros() - t;
+  uint32_t before = hostFS.bytesRead - read;
+
+  startPlaylist("{\"ps\":[1,250],\"dur\":30,\"repeat\":1}");
+  run(PASS_MS);
+  uint32_t most = 0;
+  double mostUs = 0;
+  while (applied.size() < 2) {
+    hostAdvance(PASS_MS);
+    read = hostFS.bytesRead;
+    t = hostRealMicros();
+    handlePlaylist();
+    double us = hostRealMicros() - t;
+    if (hostFS.bytesRead - read > most) most = hostFS.bytesRead - read;
+    if (us > mostUs) mostUs = us;
+  }
+  TEST_ASSERT_EQUAL_STRING("P250", applied[1].c_str());
+  TEST_ASSERT_TRUE(most < PLAYLIST_PREFETCH_CHUNK + 512); //a chunk, or parsing the preset itself
+  TEST_ASSERT_TRUE(before > 4 * most);
+
+  char msg[160];
+  snprintf(msg, sizeof(msg), "preset %u of %u (presets.json %u bytes): read in one pass %u bytes %.1f us, most per pass now %u bytes %.1f us",
+    PRESETS, PRESETS, (unsigned)presets.size(), before, beforeUs, most, mostUs);
+  TEST_MESSAGE(msg);
+}
+
+//pending preset changes are not written for the prefetch, it waits, they are written when the entry is due
+void test_pending_presets_not_forced()
+{
+  startPlaylist("{\"ps\":[1,2],\"dur\":30,\"repeat\":1}");
+  run(PASS_MS); //the first entry is read when due
+  pending = true;
+  flushes = 0;
+  uint32_t read = hostFS.bytesRead;
+  run(2900);
+  TEST_ASSERT_EQUAL_UINT32(read, hostFS.bytesRead);
+  TEST_ASSERT_EQUAL_UINT32(0, flushes);
+  run(200); //due, read like without prefetch
+  TEST_ASSERT_EQUAL(2, applied.size());
+  TEST_ASSERT_EQUAL_UINT32(1, flushes);
+}
+
+//presets.json uploaded after the next preset was read ahead: the uploaded one is applied
+void test_upload_drops_prefetch()
+{
+  startPlaylist("{\"ps\":[1,200],\"dur\":30,\"repeat\":1}");
+  run(2000);
+  TEST_ASSERT_NOT_NULL(playlistNext);
+  std::string uploaded = presetsJson({200}, " new");
+  AsyncWebServerRequest request;
+  handleFileUpload(&request, "/presets.json", 0, (uint8_t*)uploaded.data(), uploaded.size(), true);
+  commitFileOp(); //by the loop
+  run(1100);
+  TEST_ASSERT_EQUAL(2, applied.size());
+  TEST_ASSERT_EQUAL_STRING("P200 new", applied[1].c_str());
+}
+
+//an error applying the preset read ahead is kept, the preset is not taken as the current one
+void test_prefetched_error_reported()
+{
+  DynamicJsonDocument doc(256);
+  deserializeJson(doc, "{\"n\":\"Broken\",\"err\":1}");
+  currentPreset = 1;
+  TEST_ASSERT_FALSE(applyPresetFrom(5, &doc));
+  TEST_ASSERT_EQUAL_UINT8(ERR_JSON, errorFlag);
+  TEST_ASSERT_EQUAL_INT16(1, currentPreset);
+
+  deserializeJson(doc, "{\"n\":\"Fine\"}");
+  TEST_ASSERT_TRUE(applyPresetFrom(5, &doc));
+  TEST_ASSERT_EQUAL_UINT8(ERR_NONE, errorFlag);
+  TEST_ASSERT_EQUAL_INT16(5, currentPreset);
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_entries_applied_in_order);
+  RUN_TEST(test_switch_latency);
+  RUN_TEST(test_pending_presets_not_forced);
+  RUN_TEST(test_upload_drops_prefetch);
+  RUN_TEST(test_prefetched_error_reported);
+  return UNITY_END();
+}
@@ -0,0 +1,207 @@
+/*
+ * Handoff from the main loop to the render task (WLED_ENABLE_RENDER_TASK, FX_fcn.cpp): what the loop sets
+ * reaches the render task only with publishSettings(), for all segments at once, and the render task does
+ * what the setters do without it (color transitions, turning the old range of a moved segment off).
+ * Requests that do not fit in the snapshot are sent as commands, kept while the queue is full.
+ * With a loop and a render thread, every frame is drawn from one published state.
+ */
+#define WLED_ENABLE_RENDER_TASK
+#include <unity.h>
+#include <thread>
+
+bool renderCommand(uint8_t type, uint32_t arg = 0);
+
+#include "fx_host.h"
+
+#define LEDS       60
+#define SEGS       4   //of 15 LEDs each
+#define LOOP_MS    300 //the loop thread publishes for that long
+
+typedef struct RenderCommand {
+  uint8_t type;
+  uint32_t arg;
+} render_command;
+
+static SpscQueue<RenderCommand, 8> renderQueue;
+static bool renderTaskRunning = true;
+static uint32_t cmdsDone = 0;
+
+bool renderCommand(uint8_t type, uint32_t arg)
+{
+  if (!renderTaskRunning) return false;
+  RenderCommand cmd = {type, arg};
+  return renderQueue.push(cmd);
+}
+
+WS2812FX strip;
+
+//what the render task does for a frame, output is false while the main loop shows realtime data
+static void renderTaskFrame(bool output = true)
+{
+  strip.adoptSettings(output);
+  RenderCommand cmd;
+  while (renderQueue.pop(cmd)) {
+    cmdsDone++;
+    strip.runCommand(cmd.type, cmd.arg);
+  }
+  if (output) strip.service();
+}
+
+static void renderFrame(bool output = true)
+{
+  hostAdvance(FRAMETIME + 1);
+  renderTaskFrame(output);
+  busses.waitIdle();
+}
+
+void setUp()
+{
+  hostFreezeClock();
+  busses.removeAll();
+  busses.transferUs = 0;
+  renderTaskRunning = true;
+  strip.resetSegments();
+  strip.finalizeInit(LEDS, false);
+  strip.gammaCorrectCol = false;
+  strip.ablMilliampsMax = 0; //no power limit, the busses get the brightness
+  strip.setTransition(0);
+  strip.setBrightness(255);
+  strip.setColor(0, 0xFF0000);
+  strip.publishSettings();
+  renderFrame();
+  cmdsDone = 0;
+}
+
+void tearDown() {}
+
+//the render task draws with what was published last, never with what the loop is changing
+void test_drawn_after_publish()
+{
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, busses.getPixelColor(0));
+  strip.setColor(0, 0x00FF00);
+  strip.setBrightness(0);
+  renderFrame();
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, busses.getPixelColor(0));
+  TEST_ASSERT_EQUAL_UINT8(255, busses.getBrightness());
+
+  strip.setBrightness(255);
+  strip.publishSettings();
+  renderFrame();
+  TEST_ASSERT_EQUAL_HEX32(0x00FF00, busses.getPixelColor(0));
+  TEST_ASSERT_EQUAL_HEX32(0x00FF00, strip.getColor()); //the loop reads what it set
+}
+
+//the color transition is started by the render task when it adopts the new color
+void test_color_transition_on_adopt()
+{
+  strip.setTransition(1000);
+  strip.setColor(0, 0x0000FF);
+  strip.publishSettings();
+  renderFrame();
+  hostAdvance(500);
+  renderFrame();
+  uint32_t c = busses.getPixelColor(0);
+  TEST_ASSERT_TRUE((c >> 16) > 0x20 && (c & 0xFF) > 0x20); //between red and blue
+  hostAdvance(1000);
+  renderFrame();
+  TEST_ASSERT_EQUAL_HEX32(0x0000FF, busses.getPixelColor(0));
+}
+
+//the old range of a moved segment is turned off, not while realtime data is shown
+void test_moved_segment_range_off()
+{
+  strip.setSegment(0, 0, 30);
+  strip.publishSettings();
+  renderFrame();
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, busses.getPixelColor(10));
+  TEST_ASSERT_EQUAL_HEX32(0, busses.getPixelColor(40));
+
+  strip.setSegment(0, 0, 20);
+  strip.publishSettings();
+  renderFrame(false);
+  TEST_ASSERT_EQUAL_HEX32(0xFF0000, busses.getPixelColor(25));
+  TEST_ASSERT_EQUAL_UINT16(20, strip.getSegment(0).stop);
+}
+
+//trigger() and runtime resets go through the command queue once, kept until it has room
+void test_commands_kept_until_sent()
+{
+  renderTaskRunning = false;
+  strip.trigger();
+  strip.resetSegments();
+  strip.publishSettings();
+  renderTaskRunning = true;
+  renderFrame();
+  TEST_ASSERT_EQUAL_UINT32(0, cmdsDone);
+
+  for (uint8_t i = 0; i < 7; i++) TEST_ASSERT_TRUE(renderCommand(0)); //queue full
+  strip.publishSettings();
+  renderFrame();
+  TEST_ASSERT_EQUAL_UINT32(7, cmdsDone);
+
+  strip.publishSettings();
+  strip.publishSettings();
+  renderFrame();
+  TEST_ASSERT_EQUAL_UINT32(9, cmdsDone);
+}
+
+//all segments of a frame come from the same published state while the loop keeps changing them
+void test_threads_one_state_per_frame()
+{
+  hostUnfreezeClock();
+  for (uint8_t i = 0; i < SEGS; i++) strip.setSegment(i, i * (LEDS / SEGS), (i + 1) * (LEDS / SEGS), 1, 0);
+  strip.publishSettings();
+
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> handoffs{0};
+  std::thread loop([&]() {
+    uint32_t end = millis() + LOOP_MS;
+    for (uint32_t n = 1; millis() < end; n++) {
+      for (uint8_t i = 0; i < SEGS; i++) {
+        WS2812FX::Segment& seg = strip.getSegment(i);
+        seg.colors[0] = n;
+        seg.setOption(SEG_OPTION_ON, true);
+        seg.opacity = 255;
+        std::this_thread::sleep_for(std::chrono::microseconds(50)); //the other handlers of the pass
+      }
+      strip.publishSettings();
+      handoffs = n;
+    }
+    done = true;
+  });
+
+  uint32_t frames = 0, mixed = 0, last = 0, backwards = 0;
+  for (;;) {
+    renderTaskFrame();
+    busses.waitIdle();
+    uint32_t c = busses.getPixelColor(0);
+    for (uint8_t i = 1; i < SEGS; i++) {
+      if (busses.getPixelColor(i * (LEDS / SEGS)) != c) mixed++;
+    }
+    if (c < last) backwards++;
+    if (c != last) frames++;
+    last = c;
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    if (done && last == handoffs) break;
+  }
+  loop.join();
+
+  char msg[96];
+  snprintf(msg, sizeof(msg), "%u handoffs, %u frames with a new state", (unsigned)handoffs, frames);
+  TEST_MESSAGE(msg);
+  TEST_ASSERT_EQUAL_UINT32(0, mixed);
+  TEST_ASSERT_EQUAL_UINT32(0, backwards);
+  TEST_ASSERT_TRUE(frames > 5);
+  hostFreezeClock();
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_drawn_after_publish);
+  RUN_TEST(test_color_transition_on_adopt);
+  RUN_TEST(test_moved_segment_range_off);
+  RUN_TEST(test_commands_kept_until_sent);
+  RUN_TEST(test_threads_one_state_per_frame);
+  return UNITY_END();
+}
@@ -0,0 +1,167 @@
+/*
+ * Adalight/TPM2 serial input (wled_serial.cpp): a byte stream of mixed frames, line noise and
+ * TPM2 pings fed in UART sized pieces, the largest Adalight frame (65536 pixels) and parse
+ * throughput.
+ */
+#include <unity.h>
+#include "wled_host.h"
+
+#define WLED_ENABLE_ADALIGHT
+
+//UART: the test appends to rx and decides how much of it has arrived
+class HostSerial {
+  public:
+    std::vector<uint8_t> rx, tx;
+    size_t pos = 0, arrived = 0;
+    int available() { return arrived - pos; }
+    size_t readBytes(byte* buf, size_t len) {
+      if (len > arrived - pos) len = arrived - pos;
+      memcpy(buf, rx.data() + pos, len);
+      pos += len;
+      return len;
+    }
+    size_t write(uint8_t c) { tx.push_back(c); return 1; }
+    void reset() { rx.clear(); tx.clear(); pos = arrived = 0; }
+};
+
+struct HostStrip {
+  uint32_t shows = 0;
+  void setBrightness(uint8_t b) {}
+  void show() { shows++; }
+};
+
+HostSerial Serial;
+HostStrip strip;
+byte realtimeMode = 0, realtimeOverride = REALTIME_OVERRIDE_NONE, bri = 128, briLast = 128;
+uint16_t realtimeTimeoutMs = 2500;
+uint16_t ledCount = 300;
+std::vector<uint32_t> pixels(ledCount);
+uint32_t pixelWrites = 0;
+
+void realtimeLock(uint32_t timeoutMs, byte md) { realtimeMode = md; }
+void setRealtimePixel(uint16_t i, byte r, byte g, byte b, byte w)
+{
+  pixelWrites++;
+  if (i < ledCount) pixels[i] = ((uint32_t)r << 16) | (g << 8) | b;
+}
+
+#include "../../wled00/wled_serial.cpp"
+
+static uint32_t frameColor(uint32_t frame, uint32_t i) { return ((frame * 7 + i) * 0x010203) & 0xFFFFFF; }
+
+static void addAda(std::vector<uint8_t>& s, uint32_t frame, uint32_t n)
+{
+  uint8_t hi = (n - 1) >> 8, lo = (n - 1) & 0xFF;
+  s.insert(s.end(), {'A', 'd', 'a', hi, lo, (uint8_t)(hi ^ lo ^ 0x55)});
+  for (uint32_t i = 0; i < n; i++) {
+    uint32_t c = frameColor(frame, i);
+    s.insert(s.end(), {(uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c});
+  }
+}
+
+static void addTPM2(std::vector<uint8_t>& s, uint32_t frame, uint16_t n, uint8_t extra = 0, uint8_t end = TPM2_BLOCK_END)
+{
+  uint16_t size = n * 3 + extra;
+  s.insert(s.end(), {0xC9, 0xDA, (uint8_t)(size >> 8), (uint8_t)size});
+  for (uint16_t i = 0; i < n; i++) {
+    uint32_t c = frameColor(frame, i);
+    s.insert(s.end(), {(uint8_t)(c >> 16), (uint8_t)(c >> 8), (uint8_t)c});
+  }
+  for (uint8_t i = 0; i < extra; i++) s.push_back(0x11);
+  s.push_back(end);
+}
+
+//lets the stream arrive in pieces of up to chunk bytes, one handleSerial() per piece
+static void feed(size_t chunk)
+{
+  while (Serial.pos < Serial.rx.size()) {
+    size_t pos = Serial.pos;
+    Serial.arrived = min(Serial.arrived + chunk, Serial.rx.size());
+    handleSerial();
+    if (Serial.pos == pos && serialLen == SERIAL_BUF_LEN) TEST_FAIL_MESSAGE("parser stuck with a full buffer");
+  }
+}
+
+static bool framePixelsAre(uint32_t frame, uint16_t n)
+{
+  for (uint16_t i = 0; i < n; i++) if (pixels[i] != frameColor(frame, i)) return false;
+  return true;
+}
+
+void setUp()
+{
+  Serial.reset();
+  strip.shows = 0;
+  pixelWrites = 0;
+  serialState = SerialState::Header;
+  serialLen = 0;
+}
+void tearDown() {}
+
+void test_mixed_stream()
+{
+  static const size_t chunks[] = {1, 5, 64, 120, 4096};
+  for (size_t chunk : chunks) {
+    setUp();
+    std::vector<uint8_t>& s = Serial.rx;
+    s.insert(s.end(), {0x00, 0xFF, 'A', 'x', 0x41}); //noise, also a broken header
+    addAda(s, 1, 300);
+    s.insert(s.end(), {0xC9, 0xAA});                 //ping
+    addTPM2(s, 2, 300, 2);                           //size not a multiple of 3
+    s.insert(s.end(), {'A', 'd', 'a', 0x01, 0x2B, 0x00}); //bad checksum, the pixel data is skipped as noise
+    addAda(s, 3, 300);
+    addTPM2(s, 4, 300, 0, 0x00);                     //no block end, dropped
+    addAda(s, 5, 100);
+    feed(chunk);
+    TEST_ASSERT_EQUAL_UINT32(4, strip.shows);
+    TEST_ASSERT_EQUAL(1, Serial.tx.size());
+    TEST_ASSERT_EQUAL_HEX8(0xAC, Serial.tx[0]);
+    TEST_ASSERT_TRUE(framePixelsAre(5, 100));
+    TEST_ASSERT_EQUAL_HEX32(frameColor(4, 100), pixels[100]); //the dropped TPM2 frame was applied, not shown
+    TEST_ASSERT_EQUAL(0, serialLen);
+    TEST_ASSERT_TRUE(serialState == SerialState::Header);
+  }
+}
+
+void test_largest_ada_frame()
+{
+  //count 0xFFFF means 65536 pixels, more than fit a 16 bit counter
+  addAda(Serial.rx, 1, 65536);
+  addAda(Serial.rx, 2, 300);
+  feed(1024);
+  TEST_ASSERT_EQUAL_UINT32(2, strip.shows);
+  TEST_ASSERT_TRUE(framePixelsAre(2, 300));
+  TEST_ASSERT_EQUAL_UINT32(MAX_LEDS + 300, pixelWrites); //indices beyond setRealtimePixel()'s range are dropped
+  TEST_ASSERT_EQUAL(Serial.rx.size(), Serial.pos);
+}
+
+void test_throughput()
+{
+  const uint32_t frames = 2000;
+  for (uint32_t f = 0; f < frames; f++) addAda(Serial.rx, f, 300);
+  double mb = Serial.rx.size() / 1e6;
+
+  static const size_t chunks[] = {64, 256, 1024};
+  for (size_t chunk : chunks) {
+    Serial.pos = Serial.arrived = 0;
+    strip.shows = 0;
+    uint64_t t = hostRealMicros();
+    feed(chunk);
+    double s = (hostRealMicros() - t) / 1e6;
+    char msg[96];
+    snprintf(msg, sizeof(msg), "%4u byte pieces: %.0f MB/s, %.2f us per 300 LED frame", (unsigned)chunk, mb / s, s * 1e6 / frames);
+    TEST_MESSAGE(msg);
+    TEST_ASSERT_EQUAL_UINT32(frames, strip.shows);
+    TEST_ASSERT_TRUE(framePixelsAre(frames - 1, 300));
+    TEST_ASSERT_TRUE(mb / s > 1.0); //the fastest serial line (2 Mbaud) is 0.2 MB/s
+  }
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_mixed_stream);
+  RUN_TEST(test_largest_ada_frame);
+  RUN_TEST(test_throughput);
+  return UNITY_END();
+}
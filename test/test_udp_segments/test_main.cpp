@@ -0,0 +1,128 @@
+/*
+ * Segment records of the UDP sync notifier packet (udp_segments.cpp): packet size and parse time
+ * for 1, 4 and 16 segments, and that a repeated packet does not reset the receiver's segments,
+ * also when the sender has more LEDs than the receiver.
+ */
+#include <unity.h>
+#include "fx_host.h"
+
+WS2812FX strip;
+
+#include "../../wled00/udp_segments.cpp"
+
+#define WLEDPACKETSIZE 29 //udp.cpp
+#define PARSE_RUNS 2000
+
+static uint16_t lastCall = 0;
+
+//records how often it ran since the segment was (re)set
+static uint16_t mode_count_calls(WS2812FX& s, WS2812FX::Segment& seg, WS2812FX::Segment_runtime& env)
+{
+  lastCall = env.call;
+  return FRAMETIME;
+}
+
+static void initStrip(uint16_t leds)
+{
+  busses.removeAll();
+  strip.resetSegments();
+  strip.finalizeInit(leds, false);
+}
+
+//sender segments: n segments evenly over leds, with spacing on every other one
+static uint16_t makePacket(byte* buf, uint8_t n, uint16_t leds)
+{
+  initStrip(leds);
+  for (uint8_t i = 0; i < n; i++) {
+    strip.setSegment(i, i * leds / n, (i + 1) * leds / n, 1, i & 1);
+    WS2812FX::Segment& seg = strip.getSegment(i);
+    seg.setOption(SEG_OPTION_ON, true);
+    seg.mode = FX_MODE_STATIC;
+    seg.colors[0] = 0xFF0000 >> i;
+    seg.speed = 100 + i;
+  }
+  return packSegments(buf);
+}
+
+void setUp() {}
+void tearDown() {}
+
+static void measure(uint8_t n)
+{
+  byte buf[UDP_SEG_HEADER + MAX_NUM_SEGMENTS * UDP_SEG_SIZE];
+  uint16_t len = makePacket(buf, n, 480);
+  TEST_ASSERT_EQUAL_UINT16(UDP_SEG_HEADER + n * UDP_SEG_SIZE, len);
+
+  initStrip(480);
+  applySegments(buf, len, true, true); //first packet sets up the segments
+  uint64_t t = hostRealMicros();
+  for (uint16_t r = 0; r < PARSE_RUNS; r++) applySegments(buf, len, true, true);
+  double us = (double)(hostRealMicros() - t) / PARSE_RUNS;
+
+  for (uint8_t i = 0; i < n; i++) {
+    TEST_ASSERT_EQUAL_UINT16(i * 480 / n, strip.getSegment(i).start);
+    if (i != buf[2]) TEST_ASSERT_EQUAL_UINT8(100 + i, strip.getSegment(i).speed); //main segment: from the packet header
+  }
+  char msg[96];
+  snprintf(msg, sizeof(msg), "%2u segments: packet %u bytes, applied in %.2f us", n, WLEDPACKETSIZE + len, us);
+  TEST_MESSAGE(msg);
+}
+
+void test_size_and_parse_time_1_segment()   { measure(1); }
+void test_size_and_parse_time_4_segments()  { measure(4); }
+void test_size_and_parse_time_16_segments() { measure(16); }
+
+//the receiver has fewer LEDs: the sender's stop is clamped, the same packet again must not reset the segment
+void test_repeated_packet_keeps_segment_running()
+{
+  byte buf[UDP_SEG_HEADER + MAX_NUM_SEGMENTS * UDP_SEG_SIZE];
+  uint16_t len = makePacket(buf, 2, 300);
+
+  initStrip(200);
+  static uint8_t fx = strip.addEffect(&mode_count_calls, "Count");
+  applySegments(buf, len, true, false);
+  TEST_ASSERT_EQUAL_UINT16(150, strip.getSegment(1).start);
+  TEST_ASSERT_EQUAL_UINT16(200, strip.getSegment(1).stop); //clamped
+  strip.setMode(0, fx); strip.setMode(1, fx);
+
+  for (uint8_t f = 0; f < 10; f++) {
+    hostAdvance(50);
+    strip.service();
+    busses.waitIdle();
+    applySegments(buf, len, true, false); //notifications repeat the layout
+  }
+  TEST_ASSERT_EQUAL_UINT16(200, strip.getSegment(1).stop);
+  TEST_ASSERT_TRUE(lastCall >= 8); //segment 1 was serviced last, without being reset in between
+}
+
+//segments not in the packet are removed, the main segment follows the sender
+void test_layout_follows_sender()
+{
+  byte buf[UDP_SEG_HEADER + MAX_NUM_SEGMENTS * UDP_SEG_SIZE];
+  uint16_t len = makePacket(buf, 2, 100);
+  buf[2] = 1; //main segment
+
+  initStrip(100);
+  strip.setSegment(5, 10, 20);
+  applySegments(buf, len, true, true);
+  TEST_ASSERT_FALSE(strip.getSegment(5).isActive());
+  TEST_ASSERT_TRUE(strip.getSegment(1).isActive());
+  TEST_ASSERT_EQUAL_UINT8(1, strip.getSegment(1).spacing);
+  TEST_ASSERT_EQUAL_UINT8(1, strip.getMainSegmentId());
+
+  //truncated packets are ignored
+  strip.setSegment(5, 10, 20);
+  applySegments(buf, len - 1, true, true);
+  TEST_ASSERT_TRUE(strip.getSegment(5).isActive());
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_size_and_parse_time_1_segment);
+  RUN_TEST(test_size_and_parse_time_4_segments);
+  RUN_TEST(test_size_and_parse_time_16_segments);
+  RUN_TEST(test_repeated_packet_keeps_segment_running);
+  RUN_TEST(test_layout_follows_sender);
+  return UNITY_END();
+}
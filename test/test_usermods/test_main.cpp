@@ -0,0 +1,135 @@
+/*
+ * Usermod manager (um_manager.cpp): loop() is called according to each usermod's loop interval,
+ * and the time each loop() takes is reported per RENDER_TIMING_WINDOW in /json/info "umt",
+ * also for a usermod that blocks the main loop for longer than 65 ms.
+ */
+#include <unity.h>
+#include "wled_host.h"
+
+#define RENDER_TIMING_WINDOW 2000
+
+#include "../../wled00/um_manager.h"
+#include "../../wled00/um_manager.cpp"
+
+//loop() takes costUs, or slowUs every slowEvery calls
+class MockUsermod : public Usermod {
+  public:
+    uint16_t id, interval;
+    uint32_t costUs, slowUs, slowEvery;
+    uint32_t calls = 0;
+    MockUsermod(uint16_t id, uint16_t interval, uint32_t costUs, uint32_t slowUs = 0, uint32_t slowEvery = 0)
+      : id(id), interval(interval), costUs(costUs), slowUs(slowUs), slowEvery(slowEvery) {}
+    void loop() {
+      calls++;
+      hostAdvanceMicros((slowEvery && calls % slowEvery == 0) ? slowUs : costUs);
+    }
+    uint16_t getId() { return id; }
+    uint16_t getLoopInterval() { return interval; }
+};
+
+//main loop iterations of 1 ms (plus the time the usermods take) for the given time
+static void run(UsermodManager& um, uint32_t ms)
+{
+  unsigned long end = millis() + ms;
+  while (millis() < end) {
+    um.loop();
+    hostAdvance(1);
+  }
+}
+
+struct Timing { uint32_t min, avg, max; uint16_t interval; };
+
+static Timing timing(UsermodManager& um, uint8_t i)
+{
+  DynamicJsonDocument doc(1024);
+  JsonObject info = doc.to<JsonObject>();
+  um.addToJsonInfo(info);
+  JsonObject t = info["umt"][i];
+  return {t["t"][0], t["t"][1], t["t"][2], t["iv"]};
+}
+
+void setUp()
+{
+  hostFreezeClock();
+  hostAdvance(10000); //long after boot, usermods with an interval are called right away
+}
+void tearDown() {}
+
+void test_intervals()
+{
+  UsermodManager um;
+  MockUsermod every(100, 0, 0), fast(101, 100, 0), slow(102, 1000, 0);
+  um.add(&every); um.add(&fast); um.add(&slow);
+  run(um, 5000);
+  TEST_ASSERT_EQUAL_UINT32(5000, every.calls);
+  TEST_ASSERT_EQUAL_UINT32(50, fast.calls);
+  TEST_ASSERT_EQUAL_UINT32(5, slow.calls);
+  TEST_ASSERT_EQUAL_UINT16(100, timing(um, 1).interval);
+}
+
+void test_too_many_usermods()
+{
+  UsermodManager um;
+  MockUsermod m(100, 0, 0);
+  for (uint8_t i = 0; i < WLED_MAX_USERMODS; i++) TEST_ASSERT_TRUE(um.add(&m));
+  TEST_ASSERT_FALSE(um.add(&m));
+  TEST_ASSERT_FALSE(um.add(nullptr));
+  TEST_ASSERT_EQUAL(WLED_MAX_USERMODS, um.getModCount());
+}
+
+void test_timing()
+{
+  UsermodManager um;
+  MockUsermod light(100, 0, 20), sensor(101, 0, 50, 5000, 10);
+  um.add(&light); um.add(&sensor);
+  run(um, RENDER_TIMING_WINDOW + 10);
+  Timing l = timing(um, 0), s = timing(um, 1);
+  TEST_ASSERT_EQUAL_UINT32(20, l.min);
+  TEST_ASSERT_EQUAL_UINT32(20, l.avg);
+  TEST_ASSERT_EQUAL_UINT32(20, l.max);
+  TEST_ASSERT_EQUAL_UINT32(50, s.min);
+  TEST_ASSERT_UINT32_WITHIN(1, (9 * 50 + 5000) / 10, s.avg);
+  TEST_ASSERT_EQUAL_UINT32(5000, s.max);
+}
+
+//a usermod blocking for 250 ms (e.g. a sensor read with a timeout) is reported as such, not as 65 ms
+void test_blocking_usermod()
+{
+  UsermodManager um;
+  MockUsermod blocking(100, 1000, 250000);
+  um.add(&blocking);
+  run(um, RENDER_TIMING_WINDOW * 2);
+  Timing t = timing(um, 0);
+  TEST_ASSERT_EQUAL_UINT32(250000, t.min);
+  TEST_ASSERT_EQUAL_UINT32(250000, t.avg);
+  TEST_ASSERT_EQUAL_UINT32(250000, t.max);
+}
+
+//the timings of a window are reported once it is complete, an idle window reports 0
+void test_window()
+{
+  UsermodManager um;
+  MockUsermod m(100, 0, 30);
+  um.add(&m);
+  run(um, RENDER_TIMING_WINDOW + 10);
+  TEST_ASSERT_EQUAL_UINT32(30, timing(um, 0).max);
+  m.costUs = 40;
+  run(um, RENDER_TIMING_WINDOW / 2);
+  TEST_ASSERT_EQUAL_UINT32(30, timing(um, 0).max);
+  run(um, RENDER_TIMING_WINDOW);
+  TEST_ASSERT_EQUAL_UINT32(40, timing(um, 0).max);
+  m.interval = 60000;
+  run(um, RENDER_TIMING_WINDOW * 2);
+  TEST_ASSERT_EQUAL_UINT32(0, timing(um, 0).max);
+}
+
+int main(int argc, char** argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_intervals);
+  RUN_TEST(test_too_many_usermods);
+  RUN_TEST(test_timing);
+  RUN_TEST(test_blocking_usermod);
+  RUN_TEST(test_window);
+  return UNITY_END();
+}
@@ -334,7 +334,7 @@ class Animated_Staircase : public Usermod {
   void loop() {
     // Write changed settings from to flash (see readFromJsonState())
     if (saveState) {
-      serializeConfig();
+      persistConfig();
       saveState = false;
     }
 
@@ -371,7 +371,7 @@ class Animated_Staircase : public Usermod {
    * See void addToJsonState(JsonObject& root)
    */
   void readFromJsonState(JsonObject& root) {
-    // The call to serializeConfig() must be done in the main loop,
+    // persistConfig() is called in the main loop,
     // so we set a flag to signal the main loop to save state.
     saveState = readSettingsFromJson(root);
     readSensorsFromJson(root);
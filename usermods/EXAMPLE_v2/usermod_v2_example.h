@@ -54,7 +54,7 @@ class MyExampleUsermod : public Usermod {
      *    Additionally, "if (WLED_MQTT_CONNECTED)" is available to check for a connection to an MQTT broker.
      * 
      * 2. Try to avoid using the delay() function. NEVER use delays longer than 10 milliseconds.
-     *    Instead, use a timer check as shown here.
+     *    Instead, use a timer check as shown here, or getLoopInterval() below.
      */
     void loop() {
       if (millis() - lastTime > 1000) {
@@ -64,6 +64,24 @@ class MyExampleUsermod : public Usermod {
     }
 
 
+    /*
+     * getLoopInterval() lets the usermod manager call loop() only every so many milliseconds (0, the default, is every time).
+     * The time each loop() takes is shown in /json/info "umt", please keep it short.
+     */
+    //uint16_t getLoopInterval() {
+    //  return 1000;
+    //}
+
+
+    /*
+     * addEffects() is called before the strip is started, the usermod can add its own effects here
+     * with strip.addEffect(). See the usermod_v2_custom_effect usermod for an example.
+     */
+    //void addEffects() {
+    //  myEffectId = strip.addEffect(&my_effect, PSTR("My Effect"));
+    //}
+
+
     /*
      * addToJsonInfo() can be used to add custom entries to the /json/info part of the JSON API.
      * Creating an "u" object allows you to add custom key/value pairs to the Info section of the WLED web UI.
@@ -108,11 +126,12 @@ class MyExampleUsermod : public Usermod {
     /*
      * addToConfig() can be used to add custom persistent settings to the cfg.json file in the "um" (usermod) object.
      * It will be called by WLED when settings are actually saved (for example, LED settings are saved)
-     * If you want to force saving the current state, use serializeConfig() in your loop().
+     * If you want to force saving the current state, use persistConfig().
      * 
-     * CAUTION: serializeConfig() will initiate a filesystem write operation.
-     * It might cause the LEDs to stutter and will cause flash wear if called too often.
-     * Use it sparingly and always in the loop, never in network callbacks!
+     * persistConfig() only notes that cfg.json has to be written, the main loop writes it once
+     * the settings did not change for a second, so repeated changes cost a single write.
+     * Do not call serializeConfig() yourself: it writes the file right away, which might cause
+     * the LEDs to stutter and will cause flash wear if called too often.
      * 
      * addToConfig() will also not yet add your setting to one of the settings pages automatically.
      * To make that work you still have to add the setting to the HTML, xml.cpp and set.cpp manually.
@@ -85,7 +85,7 @@ public:
     }
     if (m_updateConfig)
     {
-      serializeConfig();
+      persistConfig();
       m_updateConfig = false;
     }
   }
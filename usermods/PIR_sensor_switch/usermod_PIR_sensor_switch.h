@@ -71,7 +71,7 @@ private:
   byte m_PIRsensorPinState = LOW;
   // PIR sensor enabled - ISR attached
   bool m_PIRenabled = true;
-  // state if serializeConfig() should be called
+  // state if persistConfig() should be called
   bool m_updateConfig = false;
 
   /**
@@ -186,7 +186,7 @@ public:
       handleOffTimer();
       if (m_updateConfig)
       {
-        serializeConfig();
+        persistConfig();
         m_updateConfig = false;
       }
     }
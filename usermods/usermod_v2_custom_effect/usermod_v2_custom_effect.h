@@ -0,0 +1,71 @@
+#pragma once
+
+#include "wled.h"
+
+/*
+ * Example of a usermod adding its own effect.
+ * The effect gets the next free effect ID after the builtin ones and then behaves like any other effect:
+ * it shows up in /json/eff, can be selected from the UI, presets, the HTTP API, IR and E1.31, and is synced via UDP
+ * to other nodes, as long as these run the same usermods (effect IDs are assigned in the order effects are added).
+ *
+ * Effect functions are plain functions. They render the segment being serviced (seg, runtime data in env)
+ * using the public drawing functions of the strip, pixel index 0 is the first pixel of the segment.
+ * Just like the builtin effects, they return the ms until they want to be called again.
+ *
+ * Using the usermod: add -D USERMOD_CUSTOM_EFFECT to the build flags.
+ */
+
+/*
+ * Twin Comets: two comets running from opposite ends of the segment, passing each other in the middle.
+ * Speed sets the speed, intensity the length of the tails. The comets take their colors from the palette,
+ * the tails fade to the secondary color.
+ */
+static uint16_t mode_twin_comets(WS2812FX& strip, WS2812FX::Segment& seg, WS2812FX::Segment_runtime& env)
+{
+  uint16_t len = seg.virtualLength();
+  bool wrap = (strip.paletteBlend == 1 || strip.paletteBlend == 3);
+  if (env.call == 0) {
+    strip.fill(strip.getEffectColor(1));
+    env.aux0 = 0;
+  }
+
+  uint16_t counter = strip.now * ((seg.speed >> 2) + 8);
+  uint16_t pos = ((uint32_t)counter * len) >> 16;
+
+  strip.fade_out(seg.intensity);
+
+  //all pixels passed since the last frame, so fast comets do not leave gaps
+  uint16_t from = (env.aux0 < len) ? env.aux0 : 0; //the segment may have become shorter
+  uint16_t count = (pos >= from) ? pos - from + 1 : len - from + pos + 1; //wrapped around: to the end, then from the start
+  for (uint16_t n = 0, i = from; n < count; n++, i = (i + 1 < len) ? i + 1 : 0) {
+    strip.setPixelColor(i, strip.color_from_palette(i, true, wrap, 0));
+    strip.setPixelColor(len - 1 - i, strip.color_from_palette(len - 1 - i, true, wrap, 1));
+  }
+  env.aux0 = pos;
+  return FRAMETIME;
+}
+
+class CustomEffectUsermod : public Usermod {
+  private:
+    uint8_t twinCometsId = 255;
+
+  public:
+    /*
+     * addEffects() is called before the strip is started and the boot preset is applied.
+     * strip.addEffect() returns the ID of the added effect (255 if MAX_USERMOD_EFFECTS is reached).
+     */
+    void addEffects() {
+      twinCometsId = strip.addEffect(&mode_twin_comets, PSTR("Twin Comets"), 0, FX_FLAG_PALETTE | FX_FLAG_COLOR2);
+    }
+
+    void addToJsonInfo(JsonObject& root) {
+      JsonObject user = root["u"];
+      if (user.isNull()) user = root.createNestedObject("u");
+      JsonArray fx = user.createNestedArray(F("Twin Comets effect ID"));
+      fx.add(twinCometsId);
+    }
+
+    uint16_t getId() {
+      return USERMOD_ID_CUSTOM_EFFECT;
+    }
+};
@@ -490,11 +490,12 @@ class FourLineDisplayUsermod : public Usermod {
     /*
      * addToConfig() can be used to add custom persistent settings to the cfg.json file in the "um" (usermod) object.
      * It will be called by WLED when settings are actually saved (for example, LED settings are saved)
-     * If you want to force saving the current state, use serializeConfig() in your loop().
+     * If you want to force saving the current state, use persistConfig().
      * 
-     * CAUTION: serializeConfig() will initiate a filesystem write operation.
-     * It might cause the LEDs to stutter and will cause flash wear if called too often.
-     * Use it sparingly and always in the loop, never in network callbacks!
+     * persistConfig() only notes that cfg.json has to be written, the main loop writes it once
+     * the settings did not change for a second, so repeated changes cost a single write.
+     * Do not call serializeConfig() yourself: it writes the file right away, which might cause
+     * the LEDs to stutter and will cause flash wear if called too often.
      * 
      * addToConfig() will also not yet add your setting to one of the settings pages automatically.
      * To make that work you still have to add the setting to the HTML, xml.cpp and set.cpp manually.
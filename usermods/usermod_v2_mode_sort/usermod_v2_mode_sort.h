@@ -144,9 +144,14 @@ public:
      * modes_alpha_indexes and palettes_alpha_indexes.
      */
     void sortModesAndPalettes() {
+        // Effects added by usermods are not in JSON_mode_names, they follow the sorted builtin ones.
+        // Their names end in '\0' instead of '"'.
         modes_qstrings = re_findModeStrings(JSON_mode_names, strip.getModeCount());
+        for (uint8_t i = MODE_COUNT; i < strip.getModeCount(); i++) {
+            modes_qstrings[i] = (char *)strip.getModeName(i);
+        }
         modes_alpha_indexes = re_initIndexArray(strip.getModeCount());
-        re_sortModes(modes_qstrings, modes_alpha_indexes, strip.getModeCount(), MODE_SORT_SKIP_COUNT);
+        re_sortModes(modes_qstrings, modes_alpha_indexes, MODE_COUNT, MODE_SORT_SKIP_COUNT);
 
         palettes_qstrings = re_findModeStrings(JSON_palette_names, strip.getPaletteCount());
         palettes_alpha_indexes = re_initIndexArray(strip.getPaletteCount());
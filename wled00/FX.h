@@ -30,6 +30,9 @@
 #define WS2812FX_h
 
 #include "const.h"
+#ifdef WLED_ENABLE_RENDER_TASK
+  #include "lockfree.h"
+#endif
 
 #define FASTLED_INTERNAL //remove annoying pragma messages
 #define USE_GET_MILLISECOND_TIMER
@@ -63,15 +66,40 @@
   #define MAX_NUM_TRANSITIONS  8
   /* How much data bytes all segments combined may allocate */
   #define MAX_SEGMENT_DATA  2048
+  /* How many effect transitions can run at once and how much pixel buffer memory (8 bytes per LED) they may use.
+     If the budget is exceeded, the effect changes instantly */
+  #define MAX_NUM_FX_TRANSITIONS 2
+  #define MAX_FX_TRANSITION_DATA 2048
+  /* How much buffer memory (about 4 bytes per LED) overlapping segments may use for compositing.
+     If the budget is exceeded, overlapping segments overwrite each other */
+  #define MAX_COMPOSITE_DATA 4096
 #else
   #define MAX_NUM_SEGMENTS    16
   #define MAX_NUM_TRANSITIONS 16
   #define MAX_SEGMENT_DATA  8192
+  #define MAX_NUM_FX_TRANSITIONS 4
+  #define MAX_FX_TRANSITION_DATA 16384
+  #define MAX_COMPOSITE_DATA 32768
+#endif
+
+/* How many effects usermods may add to the builtin ones (see WS2812FX::addEffect()) */
+#ifndef MAX_USERMOD_EFFECTS
+  #define MAX_USERMOD_EFFECTS 8
 #endif
 
 #define LED_SKIP_AMOUNT  1
 #define MIN_SHOW_DELAY  15
 
+/* Render timing statistics are published once per window (ms) */
+#define RENDER_TIMING_WINDOW 2000
+#define RENDER_TIMING_FX      0 //effect function of a segment
+#define RENDER_TIMING_PALETTE 1 //palette handling of a segment
+#define RENDER_TIMING_SHOW    2 //complete show(), including power calculation
+#define RENDER_TIMING_BUS     3 //bus transmit only
+#define RENDER_TIMING_FRAME   4 //complete frame (all segments + show)
+#define RENDER_TIMING_XFADE   5 //both effects of a segment in effect transition, including blending
+#define RENDER_TIMING_COMPOSE 6 //composing overlapping segments
+
 #define NUM_COLORS       3 /* number of colors per segment */
 #define SEGMENT          _segments[_segment_index]
 #define SEGCOLOR(x)      _colors_t[x]
@@ -81,6 +109,14 @@
 #define SPEED_FORMULA_L  5 + (50*(255 - SEGMENT.speed))/SEGLEN
 #define RESET_RUNTIME    memset(_segment_runtimes, 0, sizeof(_segment_runtimes))
 
+/* Segments, brightness and transition time as set through the public functions. With the render task, the main
+   loop sets them in _settings and the render task draws with the copy it adopted last (adoptSettings()) */
+#ifdef WLED_ENABLE_RENDER_TASK
+  #define SETTING(x)     _settings.x
+#else
+  #define SETTING(x)     _##x
+#endif
+
 // some common colors
 #define RED        (uint32_t)0xFF0000
 #define GREEN      (uint32_t)0x00FF00
@@ -114,126 +150,154 @@
 #define IS_REVERSE      ((SEGMENT.options & REVERSE     ) == REVERSE     )
 #define IS_SELECTED     ((SEGMENT.options & SELECTED    ) == SELECTED    )
 
-#define MODE_COUNT  118
-
-#define FX_MODE_STATIC                   0
-#define FX_MODE_BLINK                    1
-#define FX_MODE_BREATH                   2
-#define FX_MODE_COLOR_WIPE               3
-#define FX_MODE_COLOR_WIPE_RANDOM        4
-#define FX_MODE_RANDOM_COLOR             5
-#define FX_MODE_COLOR_SWEEP              6
-#define FX_MODE_DYNAMIC                  7
-#define FX_MODE_RAINBOW                  8
-#define FX_MODE_RAINBOW_CYCLE            9
-#define FX_MODE_SCAN                    10
-#define FX_MODE_DUAL_SCAN               11
-#define FX_MODE_FADE                    12
-#define FX_MODE_THEATER_CHASE           13
-#define FX_MODE_THEATER_CHASE_RAINBOW   14
-#define FX_MODE_RUNNING_LIGHTS          15
-#define FX_MODE_SAW                     16
-#define FX_MODE_TWINKLE                 17
-#define FX_MODE_DISSOLVE                18
-#define FX_MODE_DISSOLVE_RANDOM         19
-#define FX_MODE_SPARKLE                 20
-#define FX_MODE_FLASH_SPARKLE           21
-#define FX_MODE_HYPER_SPARKLE           22
-#define FX_MODE_STROBE                  23
-#define FX_MODE_STROBE_RAINBOW          24
-#define FX_MODE_MULTI_STROBE            25
-#define FX_MODE_BLINK_RAINBOW           26
-#define FX_MODE_ANDROID                 27
-#define FX_MODE_CHASE_COLOR             28
-#define FX_MODE_CHASE_RANDOM            29
-#define FX_MODE_CHASE_RAINBOW           30
-#define FX_MODE_CHASE_FLASH             31
-#define FX_MODE_CHASE_FLASH_RANDOM      32
-#define FX_MODE_CHASE_RAINBOW_WHITE     33
-#define FX_MODE_COLORFUL                34
-#define FX_MODE_TRAFFIC_LIGHT           35
-#define FX_MODE_COLOR_SWEEP_RANDOM      36
-#define FX_MODE_RUNNING_COLOR           37
-#define FX_MODE_AURORA                  38
-#define FX_MODE_RUNNING_RANDOM          39
-#define FX_MODE_LARSON_SCANNER          40
-#define FX_MODE_COMET                   41
-#define FX_MODE_FIREWORKS               42
-#define FX_MODE_RAIN                    43
-#define FX_MODE_TETRIX                  44
-#define FX_MODE_FIRE_FLICKER            45
-#define FX_MODE_GRADIENT                46
-#define FX_MODE_LOADING                 47
-#define FX_MODE_POLICE                  48
-#define FX_MODE_POLICE_ALL              49
-#define FX_MODE_TWO_DOTS                50
-#define FX_MODE_TWO_AREAS               51
-#define FX_MODE_CIRCUS_COMBUSTUS        52
-#define FX_MODE_HALLOWEEN               53
-#define FX_MODE_TRICOLOR_CHASE          54
-#define FX_MODE_TRICOLOR_WIPE           55
-#define FX_MODE_TRICOLOR_FADE           56
-#define FX_MODE_LIGHTNING               57
-#define FX_MODE_ICU                     58
-#define FX_MODE_MULTI_COMET             59
-#define FX_MODE_DUAL_LARSON_SCANNER     60
-#define FX_MODE_RANDOM_CHASE            61
-#define FX_MODE_OSCILLATE               62
-#define FX_MODE_PRIDE_2015              63
-#define FX_MODE_JUGGLE                  64
-#define FX_MODE_PALETTE                 65
-#define FX_MODE_FIRE_2012               66
-#define FX_MODE_COLORWAVES              67
-#define FX_MODE_BPM                     68
-#define FX_MODE_FILLNOISE8              69
-#define FX_MODE_NOISE16_1               70
-#define FX_MODE_NOISE16_2               71
-#define FX_MODE_NOISE16_3               72
-#define FX_MODE_NOISE16_4               73
-#define FX_MODE_COLORTWINKLE            74
-#define FX_MODE_LAKE                    75
-#define FX_MODE_METEOR                  76
-#define FX_MODE_METEOR_SMOOTH           77
-#define FX_MODE_RAILWAY                 78
-#define FX_MODE_RIPPLE                  79
-#define FX_MODE_TWINKLEFOX              80
-#define FX_MODE_TWINKLECAT              81
-#define FX_MODE_HALLOWEEN_EYES          82
-#define FX_MODE_STATIC_PATTERN          83
-#define FX_MODE_TRI_STATIC_PATTERN      84
-#define FX_MODE_SPOTS                   85
-#define FX_MODE_SPOTS_FADE              86
-#define FX_MODE_GLITTER                 87
-#define FX_MODE_CANDLE                  88
-#define FX_MODE_STARBURST               89
-#define FX_MODE_EXPLODING_FIREWORKS     90
-#define FX_MODE_BOUNCINGBALLS           91
-#define FX_MODE_SINELON                 92
-#define FX_MODE_SINELON_DUAL            93
-#define FX_MODE_SINELON_RAINBOW         94
-#define FX_MODE_POPCORN                 95
-#define FX_MODE_DRIP                    96
-#define FX_MODE_PLASMA                  97
-#define FX_MODE_PERCENT                 98
-#define FX_MODE_RIPPLE_RAINBOW          99
-#define FX_MODE_HEARTBEAT              100
-#define FX_MODE_PACIFICA               101
-#define FX_MODE_CANDLE_MULTI           102
-#define FX_MODE_SOLID_GLITTER          103
-#define FX_MODE_SUNRISE                104
-#define FX_MODE_PHASED                 105
-#define FX_MODE_TWINKLEUP              106
-#define FX_MODE_NOISEPAL               107
-#define FX_MODE_SINEWAVE               108
-#define FX_MODE_PHASEDNOISE            109
-#define FX_MODE_FLOW                   110
-#define FX_MODE_CHUNCHUN               111
-#define FX_MODE_DANCING_SHADOWS        112
-#define FX_MODE_WASHING_MACHINE        113
-#define FX_MODE_CANDY_CANE             114
-#define FX_MODE_BLENDS                 115
-#define FX_MODE_TV_SIMULATOR           116
-#define FX_MODE_DYNAMIC_SMOOTH         117
+// segment blend modes, only used where segments overlap
+// the segment with the higher ID is composed on top
+#define BLEND_MODE_NORMAL   0
+#define BLEND_MODE_ADD      1
+#define BLEND_MODE_MULTIPLY 2
+#define BLEND_MODE_MAX      3
+#define BLEND_MODE_SCREEN   4
+#define BLEND_MODE_COUNT    5
+
+/*
+ * Effect registry
+ * One line per effect: FX(id, function, "UI name", default palette, flags), the effect ID is its position
+ * (FX_MODE_<id>), so new effects are appended. The list generates the FX_MODE_* IDs, MODE_COUNT,
+ * the effect table in flash (FX_fcn.cpp) and JSON_mode_names. The first entry uses FIRST(), as there is
+ * no separator before its name in JSON_mode_names.
+ * The default palette is used while the segment's palette is 0 ("Default"). Flags (FX_FLAG_*) tell what
+ * the effect makes use of, e.g. for the UI to hide controls that have no effect.
+ */
+#define FX_FLAG_PALETTE 0x01 //colors from the palette
+#define FX_FLAG_COLOR2  0x02 //secondary color
+#define FX_FLAG_COLOR3  0x04 //tertiary color
+#define FX_FLAG_DATA    0x08 //allocates segment data
+
+#define WLED_EFFECTS(FIRST, FX) \
+  FIRST(STATIC,                  mode_static,                 "Solid",                  0, 0)                                                          \
+  FX(   BLINK,                   mode_blink,                  "Blink",                  0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   BREATH,                  mode_breath,                 "Breathe",                0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   COLOR_WIPE,              mode_color_wipe,             "Wipe",                   0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   COLOR_WIPE_RANDOM,       mode_color_wipe_random,      "Wipe Random",            0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   RANDOM_COLOR,            mode_random_color,           "Random Colors",          0, FX_FLAG_PALETTE)                                            \
+  FX(   COLOR_SWEEP,             mode_color_sweep,            "Sweep",                  0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   DYNAMIC,                 mode_dynamic,                "Dynamic",                0, FX_FLAG_PALETTE|FX_FLAG_DATA)                               \
+  FX(   RAINBOW,                 mode_rainbow,                "Colorloop",              0, FX_FLAG_PALETTE)                                            \
+  FX(   RAINBOW_CYCLE,           mode_rainbow_cycle,          "Rainbow",                0, FX_FLAG_PALETTE)                                            \
+  FX(   SCAN,                    mode_scan,                   "Scan",                   0, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3)              \
+  FX(   DUAL_SCAN,               mode_dual_scan,              "Scan Dual",              0, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3)              \
+  FX(   FADE,                    mode_fade,                   "Fade",                   0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   THEATER_CHASE,           mode_theater_chase,          "Theater",                0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   THEATER_CHASE_RAINBOW,   mode_theater_chase_rainbow,  "Theater Rainbow",        0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   RUNNING_LIGHTS,          mode_running_lights,         "Running",                0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   SAW,                     mode_saw,                    "Saw",                    0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   TWINKLE,                 mode_twinkle,                "Twinkle",                0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   DISSOLVE,                mode_dissolve,               "Dissolve",               0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   DISSOLVE_RANDOM,         mode_dissolve_random,        "Dissolve Rnd",           0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   SPARKLE,                 mode_sparkle,                "Sparkle",                0, FX_FLAG_PALETTE)                                            \
+  FX(   FLASH_SPARKLE,           mode_flash_sparkle,          "Sparkle Dark",           0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   HYPER_SPARKLE,           mode_hyper_sparkle,          "Sparkle+",               0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   STROBE,                  mode_strobe,                 "Strobe",                 0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   STROBE_RAINBOW,          mode_strobe_rainbow,         "Strobe Rainbow",         0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   MULTI_STROBE,            mode_multi_strobe,           "Strobe Mega",            0, FX_FLAG_PALETTE)                                            \
+  FX(   BLINK_RAINBOW,           mode_blink_rainbow,          "Blink Rainbow",          0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   ANDROID,                 mode_android,                "Android",                0, FX_FLAG_PALETTE)                                            \
+  FX(   CHASE_COLOR,             mode_chase_color,            "Chase",                  0, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3)              \
+  FX(   CHASE_RANDOM,            mode_chase_random,           "Chase Random",           0, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3)              \
+  FX(   CHASE_RAINBOW,           mode_chase_rainbow,          "Chase Rainbow",          0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   CHASE_FLASH,             mode_chase_flash,            "Chase Flash",            0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   CHASE_FLASH_RANDOM,      mode_chase_flash_random,     "Chase Flash Rnd",        0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   CHASE_RAINBOW_WHITE,     mode_chase_rainbow_white,    "Rainbow Runner",         0, FX_FLAG_PALETTE)                                            \
+  FX(   COLORFUL,                mode_colorful,               "Colorful",               0, FX_FLAG_PALETTE)                                            \
+  FX(   TRAFFIC_LIGHT,           mode_traffic_light,          "Traffic Light",          0, FX_FLAG_PALETTE)                                            \
+  FX(   COLOR_SWEEP_RANDOM,      mode_color_sweep_random,     "Sweep Random",           0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   RUNNING_COLOR,           mode_running_color,          "Running 2",              0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   AURORA,                  mode_aurora,                 "Aurora",                 0, FX_FLAG_PALETTE|FX_FLAG_DATA)                               \
+  FX(   RUNNING_RANDOM,          mode_running_random,         "Stream",                 0, FX_FLAG_PALETTE)                                            \
+  FX(   LARSON_SCANNER,          mode_larson_scanner,         "Scanner",                0, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3)              \
+  FX(   COMET,                   mode_comet,                  "Lighthouse",             0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   FIREWORKS,               mode_fireworks,              "Fireworks",              0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   RAIN,                    mode_rain,                   "Rain",                   0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   TETRIX,                  mode_tetrix,                 "Tetrix",                 0, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_DATA)                \
+  FX(   FIRE_FLICKER,            mode_fire_flicker,           "Fire Flicker",           0, FX_FLAG_PALETTE)                                            \
+  FX(   GRADIENT,                mode_gradient,               "Gradient",               0, FX_FLAG_PALETTE)                                            \
+  FX(   LOADING,                 mode_loading,                "Loading",                0, FX_FLAG_PALETTE)                                            \
+  FX(   POLICE,                  mode_police,                 "Police",                 0, FX_FLAG_COLOR2)                                             \
+  FX(   POLICE_ALL,              mode_police_all,             "Police All",             0, 0)                                                          \
+  FX(   TWO_DOTS,                mode_two_dots,               "Two Dots",               0, FX_FLAG_COLOR2|FX_FLAG_COLOR3)                              \
+  FX(   TWO_AREAS,               mode_two_areas,              "Two Areas",              0, FX_FLAG_COLOR2)                                             \
+  FX(   CIRCUS_COMBUSTUS,        mode_circus_combustus,       "Circus",                 0, FX_FLAG_PALETTE)                                            \
+  FX(   HALLOWEEN,               mode_halloween,              "Halloween",              0, FX_FLAG_PALETTE)                                            \
+  FX(   TRICOLOR_CHASE,          mode_tricolor_chase,         "Tri Chase",              0, FX_FLAG_PALETTE|FX_FLAG_COLOR3)                             \
+  FX(   TRICOLOR_WIPE,           mode_tricolor_wipe,          "Tri Wipe",               0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   TRICOLOR_FADE,           mode_tricolor_fade,          "Tri Fade",               0, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3)              \
+  FX(   LIGHTNING,               mode_lightning,              "Lightning",              0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   ICU,                     mode_icu,                    "ICU",                    0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   MULTI_COMET,             mode_multi_comet,            "Multi Comet",            0, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3|FX_FLAG_DATA) \
+  FX(   DUAL_LARSON_SCANNER,     mode_dual_larson_scanner,    "Scanner Dual",           0, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3)              \
+  FX(   RANDOM_CHASE,            mode_random_chase,           "Stream 2",               0, 0)                                                          \
+  FX(   OSCILLATE,               mode_oscillate,              "Oscillate",              0, FX_FLAG_DATA)                                               \
+  FX(   PRIDE_2015,              mode_pride_2015,             "Pride 2015",             0, 0)                                                          \
+  FX(   JUGGLE,                  mode_juggle,                 "Juggle",                 0, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   PALETTE,                 mode_palette,                "Palette",                0, FX_FLAG_PALETTE)                                            \
+  FX(   FIRE_2012,               mode_fire_2012,              "Fire 2012",             35, FX_FLAG_PALETTE|FX_FLAG_DATA)                               \
+  FX(   COLORWAVES,              mode_colorwaves,             "Colorwaves",            26, FX_FLAG_PALETTE)                                            \
+  FX(   BPM,                     mode_bpm,                    "Bpm",                    0, FX_FLAG_PALETTE)                                            \
+  FX(   FILLNOISE8,              mode_fillnoise8,             "Fill Noise",             9, FX_FLAG_PALETTE)                                            \
+  FX(   NOISE16_1,               mode_noise16_1,              "Noise 1",               20, FX_FLAG_PALETTE)                                            \
+  FX(   NOISE16_2,               mode_noise16_2,              "Noise 2",               43, FX_FLAG_PALETTE)                                            \
+  FX(   NOISE16_3,               mode_noise16_3,              "Noise 3",               35, FX_FLAG_PALETTE)                                            \
+  FX(   NOISE16_4,               mode_noise16_4,              "Noise 4",               26, FX_FLAG_PALETTE)                                            \
+  FX(   COLORTWINKLE,            mode_colortwinkle,           "Colortwinkles",          0, FX_FLAG_PALETTE|FX_FLAG_DATA)                               \
+  FX(   LAKE,                    mode_lake,                   "Lake",                   0, FX_FLAG_PALETTE)                                            \
+  FX(   METEOR,                  mode_meteor,                 "Meteor",                 4, FX_FLAG_PALETTE|FX_FLAG_DATA)                               \
+  FX(   METEOR_SMOOTH,           mode_meteor_smooth,          "Meteor Smooth",          4, FX_FLAG_PALETTE|FX_FLAG_DATA)                               \
+  FX(   RAILWAY,                 mode_railway,                "Railway",                4, FX_FLAG_PALETTE)                                            \
+  FX(   RIPPLE,                  mode_ripple,                 "Ripple",                 4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_DATA)                \
+  FX(   TWINKLEFOX,              mode_twinklefox,             "Twinklefox",             4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   TWINKLECAT,              mode_twinklecat,             "Twinklecat",             4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   HALLOWEEN_EYES,          mode_halloween_eyes,         "Halloween Eyes",         4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   STATIC_PATTERN,          mode_static_pattern,         "Solid Pattern",          4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   TRI_STATIC_PATTERN,      mode_tri_static_pattern,     "Solid Pattern Tri",      4, FX_FLAG_COLOR2|FX_FLAG_COLOR3)                              \
+  FX(   SPOTS,                   mode_spots,                  "Spots",                  4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   SPOTS_FADE,              mode_spots_fade,             "Spots Fade",             4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   GLITTER,                 mode_glitter,                "Glitter",               11, FX_FLAG_PALETTE)                                            \
+  FX(   CANDLE,                  mode_candle,                 "Candle",                 4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_DATA)                \
+  FX(   STARBURST,               mode_starburst,              "Fireworks Starburst",    4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_DATA)                \
+  FX(   EXPLODING_FIREWORKS,     mode_exploding_fireworks,    "Fireworks 1D",           4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_DATA)                \
+  FX(   BOUNCINGBALLS,           mode_bouncing_balls,         "Bouncing Balls",         4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3|FX_FLAG_DATA) \
+  FX(   SINELON,                 mode_sinelon,                "Sinelon",                4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3)              \
+  FX(   SINELON_DUAL,            mode_sinelon_dual,           "Sinelon Dual",           4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3)              \
+  FX(   SINELON_RAINBOW,         mode_sinelon_rainbow,        "Sinelon Rainbow",        4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3)              \
+  FX(   POPCORN,                 mode_popcorn,                "Popcorn",                4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_COLOR3|FX_FLAG_DATA) \
+  FX(   DRIP,                    mode_drip,                   "Drip",                   4, FX_FLAG_COLOR2|FX_FLAG_DATA)                                \
+  FX(   PLASMA,                  mode_plasma,                 "Plasma",                 4, FX_FLAG_PALETTE)                                            \
+  FX(   PERCENT,                 mode_percent,                "Percent",                4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   RIPPLE_RAINBOW,          mode_ripple_rainbow,         "Ripple Rainbow",         4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_DATA)                \
+  FX(   HEARTBEAT,               mode_heartbeat,              "Heartbeat",              4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   PACIFICA,                mode_pacifica,               "Pacifica",               4, FX_FLAG_PALETTE)                                            \
+  FX(   CANDLE_MULTI,            mode_candle_multi,           "Candle Multi",           4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_DATA)                \
+  FX(   SOLID_GLITTER,           mode_solid_glitter,          "Solid Glitter",          4, 0)                                                          \
+  FX(   SUNRISE,                 mode_sunrise,                "Sunrise",               35, FX_FLAG_PALETTE)                                            \
+  FX(   PHASED,                  mode_phased,                 "Phased",                 4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   TWINKLEUP,               mode_twinkleup,              "Twinkleup",              4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   NOISEPAL,                mode_noisepal,               "Noise Pal",              4, FX_FLAG_PALETTE|FX_FLAG_COLOR2|FX_FLAG_DATA)                \
+  FX(   SINEWAVE,                mode_sinewave,               "Sine",                   4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   PHASEDNOISE,             mode_phased_noise,           "Phased Noise",           4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   FLOW,                    mode_flow,                   "Flow",                   6, FX_FLAG_PALETTE)                                            \
+  FX(   CHUNCHUN,                mode_chunchun,               "Chunchun",               4, FX_FLAG_PALETTE|FX_FLAG_COLOR2)                             \
+  FX(   DANCING_SHADOWS,         mode_dancing_shadows,        "Dancing Shadows",        4, FX_FLAG_PALETTE|FX_FLAG_DATA)                               \
+  FX(   WASHING_MACHINE,         mode_washing_machine,        "Washing Machine",        4, FX_FLAG_PALETTE)                                            \
+  FX(   CANDY_CANE,              mode_candy_cane,             "Candy Cane",             4, FX_FLAG_PALETTE)                                            \
+  FX(   BLENDS,                  mode_blends,                 "Blends",                 4, FX_FLAG_PALETTE|FX_FLAG_DATA)                               \
+  FX(   TV_SIMULATOR,            mode_tv_simulator,           "TV Simulator",           4, FX_FLAG_DATA)                                               \
+  FX(   DYNAMIC_SMOOTH,          mode_dynamic_smooth,         "Dynamic Smooth",         4, FX_FLAG_PALETTE|FX_FLAG_DATA)
+
+#define FX_ENUM_ID(id, fn, name, pal, flags) FX_MODE_##id,
+enum {
+  WLED_EFFECTS(FX_ENUM_ID, FX_ENUM_ID)
+  MODE_COUNT
+};
 
 
 class WS2812FX {
@@ -246,7 +310,7 @@ class WS2812FX {
   
   // segment parameters
   public:
-    typedef struct Segment { // 24 bytes
+    typedef struct Segment { // 25 (28 in memory) bytes
       uint16_t start;
       uint16_t stop; //segment invalid if stop == 0
       uint8_t speed;
@@ -257,16 +321,21 @@ class WS2812FX {
       uint8_t grouping, spacing;
       uint8_t opacity;
       uint32_t colors[NUM_COLORS];
+      uint8_t blendMode; //how the segment is composed onto overlapping segments below it
       bool setColor(uint8_t slot, uint32_t c, uint8_t segn) { //returns true if changed
         if (slot >= NUM_COLORS || segn >= MAX_NUM_SEGMENTS) return false;
         if (c == colors[slot]) return false;
+        #ifndef WLED_ENABLE_RENDER_TASK //the render task starts it when it adopts the new color
         ColorTransition::startTransition(opacity, colors[slot], instance->_transitionDur, segn, slot);
+        #endif
         colors[slot] = c; return true;
       }
       void setOpacity(uint8_t o, uint8_t segn) {
         if (segn >= MAX_NUM_SEGMENTS) return;
         if (opacity == o) return;
+        #ifndef WLED_ENABLE_RENDER_TASK
         ColorTransition::startTransition(opacity, colors[0], instance->_transitionDur, segn, 0);
+        #endif
         opacity = o;
       }
       /*uint8_t actualOpacity() { //respects On/Off state
@@ -335,7 +404,10 @@ class WS2812FX {
         deallocateData();
         if (WS2812FX::instance->_usedSegmentData + len > MAX_SEGMENT_DATA) return false; //not enough memory
         data = new (std::nothrow) byte[len];
-        if (!data) return false; //allocation failed
+        if (!data) { //allocation failed
+          heapAllocFailed(ALLOC_SITE_SEGMENT);
+          return false;
+        }
         WS2812FX::instance->_usedSegmentData += len;
         _dataLen = len;
         memset(data, 0, len);
@@ -369,6 +441,21 @@ class WS2812FX {
        * Call resetIfRequired before calling the next effect function.
        */
       void reset() { _requiresReset = true; }
+      bool resetRequested() { return _requiresReset; }
+
+      /**
+       * Hands the runtime state including the data buffer over to another
+       * runtime object (used by effect transitions) and clears this one.
+       * Same restrictions as for resetIfRequired() apply.
+       */
+      void moveTo(Segment_runtime& to) {
+        to.deallocateData();
+        to = *this;
+        to._requiresReset = false;
+        data = nullptr; _dataLen = 0;
+        next_time = 0; step = 0; call = 0; aux0 = 0; aux1 = 0;
+        _requiresReset = false;
+      }
       private:
         uint16_t _dataLen = 0;
         bool _requiresReset = false;
@@ -452,135 +539,69 @@ class WS2812FX {
       }
     } color_transition;
 
+    typedef struct EffectTransition { // 144 bytes
+      segment_runtime env;        //runtime state of the old effect
+      uint32_t* pixOld = nullptr; //last frame of the old effect (unscaled)
+      uint32_t* pixNew = nullptr; //last frame of the new effect (unscaled)
+      CRGBPalette16 palOld;       //palettes of both effects, cached for the transition
+      CRGBPalette16 palNew;
+      uint32_t transitionStart;
+      uint32_t nextNew;           //next_time of the new effect
+      uint16_t transitionDur;
+      uint16_t len = 0;           //virtual segment length the buffers were allocated for
+      uint8_t segment = 0xFF;     //255 indicates transition not in use
+      uint8_t modeOld;
+      uint8_t palette;            //segment palette the cached palettes are for
+      uint16_t progress() { //transition progression between 0-65535
+        uint32_t elapsed = millis() - transitionStart;
+        if (elapsed >= transitionDur) return 0xFFFF;
+        return elapsed * 0xFFFF / transitionDur;
+      }
+    } effect_transition;
+
+    typedef struct RenderTiming { // 16 bytes
+      uint32_t sum = 0; //microseconds accumulated in the current window
+      uint16_t count = 0;
+      uint16_t winMin = 0xFFFF, winMax = 0;
+      uint16_t minUs = 0, avgUs = 0, maxUs = 0; //results of the last completed window
+      void add(uint32_t us) {
+        if (us > 0xFFFF) us = 0xFFFF;
+        sum += us; count++;
+        if (us < winMin) winMin = us;
+        if (us > winMax) winMax = us;
+      }
+      void publish() {
+        if (count) {
+          minUs = winMin; avgUs = sum / count; maxUs = winMax;
+        } else {
+          minUs = 0; avgUs = 0; maxUs = 0;
+        }
+        sum = 0; count = 0; winMin = 0xFFFF; winMax = 0;
+      }
+    } render_timing;
+
+    /*
+     * Effect function added by a usermod. It renders the segment being serviced (seg, with its runtime data env)
+     * using the public drawing functions (setPixelColor(), color_from_palette(), fade_out(), getEffectColor(), ...)
+     * and returns the ms until it wants to be called again, like the builtin effects.
+     */
+    typedef uint16_t (*usermod_mode_ptr)(WS2812FX& strip, WS2812FX::Segment& seg, WS2812FX::Segment_runtime& env);
+
     WS2812FX() {
       WS2812FX::instance = this;
-      //assign each member of the _mode[] array to its respective function reference 
-      _mode[FX_MODE_STATIC]                  = &WS2812FX::mode_static;
-      _mode[FX_MODE_BLINK]                   = &WS2812FX::mode_blink;
-      _mode[FX_MODE_COLOR_WIPE]              = &WS2812FX::mode_color_wipe;
-      _mode[FX_MODE_COLOR_WIPE_RANDOM]       = &WS2812FX::mode_color_wipe_random;
-      _mode[FX_MODE_RANDOM_COLOR]            = &WS2812FX::mode_random_color;
-      _mode[FX_MODE_COLOR_SWEEP]             = &WS2812FX::mode_color_sweep;
-      _mode[FX_MODE_DYNAMIC]                 = &WS2812FX::mode_dynamic;
-      _mode[FX_MODE_RAINBOW]                 = &WS2812FX::mode_rainbow;
-      _mode[FX_MODE_RAINBOW_CYCLE]           = &WS2812FX::mode_rainbow_cycle;
-      _mode[FX_MODE_SCAN]                    = &WS2812FX::mode_scan;
-      _mode[FX_MODE_DUAL_SCAN]               = &WS2812FX::mode_dual_scan;
-      _mode[FX_MODE_FADE]                    = &WS2812FX::mode_fade;
-      _mode[FX_MODE_THEATER_CHASE]           = &WS2812FX::mode_theater_chase;
-      _mode[FX_MODE_THEATER_CHASE_RAINBOW]   = &WS2812FX::mode_theater_chase_rainbow;
-      _mode[FX_MODE_SAW]                     = &WS2812FX::mode_saw;
-      _mode[FX_MODE_TWINKLE]                 = &WS2812FX::mode_twinkle;
-      _mode[FX_MODE_DISSOLVE]                = &WS2812FX::mode_dissolve;
-      _mode[FX_MODE_DISSOLVE_RANDOM]         = &WS2812FX::mode_dissolve_random;
-      _mode[FX_MODE_SPARKLE]                 = &WS2812FX::mode_sparkle;
-      _mode[FX_MODE_FLASH_SPARKLE]           = &WS2812FX::mode_flash_sparkle;
-      _mode[FX_MODE_HYPER_SPARKLE]           = &WS2812FX::mode_hyper_sparkle;
-      _mode[FX_MODE_STROBE]                  = &WS2812FX::mode_strobe;
-      _mode[FX_MODE_STROBE_RAINBOW]          = &WS2812FX::mode_strobe_rainbow;
-      _mode[FX_MODE_MULTI_STROBE]            = &WS2812FX::mode_multi_strobe;
-      _mode[FX_MODE_BLINK_RAINBOW]           = &WS2812FX::mode_blink_rainbow;
-      _mode[FX_MODE_ANDROID]                 = &WS2812FX::mode_android;
-      _mode[FX_MODE_CHASE_COLOR]             = &WS2812FX::mode_chase_color;
-      _mode[FX_MODE_CHASE_RANDOM]            = &WS2812FX::mode_chase_random;
-      _mode[FX_MODE_CHASE_RAINBOW]           = &WS2812FX::mode_chase_rainbow;
-      _mode[FX_MODE_CHASE_FLASH]             = &WS2812FX::mode_chase_flash;
-      _mode[FX_MODE_CHASE_FLASH_RANDOM]      = &WS2812FX::mode_chase_flash_random;
-      _mode[FX_MODE_CHASE_RAINBOW_WHITE]     = &WS2812FX::mode_chase_rainbow_white;
-      _mode[FX_MODE_COLORFUL]                = &WS2812FX::mode_colorful;
-      _mode[FX_MODE_TRAFFIC_LIGHT]           = &WS2812FX::mode_traffic_light;
-      _mode[FX_MODE_COLOR_SWEEP_RANDOM]      = &WS2812FX::mode_color_sweep_random;
-      _mode[FX_MODE_RUNNING_COLOR]           = &WS2812FX::mode_running_color;
-      _mode[FX_MODE_AURORA]                  = &WS2812FX::mode_aurora;
-      _mode[FX_MODE_RUNNING_RANDOM]          = &WS2812FX::mode_running_random;
-      _mode[FX_MODE_LARSON_SCANNER]          = &WS2812FX::mode_larson_scanner;
-      _mode[FX_MODE_COMET]                   = &WS2812FX::mode_comet;
-      _mode[FX_MODE_FIREWORKS]               = &WS2812FX::mode_fireworks;
-      _mode[FX_MODE_RAIN]                    = &WS2812FX::mode_rain;
-      _mode[FX_MODE_TETRIX]                  = &WS2812FX::mode_tetrix;
-      _mode[FX_MODE_FIRE_FLICKER]            = &WS2812FX::mode_fire_flicker;
-      _mode[FX_MODE_GRADIENT]                = &WS2812FX::mode_gradient;
-      _mode[FX_MODE_LOADING]                 = &WS2812FX::mode_loading;
-      _mode[FX_MODE_POLICE]                  = &WS2812FX::mode_police;
-      _mode[FX_MODE_POLICE_ALL]              = &WS2812FX::mode_police_all;
-      _mode[FX_MODE_TWO_DOTS]                = &WS2812FX::mode_two_dots;
-      _mode[FX_MODE_TWO_AREAS]               = &WS2812FX::mode_two_areas;
-      _mode[FX_MODE_CIRCUS_COMBUSTUS]        = &WS2812FX::mode_circus_combustus;
-      _mode[FX_MODE_HALLOWEEN]               = &WS2812FX::mode_halloween;
-      _mode[FX_MODE_TRICOLOR_CHASE]          = &WS2812FX::mode_tricolor_chase;
-      _mode[FX_MODE_TRICOLOR_WIPE]           = &WS2812FX::mode_tricolor_wipe;
-      _mode[FX_MODE_TRICOLOR_FADE]           = &WS2812FX::mode_tricolor_fade;
-      _mode[FX_MODE_BREATH]                  = &WS2812FX::mode_breath;
-      _mode[FX_MODE_RUNNING_LIGHTS]          = &WS2812FX::mode_running_lights;
-      _mode[FX_MODE_LIGHTNING]               = &WS2812FX::mode_lightning;
-      _mode[FX_MODE_ICU]                     = &WS2812FX::mode_icu;
-      _mode[FX_MODE_MULTI_COMET]             = &WS2812FX::mode_multi_comet;
-      _mode[FX_MODE_DUAL_LARSON_SCANNER]     = &WS2812FX::mode_dual_larson_scanner;
-      _mode[FX_MODE_RANDOM_CHASE]            = &WS2812FX::mode_random_chase;
-      _mode[FX_MODE_OSCILLATE]               = &WS2812FX::mode_oscillate;
-      _mode[FX_MODE_FIRE_2012]               = &WS2812FX::mode_fire_2012;
-      _mode[FX_MODE_PRIDE_2015]              = &WS2812FX::mode_pride_2015;
-      _mode[FX_MODE_BPM]                     = &WS2812FX::mode_bpm;
-      _mode[FX_MODE_JUGGLE]                  = &WS2812FX::mode_juggle;
-      _mode[FX_MODE_PALETTE]                 = &WS2812FX::mode_palette;
-      _mode[FX_MODE_COLORWAVES]              = &WS2812FX::mode_colorwaves;
-      _mode[FX_MODE_FILLNOISE8]              = &WS2812FX::mode_fillnoise8;
-      _mode[FX_MODE_NOISE16_1]               = &WS2812FX::mode_noise16_1;
-      _mode[FX_MODE_NOISE16_2]               = &WS2812FX::mode_noise16_2;
-      _mode[FX_MODE_NOISE16_3]               = &WS2812FX::mode_noise16_3;
-      _mode[FX_MODE_NOISE16_4]               = &WS2812FX::mode_noise16_4;
-      _mode[FX_MODE_COLORTWINKLE]            = &WS2812FX::mode_colortwinkle;
-      _mode[FX_MODE_LAKE]                    = &WS2812FX::mode_lake;
-      _mode[FX_MODE_METEOR]                  = &WS2812FX::mode_meteor;
-      _mode[FX_MODE_METEOR_SMOOTH]           = &WS2812FX::mode_meteor_smooth;
-      _mode[FX_MODE_RAILWAY]                 = &WS2812FX::mode_railway;
-      _mode[FX_MODE_RIPPLE]                  = &WS2812FX::mode_ripple;
-      _mode[FX_MODE_TWINKLEFOX]              = &WS2812FX::mode_twinklefox;
-      _mode[FX_MODE_TWINKLECAT]              = &WS2812FX::mode_twinklecat;
-      _mode[FX_MODE_HALLOWEEN_EYES]          = &WS2812FX::mode_halloween_eyes;
-      _mode[FX_MODE_STATIC_PATTERN]          = &WS2812FX::mode_static_pattern;
-      _mode[FX_MODE_TRI_STATIC_PATTERN]      = &WS2812FX::mode_tri_static_pattern;
-      _mode[FX_MODE_SPOTS]                   = &WS2812FX::mode_spots;
-      _mode[FX_MODE_SPOTS_FADE]              = &WS2812FX::mode_spots_fade;
-      _mode[FX_MODE_GLITTER]                 = &WS2812FX::mode_glitter;
-      _mode[FX_MODE_CANDLE]                  = &WS2812FX::mode_candle;
-      _mode[FX_MODE_STARBURST]               = &WS2812FX::mode_starburst;
-      _mode[FX_MODE_EXPLODING_FIREWORKS]     = &WS2812FX::mode_exploding_fireworks;
-      _mode[FX_MODE_BOUNCINGBALLS]           = &WS2812FX::mode_bouncing_balls;
-      _mode[FX_MODE_SINELON]                 = &WS2812FX::mode_sinelon;
-      _mode[FX_MODE_SINELON_DUAL]            = &WS2812FX::mode_sinelon_dual;
-      _mode[FX_MODE_SINELON_RAINBOW]         = &WS2812FX::mode_sinelon_rainbow;
-      _mode[FX_MODE_POPCORN]                 = &WS2812FX::mode_popcorn;
-      _mode[FX_MODE_DRIP]                    = &WS2812FX::mode_drip;
-      _mode[FX_MODE_PLASMA]                  = &WS2812FX::mode_plasma;
-      _mode[FX_MODE_PERCENT]                 = &WS2812FX::mode_percent;
-      _mode[FX_MODE_RIPPLE_RAINBOW]          = &WS2812FX::mode_ripple_rainbow;
-      _mode[FX_MODE_HEARTBEAT]               = &WS2812FX::mode_heartbeat;
-      _mode[FX_MODE_PACIFICA]                = &WS2812FX::mode_pacifica;
-      _mode[FX_MODE_CANDLE_MULTI]            = &WS2812FX::mode_candle_multi;
-      _mode[FX_MODE_SOLID_GLITTER]           = &WS2812FX::mode_solid_glitter;
-      _mode[FX_MODE_SUNRISE]                 = &WS2812FX::mode_sunrise;
-      _mode[FX_MODE_PHASED]                  = &WS2812FX::mode_phased;
-      _mode[FX_MODE_TWINKLEUP]               = &WS2812FX::mode_twinkleup;
-      _mode[FX_MODE_NOISEPAL]                = &WS2812FX::mode_noisepal;
-      _mode[FX_MODE_SINEWAVE]                = &WS2812FX::mode_sinewave;
-      _mode[FX_MODE_PHASEDNOISE]             = &WS2812FX::mode_phased_noise;
-      _mode[FX_MODE_FLOW]                    = &WS2812FX::mode_flow;
-      _mode[FX_MODE_CHUNCHUN]                = &WS2812FX::mode_chunchun;
-      _mode[FX_MODE_DANCING_SHADOWS]         = &WS2812FX::mode_dancing_shadows;
-      _mode[FX_MODE_WASHING_MACHINE]         = &WS2812FX::mode_washing_machine;
-      _mode[FX_MODE_CANDY_CANE]              = &WS2812FX::mode_candy_cane;
-      _mode[FX_MODE_BLENDS]                  = &WS2812FX::mode_blends;
-      _mode[FX_MODE_TV_SIMULATOR]            = &WS2812FX::mode_tv_simulator;
-      _mode[FX_MODE_DYNAMIC_SMOOTH]          = &WS2812FX::mode_dynamic_smooth;
-
       _brightness = DEFAULT_BRIGHTNESS;
       currentPalette = CRGBPalette16(CRGB::Black);
       targetPalette = CloudColors_p;
       ablMilliampsMax = 850;
       currentMilliamps = 0;
       timebase = 0;
+      memset(_fxTransitionFrom, 0xFF, sizeof(_fxTransitionFrom));
       resetSegments();
+      #ifdef WLED_ENABLE_RENDER_TASK
+      _settings.brightness = _brightness;
+      _settings.transitionDur = _transitionDur;
+      memcpy(_segments, _settings.segments, sizeof(_segments)); //nothing to adopt until the main loop changes them
+      #endif
     }
 
     void
@@ -607,13 +628,24 @@ class WS2812FX {
       setColorOrder(uint8_t co),
       setPixelSegment(uint8_t n);
 
+    #ifdef WLED_ENABLE_RENDER_TASK
+    void
+      publishSettings(void),
+      adoptSettings(bool output),
+      runCommand(uint8_t type, uint32_t arg);
+    #endif
+
     bool
       isRgbw = false,
+      pipelineOutput = false, //do not wait for the previous frame to be sent out, hand off the new one later instead
+      effectTransitions = false, //crossfade between old and new effect on mode change (cfg light.tr.fx, opt-in)
+      compositing = true, //blend overlapping segments instead of overwriting
       gammaCorrectBri = false,
       gammaCorrectCol = true,
       applyToAllSelected = true,
       segmentsAreIdentical(Segment* a, Segment* b),
       setEffectConfig(uint8_t m, uint8_t s, uint8_t i, uint8_t p),
+      flushShow(void),
       // return true if the strip is being sent pixel updates
       isUpdating(void);
 
@@ -629,6 +661,9 @@ class WS2812FX {
       getMode(void),
       getSpeed(void),
       getModeCount(void),
+      getModeDefaultPalette(uint8_t m),
+      getModeFlags(uint8_t m),
+      addEffect(usermod_mode_ptr fn, const char* name, uint8_t palette = 0, uint8_t flags = FX_FLAG_PALETTE),
       getPaletteCount(void),
       getMaxSegments(void),
       //getFirstSelectedSegment(void),
@@ -662,9 +697,13 @@ class WS2812FX {
       currentColor(uint32_t colorNew, uint8_t tNr),
       gamma32(uint32_t),
       getLastShow(void),
+      getEffectColor(uint8_t slot),
       getPixelColor(uint16_t),
       getColor(void);
 
+    const char*
+      getModeName(uint8_t m);
+
     WS2812FX::Segment&
       getSegment(uint8_t n);
 
@@ -674,6 +713,9 @@ class WS2812FX {
     WS2812FX::Segment*
       getSegments(void);
 
+    WS2812FX::RenderTiming&
+      getRenderTiming(uint8_t type, uint8_t seg = 0);
+
     // builtin modes
     uint16_t
       mode_static(void),
@@ -812,12 +854,33 @@ class WS2812FX {
 
     void load_gradient_palette(uint8_t);
     void handle_palette(void);
+    uint16_t runMode(uint8_t m);
+    uint32_t handoffFrame(void);
 
     bool
       _skipFirstMode,
-      _triggered;
+      _triggered,
+      _showPending = false;
+
+    typedef struct EffectInfo {
+      mode_ptr fn;
+      const char* name;  //PROGMEM
+      uint8_t palette;   //used if the segment palette is 0
+      uint8_t flags;     //FX_FLAG_*
+    } effect_info;
+
+    static const EffectInfo _effects[MODE_COUNT]; //in flash, see FX_fcn.cpp
+
+    //effects added by usermods, IDs from MODE_COUNT on
+    typedef struct UsermodEffect {
+      usermod_mode_ptr fn;
+      const char* name;
+      uint8_t palette;
+      uint8_t flags;
+    } usermod_effect;
 
-    mode_ptr _mode[MODE_COUNT]; // SRAM footprint: 4 bytes per element
+    usermod_effect _usermodEffects[MAX_USERMOD_EFFECTS];
+    uint8_t _usermodEffectCount = 0;
 
     show_callback _callback = nullptr;
 
@@ -849,49 +912,84 @@ class WS2812FX {
     void
       blendPixelColor(uint16_t n, uint32_t color, uint8_t blend),
       startTransition(uint8_t oldBri, uint32_t oldCol, uint16_t dur, uint8_t segn, uint8_t slot),
+      startEffectTransition(uint8_t segn, uint8_t modeOld),
+      applyTransitionMode(bool t),
+      endEffectTransition(EffectTransition& t),
+      cacheTransitionPalettes(EffectTransition& t),
+      updateCompositing(void),
+      updateSegmentMask(void),
+      composeSegments(void),
       deserializeMap(void);
 
+    uint32_t blendLayer(uint32_t dst, uint32_t src, uint8_t mode);
+
+    uint16_t renderEffectTransition(EffectTransition& t, uint32_t nowUp);
+    EffectTransition* getEffectTransition(uint8_t segn);
+
     uint16_t* customMappingTable = nullptr;
     uint16_t  customMappingSize  = 0;
     
     uint32_t _lastPaletteChange = 0;
     uint32_t _lastShow = 0;
+    uint32_t _lastTimingPublish = 0;
+
+    render_timing _fxTiming[MAX_NUM_SEGMENTS]; // SRAM footprint: 16 bytes per element
+    render_timing _paletteTiming[MAX_NUM_SEGMENTS];
+    render_timing _showTiming, _busTiming, _frameTiming;
+    uint32_t _showPendingTime = 0; //us show() took for a held back frame, without the bus transmit
 
     uint32_t _colors_t[3];
     uint8_t _bri_t;
     
     uint8_t _segment_index = 0;
     uint8_t _segment_index_palette_last = 99;
-    segment _segments[MAX_NUM_SEGMENTS] = { // SRAM footprint: 24 bytes per element
-      // start, stop, speed, intensity, palette, mode, options, grouping, spacing, opacity (unused), color[]
+    segment _segments[MAX_NUM_SEGMENTS] = { // SRAM footprint: 28 bytes per element
+      // start, stop, speed, intensity, palette, mode, options, grouping, spacing, opacity (unused), color[], blendMode
       { 0, 7, DEFAULT_SPEED, 128, 0, DEFAULT_MODE, NO_OPTIONS, 1, 0, 255, {DEFAULT_COLOR}}
     };
     segment_runtime _segment_runtimes[MAX_NUM_SEGMENTS]; // SRAM footprint: 28 bytes per element
     friend class Segment_runtime;
 
+    #ifdef WLED_ENABLE_RENDER_TASK
+    //what the main loop sets, handed to the render task with publishSettings()
+    typedef struct StripSettings {
+      segment segments[MAX_NUM_SEGMENTS];
+      uint16_t transitionDur;
+      uint8_t brightness;
+    } strip_settings;
+
+    strip_settings _settings;
+    Snapshot<StripSettings> _published;
+    uint32_t _resetMask = 0;           //segments whose runtime data the render task has to reset
+    uint8_t _transitionModeReq = 0xFF; //setTransitionMode() for the render task, 255 if none
+    bool _triggerReq = false;
+    static_assert(MAX_NUM_SEGMENTS <= 32, "RENDER_CMD_RESET takes a 32 bit segment mask");
+    #endif
+
     ColorTransition transitions[MAX_NUM_TRANSITIONS]; //12 bytes per element
     friend class ColorTransition;
 
+    effect_transition _fxTransitions[MAX_NUM_FX_TRANSITIONS]; //144 bytes per element
+    uint8_t _fxTransitionFrom[MAX_NUM_SEGMENTS]; //old mode of a requested effect transition, 255 if none
+    uint16_t _usedFxTransitionData = 0;
+    render_timing _fxTransitionTiming;
+
+    //compositing buffers of overlapping segments (unscaled colors followed by a bitmap of set pixels),
+    //nullptr if the segment writes to the busses directly
+    uint32_t* _segBuf[MAX_NUM_SEGMENTS] = {nullptr};
+    uint16_t _segBufLen[MAX_NUM_SEGMENTS] = {0};
+    uint8_t _segOpacity[MAX_NUM_SEGMENTS] = {0}; //effective opacity of the last rendered frame
+    uint16_t _usedCompositeData = 0;
+    render_timing _composeTiming;
+
     uint16_t
       realPixelIndex(uint16_t i),
       transitionProgress(uint8_t tNr);
 };
 
-//10 names per line
-const char JSON_mode_names[] PROGMEM = R"=====([
-"Solid","Blink","Breathe","Wipe","Wipe Random","Random Colors","Sweep","Dynamic","Colorloop","Rainbow",
-"Scan","Scan Dual","Fade","Theater","Theater Rainbow","Running","Saw","Twinkle","Dissolve","Dissolve Rnd",
-"Sparkle","Sparkle Dark","Sparkle+","Strobe","Strobe Rainbow","Strobe Mega","Blink Rainbow","Android","Chase","Chase Random",
-"Chase Rainbow","Chase Flash","Chase Flash Rnd","Rainbow Runner","Colorful","Traffic Light","Sweep Random","Running 2","Aurora","Stream",
-"Scanner","Lighthouse","Fireworks","Rain","Tetrix","Fire Flicker","Gradient","Loading","Police","Police All",
-"Two Dots","Two Areas","Circus","Halloween","Tri Chase","Tri Wipe","Tri Fade","Lightning","ICU","Multi Comet",
-"Scanner Dual","Stream 2","Oscillate","Pride 2015","Juggle","Palette","Fire 2012","Colorwaves","Bpm","Fill Noise",
-"Noise 1","Noise 2","Noise 3","Noise 4","Colortwinkles","Lake","Meteor","Meteor Smooth","Railway","Ripple",
-"Twinklefox","Twinklecat","Halloween Eyes","Solid Pattern","Solid Pattern Tri","Spots","Spots Fade","Glitter","Candle","Fireworks Starburst",
-"Fireworks 1D","Bouncing Balls","Sinelon","Sinelon Dual","Sinelon Rainbow","Popcorn","Drip","Plasma","Percent","Ripple Rainbow",
-"Heartbeat","Pacifica","Candle Multi", "Solid Glitter","Sunrise","Phased","Twinkleup","Noise Pal", "Sine","Phased Noise",
-"Flow","Chunchun","Dancing Shadows","Washing Machine","Candy Cane","Blends","TV Simulator","Dynamic Smooth"
-])=====";
+#define FX_JSON_FIRST(id, fn, name, pal, flags) "\"" name "\""
+#define FX_JSON_NAME(id, fn, name, pal, flags) ",\"" name "\""
+const char JSON_mode_names[] PROGMEM = "[" WLED_EFFECTS(FX_JSON_FIRST, FX_JSON_NAME) "]";
 
 
 const char JSON_palette_names[] PROGMEM = R"=====([
@@ -46,6 +46,8 @@
 //do not call this method from system context (network callback)
 void WS2812FX::finalizeInit(uint16_t countPixels, bool skipFirst)
 {
+  for (uint8_t i = 0; i < MAX_NUM_FX_TRANSITIONS; i++) endEffectTransition(_fxTransitions[i]);
+  memset(_fxTransitionFrom, 0xFF, sizeof(_fxTransitionFrom));
   RESET_RUNTIME;
   _length = countPixels;
   _skipFirstMode = skipFirst;
@@ -65,10 +67,10 @@ void WS2812FX::finalizeInit(uint16_t countPixels, bool skipFirst)
   deserializeMap();
 
   //make segment 0 cover the entire strip
-  _segments[0].start = 0;
-  _segments[0].stop = _length;
+  SETTING(segments)[0].start = 0;
+  SETTING(segments)[0].stop = _length;
 
-  setBrightness(_brightness);
+  setBrightness(SETTING(brightness));
 
   #ifdef ESP8266
   for (uint8_t i = 0; i < busses.getNumBusses(); i++) {
@@ -83,22 +85,48 @@ void WS2812FX::finalizeInit(uint16_t countPixels, bool skipFirst)
 }
 
 void WS2812FX::service() {
+  //a held back frame has to be handed off before the next one is rendered into the same buffers
+  if (!flushShow()) return;
+
   uint32_t nowUp = millis(); // Be aware, millis() rolls over every 49 days
   now = nowUp + timebase;
   if (nowUp - _lastShow < MIN_SHOW_DELAY) return;
   bool doShow = false;
 
+  if (nowUp - _lastTimingPublish > RENDER_TIMING_WINDOW) {
+    for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++) {
+      _fxTiming[i].publish(); _paletteTiming[i].publish();
+    }
+    _showTiming.publish(); _busTiming.publish(); _frameTiming.publish(); _fxTransitionTiming.publish();
+    _composeTiming.publish();
+    _lastTimingPublish = nowUp;
+  }
+  uint32_t frameStart = micros();
+  updateCompositing();
+
   for(uint8_t i=0; i < MAX_NUM_SEGMENTS; i++)
   {
     _segment_index = i;
 
+    // an effect transition takes over the runtime data of the old effect, so it has to start before the reset
+    if (_fxTransitionFrom[i] != 0xFF) {
+      startEffectTransition(i, _fxTransitionFrom[i]);
+      _fxTransitionFrom[i] = 0xFF;
+    }
+
     // reset the segment runtime data if needed, called before isActive to ensure deleted
     // segment's buffers are cleared
     SEGENV.resetIfRequired();
 
+    EffectTransition* ft = getEffectTransition(i);
+    if (ft && (!SEGMENT.isActive() || SEGMENT.getOption(SEG_OPTION_FREEZE) || ft->len != SEGMENT.virtualLength())) {
+      endEffectTransition(*ft); //segment was changed, cut to the new effect
+      ft = nullptr;
+    }
+
     if (!SEGMENT.isActive()) continue;
 
-    if(nowUp > SEGENV.next_time || _triggered || (doShow && SEGMENT.mode == 0)) //last is temporary
+    if(nowUp > SEGENV.next_time || _triggered || ft || (doShow && SEGMENT.mode == 0)) //last is temporary
     {
       if (SEGMENT.grouping == 0) SEGMENT.grouping = 1; //sanity check
       doShow = true;
@@ -115,9 +143,20 @@ void WS2812FX::service() {
           _colors_t[slot] = transitions[t].currentColor(SEGMENT.colors[slot]);
         }
         for (uint8_t c = 0; c < 3; c++) _colors_t[c] = gamma32(_colors_t[c]);
-        handle_palette();
-        delay = (this->*_mode[SEGMENT.mode])(); //effect function
-        if (SEGMENT.mode != FX_MODE_HALLOWEEN_EYES) SEGENV.call++;
+        _segOpacity[i] = _bri_t;
+        if (_segBuf[i]) updateSegmentMask();
+        uint32_t t0 = micros();
+        if (ft) {
+          delay = renderEffectTransition(*ft, nowUp); //old and new effect
+          _fxTiming[i].add(micros() - t0);
+        } else {
+          handle_palette();
+          uint32_t t1 = micros();
+          delay = runMode(SEGMENT.mode); //effect function
+          _paletteTiming[i].add(t1 - t0);
+          _fxTiming[i].add(micros() - t1);
+          if (SEGMENT.mode != FX_MODE_HALLOWEEN_EYES) SEGENV.call++;
+        }
       }
 
       SEGENV.next_time = nowUp + delay;
@@ -125,8 +164,10 @@ void WS2812FX::service() {
   }
   _virtualSegmentLength = 0;
   if(doShow) {
+    if (_usedCompositeData) composeSegments();
     yield();
     show();
+    _frameTiming.add(micros() - frameStart);
   }
   _triggered = false;
 }
@@ -175,7 +216,26 @@ void WS2812FX::setPixelColor(uint16_t i, byte r, byte g, byte b, byte w)
   }
   
   uint16_t skip = _skipFirstMode ? LED_SKIP_AMOUNT : 0;
-  if (SEGLEN) {//from segment
+  if (SEGLEN && _segBuf[_segment_index]) { //overlapping segment, opacity is applied by composeSegments()
+    uint32_t* buf = _segBuf[_segment_index];
+    uint16_t len = _segBufLen[_segment_index]; //segment bounds may have changed since the buffer was allocated
+    uint32_t col = ((w << 24) | (r << 16) | (g << 8) | (b));
+
+    bool reversed = IS_REVERSE;
+    uint16_t realIndex = realPixelIndex(i);
+
+    for (uint16_t j = 0; j < SEGMENT.grouping; j++) {
+      int16_t indexSet = realIndex + (reversed ? -j : j);
+      if (indexSet >= SEGMENT.start && indexSet < SEGMENT.stop) {
+        uint16_t o = indexSet - SEGMENT.start;
+        if (o < len) buf[o] = col;
+        if (IS_MIRROR) { //set the corresponding mirrored pixel
+          o = SEGMENT.stop - indexSet - 1;
+          if (o < len) buf[o] = col;
+        }
+      }
+    }
+  } else if (SEGLEN) {//from segment
 
     //color_blend(getpixel, col, _bri_t); (pseudocode for future blending of segments)
     if (_bri_t < 255) {  
@@ -228,6 +288,7 @@ void WS2812FX::setPixelColor(uint16_t i, byte r, byte g, byte b, byte w)
                               //you can set it to 0 if the ESP is powered by USB and the LEDs by external
 
 void WS2812FX::show(void) {
+  uint32_t showStart = micros();
 
   // avoid race condition, caputre _callback value
   show_callback callback = _callback;
@@ -305,16 +366,49 @@ void WS2812FX::show(void) {
     busses.setBrightness(_brightness);
   }
   
+  // The pixel data is kept in the bus edit buffers, which are separate from the buffers being sent out,
+  // so in pipelined mode the frame can wait there until the busses are free again instead of blocking.
+  // flushShow() (called by service() and the main loop) will then hand it off.
+  if (pipelineOutput && !busses.canAllShow()) {
+    _showPending = true;
+    _showPendingTime = micros() - showStart; //recorded with the bus transmit time on handoff
+    return;
+  }
+  handoffFrame();
+  _showTiming.add(micros() - showStart);
+}
+
+/*
+ * Starts sending the current frame to the busses and updates the FPS counter.
+ * Returns the time busses.show() took in us.
+ */
+uint32_t WS2812FX::handoffFrame() {
   // some buses send asynchronously and this method will return before
   // all of the data has been sent.
   // See https://github.com/Makuna/NeoPixelBus/wiki/ESP32-NeoMethods#neoesp32rmt-methods
+  uint32_t busStart = micros();
   busses.show();
+  uint32_t busTime = micros() - busStart;
+  _busTiming.add(busTime);
+  _showPending = false;
   unsigned long now = millis();
   unsigned long diff = now - _lastShow;
   uint16_t fpsCurr = 200;
   if (diff > 0) fpsCurr = 1000 / diff;
   _cumulativeFps = (3 * _cumulativeFps + fpsCurr) >> 2;
   _lastShow = now;
+  return busTime;
+}
+
+/**
+ * Hands off a frame that show() held back because the busses were still busy (pipelined output).
+ * Returns false if a frame is still waiting for the busses.
+ */
+bool WS2812FX::flushShow() {
+  if (!_showPending) return true;
+  if (!busses.canAllShow()) return false;
+  _showTiming.add(_showPendingTime + handoffFrame()); //the time waiting for the busses is not part of it
+  return true;
 }
 
 /**
@@ -322,7 +416,7 @@ void WS2812FX::show(void) {
  * On some hardware (ESP32), strip updates are done asynchronously.
  */
 bool WS2812FX::isUpdating() {
-  return !busses.canAllShow();
+  return _showPending || !busses.canAllShow();
 }
 
 /**
@@ -338,24 +432,89 @@ uint16_t WS2812FX::getFps() {
  * Forces the next frame to be computed on all active segments.
  */
 void WS2812FX::trigger() {
+  #ifdef WLED_ENABLE_RENDER_TASK
+  _triggerReq = true; //sent to the render task with publishSettings()
+  #else
   _triggered = true;
+  #endif
 }
 
 void WS2812FX::setMode(uint8_t segid, uint8_t m) {
   if (segid >= MAX_NUM_SEGMENTS) return;
    
-  if (m >= MODE_COUNT) m = MODE_COUNT - 1;
+  if (m >= getModeCount()) m = getModeCount() - 1;
 
-  if (_segments[segid].mode != m) 
+  if (SETTING(segments)[segid].mode != m) 
   {
+    #ifndef WLED_ENABLE_RENDER_TASK //the render task does this when it adopts the new mode
+    //service() starts the effect transition with the next frame, it needs the runtime data of the old effect
+    if (_fxTransitionFrom[segid] == 0xFF && !_segment_runtimes[segid].resetRequested()) _fxTransitionFrom[segid] = _segments[segid].mode;
     _segment_runtimes[segid].reset();
-    _segments[segid].mode = m;
+    #endif
+    SETTING(segments)[segid].mode = m;
   }
 }
 
 uint8_t WS2812FX::getModeCount()
 {
-  return MODE_COUNT;
+  return MODE_COUNT + _usermodEffectCount;
+}
+
+//effect table generated from WLED_EFFECTS, the names are separate PROGMEM strings
+#define FX_TABLE_NAME(id, fn, name, pal, flags) static const char _fxName_##id[] PROGMEM = name;
+WLED_EFFECTS(FX_TABLE_NAME, FX_TABLE_NAME)
+
+#define FX_TABLE_ENTRY(id, fn, name, pal, flags) {&WS2812FX::fn, _fxName_##id, pal, flags},
+const WS2812FX::EffectInfo WS2812FX::_effects[MODE_COUNT] PROGMEM = {
+  WLED_EFFECTS(FX_TABLE_ENTRY, FX_TABLE_ENTRY)
+};
+
+uint16_t WS2812FX::runMode(uint8_t m)
+{
+  if (m >= MODE_COUNT) {
+    //ID of a usermod effect that is not (or no longer) added, e.g. from a preset
+    if (m >= getModeCount()) return mode_static();
+    return _usermodEffects[m - MODE_COUNT].fn(*this, SEGMENT, SEGENV);
+  }
+  mode_ptr fn;
+  memcpy_P(&fn, &_effects[m].fn, sizeof(fn));
+  return (this->*fn)();
+}
+
+/*
+ * Adds an effect implemented by a usermod, with the next free ID after the builtin effects.
+ * name must stay valid (string literal, may be PSTR()) and must not contain '"'.
+ * Must be called before the boot preset is applied, i.e. from Usermod::addEffects(), so the IDs
+ * stored in presets refer to the same effects on every boot.
+ * Returns the effect ID, or 255 if no more effects can be added.
+ */
+uint8_t WS2812FX::addEffect(usermod_mode_ptr fn, const char* name, uint8_t palette, uint8_t flags)
+{
+  if (!fn || !name || _usermodEffectCount >= MAX_USERMOD_EFFECTS || getModeCount() >= 255) return 255;
+  _usermodEffects[_usermodEffectCount] = {fn, name, palette, flags};
+  return MODE_COUNT + _usermodEffectCount++;
+}
+
+//returns a PROGMEM string (or the name a usermod effect was added with), nullptr for an invalid ID
+const char* WS2812FX::getModeName(uint8_t m)
+{
+  if (m >= getModeCount()) return nullptr;
+  if (m >= MODE_COUNT) return _usermodEffects[m - MODE_COUNT].name;
+  return (const char*)pgm_read_ptr(&_effects[m].name);
+}
+
+uint8_t WS2812FX::getModeDefaultPalette(uint8_t m)
+{
+  if (m >= getModeCount()) return 0;
+  if (m >= MODE_COUNT) return _usermodEffects[m - MODE_COUNT].palette;
+  return pgm_read_byte(&_effects[m].palette);
+}
+
+uint8_t WS2812FX::getModeFlags(uint8_t m)
+{
+  if (m >= getModeCount()) return 0;
+  if (m >= MODE_COUNT) return _usermodEffects[m - MODE_COUNT].flags;
+  return pgm_read_byte(&_effects[m].flags);
 }
 
 uint8_t WS2812FX::getPaletteCount()
@@ -363,11 +522,271 @@ uint8_t WS2812FX::getPaletteCount()
   return 13 + GRADIENT_PALETTE_COUNT;
 }
 
-//TODO effect transitions
+WS2812FX::EffectTransition* WS2812FX::getEffectTransition(uint8_t segn) {
+  for (uint8_t i = 0; i < MAX_NUM_FX_TRANSITIONS; i++) {
+    if (_fxTransitions[i].segment == segn) return &_fxTransitions[i];
+  }
+  return nullptr;
+}
+
+/*
+ * Keeps the old effect of the current segment running for the transition time so it can be crossfaded
+ * with the new one. Must only be called from service(), before the runtime data of the segment is reset.
+ * If no transition slot or not enough buffer memory is available, the effect changes instantly.
+ */
+void WS2812FX::startEffectTransition(uint8_t segn, uint8_t modeOld) {
+  if (!effectTransitions || _transitionDur == 0 || _brightness == 0) return;
+  if (!SEGMENT.isActive() || SEGMENT.getOption(SEG_OPTION_FREEZE)) return;
+  if (modeOld >= getModeCount() || modeOld == SEGMENT.mode || SEGENV.call == 0) return; //old effect never ran
+
+  EffectTransition* t = getEffectTransition(segn);
+  if (t) { //effect changed again during the transition, keep fading out the oldest one
+    t->transitionStart = millis();
+    t->transitionDur = _transitionDur;
+    t->nextNew = 0;
+    t->palette = 0xFF; //palette of the new effect
+    return;
+  }
+  for (uint8_t i = 0; i < MAX_NUM_FX_TRANSITIONS; i++) {
+    if (_fxTransitions[i].segment == 0xFF) {
+      t = &_fxTransitions[i]; break;
+    }
+  }
+  if (!t) return;
+
+  uint16_t len = SEGMENT.virtualLength();
+  uint32_t bytes = len * 2 * sizeof(uint32_t);
+  if (_usedFxTransitionData + bytes > MAX_FX_TRANSITION_DATA) return;
+  uint32_t* buf = new (std::nothrow) uint32_t[len * 2];
+  if (!buf) {
+    heapAllocFailed(ALLOC_SITE_SEGMENT); return;
+  }
+  _usedFxTransitionData += bytes;
+
+  //both effects continue from the current frame
+  _virtualSegmentLength = len;
+  for (uint16_t p = 0; p < len; p++) buf[p] = buf[len + p] = getPixelColor(p);
+
+  SEGENV.moveTo(t->env);
+  t->pixOld = buf;
+  t->pixNew = buf + len;
+  t->len = len;
+  t->modeOld = modeOld;
+  t->transitionStart = millis();
+  t->transitionDur = _transitionDur;
+  t->nextNew = 0;
+  t->palette = 0xFF; //cached on the first frame, with the segment colors of that frame
+  t->segment = segn;
+}
+
+void WS2812FX::endEffectTransition(EffectTransition& t) {
+  if (t.segment == 0xFF) return;
+  t.env.deallocateData();
+  delete[] t.pixOld;
+  t.pixOld = nullptr;
+  t.pixNew = nullptr;
+  _usedFxTransitionData -= t.len * 2 * sizeof(uint32_t);
+  t.len = 0;
+  t.segment = 0xFF;
+}
+
+/*
+ * Sets the palettes of the old and the new effect of the current segment once,
+ * instead of for each effect in each frame of the transition.
+ */
+void WS2812FX::cacheTransitionPalettes(EffectTransition& t) {
+  uint8_t modeNew = SEGMENT.mode;
+  SEGMENT.mode = t.modeOld; //for the default palette
+  _segment_index_palette_last = 99; //do not fade the palette between the two effects
+  handle_palette();
+  t.palOld = currentPalette;
+  SEGMENT.mode = modeNew;
+  _segment_index_palette_last = 99;
+  handle_palette();
+  t.palNew = currentPalette;
+  t.palette = SEGMENT.palette;
+}
+
+/*
+ * Renders the old and the new effect of the current segment into their own pixel buffers,
+ * each one only when due, and writes the crossfade of both to the segment.
+ * Returns the delay until the segment needs to be serviced again.
+ */
+uint16_t WS2812FX::renderEffectTransition(EffectTransition& t, uint32_t nowUp) {
+  uint32_t start = micros();
+  uint16_t len = t.len;
+  uint8_t bri = _bri_t;
+  uint8_t modeNew = SEGMENT.mode;
+  _bri_t = 255; //effects render unscaled, opacity is applied to the blended result
+  if (t.palette != SEGMENT.palette) cacheTransitionPalettes(t); //first frame or palette changed
+  _segment_index_palette_last = _segment_index; //the next segment must not fade from these palettes
+
+  if (nowUp > t.env.next_time || _triggered) {
+    segment_runtime envNew = SEGENV;
+    SEGENV = t.env;
+    SEGMENT.mode = t.modeOld; //some effects check their ID
+    for (uint16_t p = 0; p < len; p++) setPixelColor(p, t.pixOld[p]);
+    currentPalette = t.palOld;
+    uint16_t delay = runMode(t.modeOld);
+    if (t.modeOld != FX_MODE_HALLOWEEN_EYES) SEGENV.call++;
+    SEGENV.next_time = nowUp + delay;
+    for (uint16_t p = 0; p < len; p++) t.pixOld[p] = getPixelColor(p);
+    t.env = SEGENV;
+    SEGENV = envNew;
+    if (SEGMENT.mode == t.modeOld) SEGMENT.mode = modeNew; //unless changed meanwhile
+  }
+
+  if (nowUp > t.nextNew || _triggered) {
+    for (uint16_t p = 0; p < len; p++) setPixelColor(p, t.pixNew[p]);
+    currentPalette = t.palNew;
+    uint16_t delay = runMode(modeNew);
+    if (modeNew != FX_MODE_HALLOWEEN_EYES) SEGENV.call++;
+    t.nextNew = nowUp + delay;
+    for (uint16_t p = 0; p < len; p++) t.pixNew[p] = getPixelColor(p);
+  }
+
+  uint16_t prog = t.progress();
+  _bri_t = bri;
+  for (uint16_t p = 0; p < len; p++) setPixelColor(p, color_blend(t.pixOld[p], t.pixNew[p], prog, true));
+  _fxTransitionTiming.add(micros() - start);
+
+  if (prog == 0xFFFF) { //done, the new effect continues on its own schedule
+    uint32_t nextNew = t.nextNew;
+    endEffectTransition(t);
+    return (nextNew > nowUp) ? nextNew - nowUp : 0;
+  }
+  return FRAMETIME;
+}
+
+/*
+ * Segments that overlap other active segments get a buffer to render into.
+ * composeSegments() blends them bottom-up (by segment ID) with their blend mode and opacity.
+ * Segments without overlap write to the busses directly, as before.
+ */
+void WS2812FX::updateCompositing() {
+  uint16_t len[MAX_NUM_SEGMENTS] = {0};
+  uint32_t total = 0;
+
+  for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++) {
+    Segment& seg = _segments[i];
+    if (!compositing || !seg.isActive()) continue;
+    for (uint8_t j = 0; j < MAX_NUM_SEGMENTS; j++) {
+      if (j == i || !_segments[j].isActive()) continue;
+      if (seg.start < _segments[j].stop && _segments[j].start < seg.stop) {
+        len[i] = seg.length(); break;
+      }
+    }
+    total += (len[i] + (len[i] + 31) / 32) * sizeof(uint32_t);
+  }
+  if (total > MAX_COMPOSITE_DATA) memset(len, 0, sizeof(len)); //not enough memory, overlapping segments overwrite each other
+
+  for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++) {
+    if (len[i] == _segBufLen[i]) continue;
+    if (_segBuf[i]) {
+      delete[] _segBuf[i];
+      _segBuf[i] = nullptr;
+      _usedCompositeData -= (_segBufLen[i] + (_segBufLen[i] + 31) / 32) * sizeof(uint32_t);
+      _segBufLen[i] = 0;
+    }
+    if (!len[i]) continue;
+    uint16_t words = len[i] + (len[i] + 31) / 32;
+    _segBuf[i] = new (std::nothrow) uint32_t[words];
+    if (!_segBuf[i]) {
+      heapAllocFailed(ALLOC_SITE_SEGMENT); continue;
+    }
+    memset(_segBuf[i], 0, words * sizeof(uint32_t)); //transparent until rendered
+    _segBufLen[i] = len[i];
+    _usedCompositeData += words * sizeof(uint32_t);
+    _segOpacity[i] = _segments[i].getOption(SEG_OPTION_ON) ? _segments[i].opacity : 0;
+    _segment_runtimes[i].next_time = 0; //render into the new buffer right away
+  }
+}
+
+/*
+ * Marks the pixels of the buffer of the current segment that its effect can draw to (set bitmap),
+ * with the grouping, spacing and mirroring of this frame. Pixels in the gaps stay transparent.
+ * Called for each frame the segment is rendered, so a changed segment does not leave stale pixels behind.
+ */
+void WS2812FX::updateSegmentMask() {
+  uint16_t len = _segBufLen[_segment_index];
+  uint8_t* set = (uint8_t*)(_segBuf[_segment_index] + len);
+  memset(set, 0, ((len + 31) / 32) * sizeof(uint32_t));
+
+  bool reversed = IS_REVERSE;
+  uint16_t vLen = SEGMENT.virtualLength();
+  for (uint16_t i = 0; i < vLen; i++) {
+    uint16_t realIndex = realPixelIndex(i);
+    for (uint16_t j = 0; j < SEGMENT.grouping; j++) {
+      int16_t indexSet = realIndex + (reversed ? -j : j);
+      if (indexSet < SEGMENT.start || indexSet >= SEGMENT.stop) continue;
+      uint16_t o = indexSet - SEGMENT.start;
+      if (o < len) set[o >> 3] |= 1 << (o & 7);
+      if (IS_MIRROR) {
+        o = SEGMENT.stop - indexSet - 1;
+        if (o < len) set[o >> 3] |= 1 << (o & 7);
+      }
+    }
+  }
+}
+
+uint32_t WS2812FX::blendLayer(uint32_t dst, uint32_t src, uint8_t mode) {
+  if (mode == BLEND_MODE_NORMAL) return src;
+  uint32_t out = 0;
+  for (uint8_t s = 0; s < 32; s += 8) {
+    uint8_t a = dst >> s, b = src >> s, c;
+    switch (mode) {
+      case BLEND_MODE_ADD:      c = qadd8(a, b); break;
+      case BLEND_MODE_MULTIPLY: c = scale8(a, b); break;
+      case BLEND_MODE_MAX:      c = MAX(a, b); break;
+      case BLEND_MODE_SCREEN:   c = 255 - scale8(255 - a, 255 - b); break;
+      default:                  c = b;
+    }
+    out |= (uint32_t)c << s;
+  }
+  return out;
+}
+
+/*
+ * Writes the composite of all buffered segments to the busses.
+ * The lowest segment covering a pixel is blended with black by its opacity,
+ * each segment above is blended with the result by its blend mode and opacity.
+ */
+void WS2812FX::composeSegments() {
+  uint32_t start = micros();
+  uint16_t first = 0xFFFF, last = 0;
+  for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++) {
+    if (!_segBuf[i]) continue;
+    if (_segments[i].start < first) first = _segments[i].start;
+    if (_segments[i].stop  > last)  last  = _segments[i].stop;
+  }
+  uint16_t skip = _skipFirstMode ? LED_SKIP_AMOUNT : 0;
+
+  for (uint16_t p = first; p < last; p++) {
+    uint32_t col = 0;
+    bool covered = false;
+    for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++) {
+      if (!_segBuf[i]) continue;
+      Segment& seg = _segments[i];
+      if (p < seg.start || p >= seg.start + _segBufLen[i]) continue;
+      uint16_t o = p - seg.start;
+      uint8_t* set = (uint8_t*)(_segBuf[i] + _segBufLen[i]);
+      if (!(set[o >> 3] & (1 << (o & 7)))) continue; //in a gap (spacing), transparent
+      uint32_t c = _segBuf[i][o];
+      if (covered) c = blendLayer(col, c, seg.blendMode);
+      col = color_blend(col, c, _segOpacity[i]);
+      covered = true;
+    }
+    if (!covered) continue;
+    uint16_t indexSet = p;
+    if (indexSet < customMappingSize) indexSet = customMappingTable[indexSet];
+    busses.setPixelColor(indexSet + skip, col);
+  }
+  _composeTiming.add(micros() - start);
+}
 
 
 bool WS2812FX::setEffectConfig(uint8_t m, uint8_t s, uint8_t in, uint8_t p) {
-  Segment& seg = _segments[getMainSegmentId()];
+  Segment& seg = SETTING(segments)[getMainSegmentId()];
   uint8_t modePrev = seg.mode, speedPrev = seg.speed, intensityPrev = seg.intensity, palettePrev = seg.palette;
 
   bool applied = false;
@@ -375,11 +794,11 @@ bool WS2812FX::setEffectConfig(uint8_t m, uint8_t s, uint8_t in, uint8_t p) {
   if (applyToAllSelected) {
     for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++)
     {
-      if (_segments[i].isSelected())
+      if (SETTING(segments)[i].isSelected())
       {
-        _segments[i].speed = s;
-        _segments[i].intensity = in;
-        _segments[i].palette = p;
+        SETTING(segments)[i].speed = s;
+        SETTING(segments)[i].intensity = in;
+        SETTING(segments)[i].palette = p;
         setMode(i, m);
         applied = true;
       }
@@ -409,8 +828,8 @@ void WS2812FX::setColor(uint8_t slot, uint32_t c) {
   if (applyToAllSelected) {
     for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++)
     {
-      if (_segments[i].isSelected()) {
-        _segments[i].setColor(slot, c, i);
+      if (SETTING(segments)[i].isSelected()) {
+        SETTING(segments)[i].setColor(slot, c, i);
         applied = true;
       }
     }
@@ -418,34 +837,37 @@ void WS2812FX::setColor(uint8_t slot, uint32_t c) {
 
   if (!applyToAllSelected || !applied) {
     uint8_t mainseg = getMainSegmentId();
-    _segments[mainseg].setColor(slot, c, mainseg);
+    SETTING(segments)[mainseg].setColor(slot, c, mainseg);
   }
 }
 
 void WS2812FX::setBrightness(uint8_t b) {
   if (gammaCorrectBri) b = gamma8(b);
-  if (_brightness == b) return;
-  _brightness = b;
-  _segment_index = 0;
-  if (_brightness == 0) { //unfreeze all segments on power off
+  if (SETTING(brightness) == b) return;
+  SETTING(brightness) = b;
+  if (b == 0) { //unfreeze all segments on power off
     for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++)
     {
-      _segments[i].setOption(SEG_OPTION_FREEZE, false);
+      SETTING(segments)[i].setOption(SEG_OPTION_FREEZE, false);
     }
   }
+  //with the render task, only it may call show(), it applies the change with the next frame (adoptSettings())
+  #ifndef WLED_ENABLE_RENDER_TASK
+  _segment_index = 0;
   if (SEGENV.next_time > millis() + 22 && millis() - _lastShow > MIN_SHOW_DELAY) show();//apply brightness change immediately if no refresh soon
+  #endif
 }
 
 uint8_t WS2812FX::getMode(void) {
-  return _segments[getMainSegmentId()].mode;
+  return SETTING(segments)[getMainSegmentId()].mode;
 }
 
 uint8_t WS2812FX::getSpeed(void) {
-  return _segments[getMainSegmentId()].speed;
+  return SETTING(segments)[getMainSegmentId()].speed;
 }
 
 uint8_t WS2812FX::getBrightness(void) {
-  return _brightness;
+  return SETTING(brightness);
 }
 
 uint8_t WS2812FX::getMaxSegments(void) {
@@ -467,21 +889,26 @@ uint8_t WS2812FX::getMaxSegments(void) {
 
 uint8_t WS2812FX::getMainSegmentId(void) {
   if (mainSegment >= MAX_NUM_SEGMENTS) return 0;
-  if (_segments[mainSegment].isActive()) return mainSegment;
+  if (SETTING(segments)[mainSegment].isActive()) return mainSegment;
   for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++) //get first active
   {
-    if (_segments[i].isActive()) return i;
+    if (SETTING(segments)[i].isActive()) return i;
   }
   return 0;
 }
 
 uint32_t WS2812FX::getColor(void) {
-  return _segments[getMainSegmentId()].colors[0];
+  return SETTING(segments)[getMainSegmentId()].colors[0];
 }
 
 uint32_t WS2812FX::getPixelColor(uint16_t i)
 {
   i = realPixelIndex(i);
+
+  if (SEGLEN && _segBuf[_segment_index]) { //overlapping segment, returns the color before blending
+    if (i < SEGMENT.start || i - SEGMENT.start >= _segBufLen[_segment_index]) return 0;
+    return _segBuf[_segment_index][i - SEGMENT.start];
+  }
   
   if (i < customMappingSize) i = customMappingTable[i];
 
@@ -493,8 +920,14 @@ uint32_t WS2812FX::getPixelColor(uint16_t i)
 }
 
 WS2812FX::Segment& WS2812FX::getSegment(uint8_t id) {
-  if (id >= MAX_NUM_SEGMENTS) return _segments[0];
-  return _segments[id];
+  if (id >= MAX_NUM_SEGMENTS) return SETTING(segments)[0];
+  return SETTING(segments)[id];
+}
+
+//color slot of the segment being rendered, with color transitions and gamma applied (for usermod effects)
+uint32_t WS2812FX::getEffectColor(uint8_t slot) {
+  if (slot >= 3) return 0;
+  return SEGCOLOR(slot);
 }
 
 WS2812FX::Segment_runtime WS2812FX::getSegmentRuntime(void) {
@@ -502,13 +935,30 @@ WS2812FX::Segment_runtime WS2812FX::getSegmentRuntime(void) {
 }
 
 WS2812FX::Segment* WS2812FX::getSegments(void) {
-  return _segments;
+  return SETTING(segments);
 }
 
 uint32_t WS2812FX::getLastShow(void) {
   return _lastShow;
 }
 
+/**
+ * Returns the render timing statistics of the last completed window (RENDER_TIMING_WINDOW ms).
+ * FX and PALETTE timings are kept per segment, the others for the whole strip.
+ */
+WS2812FX::RenderTiming& WS2812FX::getRenderTiming(uint8_t type, uint8_t seg) {
+  if (seg >= MAX_NUM_SEGMENTS) seg = 0;
+  switch (type) {
+    case RENDER_TIMING_FX:      return _fxTiming[seg];
+    case RENDER_TIMING_PALETTE: return _paletteTiming[seg];
+    case RENDER_TIMING_SHOW:    return _showTiming;
+    case RENDER_TIMING_BUS:     return _busTiming;
+    case RENDER_TIMING_XFADE:   return _fxTransitionTiming;
+    case RENDER_TIMING_COMPOSE: return _composeTiming;
+  }
+  return _frameTiming;
+}
+
 //TODO these need to be on a per-strip basis
 uint8_t WS2812FX::getColorOrder(void) {
   return COL_ORDER_GRB;
@@ -520,12 +970,15 @@ void WS2812FX::setColorOrder(uint8_t co) {
 
 void WS2812FX::setSegment(uint8_t n, uint16_t i1, uint16_t i2, uint8_t grouping, uint8_t spacing) {
   if (n >= MAX_NUM_SEGMENTS) return;
-  Segment& seg = _segments[n];
+  Segment& seg = SETTING(segments)[n];
+  if (i2 > _length) i2 = _length; //before the comparison, a sender with more LEDs must not reset the segment each time
 
   //return if neither bounds nor grouping have changed
   if (seg.start == i1 && seg.stop == i2 && (!grouping || (seg.grouping == grouping && seg.spacing == spacing))) return;
 
+  #ifndef WLED_ENABLE_RENDER_TASK //the render task does this when it adopts the new bounds
   if (seg.stop) setRange(seg.start, seg.stop -1, 0); //turn old segment range off
+  #endif
   if (i2 <= i1) //disable segment
   {
     seg.stop = 0; 
@@ -533,7 +986,7 @@ void WS2812FX::setSegment(uint8_t n, uint16_t i1, uint16_t i2, uint8_t grouping,
     {
       for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++)
       {
-        if (_segments[i].isActive()) {
+        if (SETTING(segments)[i].isActive()) {
           mainSegment = i;
           return;
         }
@@ -542,43 +995,49 @@ void WS2812FX::setSegment(uint8_t n, uint16_t i1, uint16_t i2, uint8_t grouping,
     }
     return;
   }
-  if (i1 < _length) seg.start = i1;
+  seg.start = i1;
   seg.stop = i2;
-  if (i2 > _length) seg.stop = _length;
   if (grouping) {
     seg.grouping = grouping;
     seg.spacing = spacing;
   }
+  #ifndef WLED_ENABLE_RENDER_TASK
+  _fxTransitionFrom[n] = 0xFF; //runtime data of the old effect does not fit the new bounds
   _segment_runtimes[n].reset();
+  #endif
 }
 
 void WS2812FX::resetSegments() {
   mainSegment = 0;
-  memset(_segments, 0, sizeof(_segments));
+  Segment* segs = SETTING(segments);
+  memset(segs, 0, sizeof(SETTING(segments)));
   //memset(_segment_runtimes, 0, sizeof(_segment_runtimes));
-  _segment_index = 0;
-  _segments[0].mode = DEFAULT_MODE;
-  _segments[0].colors[0] = DEFAULT_COLOR;
-  _segments[0].start = 0;
-  _segments[0].speed = DEFAULT_SPEED;
-  _segments[0].intensity = DEFAULT_INTENSITY;
-  _segments[0].stop = _length;
-  _segments[0].grouping = 1;
-  _segments[0].setOption(SEG_OPTION_SELECTED, 1);
-  _segments[0].setOption(SEG_OPTION_ON, 1);
-  _segments[0].opacity = 255;
+  segs[0].mode = DEFAULT_MODE;
+  segs[0].colors[0] = DEFAULT_COLOR;
+  segs[0].start = 0;
+  segs[0].speed = DEFAULT_SPEED;
+  segs[0].intensity = DEFAULT_INTENSITY;
+  segs[0].stop = _length;
+  segs[0].grouping = 1;
+  segs[0].setOption(SEG_OPTION_SELECTED, 1);
+  segs[0].setOption(SEG_OPTION_ON, 1);
+  segs[0].opacity = 255;
 
   for (uint16_t i = 1; i < MAX_NUM_SEGMENTS; i++)
   {
-    _segments[i].colors[0] = color_wheel(i*51);
-    _segments[i].grouping = 1;
-    _segments[i].setOption(SEG_OPTION_ON, 1);
-    _segments[i].opacity = 255;
-    _segments[i].speed = DEFAULT_SPEED;
-    _segments[i].intensity = DEFAULT_INTENSITY;
-    _segment_runtimes[i].reset();
+    segs[i].colors[0] = color_wheel(i*51);
+    segs[i].grouping = 1;
+    segs[i].setOption(SEG_OPTION_ON, 1);
+    segs[i].opacity = 255;
+    segs[i].speed = DEFAULT_SPEED;
+    segs[i].intensity = DEFAULT_INTENSITY;
   }
-  _segment_runtimes[0].reset();
+  #ifdef WLED_ENABLE_RENDER_TASK
+  _resetMask = 0xFFFFFFFF; //sent to the render task with publishSettings()
+  #else
+  _segment_index = 0;
+  for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++) _segment_runtimes[i].reset();
+  #endif
 }
 
 //After this function is called, setPixelColor() will use that segment (offsets, grouping, ... will apply)
@@ -611,10 +1070,19 @@ void WS2812FX::setShowCallback(show_callback cb)
 
 void WS2812FX::setTransition(uint16_t t)
 {
-  _transitionDur = t;
+  SETTING(transitionDur) = t;
 }
 
 void WS2812FX::setTransitionMode(bool t)
+{
+  #ifdef WLED_ENABLE_RENDER_TASK
+  _transitionModeReq = t; //sent to the render task with publishSettings()
+  #else
+  applyTransitionMode(t);
+  #endif
+}
+
+void WS2812FX::applyTransitionMode(bool t)
 {
   unsigned long waitMax = millis() + 20; //refresh after 20 ms if transition enabled
   for (uint16_t i = 0; i < MAX_NUM_SEGMENTS; i++)
@@ -626,6 +1094,85 @@ void WS2812FX::setTransitionMode(bool t)
   }
 }
 
+#ifdef WLED_ENABLE_RENDER_TASK
+/*
+ * Main loop, once per pass: hands the segments, brightness and transition time to the render task in a
+ * snapshot, then what does not fit in one (trigger(), runtime resets, setTransitionMode()) as commands.
+ * A request the command queue has no room for is kept and sent with the next pass.
+ */
+void WS2812FX::publishSettings() {
+  _published.write(_settings);
+  if (_resetMask && renderCommand(RENDER_CMD_RESET, _resetMask)) _resetMask = 0;
+  if (_transitionModeReq != 0xFF && renderCommand(RENDER_CMD_TRANSITION, _transitionModeReq)) _transitionModeReq = 0xFF;
+  if (_triggerReq && renderCommand(RENDER_CMD_TRIGGER)) _triggerReq = false;
+}
+
+/*
+ * Render task, before each frame: takes over the settings published last. What the setters do right away
+ * without the render task is done here for each changed segment: color transitions are started, the runtime
+ * data is reset on a new effect or new bounds, the old range of a moved segment is turned off (only if output,
+ * not while the main loop shows realtime data). A changed segment is drawn with the next frame.
+ */
+void WS2812FX::adoptSettings(bool output) {
+  StripSettings set;
+  if (!_published.read(set)) return; //nothing published yet, or the main loop is writing: with the next frame
+  _transitionDur = set.transitionDur;
+
+  for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++) {
+    Segment& seg = _segments[i];
+    Segment& s = set.segments[i];
+    bool moved = s.start != seg.start || s.stop != seg.stop || s.grouping != seg.grouping || s.spacing != seg.spacing;
+    uint8_t options = s.options ^ seg.options;
+    options &= ~(0x01 << SEG_OPTION_TRANSITIONAL); //only the render task sets it
+    if (!moved && !options && s.opacity == seg.opacity && s.blendMode == seg.blendMode && segmentsAreIdentical(&s, &seg)) continue;
+
+    if (moved) {
+      if (output && seg.stop) setRange(seg.start, seg.stop -1, 0); //turn old segment range off
+      _fxTransitionFrom[i] = 0xFF; //runtime data of the old effect does not fit the new bounds
+      _segment_runtimes[i].reset();
+    } else if (s.mode != seg.mode) {
+      //service() starts the effect transition with the next frame, it needs the runtime data of the old effect
+      if (_fxTransitionFrom[i] == 0xFF && !_segment_runtimes[i].resetRequested()) _fxTransitionFrom[i] = seg.mode;
+      _segment_runtimes[i].reset();
+    }
+    if (s.opacity != seg.opacity || s.colors[0] != seg.colors[0]) {
+      ColorTransition::startTransition(seg.opacity, seg.colors[0], _transitionDur, i, 0);
+    }
+    for (uint8_t c = 1; c < NUM_COLORS; c++) {
+      if (s.colors[c] != seg.colors[c]) ColorTransition::startTransition(seg.opacity, seg.colors[c], _transitionDur, i, c);
+    }
+
+    bool transitional = seg.getOption(SEG_OPTION_TRANSITIONAL);
+    seg = s;
+    seg.setOption(SEG_OPTION_TRANSITIONAL, transitional);
+    _segment_runtimes[i].next_time = 0;
+  }
+
+  //after the segments: like without the render task, turning on from off starts no color transition
+  if (set.brightness != _brightness) {
+    _brightness = set.brightness;
+    _triggered = true;
+  }
+}
+
+//render task: a command sent by publishSettings()
+void WS2812FX::runCommand(uint8_t type, uint32_t arg) {
+  switch (type) {
+    case RENDER_CMD_TRIGGER:
+      _triggered = true; break;
+    case RENDER_CMD_RESET:
+      for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++) {
+        if (!(arg & (1UL << i))) continue;
+        _fxTransitionFrom[i] = 0xFF;
+        _segment_runtimes[i].reset();
+      }
+      break;
+    case RENDER_CMD_TRANSITION:
+      applyTransitionMode(arg); break;
+  }
+}
+#endif
+
 /*
  * color blend function
  */
@@ -833,27 +1380,11 @@ void WS2812FX::handle_palette(void)
   _segment_index_palette_last = _segment_index;
 
   byte paletteIndex = SEGMENT.palette;
-  if (paletteIndex == 0) //default palette. Differs depending on effect
-  {
-    switch (SEGMENT.mode)
-    {
-      case FX_MODE_FIRE_2012  : paletteIndex = 35; break; //heat palette
-      case FX_MODE_COLORWAVES : paletteIndex = 26; break; //landscape 33
-      case FX_MODE_FILLNOISE8 : paletteIndex =  9; break; //ocean colors
-      case FX_MODE_NOISE16_1  : paletteIndex = 20; break; //Drywet
-      case FX_MODE_NOISE16_2  : paletteIndex = 43; break; //Blue cyan yellow
-      case FX_MODE_NOISE16_3  : paletteIndex = 35; break; //heat palette
-      case FX_MODE_NOISE16_4  : paletteIndex = 26; break; //landscape 33
-      case FX_MODE_GLITTER    : paletteIndex = 11; break; //rainbow colors
-      case FX_MODE_SUNRISE    : paletteIndex = 35; break; //heat palette
-      case FX_MODE_FLOW       : paletteIndex =  6; break; //party
-    }
-  }
-  if (SEGMENT.mode >= FX_MODE_METEOR && paletteIndex == 0) paletteIndex = 4;
+  if (paletteIndex == 0) paletteIndex = getModeDefaultPalette(SEGMENT.mode); //default palette. Differs depending on effect
   
   switch (paletteIndex)
   {
-    case 0: //default palette. Exceptions for specific effects above
+    case 0: //default palette. Exceptions for specific effects in WLED_EFFECTS
       targetPalette = PartyColors_p; break;
     case 1: {//periodically replace palette with a random one. Doesn't work with multiple FastLED segments
       if (!singleSegmentMode)
@@ -968,29 +1499,146 @@ bool WS2812FX::segmentsAreIdentical(Segment* a, Segment* b)
 }
 
 
-//load custom mapping table from JSON file
-void WS2812FX::deserializeMap(void) {
-  if (!WLED_FS.exists("/ledmap.json")) return;
-  DynamicJsonDocument doc(JSON_BUFFER_SIZE);  // full sized buffer for larger maps
+/*
+ * Custom mapping tables are read straight from the file into customMappingTable,
+ * so only the table itself (2 bytes per LED) has to fit into the heap.
+ *
+ * "ledmap.map" is an optional compact binary format, used instead of "ledmap.json" if present
+ * (all values little endian):
+ *   uint32 magic "WLM1", uint16 number of entries, uint16 number of runs, uint32 FNV-1a of the runs
+ *   runs: uint16 first value, int16 length (negative: descending values, e.g. serpentine rows)
+ */
+#define LEDMAP_BIN_MAGIC  0x314D4C57 //"WLM1"
+#define LEDMAP_BIN_HEADER 12
+#define LEDMAP_READ_BUF   64
+
+//buffered sequential reading of a file
+class MapReader {
+  public:
+    MapReader(File& f) : _f(f) {}
+    void rewind() { _f.seek(0); _pos = _len = 0; }
+    int next() {
+      if (_pos >= _len) {
+        _len = _f.read(_buf, LEDMAP_READ_BUF);
+        _pos = 0;
+        if (_len == 0) return -1;
+      }
+      return _buf[_pos++];
+    }
+  private:
+    File& _f;
+    uint8_t _buf[LEDMAP_READ_BUF];
+    uint8_t _pos = 0, _len = 0;
+};
+
+/*
+ * Parses the numbers of the "map" array without building a JSON document.
+ * Only counts them if table is nullptr. Returns the number of entries, 0 on error.
+ */
+static uint32_t parseMapJson(MapReader& in, uint16_t* table)
+{
+  in.rewind();
+  const char* key = "\"map\"";
+  uint8_t matched = 0;
+  int c;
+  while (key[matched]) { //find the key
+    c = in.next();
+    if (c < 0) return 0;
+    matched = (c == key[matched]) ? matched + 1 : (c == key[0]);
+  }
+  do { c = in.next(); } while (c == ' ' || c == ':' || c == '\r' || c == '\n' || c == '\t');
+  if (c != '[') return 0;
+
+  uint32_t count = 0;
+  for (;;) {
+    c = in.next();
+    if (c == ' ' || c == ',' || c == '\r' || c == '\n' || c == '\t') continue;
+    if (c == ']') return count;
+    if (c != '-' && (c < '0' || c > '9')) return 0; //invalid or truncated
+    bool negative = (c == '-');
+    int32_t val = negative ? 0 : c - '0';
+    while ((c = in.next()) >= '0' && c <= '9') val = val * 10 + (c - '0');
+    if (table) table[count] = negative ? -val : val; //as before, -1 becomes 65535
+    if (++count > 0xFFFF) return 0;
+    if (c == ']') return count;
+    if (c != ' ' && c != ',' && c != '\r' && c != '\n' && c != '\t') return 0; //e.g. decimals or end of file
+  }
+}
 
-  DEBUG_PRINTLN(F("Reading LED map from /ledmap.json..."));
+static uint16_t* loadMapJson(File& f, uint16_t& size)
+{
+  MapReader in(f);
+  uint32_t count = parseMapJson(in, nullptr);
+  if (!count) return nullptr;
+  uint16_t* table = new (std::nothrow) uint16_t[count];
+  if (!table) return nullptr;
+  parseMapJson(in, table);
+  size = count;
+  return table;
+}
 
-  if (!readObjectFromFile("/ledmap.json", nullptr, &doc)) return; //if file does not exist just exit
+static uint16_t* loadMapBinary(File& f, uint16_t& size)
+{
+  uint8_t hdr[LEDMAP_BIN_HEADER];
+  if (f.read(hdr, LEDMAP_BIN_HEADER) != LEDMAP_BIN_HEADER) return nullptr;
+  uint32_t magic = hdr[0] | (hdr[1] << 8) | (hdr[2] << 16) | ((uint32_t)hdr[3] << 24);
+  uint16_t entries = hdr[4] | (hdr[5] << 8);
+  uint16_t runs    = hdr[6] | (hdr[7] << 8);
+  uint32_t check   = hdr[8] | (hdr[9] << 8) | (hdr[10] << 16) | ((uint32_t)hdr[11] << 24);
+  if (magic != LEDMAP_BIN_MAGIC || !entries) return nullptr;
+
+  uint16_t* table = new (std::nothrow) uint16_t[entries];
+  if (!table) return nullptr;
+  uint32_t hash = 2166136261UL, filled = 0;
+  uint8_t buf[LEDMAP_READ_BUF];
+  uint16_t done = 0;
+  while (done < runs) {
+    uint16_t n = min(runs - done, LEDMAP_READ_BUF / 4);
+    if (f.read(buf, n * 4) != n * 4u) break;
+    for (uint16_t b = 0; b < n * 4; b++) hash = (hash ^ buf[b]) * 16777619UL;
+    for (uint16_t r = 0; r < n; r++) {
+      uint16_t first = buf[r*4] | (buf[r*4 +1] << 8);
+      int16_t len = buf[r*4 +2] | (buf[r*4 +3] << 8);
+      int8_t step = (len < 0) ? -1 : 1;
+      uint16_t cnt = (len < 0) ? -len : len;
+      if (filled + cnt > entries) { filled = entries + 1; break; }
+      for (uint16_t i = 0; i < cnt; i++) table[filled++] = first + i * step;
+    }
+    done += n;
+  }
+  if (done != runs || filled != entries || hash != check) { //truncated or corrupt
+    delete[] table;
+    return nullptr;
+  }
+  size = entries;
+  return table;
+}
 
+//load custom mapping table from file
+void WS2812FX::deserializeMap(void) {
   if (customMappingTable != nullptr) {
     delete[] customMappingTable;
     customMappingTable = nullptr;
     customMappingSize = 0;
   }
 
-  JsonArray map = doc[F("map")];
-  if (!map.isNull() && map.size()) {  // not an empty map
-    customMappingSize  = map.size();
-    customMappingTable = new uint16_t[customMappingSize];
-    for (uint16_t i=0; i<customMappingSize; i++) {
-      customMappingTable[i] = (uint16_t) map[i];
-    }
+  uint16_t size = 0;
+  File f;
+  if (WLED_FS.exists("/ledmap.map") && (f = WLED_FS.open("/ledmap.map", "r"))) {
+    DEBUG_PRINTLN(F("Reading LED map from /ledmap.map..."));
+    customMappingTable = loadMapBinary(f, size);
+    f.close();
+  }
+  if (!customMappingTable) {
+    if (!WLED_FS.exists("/ledmap.json")) return;
+    f = WLED_FS.open("/ledmap.json", "r");
+    if (!f) return; //if file does not exist just exit
+    DEBUG_PRINTLN(F("Reading LED map from /ledmap.json..."));
+    customMappingTable = loadMapJson(f, size);
+    f.close();
   }
+  if (customMappingTable) customMappingSize = size;
+  else DEBUG_PRINTLN(F("Invalid LED map."));
 }
 
 //gamma 2.8 lookup table used for color correction
@@ -5,8 +5,9 @@
 * NodeStruct from the ESP Easy project (https://github.com/letscontrolit/ESPEasy)
 \*********************************************************************************************/
 
-#include <map>
-#include <IPAddress.h>
+#include <stdint.h>
+#include <string.h>
+#include <new>
 
 #define NODE_TYPE_ID_UNDEFINED        0
 #define NODE_TYPE_ID_ESP8266         82
@@ -17,18 +18,134 @@
 \*********************************************************************************************/
 struct NodeStruct
 {
-  String    nodeName;
-  IPAddress ip;
-  uint8_t   unit;
-  uint8_t   age;
-  uint8_t   nodeType;
+  uint32_t  ip;       //IPAddress raw value, 0 if slot is free
+  uint32_t  lastSeen; //millis() of the last announcement
   uint32_t  build;
+  char      nodeName[33];
+  uint8_t   nodeType;
+};
+
+/*
+ * Fixed capacity node list, open addressing with linear probing keyed by the full IP.
+ * Deleting shifts the following entries back, so lookups never need tombstones.
+ * The slots are only allocated once the first node is added.
+ */
+class NodeTable
+{
+  public:
+    NodeTable(uint16_t capacity, uint16_t maxNodes) : _capacity(capacity), _maxNodes(maxNodes) {}
+    ~NodeTable() { delete[] _slots; }
+
+    //nullptr if not present
+    NodeStruct* find(uint32_t ip) {
+      if (!_slots || !ip) return nullptr;
+      for (uint16_t i = home(ip), n = 0; n < _capacity; i = next(i), n++) {
+        if (_slots[i].ip == ip) return &_slots[i];
+        if (!_slots[i].ip) return nullptr;
+      }
+      return nullptr;
+    }
+
+    //returns the existing or a new (zeroed) node, nullptr if the table is full or out of memory
+    NodeStruct* insert(uint32_t ip) {
+      if (!ip) return nullptr;
+      NodeStruct* node = find(ip);
+      if (node) return node;
+      if (_size >= _maxNodes) return nullptr;
+      if (!_slots) {
+        _slots = new (std::nothrow) NodeStruct[_capacity];
+        if (!_slots) return nullptr;
+        memset(_slots, 0, sizeof(NodeStruct) * _capacity);
+      }
+      uint16_t i = home(ip);
+      while (_slots[i].ip) i = next(i);
+      _slots[i].ip = ip;
+      _size++;
+      return &_slots[i];
+    }
+
+    void remove(uint32_t ip) {
+      NodeStruct* node = find(ip);
+      if (node) removeAt(node - _slots);
+    }
+
+    //removes nodes not seen for maxAge ms
+    void expire(uint32_t now, uint32_t maxAge) {
+      if (!_slots) return;
+      for (uint16_t i = 0; i < _capacity; i++) {
+        //an entry shifted back into slot i may be expired as well
+        while (_slots[i].ip && now - _slots[i].lastSeen > maxAge) removeAt(i);
+      }
+    }
+
+    void clear() {
+      delete[] _slots;
+      _slots = nullptr;
+      _size = 0;
+    }
+
+    uint16_t size() { return _size; }
+    uint16_t capacity() { return _slots ? _capacity : 0; }
+
+    //for iterating over all slots, nullptr if the slot is free
+    NodeStruct* at(uint16_t i) {
+      if (!_slots || i >= _capacity || !_slots[i].ip) return nullptr;
+      return &_slots[i];
+    }
+
+  private:
+    NodeStruct* _slots = nullptr;
+    uint16_t _capacity, _maxNodes, _size = 0;
+
+    uint16_t home(uint32_t ip) { return (ip * 2654435761u) % _capacity; }
+    uint16_t next(uint16_t i) { return (i + 1 < _capacity) ? i + 1 : 0; }
+
+    //backward shift deletion
+    void removeAt(uint16_t i) {
+      uint16_t j = i;
+      for (;;) {
+        j = next(j);
+        if (!_slots[j].ip) break;
+        uint16_t k = home(_slots[j].ip);
+        //move j back to i unless its home slot lies cyclically in (i, j]
+        bool inRange = (i <= j) ? (i < k && k <= j) : (i < k || k <= j);
+        if (!inRange) {
+          _slots[i] = _slots[j];
+          i = j;
+        }
+      }
+      _slots[i].ip = 0;
+      _size--;
+    }
+};
+
+/*
+ * Rate limit for answering node queries, per requesting node: all nodes may query at the same time
+ * (e.g. after a power cut), but a single node flooding queries only gets one reply per interval.
+ * Remembers the last N requesters, the least recently answered one is replaced.
+ */
+template <uint8_t N>
+class QueryRateLimit
+{
+  public:
+    //true if a query of ip may be answered now, which is then recorded
+    bool allow(uint32_t ip, uint32_t now, uint32_t interval) {
+      uint8_t oldest = 0;
+      for (uint8_t i = 0; i < N; i++) {
+        if (_ip[i] == ip) {
+          if (now - _time[i] < interval) return false;
+          oldest = i; break;
+        }
+        if (now - _time[i] > now - _time[oldest]) oldest = i;
+      }
+      _ip[oldest] = ip;
+      _time[oldest] = now;
+      return true;
+    }
 
-  NodeStruct() : age(0), nodeType(0), build(0)
-  {
-    for (uint8_t i = 0; i < 4; ++i) { ip[i] = 0; }
-  }
+  private:
+    uint32_t _ip[N] = {0};
+    uint32_t _time[N] = {0};
 };
-typedef std::map<uint8_t, NodeStruct> NodesMap;
 
 #endif // WLED_NODESTRUCT_H
@@ -0,0 +1,153 @@
+#include "wled.h"
+
+/*
+ * Boot phase profiling and fast boot
+ * bootMark() records the time (us since power-on) a boot phase was completed,
+ * reported in /json/info "boot" and printed in debug builds.
+ * With fast boot enabled, the state the boot preset results in is cached in a small binary
+ * file, so the next boot does not have to search and parse presets.json before the first light.
+ * The cache is removed whenever a preset is saved or deleted, and when presets.json is uploaded
+ * or deleted through the web server. Its size is part of the cache key in case it is replaced otherwise.
+ * Only presets that set nothing but the cached state are cached (not e.g. a nightlight or transition).
+ */
+
+#define BOOT_MAX_PHASES     10
+#define FASTBOOT_FILE       "/fastboot.bin"
+#define FASTBOOT_MAGIC      0x57424631 //"WBF1"
+
+static const char* bootPhaseName[BOOT_MAX_PHASES]; //PROGMEM strings
+static uint32_t bootPhaseTime[BOOT_MAX_PHASES];
+static uint8_t bootPhases = 0;
+static bool bootFast = false;          //state was restored from the cache
+
+typedef struct FastBootState {
+  uint32_t magic;
+  uint32_t build;                      //segment layout may change with the firmware
+  uint32_t layout;                     //sizeof(FastBootState), also changes in dev builds of the same version
+  uint32_t presetsSize;
+  uint16_t ledCount;
+  uint8_t preset;
+  uint8_t mainSegment;
+  uint8_t bri;
+  uint8_t effectCurrent, effectSpeed, effectIntensity, effectPalette;
+  uint8_t col[4], colSec[4];
+  WS2812FX::Segment segments[MAX_NUM_SEGMENTS];
+  uint32_t check;                      //FNV-1a of all bytes before
+} fastboot_state;
+
+//phase must be a PSTR() literal
+void bootMark(const char* phase)
+{
+  if (bootPhases >= BOOT_MAX_PHASES) return;
+  bootPhaseName[bootPhases] = phase;
+  bootPhaseTime[bootPhases] = micros();
+  DEBUG_PRINT(F("Boot "));
+  DEBUG_PRINT(FPSTR(phase));
+  DEBUG_PRINT(F(": "));
+  DEBUG_PRINT(bootPhaseTime[bootPhases] / 1000);
+  DEBUG_PRINTLN(F(" ms"));
+  bootPhases++;
+}
+
+void serializeBootTimes(JsonObject root)
+{
+  for (uint8_t i = 0; i < bootPhases; i++) root[(const __FlashStringHelper*)bootPhaseName[i]] = bootPhaseTime[i]; //us
+  root[F("fast")] = bootFast;
+}
+
+static uint32_t presetsFileSize()
+{
+  File f = WLED_FS.open("/presets.json", "r");
+  if (!f) return 0;
+  uint32_t size = f.size();
+  f.close();
+  return size;
+}
+
+static uint32_t fastBootChecksum(const FastBootState& s)
+{
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&s);
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < offsetof(FastBootState, check); i++) hash = (hash ^ p[i]) * 16777619UL;
+  return hash;
+}
+
+//restores the cached boot preset state, returns false if there is no valid cache for it
+bool loadFastBootState()
+{
+  if (!fastBoot || !bootPreset || !WLED_FS.exists(FASTBOOT_FILE)) return false;
+  File f = WLED_FS.open(FASTBOOT_FILE, "r");
+  if (!f) return false;
+  FastBootState* s = new (std::nothrow) FastBootState;
+  bool ok = s && f.read(reinterpret_cast<uint8_t*>(s), sizeof(FastBootState)) == sizeof(FastBootState);
+  f.close();
+  ok = ok && s->magic == FASTBOOT_MAGIC && s->build == VERSION && s->layout == sizeof(FastBootState) && s->ledCount == ledCount
+          && s->preset == bootPreset && s->check == fastBootChecksum(*s) && s->presetsSize == presetsFileSize();
+  if (ok) {
+    memcpy(strip.getSegments(), s->segments, sizeof(s->segments));
+    strip.mainSegment = s->mainSegment;
+    bri = s->bri;
+    effectCurrent = s->effectCurrent; effectSpeed = s->effectSpeed;
+    effectIntensity = s->effectIntensity; effectPalette = s->effectPalette;
+    memcpy(col, s->col, 4); memcpy(colSec, s->colSec, 4);
+    currentPreset = bootPreset;
+    isPreset = true;
+    bootFast = true;
+  }
+  delete s;
+  return ok;
+}
+
+//true if the boot preset only sets what the cache restores
+static bool bootPresetCacheable()
+{
+  DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+  if (!doc.capacity() || !readObjectFromFileUsingId("/presets.json", bootPreset, &doc)) return false;
+  for (JsonPair kv : doc.as<JsonObject>()) {
+    const char* key = kv.key().c_str();
+    if (!strcmp_P(key, PSTR("on"))) {
+      if (kv.value() != true) return false; //turning off keeps the brightness to turn on with, which is not cached
+    } else if (strcmp_P(key, PSTR("n")) && strcmp_P(key, PSTR("ql")) && strcmp_P(key, PSTR("bri"))
+        && strcmp_P(key, PSTR("seg")) && strcmp_P(key, PSTR("mainseg"))) return false;
+  }
+  return true;
+}
+
+//caches the state after the boot preset was applied
+void saveFastBootState()
+{
+  if (!fastBoot || !bootPreset || currentPlaylist >= 0) return; //playlists need the preset to run
+  if (!bootPresetCacheable()) { //a cache of a previous boot preset must not be used for it either
+    invalidateFastBootState(); return;
+  }
+  FastBootState* s = new (std::nothrow) FastBootState;
+  if (!s) return;
+  memset(s, 0, sizeof(FastBootState));
+  s->magic = FASTBOOT_MAGIC;
+  s->build = VERSION;
+  s->layout = sizeof(FastBootState);
+  s->presetsSize = presetsFileSize();
+  s->ledCount = ledCount;
+  s->preset = bootPreset;
+  s->mainSegment = strip.getMainSegmentId();
+  s->bri = bri;
+  s->effectCurrent = effectCurrent; s->effectSpeed = effectSpeed;
+  s->effectIntensity = effectIntensity; s->effectPalette = effectPalette;
+  memcpy(s->col, col, 4); memcpy(s->colSec, colSec, 4);
+  memcpy(s->segments, strip.getSegments(), sizeof(s->segments));
+  for (uint8_t i = 0; i < MAX_NUM_SEGMENTS; i++) s->segments[i].setOption(SEG_OPTION_TRANSITIONAL, false);
+  s->check = fastBootChecksum(*s);
+  invalidateFileETag(FASTBOOT_FILE); //always the same size
+  File f = WLED_FS.open(FASTBOOT_FILE, "w");
+  if (f) {
+    f.write(reinterpret_cast<uint8_t*>(s), sizeof(FastBootState));
+    f.close();
+  }
+  delete s;
+}
+
+void invalidateFastBootState()
+{
+  if (WLED_FS.exists(FASTBOOT_FILE)) WLED_FS.remove(FASTBOOT_FILE);
+  invalidateFileETag(FASTBOOT_FILE);
+}
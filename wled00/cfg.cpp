@@ -21,6 +21,7 @@ void deserializeConfig() {
   }
 
   DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+  if (!doc.capacity()) heapAllocFailed(ALLOC_SITE_JSON);
 
   DEBUG_PRINTLN(F("Reading settings from /cfg.json..."));
 
@@ -96,6 +97,7 @@ void deserializeConfig() {
   CJSON(strip.ablMilliampsMax, hw_led[F("maxpwr")]);
   CJSON(strip.milliampsPerLed, hw_led[F("ledma")]);
   CJSON(strip.rgbwMode, hw_led[F("rgbwm")]);
+  CJSON(strip.pipelineOutput, hw_led[F("pipe")]);
 
   JsonArray ins = hw_led["ins"];
   uint8_t s = 0; //bus iterator
@@ -181,6 +183,7 @@ void deserializeConfig() {
   JsonObject light = doc[F("light")];
   CJSON(briMultiplier, light[F("scale-bri")]);
   CJSON(strip.paletteBlend, light[F("pal-mode")]);
+  CJSON(strip.compositing, light[F("comp")]);
 
   float light_gc_bri = light[F("gc")]["bri"];
   float light_gc_col = light[F("gc")]["col"]; // 2.8
@@ -194,6 +197,7 @@ void deserializeConfig() {
   int tdd = light_tr[F("dur")] | -1;
   if (tdd >= 0) transitionDelayDefault = tdd * 100;
   CJSON(strip.paletteFade, light_tr[F("pal")]);
+  CJSON(strip.effectTransitions, light_tr[F("fx")]);
 
   JsonObject light_nl = light["nl"];
   CJSON(nightlightMode, light_nl[F("mode")]);
@@ -205,6 +209,7 @@ void deserializeConfig() {
 
   JsonObject def = doc[F("def")];
   CJSON(bootPreset, def[F("ps")]);
+  CJSON(fastBoot, def[F("fb")]);
   CJSON(turnOnAtBoot, def["on"]); // true
   CJSON(briS, def["bri"]); // 128
 
@@ -222,11 +227,13 @@ void deserializeConfig() {
   JsonObject if_sync = interfaces[F("sync")];
   CJSON(udpPort, if_sync[F("port0")]); // 21324
   CJSON(udpPort2, if_sync[F("port1")]); // 65506
+  CJSON(clockSyncEnabled, if_sync[F("clk")]);
 
   JsonObject if_sync_recv = if_sync["recv"];
   CJSON(receiveNotificationBrightness, if_sync_recv["bri"]);
   CJSON(receiveNotificationColor, if_sync_recv["col"]);
   CJSON(receiveNotificationEffects, if_sync_recv[F("fx")]);
+  CJSON(receiveNotificationSegments, if_sync_recv[F("seg")]);
   receiveNotifications = (receiveNotificationBrightness || receiveNotificationColor || receiveNotificationEffects);
 
   JsonObject if_sync_send = if_sync["send"];
@@ -250,6 +257,7 @@ void deserializeConfig() {
   JsonObject if_live_dmx = if_live[F("dmx")];
   CJSON(e131Universe, if_live_dmx[F("uni")]);
   CJSON(e131SkipOutOfSequence, if_live_dmx[F("seqskip")]);
+  CJSON(e131MergeMode, if_live_dmx[F("merge")]);
   CJSON(DMXAddress, if_live_dmx[F("addr")]);
   CJSON(DMXMode, if_live_dmx[F("mode")]);
 
@@ -280,6 +288,7 @@ void deserializeConfig() {
   getStringFromJson(mqttUser, if_mqtt[F("user")], 41);
   getStringFromJson(mqttPass, if_mqtt["psk"], 41); //normally not present due to security
   getStringFromJson(mqttClientID, if_mqtt[F("cid")], 41);
+  CJSON(mqttHeapInterval, if_mqtt[F("heap")]);
 
   getStringFromJson(mqttDeviceTopic, if_mqtt[F("topics")][F("device")], 33); // "wled/test"
   getStringFromJson(mqttGroupTopic, if_mqtt[F("topics")][F("group")], 33); // ""
@@ -372,6 +381,7 @@ void deserializeConfig() {
   CJSON(DMXGap,dmx[F("gap")]);
   CJSON(DMXStart, dmx[F("start")]);
   CJSON(DMXStartLED,dmx[F("start-led")]);
+  CJSON(DMXRefreshRate, dmx[F("rate")]);
 
   JsonArray dmx_fixmap = dmx[F("fixmap")];
   it = 0;
@@ -392,6 +402,9 @@ void serializeConfig() {
   DEBUG_PRINTLN(F("Writing settings to /cfg.json..."));
 
   DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+  if (!doc.capacity()) { //an empty document would replace all settings
+    heapAllocFailed(ALLOC_SITE_JSON); return;
+  }
 
   JsonArray rev = doc.createNestedArray("rev");
   rev.add(1); //major settings revision
@@ -451,6 +464,7 @@ void serializeConfig() {
   hw_led[F("maxpwr")] = strip.ablMilliampsMax;
   hw_led[F("ledma")] = strip.milliampsPerLed;
   hw_led[F("rgbwm")] = strip.rgbwMode;
+  hw_led[F("pipe")] = strip.pipelineOutput;
 
   JsonArray hw_led_ins = hw_led.createNestedArray("ins");
 
@@ -503,6 +517,7 @@ void serializeConfig() {
   JsonObject light = doc.createNestedObject(F("light"));
   light[F("scale-bri")] = briMultiplier;
   light[F("pal-mode")] = strip.paletteBlend;
+  light[F("comp")] = strip.compositing;
 
   JsonObject light_gc = light.createNestedObject("gc");
   light_gc["bri"] = (strip.gammaCorrectBri) ? 2.8 : 1.0;
@@ -512,6 +527,7 @@ void serializeConfig() {
   light_tr[F("mode")] = fadeTransition;
   light_tr[F("dur")] = transitionDelayDefault / 100;
   light_tr[F("pal")] = strip.paletteFade;
+  light_tr[F("fx")] = strip.effectTransitions;
 
   JsonObject light_nl = light.createNestedObject("nl");
   light_nl[F("mode")] = nightlightMode;
@@ -521,6 +537,7 @@ void serializeConfig() {
 
   JsonObject def = doc.createNestedObject("def");
   def[F("ps")] = bootPreset;
+  def[F("fb")] = fastBoot;
   def["on"] = turnOnAtBoot;
   def["bri"] = briS;
 
@@ -540,11 +557,13 @@ void serializeConfig() {
   JsonObject if_sync = interfaces.createNestedObject("sync");
   if_sync[F("port0")] = udpPort;
   if_sync[F("port1")] = udpPort2;
+  if_sync[F("clk")] = clockSyncEnabled;
 
   JsonObject if_sync_recv = if_sync.createNestedObject("recv");
   if_sync_recv["bri"] = receiveNotificationBrightness;
   if_sync_recv["col"] = receiveNotificationColor;
   if_sync_recv[F("fx")] = receiveNotificationEffects;
+  if_sync_recv[F("seg")] = receiveNotificationSegments;
 
   JsonObject if_sync_send = if_sync.createNestedObject("send");
   if_sync_send[F("dir")] = notifyDirect;
@@ -566,6 +585,7 @@ void serializeConfig() {
   JsonObject if_live_dmx = if_live.createNestedObject("dmx");
   if_live_dmx[F("uni")] = e131Universe;
   if_live_dmx[F("seqskip")] = e131SkipOutOfSequence;
+  if_live_dmx[F("merge")] = e131MergeMode;
   if_live_dmx[F("addr")] = DMXAddress;
   if_live_dmx[F("mode")] = DMXMode;
   if_live[F("timeout")] = realtimeTimeoutMs / 100;
@@ -591,6 +611,7 @@ void serializeConfig() {
   if_mqtt[F("user")] = mqttUser;
   if_mqtt[F("pskl")] = strlen(mqttPass);
   if_mqtt[F("cid")] = mqttClientID;
+  if_mqtt[F("heap")] = mqttHeapInterval;
 
   JsonObject if_mqtt_topics = if_mqtt.createNestedObject(F("topics"));
   if_mqtt_topics[F("device")] = mqttDeviceTopic;
@@ -660,6 +681,7 @@ void serializeConfig() {
   dmx[F("gap")] = DMXGap;
   dmx[F("start")] = DMXStart;
   dmx[F("start-led")] = DMXStartLED;
+  dmx[F("rate")] = DMXRefreshRate;
 
   JsonArray dmx_fixmap = dmx.createNestedArray(F("fixmap"));
   for (byte i = 0; i < 15; i++)
@@ -670,9 +692,7 @@ void serializeConfig() {
   JsonObject usermods_settings = doc.createNestedObject("um");
   usermods.addToConfig(usermods_settings);
 
-  File f = WLED_FS.open("/cfg.json", "w");
-  if (f) serializeJson(doc, f);
-  f.close();
+  writeJsonAtomic("/cfg.json", &doc);
 }
 
 //settings in /wsec.json, not accessible via webserver, for passwords and tokens
@@ -680,6 +700,7 @@ bool deserializeConfigSec() {
   DEBUG_PRINTLN(F("Reading settings from /wsec.json..."));
 
   DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+  if (!doc.capacity()) heapAllocFailed(ALLOC_SITE_JSON);
 
   bool success = readObjectFromFile("/wsec.json", nullptr, &doc);
   if (!success) return false;
@@ -715,6 +736,9 @@ void serializeConfigSec() {
   DEBUG_PRINTLN(F("Writing settings to /wsec.json..."));
 
   DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+  if (!doc.capacity()) {
+    heapAllocFailed(ALLOC_SITE_JSON); return;
+  }
 
   JsonObject nw = doc.createNestedObject("nw");
 
@@ -740,7 +764,5 @@ void serializeConfigSec() {
   ota[F("lock-wifi")] = wifiLock;
   ota[F("aota")] = aOtaEnabled;
 
-  File f = WLED_FS.open("/wsec.json", "w");
-  if (f) serializeJson(doc, f);
-  f.close();
+  writeJsonAtomic("/wsec.json", &doc);
 }
@@ -0,0 +1,152 @@
+#include "wled.h"
+#include "clock_sync.h"
+
+/*
+ * Node-to-node clock sync
+ * The notifier packet only carries the sender's effect time, which is off by the (unknown) network
+ * delay and starts to drift right away. A receiving node therefore runs an NTP-style exchange
+ * with the node it last received a notification from, on the supplemental UDP port:
+ *   request  [255,3,seq,0, t1]
+ *   response [255,4,seq,0, t1, t2, t3, timebase]
+ * t1..t3 are 64 bit little endian us timestamps, timebase is the responder's strip.timebase.
+ * ClockSyncFilter estimates offset and drift, and strip.timebase is slewed by 1 ms steps
+ * towards the responder's effect time, so effects do not visibly jump.
+ */
+
+#define CLOCK_SYNC_REQ_LEN        12
+#define CLOCK_SYNC_RESP_LEN       32
+#define CLOCK_SYNC_FAST_INTERVAL  250    //ms between requests until the filter window is filled
+#define CLOCK_SYNC_INTERVAL       2000
+#define CLOCK_SYNC_LOST_INTERVAL  10000  //source did not answer for a while
+#define CLOCK_SYNC_MAX_MISSED     10
+#define CLOCK_SYNC_SLEW_INTERVAL  20     //ms per 1 ms timebase correction (5% speed change)
+#define CLOCK_SYNC_MAX_SLEW_MS    100    //larger errors are corrected at once
+
+static ClockSyncFilter clockFilter;
+static IPAddress clockSource;            //node that is followed, 0.0.0.0 if none
+static uint32_t clockRemoteTimebase = 0;
+static int64_t clockRequestTime = 0;     //t1 of the request in flight
+static uint8_t clockSeq = 0;
+static uint8_t clockExchanges = 0;       //since the source was (re)selected
+static uint8_t clockMissed = 0;          //requests without a response
+static unsigned long clockLastRequest = 0, clockLastSlew = 0;
+
+static inline int64_t clockUs()
+{
+  #ifdef ESP8266
+  return micros64();
+  #else
+  return esp_timer_get_time();
+  #endif
+}
+
+static void put64(uint8_t* buf, int64_t v)
+{
+  for (uint8_t i = 0; i < 8; i++) buf[i] = (uint64_t)v >> (8*i);
+}
+
+static int64_t get64(const uint8_t* buf)
+{
+  uint64_t v = 0;
+  for (uint8_t i = 0; i < 8; i++) v |= (uint64_t)buf[i] << (8*i);
+  return v;
+}
+
+//true if the timebase is disciplined by the clock sync and notifications should leave it alone
+bool clockSyncLocked()
+{
+  return clockSyncEnabled && clockFilter.synced() && clockMissed < CLOCK_SYNC_MAX_MISSED;
+}
+
+//called for every accepted notification, its sender becomes the clock source
+void clockSyncSource(IPAddress ip)
+{
+  if (ip == clockSource) return;
+  clockSource = ip;
+  clockFilter.reset();
+  clockExchanges = 0;
+  clockMissed = 0;
+  clockLastRequest = millis() - CLOCK_SYNC_INTERVAL; //ask right away
+}
+
+//handles clock sync packets received on the supplemental port, returns true if the packet was one
+bool handleClockSyncPacket(const uint8_t* udpIn, uint16_t len)
+{
+  int64_t rxTime = clockUs();
+  if (len < 2 || udpIn[0] != 255) return false;
+
+  if (udpIn[1] == 3) { //request, answer with our clock
+    if (len < CLOCK_SYNC_REQ_LEN || !clockSyncEnabled || !udp2Connected) return true;
+    uint8_t data[CLOCK_SYNC_RESP_LEN];
+    data[0] = 255; data[1] = 4; data[2] = udpIn[2]; data[3] = 0;
+    memcpy(data + 4, udpIn + 4, 8);
+    put64(data + 12, rxTime);
+    uint32_t tb = strip.timebase;
+    for (uint8_t i = 0; i < 4; i++) data[28 + i] = tb >> (8*i);
+    notifier2Udp.beginPacket(notifier2Udp.remoteIP(), notifier2Udp.remotePort());
+    put64(data + 20, clockUs());
+    notifier2Udp.write(data, sizeof(data));
+    notifier2Udp.endPacket();
+    return true;
+  }
+
+  if (udpIn[1] == 4) { //response to our request
+    if (len < CLOCK_SYNC_RESP_LEN || notifier2Udp.remoteIP() != clockSource) return true;
+    int64_t t1 = get64(udpIn + 4);
+    if (udpIn[2] != clockSeq || t1 != clockRequestTime) return true; //late or duplicate
+    clockRequestTime = 0;
+    clockMissed = 0;
+    if (clockExchanges < 255) clockExchanges++;
+    clockRemoteTimebase = udpIn[28] | (udpIn[29] << 8) | (udpIn[30] << 16) | ((uint32_t)udpIn[31] << 24);
+    clockFilter.addSample(t1, get64(udpIn + 12), get64(udpIn + 20), rxTime);
+    return true;
+  }
+  return false;
+}
+
+static void sendClockSyncRequest()
+{
+  if (clockRequestTime && clockMissed < 255) clockMissed++; //previous one got lost
+  if (clockMissed == CLOCK_SYNC_MAX_MISSED) DEBUG_PRINTLN(F("Clock sync source lost"));
+  uint8_t data[CLOCK_SYNC_REQ_LEN];
+  data[0] = 255; data[1] = 3; data[2] = ++clockSeq; data[3] = 0;
+  notifier2Udp.beginPacket(clockSource, udpPort2);
+  clockRequestTime = clockUs();
+  put64(data + 4, clockRequestTime);
+  notifier2Udp.write(data, sizeof(data));
+  notifier2Udp.endPacket();
+}
+
+//polls the clock source and slews strip.timebase, called once per loop()
+void handleClockSync()
+{
+  if (!clockSyncEnabled || !udp2Connected || clockSource[0] == 0) return;
+  unsigned long now = millis();
+
+  unsigned long interval = CLOCK_SYNC_INTERVAL;
+  if (clockMissed >= CLOCK_SYNC_MAX_MISSED) interval = CLOCK_SYNC_LOST_INTERVAL;
+  else if (clockExchanges < CLOCK_SYNC_WINDOW) interval = CLOCK_SYNC_FAST_INTERVAL;
+  if (now - clockLastRequest >= interval) {
+    clockLastRequest = now;
+    sendClockSyncRequest();
+  }
+
+  if (!clockSyncLocked() || now - clockLastSlew < CLOCK_SYNC_SLEW_INTERVAL) return;
+  clockLastSlew = now;
+  //our effect time has to equal the source's: millis() + timebase == remote millis() + remote timebase
+  int64_t offsetUs = clockFilter.offset(clockUs());
+  uint32_t target = clockRemoteTimebase + (uint32_t)((offsetUs + (offsetUs < 0 ? -500 : 500)) / 1000);
+  int32_t diff = target - strip.timebase;
+  if (diff > CLOCK_SYNC_MAX_SLEW_MS || diff < -CLOCK_SYNC_MAX_SLEW_MS) strip.timebase = target;
+  else if (diff > 0) strip.timebase++;
+  else if (diff < 0) strip.timebase--;
+}
+
+void serializeClockSync(JsonObject root)
+{
+  root[F("src")] = clockSource[0] ? clockSource.toString() : "";
+  root[F("ok")] = clockSyncLocked();
+  root[F("err")] = clockFilter.synced() ? clockFilter.error() : -1;  //us
+  root[F("rtt")] = clockFilter.rtt();                                 //us
+  root[F("drift")] = roundf(clockFilter.drift() * 10) / 10;           //ppm
+}
@@ -0,0 +1,118 @@
+#ifndef WLED_CLOCK_SYNC_H
+#define WLED_CLOCK_SYNC_H
+/*
+ * Clock offset estimator for the node-to-node clock sync (see clock_sync.cpp).
+ * Fed with NTP-style timestamp quadruples, it keeps the sample with the lowest round trip
+ * out of the last few exchanges (queueing delays only ever make a sample worse) and fits
+ * a line through the accepted offsets to follow the drift of the two crystals.
+ * Plain C++, no dependency on the Arduino core, so it can be compiled on any host.
+ */
+
+#include <stdint.h>
+#include <math.h>
+
+#define CLOCK_SYNC_WINDOW   8        //raw samples the minimum delay is picked from
+#define CLOCK_SYNC_HISTORY  16       //accepted offsets used for the drift fit
+#define CLOCK_SYNC_STEP_US  50000    //an offset this far from the prediction restarts the estimation
+
+class ClockSyncFilter
+{
+  public:
+    void reset() {
+      _rawCount = _rawNext = _histCount = _histNext = 0;
+      _lastAccepted = INT64_MIN;
+      _slope = 0.0f; _intercept = 0.0f; _rms = 0;
+    }
+
+    /*
+     * t1: request sent (local clock), t2: request received (remote clock),
+     * t3: response sent (remote clock), t4: response received (local clock), all in us.
+     * Returns true if the sample was used for a new offset estimate.
+     */
+    bool addSample(int64_t t1, int64_t t2, int64_t t3, int64_t t4) {
+      int64_t delay = (t4 - t1) - (t3 - t2);
+      if (t4 < t1 || t3 < t2) return false;
+      if (delay < 0) delay = 0;
+      int64_t offset = ((t2 - t1) + (t3 - t4)) / 2;
+
+      //remote clock restarted or jumped (more than a slow round trip can explain), the history is worthless
+      if (synced()) {
+        int64_t dev = offset - this->offset(t4);
+        if (dev < 0) dev = -dev;
+        if (dev > CLOCK_SYNC_STEP_US + delay / 2) reset();
+      }
+
+      _raw[_rawNext] = {t4, offset, (uint32_t)(delay > UINT32_MAX ? UINT32_MAX : delay)};
+      _rawNext = (_rawNext + 1) % CLOCK_SYNC_WINDOW;
+      if (_rawCount < CLOCK_SYNC_WINDOW) _rawCount++;
+
+      uint8_t best = 0;
+      for (uint8_t i = 1; i < _rawCount; i++) if (_raw[i].delay < _raw[best].delay) best = i;
+      if (_raw[best].t <= _lastAccepted) return false; //still the same best sample
+      _lastAccepted = _raw[best].t;
+      _rtt = _raw[best].delay;
+
+      _hist[_histNext] = _raw[best];
+      _histNext = (_histNext + 1) % CLOCK_SYNC_HISTORY;
+      if (_histCount < CLOCK_SYNC_HISTORY) _histCount++;
+      fit();
+      return true;
+    }
+
+    //estimated remote minus local clock at local time t
+    int64_t offset(int64_t t) {
+      if (!_histCount) return 0;
+      return _ref.offset + (int64_t)(_intercept + _slope * (float)((t - _ref.t) / 1000));
+    }
+
+    bool synced() { return _histCount > 0; }
+    uint32_t rtt() { return _rtt; }              //us, round trip of the best recent sample
+    int32_t error() { return _rms + _rtt / 2; }  //us, fit residual plus the worst case asymmetry
+    float drift() { return _slope * 1000.0f; }   //ppm, positive if the remote clock runs faster
+
+  private:
+    struct Sample {
+      int64_t t;      //local time
+      int64_t offset;
+      uint32_t delay;
+    };
+
+    Sample _raw[CLOCK_SYNC_WINDOW];
+    Sample _hist[CLOCK_SYNC_HISTORY];
+    Sample _ref = {0, 0, 0};           //newest accepted sample, the fit is relative to it
+    uint8_t _rawCount = 0, _rawNext = 0, _histCount = 0, _histNext = 0;
+    int64_t _lastAccepted = INT64_MIN;
+    uint32_t _rtt = 0;
+    int32_t _rms = 0;
+    float _slope = 0.0f, _intercept = 0.0f; //us per ms and us
+
+    //least squares fit of offset over time, in ms and us relative to the newest sample
+    void fit() {
+      _ref = _hist[(_histNext + CLOCK_SYNC_HISTORY - 1) % CLOCK_SYNC_HISTORY];
+      double sx = 0, sy = 0, sxx = 0, sxy = 0;
+      for (uint8_t i = 0; i < _histCount; i++) {
+        double x = (double)((_hist[i].t - _ref.t) / 1000);
+        double y = (double)(_hist[i].offset - _ref.offset);
+        sx += x; sy += y; sxx += x*x; sxy += x*y;
+      }
+      double n = _histCount;
+      double den = n*sxx - sx*sx;
+      //at least 4 points over 10 seconds before the slope means anything
+      if (_histCount >= 4 && sxx - sx*sx/n > n * 1e8 / 12.0 && den != 0) {
+        _slope = (n*sxy - sx*sy) / den;
+        _intercept = (sy - _slope*sx) / n;
+      } else {
+        _slope = 0.0f;
+        _intercept = 0.0f;
+      }
+      double sr = 0;
+      for (uint8_t i = 0; i < _histCount; i++) {
+        double x = (double)((_hist[i].t - _ref.t) / 1000);
+        double r = (double)(_hist[i].offset - _ref.offset) - (_intercept + _slope*x);
+        sr += r*r;
+      }
+      _rms = sqrt(sr / n);
+    }
+};
+
+#endif // WLED_CLOCK_SYNC_H
@@ -0,0 +1,307 @@
+#include "wled.h"
+
+/*
+ * Deferred command queue
+ * JSON and HTTP API commands received in network callbacks (async TCP context) are copied into
+ * a bounded queue and applied by the main loop, so they never change the state while a frame
+ * is rendered. The network task no longer needs a JSON_BUFFER_SIZE document.
+ * Small brightness/on/transition-only commands are pre-parsed and coalesced
+ * (e.g. 30 brightness slider updates result in a single state change), HTTP gets the response
+ * for these when they are queued.
+ * A JSON command may also be an array of state objects, applied as one change.
+ * "resp":false in a command skips the response (HTTP 204, no websocket reply).
+ * File requests waiting for pending writes (presets.json read, upload, FS editor delete) are answered
+ * by the loop as well once it wrote them, the web server handlers never wait for it.
+ */
+
+#ifdef ESP8266
+  #define CMD_QUEUE_LEN       8
+  #define CMD_QUEUE_MAX_BYTES 4096 //payload memory of all queued commands
+#else
+  #define CMD_QUEUE_LEN       16
+  #define CMD_QUEUE_MAX_BYTES 16384
+#endif
+
+#define CMD_TYPE_JSON 0
+#define CMD_TYPE_API  1
+#define CMD_TYPE_BRI  2 //pre-parsed, only "bri", "on" and "tt"
+#define CMD_TYPE_FILE 3 //serves the file at payload after pending writes
+#define CMD_TYPE_DONE 4 //sends payload as text after pending writes
+
+typedef struct QueuedCommand {
+  char* payload;                  //heap copy, nullptr for pre-parsed commands
+  AsyncWebServerRequest* request; //HTTP request waiting for the response, nullptr if none or disconnected
+  uint32_t wsClient;              //websocket client to respond to, 0 if none
+  uint16_t len;
+  int16_t bri, tt;                //-1 if not set
+  int8_t on;
+  uint8_t type;
+} queued_command;
+
+static QueuedCommand cmdQueue[CMD_QUEUE_LEN];
+static uint8_t cmdQueueHead = 0, cmdQueueCount = 0;
+static uint16_t cmdQueueBytes = 0;
+static AsyncWebServerRequest* cmdRequest = nullptr; //request of the command being applied
+
+#ifdef ARDUINO_ARCH_ESP32
+//held while a response is sent, so a disconnecting client's request cannot be deleted meanwhile.
+//Recursive, as the async TCP stack may call the onDisconnect handler from within send()
+static SemaphoreHandle_t cmdQueueMux = xSemaphoreCreateRecursiveMutex();
+#define CMDQ_LOCK   xSemaphoreTakeRecursive(cmdQueueMux, portMAX_DELAY)
+#define CMDQ_UNLOCK xSemaphoreGiveRecursive(cmdQueueMux)
+#else //network callbacks do not preempt loop()
+#define CMDQ_LOCK
+#define CMDQ_UNLOCK
+#endif
+
+//forget a request that was closed by the client before its command was applied
+static void cancelQueuedRequest(AsyncWebServerRequest* request)
+{
+  CMDQ_LOCK;
+  for (uint8_t i = 0; i < CMD_QUEUE_LEN; i++) {
+    if (cmdQueue[i].request == request) cmdQueue[i].request = nullptr;
+  }
+  if (cmdRequest == request) cmdRequest = nullptr;
+  CMDQ_UNLOCK;
+}
+
+//returns false if the queue is full
+static bool pushCommand(QueuedCommand& cmd)
+{
+  bool ok = false;
+  CMDQ_LOCK;
+  QueuedCommand* last = cmdQueueCount ? &cmdQueue[(cmdQueueHead + cmdQueueCount - 1) % CMD_QUEUE_LEN] : nullptr;
+  //commands of different websocket clients are not coalesced, each of them gets its reply
+  if (cmd.type == CMD_TYPE_BRI && last && last->type == CMD_TYPE_BRI &&
+      (!cmd.wsClient || !last->wsClient || cmd.wsClient == last->wsClient)) {
+    //a later "bri" decides about on/off unless "on" is given as well
+    if (cmd.bri >= 0) {
+      last->bri = cmd.bri; last->on = cmd.on;
+    } else if (cmd.on >= 0) last->on = cmd.on;
+    if (cmd.tt >= 0) last->tt = cmd.tt;
+    if (cmd.wsClient) last->wsClient = cmd.wsClient;
+    ok = true;
+  } else if (cmdQueueCount < CMD_QUEUE_LEN && cmdQueueBytes + cmd.len <= CMD_QUEUE_MAX_BYTES) {
+    cmdQueue[(cmdQueueHead + cmdQueueCount) % CMD_QUEUE_LEN] = cmd;
+    cmdQueueCount++;
+    cmdQueueBytes += cmd.len;
+    ok = true;
+  }
+  CMDQ_UNLOCK;
+  return ok;
+}
+
+static bool popCommand(QueuedCommand& cmd)
+{
+  bool ok = false;
+  CMDQ_LOCK;
+  if (cmdQueueCount) {
+    cmd = cmdQueue[cmdQueueHead];
+    cmdQueue[cmdQueueHead].request = nullptr;
+    cmdRequest = cmd.request;
+    cmdQueueHead = (cmdQueueHead + 1) % CMD_QUEUE_LEN;
+    cmdQueueCount--;
+    cmdQueueBytes -= cmd.len;
+    ok = true;
+  }
+  CMDQ_UNLOCK;
+  return ok;
+}
+
+//must be called before the request is queued, the loop may respond to it right away.
+//Replaces the handler admitRequest() set, so it releases the slot as well
+static void watchRequest(AsyncWebServerRequest* request)
+{
+  if (request) request->onDisconnect([request]() { cancelQueuedRequest(request); releaseRequest(request); });
+}
+
+static void sendBusy(AsyncWebServerRequest* request, uint32_t wsClient)
+{
+  if (request) request->send(503, "application/json", F("{\"error\":\"Busy\"}"));
+  #ifdef WLED_ENABLE_WEBSOCKETS
+  if (wsClient) {
+    AsyncWebSocketClient* client = ws.client(wsClient);
+    if (client) client->text(F("{\"error\":\"Busy\"}"));
+  }
+  #endif
+}
+
+//true if the command only contains "bri", "on" (true/false) and "tt"
+static bool preParseCommand(const uint8_t* data, size_t len, QueuedCommand& cmd)
+{
+  StaticJsonDocument<128> doc;
+  if (deserializeJson(doc, data, len)) return false; //also fails for larger commands
+  JsonObject root = doc.as<JsonObject>();
+  if (root.isNull() || root.size() == 0) return false;
+  for (JsonPair kv : root) {
+    if      (kv.key() == "bri" && kv.value().is<uint8_t>()) cmd.bri = kv.value();
+    else if (kv.key() == "on"  && kv.value().is<bool>())    cmd.on  = kv.value().as<bool>();
+    else if (kv.key() == "tt"  && kv.value().is<uint16_t>() && kv.value() <= 32767) cmd.tt = kv.value();
+    else return false;
+  }
+  return true;
+}
+
+/*
+ * Queues a JSON state command. For HTTP, the response is sent when the command was applied,
+ * except for pre-parsed commands: these are answered with 200 right away, as they may be coalesced
+ * with others and applying "bri", "on" and "tt" can not fail.
+ * Returns false (and responds with 503 Busy) if the queue is full.
+ */
+bool queueJsonCommand(const uint8_t* data, size_t len, AsyncWebServerRequest* request, uint32_t wsClient)
+{
+  QueuedCommand cmd = {nullptr, nullptr, wsClient, 0, -1, -1, -1, CMD_TYPE_BRI};
+  if (preParseCommand(data, len, cmd)) {
+    if (!pushCommand(cmd)) {
+      sendBusy(request, wsClient); return false;
+    }
+    if (request) request->send(200, "application/json", F("{\"success\":true}"));
+    return true;
+  }
+
+  cmd.type = CMD_TYPE_JSON;
+  cmd.request = request;
+  cmd.len = len;
+  watchRequest(request);
+  cmd.payload = (char*)malloc(len + 1);
+  if (!cmd.payload) heapAllocFailed(ALLOC_SITE_JSON);
+  if (len > CMD_QUEUE_MAX_BYTES || !cmd.payload || (memcpy(cmd.payload, data, len), cmd.payload[len] = '\0', !pushCommand(cmd))) {
+    free(cmd.payload);
+    sendBusy(request, wsClient); return false;
+  }
+  return true;
+}
+
+//queues a HTTP API command ("win&..."), the XML response is sent when the command was applied
+bool queueApiCommand(const char* req, AsyncWebServerRequest* request)
+{
+  size_t len = strlen(req);
+  QueuedCommand cmd = {nullptr, request, 0, (uint16_t)len, -1, -1, -1, CMD_TYPE_API};
+  watchRequest(request);
+  cmd.payload = (char*)malloc(len + 1);
+  if (!cmd.payload) heapAllocFailed(ALLOC_SITE_JSON);
+  if (len > CMD_QUEUE_MAX_BYTES || !cmd.payload || (strcpy(cmd.payload, req), !pushCommand(cmd))) {
+    free(cmd.payload);
+    sendBusy(request, 0); return false;
+  }
+  return true;
+}
+
+/*
+ * Has the loop respond to a file request once it wrote pending preset changes and applied the pending
+ * upload or delete: serves the file at path, or sends 200 with text if it is not nullptr.
+ * Returns false without responding if the queue is full.
+ */
+bool queueFileResponse(AsyncWebServerRequest* request, const char* path, const char* text)
+{
+  const char* payload = text ? text : path;
+  size_t len = strlen(payload);
+  QueuedCommand cmd = {nullptr, request, 0, (uint16_t)len, -1, -1, -1, (uint8_t)(text ? CMD_TYPE_DONE : CMD_TYPE_FILE)};
+  watchRequest(request);
+  cmd.payload = (char*)malloc(len + 1);
+  if (!cmd.payload) heapAllocFailed(ALLOC_SITE_JSON);
+  if (len > CMD_QUEUE_MAX_BYTES || !cmd.payload || (strcpy(cmd.payload, payload), !pushCommand(cmd))) {
+    free(cmd.payload);
+    return false;
+  }
+  return true;
+}
+
+static void applyCommand(QueuedCommand& cmd)
+{
+  bool verboseResponse = false;
+  bool respond = true;
+
+  if (cmd.type == CMD_TYPE_FILE || cmd.type == CMD_TYPE_DONE) {
+    flushPersistence();
+    commitFileOp();
+    CMDQ_LOCK;
+    if (cmdRequest) {
+      if (cmd.type == CMD_TYPE_DONE) cmdRequest->send(200, "text/plain", cmd.payload);
+      else if (!handleFileRead(cmdRequest, cmd.payload)) cmdRequest->send(404, "text/plain", "Not found");
+    }
+    cmdRequest = nullptr;
+    CMDQ_UNLOCK;
+    return;
+  }
+
+  if (cmd.type == CMD_TYPE_API) {
+    String apireq = cmd.payload;
+    handleSet(nullptr, apireq);
+    CMDQ_LOCK;
+    if (cmdRequest && apireq.indexOf(F("IN")) < 1) XML_response(cmdRequest); //internal call, does not send XML response
+    cmdRequest = nullptr;
+    CMDQ_UNLOCK;
+    return;
+  }
+
+  if (cmd.type == CMD_TYPE_BRI) {
+    StaticJsonDocument<64> doc;
+    JsonObject root = doc.to<JsonObject>();
+    if (cmd.bri >= 0) root["bri"] = cmd.bri;
+    if (cmd.on  >= 0) root["on"]  = (bool)cmd.on;
+    if (cmd.tt  >= 0) root["tt"]  = cmd.tt;
+    deserializeState(root);
+  } else {
+    { //scope JsonDocument so it releases its buffer
+      DynamicJsonDocument jsonBuffer(JSON_BUFFER_SIZE);
+      if (!jsonBuffer.capacity()) heapAllocFailed(ALLOC_SITE_JSON); //deserializeJson() fails below
+      DeserializationError error = deserializeJson(jsonBuffer, cmd.payload, cmd.len);
+      JsonObject root = jsonBuffer.as<JsonObject>();
+      JsonArray batch = jsonBuffer.as<JsonArray>(); //state objects applied as one change
+      if (error || (root.isNull() && batch.isNull())) {
+        CMDQ_LOCK;
+        if (cmdRequest) cmdRequest->send(400, "application/json", F("{\"error\":9}"));
+        cmdRequest = nullptr;
+        CMDQ_UNLOCK;
+        return;
+      }
+      if (!batch.isNull()) {
+        for (JsonObject elem : batch) if (!(elem[F("resp")] | true)) respond = false;
+      } else {
+        respond = root[F("resp")] | true;
+        #ifdef WLED_ENABLE_WEBSOCKETS
+        if (cmd.wsClient && root.containsKey("lv")) wsLiveClientId = root["lv"] ? cmd.wsClient : 0;
+        if (cmd.wsClient && root.containsKey("sub")) subscribeStateWs(cmd.wsClient, root["sub"]);
+        #endif
+      }
+      fileDoc = &jsonBuffer;
+      verboseResponse = batch.isNull() ? deserializeState(root) : deserializeStateBatch(batch);
+      fileDoc = nullptr;
+    }
+    CMDQ_LOCK;
+    if (cmdRequest) {
+      if (!respond) cmdRequest->send(204); //"resp":false, no response body wanted
+      else if (verboseResponse) serveJson(cmdRequest); //if JSON contains "v"
+      else cmdRequest->send(200, "application/json", F("{\"success\":true}"));
+    }
+    cmdRequest = nullptr;
+    CMDQ_UNLOCK;
+  }
+
+  #ifdef WLED_ENABLE_WEBSOCKETS
+  if (cmd.wsClient && respond && (verboseResponse || millis() - lastInterfaceUpdate < 1900)) { //update if it takes longer than 100ms until next "broadcast"
+    AsyncWebSocketClient* client = ws.client(cmd.wsClient);
+    if (client) sendDataWs(client);
+  }
+  #endif
+}
+
+//applies all queued commands, called once per loop()
+void handleCommandQueue()
+{
+  uint8_t n = cmdQueueCount; //commands queued meanwhile wait for the next loop
+  QueuedCommand cmd;
+  while (n-- && popCommand(cmd)) {
+    applyCommand(cmd);
+    free(cmd.payload);
+    CMDQ_LOCK;
+    cmdRequest = nullptr; //responded or no response needed
+    CMDQ_UNLOCK;
+  }
+}
+
+uint8_t getCommandQueueLength()
+{
+  return cmdQueueCount;
+}
@@ -32,6 +32,7 @@
 #define USERMOD_ID_AUTO_SAVE      9            //Usermod "usermod_v2_auto_save.h"
 #define USERMOD_ID_DHT           10            //Usermod "usermod_dht.h"
 #define USERMOD_ID_MODE_SORT     11            //Usermod "usermod_v2_mode_sort.h"
+#define USERMOD_ID_CUSTOM_EFFECT 12            //Usermod "usermod_v2_custom_effect.h"
 
 //Access point behavior
 #define AP_BEHAVIOR_BOOT_NO_CONN  0            //Open AP when no connection after boot
@@ -75,6 +76,24 @@
 #define REALTIME_OVERRIDE_ONCE    1
 #define REALTIME_OVERRIDE_ALWAYS  2
 
+//Segment records appended to the UDP sync notifier packet (udp_segments.cpp)
+#define UDP_SEG_HEADER            3            //number of records, record size, main segment id
+#define UDP_SEG_SIZE              25           //bytes per record
+
+//Render task commands (WLED_ENABLE_RENDER_TASK)
+#define RENDER_CMD_TRIGGER        1            //render all segments with the next frame
+#define RENDER_CMD_RESET          2            //reset the runtime data of the segments in arg (bit mask)
+#define RENDER_CMD_TRANSITION     3            //setTransitionMode(arg)
+
+//JSON state field groups for change tracking (revision.cpp)
+#define STATE_FIELD_BRI        0x01            //on, bri, transition
+#define STATE_FIELD_PS         0x02            //ps, pl, ccnf, error
+#define STATE_FIELD_NL         0x04            //nl
+#define STATE_FIELD_UDPN       0x08            //udpn
+#define STATE_FIELD_LOR        0x10            //lor
+#define STATE_FIELD_SEG        0x20            //mainseg, seg
+#define STATE_FIELD_ALL        0x3F
+
 //E1.31 DMX modes
 #define DMX_MODE_DISABLED         0            //not used
 #define DMX_MODE_SINGLE_RGB       1            //all LEDs same RGB color (3 channels)
@@ -84,6 +103,11 @@
 #define DMX_MODE_MULTIPLE_DRGB    5            //every LED is addressed with its own RGB and share a master dimmer (ledCount * 3 + 1 channels)
 #define DMX_MODE_MULTIPLE_RGBW    6            //every LED is addressed with its own RGBW (ledCount * 4 channels)
 
+//E1.31 / Art-Net merging of several sources sending the same universe (at the same priority)
+#define E131_MERGE_LTP            0            //latest packet wins (default)
+#define E131_MERGE_HTP            1            //highest channel value of all sources
+#define E131_MERGE_PRIORITY       2            //the source that was there first keeps control
+
 //Light capability byte (unused) 0bRRCCTTTT
 //bits 0/1/2/3: specifies a type of LED driver. A single "driver" may have different chip models but must have the same protocol/behavior
 //bits 4/5: specifies the class of LED driver - 0b00 (dec. 0-15)  unconfigured/reserved
@@ -210,6 +234,7 @@
 #define OMAX 2048
 
 #define E131_MAX_UNIVERSE_COUNT 9
+#define E131_MAX_SOURCES 2          //per universe, e.g. main and backup controller
 
 #define ABL_MILLIAMPS_DEFAULT 850  // auto lower brightness to stay close to milliampere limit
 
@@ -231,11 +256,51 @@
   #define JSON_BUFFER_SIZE 16384
 #endif
 
-// Maximum size of node map (list of other WLED instances)
+// Maximum size of node list (other WLED instances), the table has some free slots to keep probing short
 #ifdef ESP8266
   #define WLED_MAX_NODES 15
+  #define WLED_NODE_TABLE_SIZE 20
+  #define WLED_NODE_QUERY_LIMIT_SLOTS 8
 #else
   #define WLED_MAX_NODES 150
+  #define WLED_NODE_TABLE_SIZE 192
+  #define WLED_NODE_QUERY_LIMIT_SLOTS 16
+#endif
+#define WLED_NODE_MAX_AGE   330000  //ms without announcement before a node is removed
+#define WLED_NODE_QUERY_INTERVAL 100 //ms, a node asking more often gets no reply
+
+// Web server admission control: handlers allocating a JSON document or similar that may run at once,
+// static content (files, UI pages) in progress at once, heap that must stay free for realtime packets
+#ifdef ESP8266
+  #define WLED_MAX_HEAVY_REQUESTS  2
+  #define WLED_MAX_STATIC_REQUESTS 3
+  #define WLED_REQUEST_HEAP_RESERVE 6144
+#else
+  #define WLED_MAX_HEAVY_REQUESTS  4
+  #define WLED_MAX_STATIC_REQUESTS 8
+  #define WLED_REQUEST_HEAP_RESERVE 16384
+#endif
+#define REQ_LANE_HEAVY  0  //JSON state/info, settings pages, uploads
+#define REQ_LANE_STATIC 1  //files and PROGMEM pages
+
+// Call sites of allocations counted by the heap telemetry when they fail
+#define ALLOC_SITE_SEGMENT 0  //effect data, compositor and transition buffers
+#define ALLOC_SITE_JSON    1  //JSON documents and command buffers
+#define ALLOC_SITE_WS      2  //websocket message buffers
+#define ALLOC_SITE_BUS     3  //LED bus pixel buffers
+#define ALLOC_SITE_PRESET  4  //preset and playlist buffers
+#define ALLOC_SITES        5
+
+//Adalight/TPM2 need a higher baud rate for long strips (e.g. 921600 or 1000000)
+#ifndef WLED_SERIAL_BAUD_RATE
+  #define WLED_SERIAL_BAUD_RATE 115200
+#endif
+#ifndef WLED_SERIAL_RX_BUFFER
+  #ifdef ESP8266
+    #define WLED_SERIAL_RX_BUFFER 512
+  #else
+    #define WLED_SERIAL_RX_BUFFER 2048
+  #endif
 #endif
 
 //this is merely a default now and can be changed at runtime
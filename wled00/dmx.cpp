@@ -9,57 +9,110 @@
 
 #ifdef WLED_ENABLE_DMX
 
+/*
+ * The DMX frame is built once per shown LED frame. Channels are only written to the library
+ * if they changed, and the bus (~23ms blocking for a full universe) is only updated if
+ * something changed, at most DMXRefreshRate times per second, plus a keepalive so fixtures
+ * do not time out.
+ */
+
+#define DMX_MAX_CHANNELS   511   //ESPDMX buffer holds the start code and 511 channels
+#define DMX_MIN_CHANNELS   24    //shortest frame allowed by the standard
+#define DMX_KEEPALIVE_MS   800   //many fixtures black out after 1s without signal
+#define DMX_SRC_ZERO       0     //DMXFixtureMap value for "always 0"
+#define DMX_SRC_COUNT      7
+
+static uint8_t dmxFrame[DMX_MAX_CHANNELS + 1];   //channel 1 at index 1
+static uint8_t dmxSent[DMX_MAX_CHANNELS + 1];    //what the library buffer holds
+static uint8_t dmxMap[15];                       //validated DMXFixtureMap
+static uint16_t dmxStart = 0, dmxGap = 0, dmxStartLED = 0; //settings the frame is built with
+static uint8_t dmxChannels = 0;
+static uint16_t dmxFixtures = 0;                 //fixtures that fit into the universe
+static uint16_t dmxUsedChannels = 0;             //highest channel written
+static uint16_t dmxBusChannels = DMX_MIN_CHANNELS; //channels sent per frame
+static uint16_t dmxLedCount = 0;                 //ledCount the fixtures were counted for
+static uint32_t dmxLastShow = 0;
+static unsigned long dmxLastUpdate = 0;
+static bool dmxDirty = true;
+static bool dmxWriteAll = true;                  //library buffer content unknown (init or proxy mode)
+
+//precomputes what only changes with the settings, must be called after they changed (from the loop, see doInitDMX)
+//the settings are copied, so the async settings handler changing them can not make the frame builder leave dmxFrame
+void initDMX() {
+  for (byte j = 0; j < 15; j++) dmxMap[j] = (DMXFixtureMap[j] < DMX_SRC_COUNT) ? DMXFixtureMap[j] : DMX_SRC_ZERO;
+  dmxStart = DMXStart;
+  dmxGap = DMXGap;
+  dmxChannels = DMXChannels;
+  dmxStartLED = DMXStartLED;
+
+  dmxFixtures = 0;
+  dmxUsedChannels = 0;
+  dmxLedCount = ledCount;
+  if (dmxStart > 0 && dmxChannels > 0 && dmxChannels <= 15 && dmxStartLED < ledCount) {
+    for (uint16_t i = dmxStartLED; i < ledCount; i++) {
+      uint32_t last = dmxStart + (uint32_t)dmxGap * dmxFixtures + dmxChannels - 1;
+      if (last > DMX_MAX_CHANNELS) break;
+      dmxUsedChannels = last;
+      dmxFixtures++;
+    }
+  }
+
+  memset(dmxFrame, 0, sizeof(dmxFrame));
+  dmxDirty = true;
+  dmxWriteAll = true;
+  //a shorter frame blocks the loop for less time (44us per channel)
+  dmxBusChannels = max(dmxUsedChannels, (uint16_t)DMX_MIN_CHANNELS);
+  dmx.init(dmxBusChannels + 1);        // initialize with bus length (including start code)
+}
+
+//fills dmxFrame from the current LED colors
+static void buildDMXFrame()
+{
+  uint8_t src[DMX_SRC_COUNT] = {0, 0, 0, 0, 0, strip.getBrightness(), 255}; //zero, R, G, B, W, shutter, full
+  for (uint16_t f = 0; f < dmxFixtures; f++) {
+    uint32_t in = strip.getPixelColor(dmxStartLED + f);
+    src[1] = in >> 16; src[2] = in >> 8; src[3] = in; src[4] = in >> 24;
+
+    uint8_t* out = &dmxFrame[dmxStart + dmxGap * f];
+    for (byte j = 0; j < dmxChannels; j++) out[j] = src[dmxMap[j]];
+  }
+}
+
 void handleDMX()
 {
   // don't act, when in DMX Proxy mode
-  if (e131ProxyUniverse != 0) return;
+  if (e131ProxyUniverse != 0) {
+    dmxWriteAll = true;
+    return;
+  }
+  if (doInitDMX || ledCount != dmxLedCount) {
+    doInitDMX = false;
+    initDMX();
+  }
 
   // TODO: calculate brightness manually if no shutter channel is set
 
-  uint8_t brightness = strip.getBrightness();
-
-  for (int i = DMXStartLED; i < ledCount; i++) {        // uses the amount of LEDs as fixture count
-
-    uint32_t in = strip.getPixelColor(i);     // get the colors for the individual fixtures as suggested by Aircoookie in issue #462
-    byte w = in >> 24 & 0xFF;
-    byte r = in >> 16 & 0xFF;
-    byte g = in >> 8 & 0xFF;
-    byte b = in & 0xFF;
-
-    int DMXFixtureStart = DMXStart + (DMXGap * (i - DMXStartLED));
-    for (int j = 0; j < DMXChannels; j++) {
-      int DMXAddr = DMXFixtureStart + j;
-      switch (DMXFixtureMap[j]) {
-        case 0:        // Set this channel to 0. Good way to tell strobe- and fade-functions to fuck right off.
-          dmx.write(DMXAddr, 0);
-          break;
-        case 1:        // Red
-          dmx.write(DMXAddr, r);
-          break;
-        case 2:        // Green
-          dmx.write(DMXAddr, g);
-          break;
-        case 3:        // Blue
-          dmx.write(DMXAddr, b);
-          break;
-        case 4:        // White
-          dmx.write(DMXAddr, w);
-          break;
-        case 5:        // Shutter channel. Controls the brightness.
-          dmx.write(DMXAddr, brightness);
-          break;
-        case 6:        // Sets this channel to 255. Like 0, but more wholesome.
-          dmx.write(DMXAddr, 255);
-          break;
-      }
-    }
+  uint32_t lastShow = strip.getLastShow();
+  if (lastShow != dmxLastShow) { //new frame shown
+    dmxLastShow = lastShow;
+    buildDMXFrame();
+    if (dmxWriteAll || memcmp(dmxFrame, dmxSent, dmxUsedChannels + 1)) dmxDirty = true;
   }
 
-  dmx.update();        // update the DMX bus
-}
+  unsigned long now = millis();
+  uint16_t minInterval = 1000 / (DMXRefreshRate ? DMXRefreshRate : 1);
+  if (now - dmxLastUpdate < minInterval) return;
+  if (!dmxDirty && now - dmxLastUpdate < DMX_KEEPALIVE_MS) return;
 
-void initDMX() {
-  dmx.init(512);        // initialize with bus length
+  for (uint16_t ch = 1; ch <= dmxBusChannels; ch++) {
+    if (dmxFrame[ch] == dmxSent[ch] && !dmxWriteAll) continue;
+    dmx.write(ch, dmxFrame[ch]);
+    dmxSent[ch] = dmxFrame[ch];
+  }
+  dmxDirty = false;
+  dmxWriteAll = false;
+  dmxLastUpdate = now;
+  dmx.update();        // update the DMX bus
 }
 
 #else
@@ -8,10 +8,12 @@
  * E1.31 handler
  */
 
+static byte ddpLastSequenceNumber = 0; //of the last pushed frame, to detect late packets
+
 //DDP protocol support, called by handleE131Packet
 //handles RGB data only
 void handleDDPPacket(e131_packet_t* p) {
-  int lastPushSeq = e131LastSequenceNumber[0];
+  int lastPushSeq = ddpLastSequenceNumber;
   
   //reject late packets belonging to previous frame (assuming 4 packets max. before push)
   if (e131SkipOutOfSequence && lastPushSeq) {
@@ -33,6 +35,7 @@ void handleDDPPacket(e131_packet_t* p) {
   if (p->flags & DDP_TIMECODE_FLAG) c = 4; //packet has timecode flag, we do not support it, but data starts 4 bytes later
 
   realtimeLock(realtimeTimeoutMs, REALTIME_MODE_DDP);
+  if (realtimeOverride) return;
   
   for (uint16_t i = start; i < stop; i++) {
     setRealtimePixel(i, data[c], data[c+1], data[c+2], 0);
@@ -43,12 +46,134 @@ void handleDDPPacket(e131_packet_t* p) {
   if (push) {
     e131NewData = true;
     byte sn = p->sequenceNum & 0xF;
-    if (sn) e131LastSequenceNumber[0] = sn;
+    if (sn) ddpLastSequenceNumber = sn;
+  }
+}
+
+/*
+ * Source tracking for E1.31 and Art-Net
+ * Each universe keeps up to E131_MAX_SOURCES senders, identified by CID (Art-Net: IP).
+ * Only sources with the highest priority are used. Sources with the same priority are
+ * merged according to e131MergeMode. A source is dropped after the E1.31 data loss timeout
+ * or when it marks its stream as terminated.
+ */
+#define E131_SOURCE_TIMEOUT     2500  //ms
+#define E131_OPTION_TERMINATED  0x40
+#define E131_DEFAULT_PRIORITY   100   //for Art-Net, which has no priority
+#define E131_DATA_LEN           513   //start code and 512 channels
+
+typedef struct E131Source {
+  uint8_t cid[16];
+  uint32_t lastSeen;  //0 if the slot is free
+  uint8_t* data;      //last channel values (as received, incl. start code for E1.31), only kept for HTP
+  uint16_t len;
+  uint8_t priority;
+  uint8_t seq;
+} e131_source;
+
+static E131Source e131Sources[E131_MAX_UNIVERSE_COUNT][E131_MAX_SOURCES];
+static uint8_t e131Owner[E131_MAX_UNIVERSE_COUNT];  //source in control with E131_MERGE_PRIORITY (opt-in)
+static uint8_t* e131MergeBuf = nullptr;             //HTP result
+
+static void freeE131Source(E131Source& src)
+{
+  delete[] src.data;
+  src.data = nullptr;
+  src.lastSeen = 0;
+}
+
+static bool isE131SourceActive(E131Source& src, uint32_t now)
+{
+  if (src.lastSeen && now - src.lastSeen > E131_SOURCE_TIMEOUT) freeE131Source(src);
+  return src.lastSeen;
+}
+
+/*
+ * Registers the packet with its source, returns the channel data to apply (the packet's own
+ * data or the HTP merge of all sources) or nullptr if the packet must be ignored.
+ */
+static uint8_t* mergeE131Source(uint8_t idx, const uint8_t* cid, uint8_t priority, uint8_t seq, bool terminated, uint8_t* data, uint16_t len)
+{
+  E131Source* sources = e131Sources[idx];
+  uint32_t now = millis();
+  if (!now) now = 1; //0 marks a free slot
+  int8_t slot = -1, freeSlot = -1, lowest = -1;
+  for (uint8_t i = 0; i < E131_MAX_SOURCES; i++) {
+    if (!isE131SourceActive(sources[i], now)) { if (freeSlot < 0) freeSlot = i; continue; }
+    if (!memcmp(sources[i].cid, cid, 16)) slot = i;
+    else if (lowest < 0 || sources[i].priority < sources[lowest].priority) lowest = i;
+  }
+
+  if (terminated) { //stream terminated, the other sources take over
+    if (slot >= 0) freeE131Source(sources[slot]);
+    return nullptr;
+  }
+
+  if (slot < 0) { //new source
+    if (freeSlot >= 0) slot = freeSlot;
+    else if (lowest >= 0 && priority > sources[lowest].priority) { //replaces a lower priority source
+      slot = lowest;
+      freeE131Source(sources[slot]);
+    } else return nullptr;
+    memcpy(sources[slot].cid, cid, 16);
+    sources[slot].seq = seq;
+  } else if (e131SkipOutOfSequence) {
+    byte last = sources[slot].seq;
+    if (seq < last && seq > 20 && last < 250) {
+      DEBUG_PRINT("skipping E1.31 frame (last seq=");
+      DEBUG_PRINT(last);
+      DEBUG_PRINT(", current seq=");
+      DEBUG_PRINT(seq);
+      DEBUG_PRINT(", universe=");
+      DEBUG_PRINT(idx + e131Universe);
+      DEBUG_PRINTLN(")");
+      return nullptr;
+    }
+  }
+  E131Source& src = sources[slot];
+  src.lastSeen = now;
+  src.priority = priority;
+  src.seq = seq;
+
+  //only the highest priority is used
+  uint8_t others = 0;
+  for (uint8_t i = 0; i < E131_MAX_SOURCES; i++) {
+    if (i == slot || !sources[i].lastSeen) continue;
+    if (sources[i].priority > priority) return nullptr;
+    if (sources[i].priority == priority) others++;
+  }
+
+  if (!others || e131Owner[idx] >= E131_MAX_SOURCES || !sources[e131Owner[idx]].lastSeen
+      || sources[e131Owner[idx]].priority < priority) e131Owner[idx] = slot;
+
+  if (e131MergeMode == E131_MERGE_HTP) { //keep the values, a second source may start any time
+    if (!src.data) src.data = new (std::nothrow) uint8_t[E131_DATA_LEN];
+    if (src.data) {
+      memcpy(src.data, data, len);
+      src.len = len;
+    }
+  }
+  if (!others) return data;
+
+  switch (e131MergeMode) {
+    case E131_MERGE_PRIORITY: return (e131Owner[idx] == slot) ? data : nullptr;
+    case E131_MERGE_HTP: {
+      if (!e131MergeBuf) e131MergeBuf = new (std::nothrow) uint8_t[E131_DATA_LEN];
+      if (!src.data || !e131MergeBuf) return data; //out of memory, behave like LTP
+      memcpy(e131MergeBuf, data, len);
+      for (uint8_t i = 0; i < E131_MAX_SOURCES; i++) {
+        if (i == slot || !sources[i].lastSeen || sources[i].priority != priority || !sources[i].data) continue;
+        uint16_t n = min(len, sources[i].len);
+        for (uint16_t c = 0; c < n; c++) if (sources[i].data[c] > e131MergeBuf[c]) e131MergeBuf[c] = sources[i].data[c];
+      }
+      return e131MergeBuf;
+    }
+    default: return data; //E131_MERGE_LTP
   }
 }
 
 //E1.31 and Art-Net protocol support
-void handleE131Packet(e131_packet_t* p, IPAddress clientIP, byte protocol){
+static void applyE131Packet(e131_packet_t* p, IPAddress clientIP, byte protocol){
 
   uint16_t uni = 0, dmxChannels = 0;
   uint8_t* e131_data = nullptr;
@@ -86,18 +211,22 @@ void handleE131Packet(e131_packet_t* p, IPAddress clientIP, byte protocol){
 
   uint8_t previousUniverses = uni - e131Universe;
 
-  if (e131SkipOutOfSequence)
-    if (seq < e131LastSequenceNumber[uni-e131Universe] && seq > 20 && e131LastSequenceNumber[uni-e131Universe] < 250){
-      DEBUG_PRINT("skipping E1.31 frame (last seq=");
-      DEBUG_PRINT(e131LastSequenceNumber[uni-e131Universe]);
-      DEBUG_PRINT(", current seq=");
-      DEBUG_PRINT(seq);
-      DEBUG_PRINT(", universe=");
-      DEBUG_PRINT(uni);
-      DEBUG_PRINTLN(")");
-      return;
-    }
-  e131LastSequenceNumber[uni-e131Universe] = seq;
+  if (uni < e131Universe) return;
+
+  uint8_t cid[16] = {0};
+  uint8_t priority = E131_DEFAULT_PRIORITY;
+  bool terminated = false;
+  if (protocol == P_E131) {
+    memcpy(cid, p->cid, 16);
+    priority = p->priority;
+    terminated = p->options & E131_OPTION_TERMINATED;
+  } else {
+    for (uint8_t i = 0; i < 4; i++) cid[i] = clientIP[i];
+  }
+  //channel data as received, E1.31 includes the start code
+  uint16_t dataLen = min((protocol == P_E131) ? dmxChannels + 1 : (int)dmxChannels, E131_DATA_LEN);
+  e131_data = mergeE131Source(previousUniverses, cid, priority, seq, terminated, e131_data, dataLen);
+  if (!e131_data) return;
 
   // update status info
   realtimeIP = clientIP;
@@ -140,7 +269,7 @@ void handleE131Packet(e131_packet_t* p, IPAddress clientIP, byte protocol){
         DMXOldDimmer = e131_data[DMXAddress+0];
         bri = e131_data[DMXAddress+0];
       }
-      if (e131_data[DMXAddress+1] < MODE_COUNT)
+      if (e131_data[DMXAddress+1] < strip.getModeCount())
         effectCurrent = e131_data[DMXAddress+ 1];
       effectSpeed     = e131_data[DMXAddress+ 2];  // flickers
       effectIntensity = e131_data[DMXAddress+ 3];
@@ -207,3 +336,41 @@ void handleE131Packet(e131_packet_t* p, IPAddress clientIP, byte protocol){
 
   e131NewData = true;
 }
+
+#ifdef WLED_ENABLE_RENDER_TASK
+/*
+ * With the render task, the async UDP task only queues the packets (lock-free, it never waits),
+ * the main loop applies them like the other realtime protocols. A packet is dropped if the queue is full.
+ */
+#define E131_QUEUE_LEN 8
+
+typedef struct E131Queued {
+  e131_packet_t packet;
+  IPAddress clientIP;
+  byte protocol;
+} e131_queued;
+
+static SpscQueue<E131Queued, E131_QUEUE_LEN> e131Queue;
+static E131Queued e131In, e131Out; //copies kept off the task stacks
+
+//called by the async UDP task
+void handleE131Packet(e131_packet_t* p, IPAddress clientIP, byte protocol)
+{
+  memcpy(&e131In.packet, p, sizeof(e131_packet_t));
+  e131In.clientIP = clientIP;
+  e131In.protocol = protocol;
+  e131Queue.push(e131In);
+}
+
+//called by the main loop
+void handleE131()
+{
+  while (e131Queue.pop(e131Out)) applyE131Packet(&e131Out.packet, e131Out.clientIP, e131Out.protocol);
+}
+#else
+//called by the async UDP task
+void handleE131Packet(e131_packet_t* p, IPAddress clientIP, byte protocol)
+{
+  applyE131Packet(p, clientIP, protocol);
+}
+#endif
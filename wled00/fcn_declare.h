@@ -19,6 +19,13 @@ void initBlynk(const char* auth, const char* host, uint16_t port);
 void handleBlynk();
 void updateBlynk();
 
+//boot.cpp
+void bootMark(const char* phase);
+void serializeBootTimes(JsonObject root);
+bool loadFastBootState();
+void saveFastBootState();
+void invalidateFastBootState();
+
 //button.cpp
 void shortPressAction();
 bool isButtonPressed();
@@ -31,6 +38,20 @@ bool deserializeConfigSec();
 void serializeConfig();
 void serializeConfigSec();
 
+//clock_sync.cpp
+bool clockSyncLocked();
+void clockSyncSource(IPAddress ip);
+bool handleClockSyncPacket(const uint8_t* udpIn, uint16_t len);
+void handleClockSync();
+void serializeClockSync(JsonObject root);
+
+//cmdqueue.cpp
+bool queueJsonCommand(const uint8_t* data, size_t len, AsyncWebServerRequest* request = nullptr, uint32_t wsClient = 0);
+bool queueApiCommand(const char* req, AsyncWebServerRequest* request = nullptr);
+bool queueFileResponse(AsyncWebServerRequest* request, const char* path, const char* text = nullptr);
+void handleCommandQueue();
+uint8_t getCommandQueueLength();
+
 //colors.cpp
 void colorFromUint32(uint32_t in, bool secondary = false);
 void colorFromUint24(uint32_t in, bool secondary = false);
@@ -53,15 +74,30 @@ void handleDMX();
 
 //e131.cpp
 void handleE131Packet(e131_packet_t* p, IPAddress clientIP, byte protocol);
+#ifdef WLED_ENABLE_RENDER_TASK
+void handleE131();
+#endif
 
 //file.cpp
 bool handleFileRead(AsyncWebServerRequest*, String path);
+void handleFileUpload(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final);
+void handleFileUploadDone(AsyncWebServerRequest* request);
+void handleFileDelete(AsyncWebServerRequest* request);
 bool writeObjectToFileUsingId(const char* file, uint16_t id, JsonDocument* content);
 bool writeObjectToFile(const char* file, const char* key, JsonDocument* content);
 bool readObjectFromFileUsingId(const char* file, uint16_t id, JsonDocument* dest);
 bool readObjectFromFile(const char* file, const char* key, JsonDocument* dest);
 void updateFSInfo();
 void closeFile();
+void invalidateFileETag(const char* path);
+bool fileOpPending();
+void commitFileOp();
+
+//heap.cpp
+uint32_t getMaxFreeBlock();
+void heapAllocFailed(uint8_t site);
+void handleHeapTelemetry();
+void serializeHeap(JsonObject root);
 
 //hue.cpp
 void handleHue();
@@ -98,9 +134,13 @@ void handleIR();
 
 void deserializeSegment(JsonObject elem, byte it);
 bool deserializeState(JsonObject root);
+bool deserializeStateBatch(JsonArray batch);
 void serializeSegment(JsonObject& root, WS2812FX::Segment& seg, byte id, bool forPreset = false, bool segmentBounds = true);
 void serializeState(JsonObject root, bool forPreset = false, bool includeBri = true, bool segmentBounds = true);
 void serializeInfo(JsonObject root);
+void serializePerf(JsonObject root, bool segments = true);
+void serializeModeData(JsonObject root);
+String getModeNamesJson();
 void serveJson(AsyncWebServerRequest* request);
 bool serveLiveLeds(AsyncWebServerRequest* request, uint32_t wsClient = 0);
 
@@ -148,16 +188,59 @@ void setCronixie();
 void _overlayCronixie();    
 void _drawOverlayCronixie();
 
+//persist.cpp
+bool writeJsonAtomic(const char* path, JsonDocument* doc);
+void persistConfig();
+void persistPreset(byte index, JsonDocument* content);
+void handlePersistence();
+void flushPresets();
+void flushPersistence();
+void clearPersistence();
+bool presetsPending();
+bool commitTempFile(const char* tmp, const char* path);
+void recoverFiles();
+void serializePersistence(JsonObject root);
+
 //playlist.cpp
+void invalidatePlaylistPrefetch();
 void unloadPlaylist();
 void loadPlaylist(JsonObject playlistObject);
 void handlePlaylist();
 
 //presets.cpp
 bool applyPreset(byte index);
+bool applyPresetFrom(byte index, JsonDocument* doc);
 void savePreset(byte index, bool persist = true, const char* pname = nullptr, JsonObject saveobj = JsonObject());
 void deletePreset(byte index);
 
+//render_task.cpp
+#ifdef WLED_ENABLE_RENDER_TASK
+typedef struct RenderState {
+  uint32_t frames;   //frames sent by the render task
+  uint32_t cmdsDone; //commands processed
+  uint32_t lastShow;
+  uint16_t fps;
+  uint16_t milliamps;
+} render_state;
+
+void initRenderTask();
+bool renderCommand(uint8_t type, uint32_t arg = 0);
+bool getRenderState(RenderState& rs);
+void lockStrip();
+void unlockStrip();
+#else
+inline void lockStrip() {}
+inline void unlockStrip() {}
+#endif
+
+//revision.cpp
+void serializeStateDelta(JsonObject root, uint8_t fields);
+void serveStateSince(AsyncWebServerRequest* request, uint32_t since);
+void subscribeStateWs(uint32_t client, JsonVariant sub);
+bool isStateSubscriber(uint32_t client);
+bool hasStateSubscribers();
+void handleStateRevision();
+
 //set.cpp
 void _setRandomColor(bool _sec,bool fromButton=false);
 bool isAsterisksOnly(const char* str, byte maxLen);
@@ -172,44 +255,15 @@ void realtimeLock(uint32_t timeoutMs, byte md = REALTIME_MODE_GENERIC);
 void handleNotifications();
 void setRealtimePixel(uint16_t i, byte r, byte g, byte b, byte w);
 void refreshNodeList();
-void sendSysInfoUDP();
+void sendSysInfoUDP(IPAddress to = IPAddress(255, 255, 255, 255));
+void sendNodeQueryUDP();
+
+//udp_segments.cpp
+uint16_t packSegments(byte* buf);
+void applySegments(const byte* buf, uint16_t len, bool applyColors, bool applyEffects);
 
 //um_manager.cpp
-class Usermod {
-  public:
-    virtual void loop() {}
-    virtual void setup() {}
-    virtual void connected() {}
-    virtual void addToJsonState(JsonObject& obj) {}
-    virtual void addToJsonInfo(JsonObject& obj) {}
-    virtual void readFromJsonState(JsonObject& obj) {}
-    virtual void addToConfig(JsonObject& obj) {}
-    virtual void readFromConfig(JsonObject& obj) {}
-    virtual uint16_t getId() {return USERMOD_ID_UNSPECIFIED;}
-};
-
-class UsermodManager {
-  private:
-    Usermod* ums[WLED_MAX_USERMODS];
-    byte numMods = 0;
-
-  public:
-    void loop();
-
-    void setup();
-    void connected();
-
-    void addToJsonState(JsonObject& obj);
-    void addToJsonInfo(JsonObject& obj);
-    void readFromJsonState(JsonObject& obj);
-
-    void addToConfig(JsonObject& obj);
-    void readFromConfig(JsonObject& obj);
-
-    bool add(Usermod* um);
-    Usermod* lookup(uint16_t mod_id);
-    byte getModCount();
-};
+#include "um_manager.h"
 
 //usermods_list.cpp
 void registerUsermods();
@@ -231,9 +285,17 @@ void handleSerial();
 //wled_server.cpp
 bool isIp(String str);
 bool captivePortal(AsyncWebServerRequest *request);
+bool requestAdmitted(AsyncWebServerRequest* request);
+void releaseRequest(AsyncWebServerRequest* request);
+void sendUnavailable(AsyncWebServerRequest* request);
+bool admitRequest(AsyncWebServerRequest* request, uint8_t lane, bool respond = true);
+void serializeServerLoad(JsonObject root);
 void initServer();
 void serveIndexOrWelcome(AsyncWebServerRequest *request);
 void serveIndex(AsyncWebServerRequest* request);
+bool handleIfNoneMatchCacheHeader(AsyncWebServerRequest* request, const char* etag);
+void setStaticContentCacheHeaders(AsyncWebServerResponse *response, const char* etag);
+void serveStaticP(AsyncWebServerRequest* request, const char* contentType, const uint8_t* content, size_t len, char* etag, bool gzip);
 String msgProcessor(const String& var);
 void serveMessage(AsyncWebServerRequest* request, uint16_t code, const String& headl, const String& subl="", byte optionT=255);
 String settingsProcessor(const String& var);
@@ -280,6 +280,7 @@ bool writeObjectToFile(const char* file, const char* key, JsonDocument* content)
     DEBUGFS_PRINTLN(F("Failed to open!"));
     return false;
   }
+  invalidateFileETag(file); //an edit may keep the size
   
   if (!bufferedFind(key)) //key does not exist in file
   {
@@ -382,8 +383,8 @@ String getContentType(AsyncWebServerRequest* request, String filename){
   if(request->hasArg("download")) return "application/octet-stream";
   else if(filename.endsWith(".htm")) return "text/html";
   else if(filename.endsWith(".html")) return "text/html";
-//  else if(filename.endsWith(".css")) return "text/css";
-//  else if(filename.endsWith(".js")) return "application/javascript";
+  else if(filename.endsWith(".css")) return "text/css";
+  else if(filename.endsWith(".js")) return "application/javascript";
   else if(filename.endsWith(".json")) return "application/json";
   else if(filename.endsWith(".png")) return "image/png";
 //  else if(filename.endsWith(".gif")) return "image/gif";
@@ -396,19 +397,288 @@ String getContentType(AsyncWebServerRequest* request, String filename){
   return "text/plain";
 }
 
+/*
+ * Static files are served with a hash of their content as ETag. It is computed while a file is uploaded
+ * and stored next to it in <name>.etag (size and hash), so revalidating a cached file costs a 304 instead
+ * of the whole file. Files written by other means get their .etag on the first request (one read of the file).
+ * Every other write to a file has to remove its .etag (invalidateFileETag()), the sidecars themselves are never served.
+ * <name>.gz is preferred if the client accepts gzip, uploading <name> removes an outdated <name>.gz.
+ * A single byte range may be requested.
+ * Uploads are written to <name>.upl, the loop replaces the file with it (and deletes files of the FS editor)
+ * in commitFileOp(), after it wrote what is pending in persist.cpp, which would otherwise overwrite the new file.
+ */
+
+#define FILE_ETAG_EXT   ".etag"
+#define FILE_UPLOAD_EXT ".upl"
+
+#define FILE_OP_NONE   0
+#define FILE_OP_UPLOAD 1
+#define FILE_OP_DELETE 2
+
+typedef struct FileETag {
+  uint32_t size;
+  uint32_t hash;   //FNV-1a of the content
+} file_etag;
+
+static uint32_t fileHash(uint32_t hash, const uint8_t* data, size_t len)
+{
+  for (size_t i = 0; i < len; i++) hash = (hash ^ data[i]) * 16777619UL;
+  return hash;
+}
+
+static void writeFileETag(const String& path, const FileETag& tag)
+{
+  File tagFile = WLED_FS.open(path + FILE_ETAG_EXT, "w");
+  if (!tagFile) return;
+  tagFile.write((const uint8_t*)&tag, sizeof(tag));
+  tagFile.close();
+}
+
+//to be called when a file is changed other than by an upload (e.g. in place, keeping its size)
+void invalidateFileETag(const char* path)
+{
+  String tagPath = String(path) + FILE_ETAG_EXT;
+  if (WLED_FS.exists(tagPath)) WLED_FS.remove(tagPath);
+}
+
+//an upload or delete waiting for the loop, set by the web server handlers
+static struct FileOp {
+  char path[33];
+  FileETag tag;          //size 0 to compute it on the first request
+  volatile uint8_t op;   //set last
+} fileOp = {"", {0, 0}, FILE_OP_NONE};
+
+bool fileOpPending()
+{
+  return fileOp.op != FILE_OP_NONE;
+}
+
+//the pending op replaces or removes the file at path (or the .gz served for it)
+static bool fileOpPendingFor(const String& path)
+{
+  if (!fileOpPending()) return false;
+  String opPath = fileOp.path;
+  return opPath == path || opPath == path + ".gz";
+}
+
+//queues the op for the loop to apply (handlePersistence() or a queued file response), false if another one is still waiting
+static bool queueFileOp(uint8_t op, const String& path, const FileETag* tag)
+{
+  if (fileOpPending()) return false;
+  strlcpy(fileOp.path, path.c_str(), sizeof(fileOp.path));
+  fileOp.tag.size = tag ? tag->size : 0;
+  fileOp.tag.hash = tag ? tag->hash : 0;
+  fileOp.op = op;
+  return true;
+}
+
+//etag must hold 11 chars, the hash in quotes
+static void getFileETag(const String& path, File& file, char* etag)
+{
+  FileETag tag = {0, 0};
+  String tagPath = path + FILE_ETAG_EXT;
+  if (WLED_FS.exists(tagPath)) {
+    File tagFile = WLED_FS.open(tagPath, "r");
+    if (tagFile && tagFile.read((uint8_t*)&tag, sizeof(tag)) != sizeof(tag)) tag.size = 0;
+    tagFile.close();
+  }
+  if (!tag.hash || tag.size != file.size()) { //missing or outdated
+    uint8_t buf[FS_BUFSIZE];
+    tag.size = file.size();
+    tag.hash = 2166136261UL;
+    size_t len;
+    while ((len = file.read(buf, sizeof(buf))) > 0) tag.hash = fileHash(tag.hash, buf, len);
+    file.seek(0);
+    writeFileETag(path, tag);
+  }
+  sprintf_P(etag, PSTR("\"%08x\""), (unsigned)tag.hash);
+}
+
+//parses a single "bytes=first-last" range, returns 0 to send the whole file, -1 if the range is not satisfiable
+static int8_t getRequestRange(AsyncWebServerRequest* request, size_t size, const char* etag, size_t& first, size_t& last)
+{
+  AsyncWebHeader* header = request->getHeader("Range");
+  if (!header) return 0;
+  AsyncWebHeader* ifRange = request->getHeader("If-Range");
+  if (ifRange && ifRange->value() != etag) return 0; //the file changed since the client got the first part
+  const char* s = header->value().c_str();
+  if (strncmp_P(s, PSTR("bytes="), 6) || strchr(s, ',')) return 0; //multiple ranges are not supported
+  s += 6;
+  char* end;
+  if (*s == '-') { //the last n bytes
+    unsigned long n = strtoul(s + 1, &end, 10);
+    if (end == s + 1 || *end) return 0;
+    if (!n || !size) return -1;
+    first = (n < size) ? size - n : 0;
+    last = size - 1;
+    return 1;
+  }
+  unsigned long from = strtoul(s, &end, 10);
+  if (end == s || *end != '-') return 0;
+  s = end + 1;
+  unsigned long to = ULONG_MAX;
+  if (*s) {
+    to = strtoul(s, &end, 10);
+    if (*end || to < from) return 0;
+  }
+  if (from >= size) return -1;
+  first = from;
+  last = (to < size) ? to : size - 1;
+  return 1;
+}
+
+static bool acceptsGzip(AsyncWebServerRequest* request)
+{
+  AsyncWebHeader* header = request->getHeader("Accept-Encoding");
+  return header && header->value().indexOf("gzip") >= 0;
+}
+
 bool handleFileRead(AsyncWebServerRequest* request, String path){
   DEBUG_PRINTLN("FileRead: " + path);
   if(path.endsWith("/")) path += "index.htm";
   if(path.indexOf("sec") > -1) return false;
-  String contentType = getContentType(request, path);
-  /*String pathWithGz = path + ".gz";
-  if(WLED_FS.exists(pathWithGz)){
-    request->send(WLED_FS, pathWithGz, contentType);
+  if(path.endsWith(FILE_ETAG_EXT)) return false;
+  if(path.endsWith(FILE_UPLOAD_EXT)) return false;
+  if ((path.startsWith(F("/presets.json")) && presetsPending()) || fileOpPendingFor(path)) {
+    if (!queueFileResponse(request, path.c_str())) sendUnavailable(request); //served by the loop once it wrote them
     return true;
-  }*/
-  if(WLED_FS.exists(path)) {
-    request->send(WLED_FS, path, contentType);
+  }
+  String contentType = getContentType(request, path);
+  bool gzip = false;
+  if (!request->hasArg("download") && acceptsGzip(request) && WLED_FS.exists(path + ".gz")) {
+    path += ".gz";
+    gzip = true;
+  } else if (!WLED_FS.exists(path)) return false;
+
+  File file = WLED_FS.open(path, "r");
+  if (!file) return false;
+  size_t size = file.size();
+  char etag[11];
+  getFileETag(path, file, etag);
+  if (handleIfNoneMatchCacheHeader(request, etag)) return true;
+
+  size_t first = 0, last = 0;
+  int8_t range = getRequestRange(request, size, etag, first, last);
+  AsyncWebServerResponse* response;
+  if (range < 0) {
+    response = request->beginResponse(416);
+    response->addHeader(F("Content-Range"), "bytes */" + String(size));
+    request->send(response);
     return true;
   }
-  return false;
+  if (range > 0) {
+    size_t len = last - first + 1;
+    response = request->beginResponse(contentType, len, [file, first, len](uint8_t* buf, size_t maxLen, size_t index) mutable -> size_t {
+      if (index >= len) return 0;
+      file.seek(first + index);
+      return file.read(buf, (len - index < maxLen) ? len - index : maxLen);
+    });
+    response->setCode(206);
+    char contentRange[40];
+    snprintf_P(contentRange, sizeof(contentRange), PSTR("bytes %u-%u/%u"), (unsigned)first, (unsigned)last, (unsigned)size);
+    response->addHeader(F("Content-Range"), contentRange);
+  } else {
+    response = request->beginResponse(file, path, contentType);
+  }
+  if (gzip) response->addHeader(F("Content-Encoding"), "gzip");
+  response->addHeader(F("Accept-Ranges"), "bytes");
+  response->addHeader(F("Vary"), "Accept-Encoding");
+  setStaticContentCacheHeaders(response, etag);
+  request->send(response);
+  return true;
+}
+
+//to be called after a file was replaced or removed through the web server
+static void fileReplaced(const String& path)
+{
+  if (!path.equals(F("/presets.json"))) return;
+  invalidateFastBootState(); //its size alone does not tell a new file
+  invalidatePlaylistPrefetch();
+}
+
+//state of an upload, freed with the request
+typedef struct FileUpload {
+  FileETag tag;
+  uint16_t status; //response once the body was received
+} file_upload;
+
+//upload handler (/upload and the FS editor), the ETag is computed while the file is written
+void handleFileUpload(AsyncWebServerRequest* request, const String& filename, size_t index, uint8_t* data, size_t len, bool final)
+{
+  String path = filename;
+  if (path.charAt(0) != '/') path = "/" + path;
+  if (!index) {
+    if (!admitRequest(request, REQ_LANE_HEAVY, false)) return; //the rest of the body is discarded
+    FileUpload* upload = (FileUpload*)malloc(sizeof(FileUpload));
+    request->_tempObject = upload;
+    if (!upload) return; //answered with 503
+    upload->tag.size = 0;
+    upload->tag.hash = 2166136261UL;
+    upload->status = 400;
+    if (path.endsWith(FILE_ETAG_EXT) || path.endsWith(FILE_UPLOAD_EXT)) return; //would be taken as the tag or upload of another file
+    if (path.length() + strlen(FILE_UPLOAD_EXT) >= sizeof(fileOp.path)) return; //SPIFFS allows 31 chars
+    DEBUG_PRINTLN("Upload: " + path);
+    request->_tempFile = WLED_FS.open(path + FILE_UPLOAD_EXT, "w");
+    upload->status = request->_tempFile ? 200 : 500;
+  }
+  FileUpload* upload = (FileUpload*)request->_tempObject;
+  if (!upload || !request->_tempFile) return;
+  if (len) {
+    request->_tempFile.write(data, len);
+    upload->tag.size += len;
+    upload->tag.hash = fileHash(upload->tag.hash, data, len);
+  }
+  if (final) {
+    request->_tempFile.close();
+    if (!queueFileOp(FILE_OP_UPLOAD, path, &upload->tag)) { //another upload or delete is still waiting for the loop
+      WLED_FS.remove(path + FILE_UPLOAD_EXT);
+      upload->status = 503;
+    }
+  }
+}
+
+//responds to an upload once its body was received, the loop responds once it replaced the file
+void handleFileUploadDone(AsyncWebServerRequest* request)
+{
+  FileUpload* upload = (FileUpload*)request->_tempObject;
+  if (!requestAdmitted(request) || !upload || upload->status == 503) sendUnavailable(request); //rejected or busy, may be retried
+  else if (upload->status != 200) request->send(upload->status);
+  else if (!queueFileResponse(request, nullptr, "")) request->send(200); //handlePersistence() still applies it
+}
+
+//delete request of the FS editor, handled before the editor itself does
+void handleFileDelete(AsyncWebServerRequest* request)
+{
+  if (!request->hasParam("path", true)) {
+    request->send(404);
+    return;
+  }
+  String path = request->getParam("path", true)->value();
+  if (path.length() >= sizeof(fileOp.path)) {
+    request->send(400);
+    return;
+  }
+  if (!queueFileOp(FILE_OP_DELETE, path, nullptr)) { //another upload or delete is still waiting for the loop
+    sendUnavailable(request);
+    return;
+  }
+  String msg = "DELETE: " + path;
+  if (!queueFileResponse(request, nullptr, msg.c_str())) request->send(200, "text/plain", msg); //handlePersistence() still applies it
+}
+
+//applies the upload or delete of a web server handler, called by the loop after pending writes are written
+void commitFileOp()
+{
+  if (!fileOpPending()) return;
+  String path = fileOp.path;
+  if (fileOp.op == FILE_OP_UPLOAD) {
+    if (commitTempFile((path + FILE_UPLOAD_EXT).c_str(), path.c_str()) && fileOp.tag.size) writeFileETag(path, fileOp.tag); //else computed on the first request
+    if (!path.endsWith(".gz") && WLED_FS.exists(path + ".gz")) WLED_FS.remove(path + ".gz"); //would be served instead
+  } else {
+    WLED_FS.remove(path);
+    invalidateFileETag(path.c_str()); //a file created at the same path later must not get its tag
+  }
+  fileReplaced(path);
+  updateFSInfo();
+  fileOp.op = FILE_OP_NONE;
 }
@@ -0,0 +1,121 @@
+#include "wled.h"
+
+/*
+ * Heap telemetry
+ * Allocations in the field mostly fail because the heap is fragmented, not because it is used up.
+ * The free heap is sampled every loop and the largest free block every HEAP_BLOCK_INTERVAL.
+ * The lowest free heap of each HEAP_LOW_WINDOW is kept in a ring with its uptime and the
+ * largest block at that moment. Failed allocations are counted per call site (ALLOC_SITE_*).
+ * All of it is reported in /json/info "heap", and published to <device topic>/heap every
+ * mqttHeapInterval seconds if that is set.
+ */
+
+#define HEAP_LOW_WINDOW      60000  //ms
+#define HEAP_LOW_COUNT       8
+#define HEAP_BLOCK_INTERVAL  100    //ms, finding the largest block walks the heap on ESP8266
+
+typedef struct HeapLow {
+  uint32_t time;    //s of uptime
+  uint32_t free;
+  uint32_t block;   //largest free block
+} heap_low;
+
+static HeapLow heapLows[HEAP_LOW_COUNT];
+static HeapLow heapWindowLow = {0, UINT32_MAX, 0};
+static uint8_t heapLowNext = 0, heapLowCount = 0;
+static uint32_t heapMinFree = UINT32_MAX, heapMinBlock = UINT32_MAX;
+static uint32_t heapBlock = 0;
+static uint16_t allocFailures[ALLOC_SITES];
+static unsigned long heapWindowStart = 0, heapLastBlockSample = 0, heapLastPublish = 0;
+
+uint32_t getMaxFreeBlock()
+{
+  #ifdef ESP8266
+  return ESP.getMaxFreeBlockSize();
+  #else
+  return ESP.getMaxAllocHeap();
+  #endif
+}
+
+//called where an allocation failed, site is one of ALLOC_SITE_*
+void heapAllocFailed(uint8_t site)
+{
+  if (site >= ALLOC_SITES) return;
+  if (allocFailures[site] < UINT16_MAX) allocFailures[site]++;
+  DEBUG_PRINT(F("Allocation failed, site "));
+  DEBUG_PRINTLN(site);
+}
+
+static void publishHeapMqtt();
+
+//samples the heap, called once per loop()
+void handleHeapTelemetry()
+{
+  unsigned long now = millis();
+  uint32_t freeHeap = ESP.getFreeHeap();
+  if (now - heapLastBlockSample >= HEAP_BLOCK_INTERVAL || freeHeap < heapWindowLow.free) {
+    heapLastBlockSample = now;
+    heapBlock = getMaxFreeBlock();
+    if (heapBlock < heapMinBlock) heapMinBlock = heapBlock;
+  }
+  if (freeHeap < heapMinFree) heapMinFree = freeHeap;
+  if (freeHeap < heapWindowLow.free) {
+    heapWindowLow.time = millis()/1000 + rolloverMillis*4294967;
+    heapWindowLow.free = freeHeap;
+    heapWindowLow.block = heapBlock;
+  }
+
+  if (now - heapWindowStart >= HEAP_LOW_WINDOW) {
+    heapWindowStart = now;
+    heapLows[heapLowNext] = heapWindowLow;
+    heapLowNext = (heapLowNext + 1) % HEAP_LOW_COUNT;
+    if (heapLowCount < HEAP_LOW_COUNT) heapLowCount++;
+    heapWindowLow.free = UINT32_MAX;
+  }
+
+  if (mqttHeapInterval && now - heapLastPublish >= mqttHeapInterval * 1000UL) {
+    heapLastPublish = now;
+    publishHeapMqtt();
+  }
+}
+
+void serializeHeap(JsonObject root)
+{
+  uint32_t freeHeap = ESP.getFreeHeap();
+  uint32_t block = getMaxFreeBlock();
+  root[F("free")] = freeHeap;
+  root[F("blk")] = block;
+  root[F("frag")] = freeHeap ? 100 - (block * 100) / freeHeap : 0; //%
+  root[F("min")] = heapMinFree;
+  root[F("minblk")] = heapMinBlock;
+
+  JsonObject fail = root.createNestedObject(F("fail"));
+  fail[F("seg")]  = allocFailures[ALLOC_SITE_SEGMENT];
+  fail[F("json")] = allocFailures[ALLOC_SITE_JSON];
+  fail[F("ws")]   = allocFailures[ALLOC_SITE_WS];
+  fail[F("bus")]  = allocFailures[ALLOC_SITE_BUS];
+  fail[F("ps")]   = allocFailures[ALLOC_SITE_PRESET];
+
+  //[uptime s, free, largest block] of the last windows, oldest first
+  JsonArray lows = root.createNestedArray(F("lows"));
+  for (uint8_t i = 0; i < heapLowCount; i++) {
+    HeapLow& l = heapLows[(heapLowNext + HEAP_LOW_COUNT - heapLowCount + i) % HEAP_LOW_COUNT];
+    JsonArray low = lows.createNestedArray();
+    low.add(l.time); low.add(l.free); low.add(l.block);
+  }
+}
+
+static void publishHeapMqtt()
+{
+  #ifdef WLED_ENABLE_MQTT
+  if (!WLED_MQTT_CONNECTED) return;
+  StaticJsonDocument<768> doc;
+  serializeHeap(doc.to<JsonObject>());
+  char payload[512];
+  serializeJson(doc, payload, sizeof(payload));
+  char subuf[38];
+  strcpy(subuf, mqttDeviceTopic);
+  strcat(subuf, "/heap");
+  mqtt->publish(subuf, 0, false, payload);
+  #endif
+}
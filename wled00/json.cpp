@@ -92,6 +92,8 @@ void deserializeSegment(JsonObject elem, byte it)
     seg.setOption(SEG_OPTION_SELECTED, elem[F("sel")] | seg.getOption(SEG_OPTION_SELECTED));
     seg.setOption(SEG_OPTION_REVERSED, elem["rev"] | seg.getOption(SEG_OPTION_REVERSED));
     seg.setOption(SEG_OPTION_MIRROR  , elem[F("mi")]  | seg.getOption(SEG_OPTION_MIRROR  ));
+    byte bm = elem[F("bm")] | seg.blendMode;
+    if (bm < BLEND_MODE_COUNT) seg.blendMode = bm;
 
     //temporary, strip object gets updated via colorUpdated()
     if (id == strip.getMainSegmentId()) {
@@ -109,6 +111,7 @@ void deserializeSegment(JsonObject elem, byte it)
 
     JsonArray iarr = elem[F("i")]; //set individual LEDs
     if (!iarr.isNull()) {
+      lockStrip(); //the pixels are written here, not by the render task
       strip.setPixelSegment(id);
 
       //freeze and init to black
@@ -148,6 +151,10 @@ void deserializeSegment(JsonObject elem, byte it)
         }
       }
       strip.setPixelSegment(255);
+      #ifdef WLED_ENABLE_RENDER_TASK
+      strip.publishSettings(); //the render task adopts the frozen segment before it draws again
+      #endif
+      unlockStrip();
       strip.trigger();
     } else { //return to regular effect
       seg.setOption(SEG_OPTION_FREEZE, false);
@@ -156,7 +163,32 @@ void deserializeSegment(JsonObject elem, byte it)
   }
 }
 
-bool deserializeState(JsonObject root)
+#define CALL_MODE_NONE 255 //no colorUpdated() pending
+
+/*
+ * Applies the changes previous objects of a batch made to the main segment, before it changes or a preset is
+ * saved from the state. They are not notified here but with the colorUpdated() at the end of the batch, so
+ * a batch sends one notification: effectChanged makes it send one also if the later objects change nothing.
+ */
+static void applyPendingChanges(byte callMode)
+{
+  if (callMode == CALL_MODE_NONE) return;
+  byte pendingUpdate = interfaceUpdateCallMode;
+  interfaceUpdateCallMode = 0;
+  colorUpdated(NOTIFIER_CALL_MODE_NO_NOTIFY);
+  if (!interfaceUpdateCallMode) { //nothing changed
+    interfaceUpdateCallMode = pendingUpdate;
+    return;
+  }
+  if (callMode != NOTIFIER_CALL_MODE_NO_NOTIFY) effectChanged = true;
+}
+
+/*
+ * Applies a state object without calling colorUpdated().
+ * callMode is the call mode of changes still pending from previous objects of a batch (CALL_MODE_NONE if none),
+ * it is returned with the call mode pending after this object.
+ */
+static bool applyState(JsonObject root, byte& callMode)
 {
   strip.applyToAllSelected = false;
   bool stateResponse = root[F("v")] | false;
@@ -221,7 +253,9 @@ bool deserializeState(JsonObject root)
   }
 
   byte prevMain = strip.getMainSegmentId();
-  strip.mainSegment = root[F("mainseg")] | prevMain;
+  byte newMain = root[F("mainseg")] | prevMain;
+  if (newMain != prevMain) applyPendingChanges(callMode); //they apply to the previous main segment
+  strip.mainSegment = newMain;
   if (strip.getMainSegmentId() != prevMain) setValuesFromMainSeg();
 
   int it = 0;
@@ -262,6 +296,7 @@ bool deserializeState(JsonObject root)
 
   int ps = root[F("psave")] | -1;
   if (ps > 0) {
+    applyPendingChanges(callMode); //save what previous objects of the batch set
     savePreset(ps, true, nullptr, root);
   } else {
     ps = root[F("pdel")] | -1; //deletion
@@ -269,7 +304,11 @@ bool deserializeState(JsonObject root)
       deletePreset(ps);
     }
     ps = root["ps"] | -1; //load preset (clears state request!)
-    if (ps >= 0) {applyPreset(ps); return stateResponse;}
+    if (ps >= 0) {
+      applyPreset(ps); //calls colorUpdated(), also for pending changes
+      callMode = CALL_MODE_NONE;
+      return stateResponse;
+    }
 
     //HTTP API commands
     const char* httpwin = root["win"];
@@ -286,8 +325,34 @@ bool deserializeState(JsonObject root)
     noNotification = true; //do not notify both for this request and the first playlist entry
   }
 
-  colorUpdated(noNotification ? NOTIFIER_CALL_MODE_NO_NOTIFY : NOTIFIER_CALL_MODE_DIRECT_CHANGE);
+  //notify if any object of a batch wants to
+  if (!noNotification) callMode = NOTIFIER_CALL_MODE_DIRECT_CHANGE;
+  else if (callMode == CALL_MODE_NONE) callMode = NOTIFIER_CALL_MODE_NO_NOTIFY;
+
+  return stateResponse;
+}
 
+bool deserializeState(JsonObject root)
+{
+  byte callMode = CALL_MODE_NONE;
+  bool stateResponse = applyState(root, callMode);
+  if (callMode != CALL_MODE_NONE) colorUpdated(callMode);
+  return stateResponse;
+}
+
+/*
+ * Applies an array of state objects in order as one change,
+ * with a single notification and interface update at the end, also if objects change the main segment.
+ * Returns true if any of the objects requests a state response.
+ */
+bool deserializeStateBatch(JsonArray batch)
+{
+  byte callMode = CALL_MODE_NONE;
+  bool stateResponse = false;
+  for (JsonObject elem : batch) {
+    if (applyState(elem, callMode)) stateResponse = true;
+  }
+  if (callMode != CALL_MODE_NONE) colorUpdated(callMode);
   return stateResponse;
 }
 
@@ -333,6 +398,7 @@ void serializeSegment(JsonObject& root, WS2812FX::Segment& seg, byte id, bool fo
 	root[F("sel")] = seg.isSelected();
 	root["rev"] = seg.getOption(SEG_OPTION_REVERSED);
   root[F("mi")]  = seg.getOption(SEG_OPTION_MIRROR);
+  root[F("bm")]  = seg.blendMode;
 }
 
 void serializeState(JsonObject root, bool forPreset, bool includeBri, bool segmentBounds)
@@ -374,6 +440,7 @@ void serializeState(JsonObject root, bool forPreset, bool includeBri, bool segme
     udpn["recv"] = receiveNotifications;
 
     root[F("lor")] = realtimeOverride;
+    root[F("rev")] = stateRevision;
   }
 
   root[F("mainseg")] = strip.getMainSegmentId();
@@ -426,9 +493,18 @@ void serializeInfo(JsonObject root)
   JsonArray leds_pin = leds.createNestedArray("pin");
   leds_pin.add(LEDPIN);
 
+  #ifdef WLED_ENABLE_RENDER_TASK
+  RenderState rs = {0};
+  getRenderState(rs); //consistent copy of the values written by the render task
+  leds[F("pwr")] = rs.milliamps;
+  leds[F("fps")] = (millis() - rs.lastShow > 2000) ? 0 : rs.fps;
+  leds[F("maxpwr")] = (rs.milliamps)? strip.ablMilliampsMax : 0;
+  leds[F("frames")] = rs.frames;
+  #else
   leds[F("pwr")] = strip.currentMilliamps;
   leds[F("fps")] = strip.getFps();
   leds[F("maxpwr")] = (strip.currentMilliamps)? strip.ablMilliampsMax : 0;
+  #endif
   leds[F("maxseg")] = strip.getMaxSegments();
   leds[F("seglock")] = false; //will be used in the future to prevent modifications to segment config
 
@@ -477,6 +553,8 @@ void serializeInfo(JsonObject root)
   fs_info["u"] = fsBytesUsed / 1000;
   fs_info["t"] = fsBytesTotal / 1000;
   fs_info[F("pmt")] = presetsModifiedTime;
+  JsonObject persist = fs_info.createNestedObject(F("wr"));
+  serializePersistence(persist);
 
   root[F("ndc")] = nodeListEnabled ? (int)Nodes.size() : -1;
   
@@ -506,6 +584,20 @@ void serializeInfo(JsonObject root)
   root[F("freeheap")] = ESP.getFreeHeap();
   root[F("uptime")] = millis()/1000 + rolloverMillis*4294967;
 
+  JsonObject perf = root.createNestedObject("perf");
+  serializePerf(perf, false);
+
+  JsonObject sync = root.createNestedObject("sync");
+  serializeClockSync(sync);
+
+  JsonObject boot = root.createNestedObject("boot");
+  serializeBootTimes(boot);
+
+  JsonObject http = root.createNestedObject("http");
+  serializeServerLoad(http);
+
+  JsonObject heap = root.createNestedObject("heap");
+  serializeHeap(heap);
 
   usermods.addToJsonInfo(root);
 
@@ -541,6 +633,38 @@ void serializeInfo(JsonObject root)
   root["mac"] = escapedMac;
 }
 
+//[min, avg, max] in microseconds
+void serializeTiming(JsonArray arr, WS2812FX::RenderTiming& t)
+{
+  arr.add(t.minUs);
+  arr.add(t.avgUs);
+  arr.add(t.maxUs);
+}
+
+void serializePerf(JsonObject root, bool segments)
+{
+  root[F("win")] = RENDER_TIMING_WINDOW;
+  serializeTiming(root.createNestedArray("frame"), strip.getRenderTiming(RENDER_TIMING_FRAME));
+  serializeTiming(root.createNestedArray("show"),  strip.getRenderTiming(RENDER_TIMING_SHOW));
+  serializeTiming(root.createNestedArray("bus"),   strip.getRenderTiming(RENDER_TIMING_BUS));
+  serializeTiming(root.createNestedArray("xf"),    strip.getRenderTiming(RENDER_TIMING_XFADE));
+  serializeTiming(root.createNestedArray("cmp"),   strip.getRenderTiming(RENDER_TIMING_COMPOSE));
+
+  if (!segments) return;
+  JsonArray seg = root.createNestedArray("seg");
+  for (byte s = 0; s < strip.getMaxSegments(); s++)
+  {
+    WS2812FX::Segment& sg = strip.getSegment(s);
+    if (!sg.isActive()) continue;
+    JsonObject seg0 = seg.createNestedObject();
+    seg0["id"] = s;
+    seg0["fx"] = sg.mode;
+    seg0[F("len")] = sg.length();
+    serializeTiming(seg0.createNestedArray("fxt"), strip.getRenderTiming(RENDER_TIMING_FX, s));
+    serializeTiming(seg0.createNestedArray("palt"), strip.getRenderTiming(RENDER_TIMING_PALETTE, s));
+  }
+}
+
 void setPaletteColors(JsonArray json, CRGBPalette16 palette)
 {
     for (int i = 0; i < 16; i++) {
@@ -688,24 +812,109 @@ void serializePalettes(JsonObject root, AsyncWebServerRequest* request)
   }
 }
 
+//JSON_mode_names with the names of the effects added by usermods appended
+String getModeNamesJson()
+{
+  String names = FPSTR(JSON_mode_names);
+  names.remove(names.length() - 1); //"]"
+  for (uint8_t i = MODE_COUNT; i < strip.getModeCount(); i++) {
+    names += F(",\"");
+    names += FPSTR(strip.getModeName(i));
+    names += '"';
+  }
+  names += ']';
+  return names;
+}
+
+//[default palette, FX_FLAG_* bits] per effect, in the order of /json/eff
+void serializeModeData(JsonObject root)
+{
+  JsonArray fx = root.createNestedArray(F("fx"));
+  for (uint8_t i = 0; i < strip.getModeCount(); i++) {
+    JsonArray e = fx.createNestedArray();
+    e.add(strip.getModeDefaultPalette(i));
+    e.add(strip.getModeFlags(i));
+  }
+}
+
 void serializeNodes(JsonObject root)
 {
   JsonArray nodes = root.createNestedArray("nodes");
 
-  for (NodesMap::iterator it = Nodes.begin(); it != Nodes.end(); ++it)
+  uint32_t now = millis();
+  for (uint16_t i = 0; i < Nodes.capacity(); i++)
   {
-    if (it->second.ip[0] != 0)
-    {
-      JsonObject node = nodes.createNestedObject();
-      node[F("name")] = it->second.nodeName;
-      node["type"]    = it->second.nodeType;
-      node["ip"]      = it->second.ip.toString();
-      node[F("age")]  = it->second.age;
-      node[F("vid")]  = it->second.build;
+    NodeStruct* n = Nodes.at(i);
+    if (!n) continue;
+    JsonObject node = nodes.createNestedObject();
+    node[F("name")] = n->nodeName;
+    node["type"]    = n->nodeType;
+    node["ip"]      = IPAddress(n->ip).toString();
+    node[F("age")]  = (now - n->lastSeen) / 30000; //in former broadcast intervals
+    node[F("vid")]  = n->build;
+  }
+}
+
+//splits a field list like "bri,on,seg[0].fx" into a filter tree ({"bri":true,"on":true,"seg":{"0":{"fx":true}}})
+static void parseFieldFilter(const String& fields, JsonObject filter)
+{
+  int start = 0;
+  while (start < (int)fields.length()) {
+    int end = fields.indexOf(',', start);
+    if (end < 0) end = fields.length();
+    JsonObject cur = filter;
+    int p = start;
+    while (p < end && !cur.isNull()) {
+      int q = p;
+      while (q < end && fields[q] != '.' && fields[q] != '[' && fields[q] != ']') q++;
+      String key = fields.substring(p, q);
+      while (q < end && (fields[q] == '.' || fields[q] == '[' || fields[q] == ']')) q++;
+      p = q;
+      if (!key.length()) continue;
+      if (p >= end) {
+        cur[key] = true; //whole value
+      } else if (cur[key] == true) {
+        cur = JsonObject(); //parent already selected as a whole
+      } else {
+        JsonObject next = cur[key];
+        if (next.isNull()) next = cur.createNestedObject(key);
+        cur = next;
+      }
     }
+    start = end + 1;
   }
 }
 
+//removes everything the filter does not select
+static void applyFieldFilter(JsonVariant v, JsonVariantConst filter)
+{
+  if (!filter.is<JsonObject>()) return; //selected as a whole
+  JsonObjectConst f = filter.as<JsonObjectConst>();
+
+  if (v.is<JsonObject>()) {
+    JsonObject obj = v.as<JsonObject>();
+    for (JsonObject::iterator it = obj.begin(); it != obj.end();) {
+      JsonObject::iterator cur = it; ++it;
+      const char* key = cur->key().c_str();
+      if (f.containsKey(key)) applyFieldFilter(cur->value(), f[key]);
+      else obj.remove(cur);
+    }
+  } else if (v.is<JsonArray>()) {
+    JsonArray arr = v.as<JsonArray>();
+    for (int i = arr.size() - 1; i >= 0; i--) {
+      char key[6];
+      sprintf(key, "%d", i);
+      if (f.containsKey(key)) applyFieldFilter(arr[i], f[key]);
+      else arr.remove(i);
+    }
+  }
+}
+
+/*
+ * GET /json[/state|info|...][?f=field list]
+ * With "f", only the listed fields are sent (e.g. ?f=bri,on,seg[0].fx or ?f=state.bri,info.leds.count for /json).
+ * /json/state carries an ETag built from the state revision, so polling clients get 304 while nothing changed.
+ */
 void serveJson(AsyncWebServerRequest* request)
 {
   byte subJson = 0;
@@ -715,12 +924,15 @@ void serveJson(AsyncWebServerRequest* request)
   else if (url.indexOf("si") > 0) subJson = 3;
   else if (url.indexOf("nodes") > 0) subJson = 4;
   else if (url.indexOf("palx") > 0) subJson = 5;
+  else if (url.indexOf("perf") > 0) subJson = 6;
+  else if (url.indexOf("fxdata") > 0) subJson = 7;
   else if (url.indexOf("live")  > 0) {
     serveLiveLeds(request);
     return;
   }
   else if (url.indexOf(F("eff"))   > 0) {
-    request->send_P(200, "application/json", JSON_mode_names);
+    if (strip.getModeCount() > MODE_COUNT) request->send(200, "application/json", getModeNamesJson());
+    else request->send_P(200, "application/json", JSON_mode_names);
     return;
   }
   else if (url.indexOf(F("pal"))   > 0) {
@@ -732,8 +944,58 @@ void serveJson(AsyncWebServerRequest* request)
     return;
   }
 
+  if (subJson == 1 && request->hasParam("since")) { //long-poll for changes
+    serveStateSince(request, strtoul(request->getParam("since")->value().c_str(), nullptr, 10));
+    return;
+  }
+
+  String fields;
+  if (request->hasParam("f")) fields = request->getParam("f")->value();
+
+  //no ETag while the nightlight counts down, usermod state is not covered by the revision
+  char etag[32] = "";
+  if (subJson == 1 && !nightlightActive && usermods.getModCount() == 0) {
+    static uint32_t etagSeed = 0; //ETags of a previous boot never match
+    #ifdef ARDUINO_ARCH_ESP32
+    if (!etagSeed) etagSeed = esp_random() | 1;
+    #else
+    if (!etagSeed) etagSeed = RANDOM_REG32 | 1;
+    #endif
+    uint32_t hash = 5381;
+    for (uint16_t i = 0; i < fields.length(); i++) hash = ((hash << 5) + hash) + fields[i];
+    sprintf(etag, "\"%08X-%X-%X\"", etagSeed, stateRevision, hash);
+
+    if (request->hasHeader("If-None-Match") && request->header("If-None-Match") == etag) {
+      AsyncWebServerResponse* notModified = request->beginResponse(304);
+      notModified->addHeader(F("ETag"), etag);
+      request->send(notModified);
+      return;
+    }
+  }
+
+  //at most one key per two chars of the list (e.g. "a,b"), each stored with its name
+  DynamicJsonDocument filter(fields.length() ? (fields.length() / 2 + 1) * JSON_OBJECT_SIZE(1) + fields.length() + 1 : 0);
+  if (fields.length()) {
+    if (!filter.capacity()) {
+      heapAllocFailed(ALLOC_SITE_JSON);
+      request->send(503, "application/json", F("{\"error\":\"Out of memory\"}"));
+      return;
+    }
+    parseFieldFilter(fields, filter.to<JsonObject>());
+    if (filter.overflowed()) { //a filter missing fields would answer incompletely
+      request->send(400, "application/json", F("{\"error\":\"Field list too long\"}"));
+      return;
+    }
+  }
+
   AsyncJsonResponse* response = new AsyncJsonResponse(JSON_BUFFER_SIZE);
   JsonObject doc = response->getRoot();
+  if (doc.isNull()) { //document could not be allocated
+    heapAllocFailed(ALLOC_SITE_JSON);
+    delete response;
+    request->send(503, "application/json", F("{\"error\":\"Out of memory\"}"));
+    return;
+  }
 
   switch (subJson)
   {
@@ -745,6 +1007,10 @@ void serveJson(AsyncWebServerRequest* request)
       serializeNodes(doc); break;
     case 5: //palettes
       serializePalettes(doc, request); break;
+    case 6: //render timing
+      serializePerf(doc); break;
+    case 7: //effect metadata
+      serializeModeData(doc); break;
     default: //all
       JsonObject state = doc.createNestedObject("state");
       serializeState(state);
@@ -752,11 +1018,18 @@ void serveJson(AsyncWebServerRequest* request)
       serializeInfo(info);
       if (subJson != 3)
       {
-        doc[F("effects")]  = serialized((const __FlashStringHelper*)JSON_mode_names);
+        if (strip.getModeCount() > MODE_COUNT) doc[F("effects")] = serialized(getModeNamesJson());
+        else doc[F("effects")] = serialized((const __FlashStringHelper*)JSON_mode_names);
         doc[F("palettes")] = serialized((const __FlashStringHelper*)JSON_palette_names);
       }
   }
 
+  if (fields.length()) applyFieldFilter(doc, filter.as<JsonObject>());
+  if (etag[0]) {
+    response->addHeader(F("ETag"), etag);
+    response->addHeader(F("Cache-Control"), F("no-cache")); //always revalidate
+  }
+
   response->setLength();
   request->send(response);
 }
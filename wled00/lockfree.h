@@ -0,0 +1,95 @@
+#ifndef WLED_LOCKFREE_H
+#define WLED_LOCKFREE_H
+/*
+ * Lock-free primitives for passing data between exactly two tasks
+ * (e.g. the main loop and the render task on ESP32).
+ * Plain C++11, no dependency on the Arduino core, so they can be compiled on any host.
+ */
+
+#include <atomic>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * Bounded single-producer/single-consumer FIFO.
+ * push() may only be called from one task, pop() only from one (other) task.
+ * N must be a power of two. One slot is kept free to tell a full queue from an empty one.
+ */
+template <typename T, uint8_t N>
+class SpscQueue {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+  public:
+  //returns false if the queue is full
+  bool push(const T& item) {
+    uint8_t head = _head.load(std::memory_order_relaxed);
+    uint8_t next = (head + 1) & (N - 1);
+    if (next == _tail.load(std::memory_order_acquire)) return false;
+    _items[head] = item;
+    _head.store(next, std::memory_order_release); //publish the item
+    return true;
+  }
+
+  //returns false if the queue is empty
+  bool pop(T& item) {
+    uint8_t tail = _tail.load(std::memory_order_relaxed);
+    if (tail == _head.load(std::memory_order_acquire)) return false;
+    item = _items[tail];
+    _tail.store((tail + 1) & (N - 1), std::memory_order_release); //free the slot
+    return true;
+  }
+
+  bool isEmpty() {
+    return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+  }
+
+  private:
+  T _items[N];
+  std::atomic<uint8_t> _head{0};
+  std::atomic<uint8_t> _tail{0};
+};
+
+/*
+ * Single-writer snapshot of a small, trivially copyable struct (sequence lock).
+ * The writer never waits. A reader retries while a write is in progress,
+ * so it can never return a torn copy.
+ * The data is stored as relaxed atomic words to keep concurrent access well-defined.
+ */
+template <typename T>
+class Snapshot {
+  static const size_t WORDS = (sizeof(T) + 3) / 4;
+
+  public:
+  void write(const T& val) {
+    uint32_t buf[WORDS] = {0};
+    memcpy(buf, &val, sizeof(T));
+    uint32_t seq = _seq.load(std::memory_order_relaxed);
+    _seq.store(seq + 1, std::memory_order_relaxed); //odd: write in progress
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < WORDS; i++) _data[i].store(buf[i], std::memory_order_relaxed);
+    _seq.store(seq + 2, std::memory_order_release);
+  }
+
+  //returns false if no consistent copy could be taken within maxTries (writer busy), or nothing was written yet
+  bool read(T& out, uint16_t maxTries = 64) {
+    uint32_t buf[WORDS];
+    for (uint16_t t = 0; t < maxTries; t++) {
+      uint32_t seq1 = _seq.load(std::memory_order_acquire);
+      if (seq1 & 1) continue;
+      for (size_t i = 0; i < WORDS; i++) buf[i] = _data[i].load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (_seq.load(std::memory_order_relaxed) != seq1) continue;
+      if (seq1 == 0) return false;
+      memcpy(&out, buf, sizeof(T));
+      return true;
+    }
+    return false;
+  }
+
+  private:
+  std::atomic<uint32_t> _seq{0};
+  std::atomic<uint32_t> _data[WORDS];
+};
+
+#endif
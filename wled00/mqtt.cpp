@@ -85,14 +85,13 @@ void onMqttMessage(char* topic, char* payload, AsyncMqttClientMessageProperties
     colorUpdated(NOTIFIER_CALL_MODE_DIRECT_CHANGE);
   } else if (strcmp(topic, "/api") == 0)
   {
+    //applied by the main loop
     if (payload[0] == '{') { //JSON API
-      DynamicJsonDocument doc(JSON_BUFFER_SIZE);
-      deserializeJson(doc, payload);
-      deserializeState(doc.as<JsonObject>());
+      queueJsonCommand((const uint8_t*)payload, len);
     } else { //HTTP API
       String apireq = "win&";
       apireq += (char*)payload;
-      handleSet(nullptr, apireq);
+      queueApiCommand(apireq.c_str());
     }
   } else if (strcmp(topic, "") == 0)
   {
@@ -0,0 +1,323 @@
+#include "wled.h"
+
+/*
+ * Coalesced and atomic writes of the settings and presets
+ * persistConfig() and persistPreset() only note what has to be written. handlePersistence() writes a file once
+ * no further change came in for PERSIST_DELAY (at the latest PERSIST_MAX_DELAY after the first change), and not
+ * sooner than PERSIST_MIN_INTERVAL after its last write. A slider dragged on a settings page or an auto-save
+ * preset saved over and over thereby costs one write instead of dozens, saving an unchanged preset none.
+ * Files are written to <name>.tmp, which is then renamed over the original, so a power cut leaves either the
+ * old or the new file. SPIFFS cannot rename over an existing file, recoverFiles() completes the rename if the
+ * power was cut between removing the old file and renaming the new one.
+ * Pending writes are flushed before a reboot, before presets.json is read and before an upload replaces a file.
+ * Only the loop writes: on ESP32 the web server handlers run in the async TCP task, concurrently to it. They
+ * queue their upload or delete for the loop (commitFileOp()) and have the command queue respond once it was
+ * written, they never wait for the loop. What they share with it (dirty flags, pending presets) is guarded by PERSIST_LOCK.
+ */
+
+#define PERSIST_DELAY          1000   //ms without further changes before a file is written
+#define PERSIST_MAX_DELAY     10000   //ms after the first change a file is written at the latest
+#define PERSIST_MIN_INTERVAL   5000   //ms between two writes of the same file
+#define PERSIST_MAX_PRESETS       4   //pending preset writes, more flush the pending ones
+#define PERSIST_SECTOR_SIZE    4096   //flash erase unit
+#define PERSIST_FLASH_CYCLES 100000   //erase cycles a flash sector is specified for
+#define PERSIST_TMP_EXT      ".tmp"
+
+#define PERSIST_CONFIG  0
+#define PERSIST_PRESETS 1
+#define PERSIST_TARGETS 2
+
+typedef struct PersistTarget {
+  bool dirty;
+  unsigned long firstChange, lastChange, lastWrite;
+} persist_target;
+
+typedef struct PendingPreset {
+  byte index;
+  char* json;                 //serialized preset, nullptr to delete it
+} pending_preset;
+
+static PersistTarget persistTargets[PERSIST_TARGETS];
+static PendingPreset pendingPresets[PERSIST_MAX_PRESETS];
+static uint8_t pendingPresetCount = 0;
+static byte lastPresetIndex = 0;     //last preset queued and the hash of its content, an identical save is skipped
+static uint32_t lastPresetHash = 0;
+
+#ifdef ARDUINO_ARCH_ESP32
+//recursive, as persistPreset() may flush the pending presets
+static SemaphoreHandle_t persistMux = xSemaphoreCreateRecursiveMutex();
+#define PERSIST_LOCK   xSemaphoreTakeRecursive(persistMux, portMAX_DELAY)
+#define PERSIST_UNLOCK xSemaphoreGiveRecursive(persistMux)
+#else //network callbacks do not preempt loop()
+#define PERSIST_LOCK
+#define PERSIST_UNLOCK
+#endif
+
+static uint32_t persistWrites = 0, persistSkipped = 0, persistFailures = 0;
+static uint32_t persistBytes = 0, persistSectors = 0;
+static uint16_t persistLastMs = 0, persistMaxMs = 0;
+
+static void markDirty(uint8_t target)
+{
+  PersistTarget& t = persistTargets[target];
+  unsigned long ms = millis();
+  if (!t.dirty) t.firstChange = ms;
+  t.lastChange = ms;
+  t.dirty = true;
+}
+
+static void accountWrite(uint32_t bytes, unsigned long start)
+{
+  uint16_t ms = millis() - start;
+  persistWrites++;
+  persistBytes += bytes;
+  persistSectors += (bytes + PERSIST_SECTOR_SIZE - 1) / PERSIST_SECTOR_SIZE + 1; //plus the file system metadata
+  persistLastMs = ms;
+  if (ms > persistMaxMs) persistMaxMs = ms;
+}
+
+static void tempPath(char* dest, const char* path)
+{
+  strcpy(dest, path);
+  strcat_P(dest, PSTR(PERSIST_TMP_EXT));
+}
+
+//replaces path by tmp
+bool commitTempFile(const char* tmp, const char* path)
+{
+  invalidateFileETag(path);
+  if (WLED_FS.rename(tmp, path)) return true; //LittleFS replaces the old file atomically
+  WLED_FS.remove(path);
+  return WLED_FS.rename(tmp, path);
+}
+
+//writes doc to path via a temporary file
+bool writeJsonAtomic(const char* path, JsonDocument* doc)
+{
+  char tmp[32];
+  tempPath(tmp, path);
+  unsigned long start = millis();
+  File file = WLED_FS.open(tmp, "w");
+  if (!file) {
+    persistFailures++; return false;
+  }
+  size_t len = measureJson(*doc);
+  bool ok = serializeJson(*doc, file) == len;
+  file.close();
+  if (!ok || !commitTempFile(tmp, path)) {
+    WLED_FS.remove(tmp);
+    persistFailures++; return false;
+  }
+  accountWrite(len, start);
+  return true;
+}
+
+static bool copyFile(const char* from, const char* to)
+{
+  File dest = WLED_FS.open(to, "w");
+  if (!dest) return false;
+  bool ok = true;
+  File src = WLED_FS.open(from, "r");
+  if (src) {
+    uint8_t buf[256];
+    size_t len;
+    while (ok && (len = src.read(buf, sizeof(buf))) > 0) ok = dest.write(buf, len) == len;
+    src.close();
+  }
+  dest.close();
+  return ok;
+}
+
+static void clearPendingPresets()
+{
+  for (uint8_t i = 0; i < pendingPresetCount; i++) delete[] pendingPresets[i].json;
+  pendingPresetCount = 0;
+}
+
+//applies the pending preset changes to a copy of presets.json and replaces it
+static void writePresets()
+{
+  if (doCloseFile) closeFile();
+  unsigned long start = millis();
+  char tmp[32];
+  tempPath(tmp, "/presets.json");
+  const char* file = tmp;
+  if (!copyFile("/presets.json", tmp)) { //not enough space for a copy, edit the file itself like before
+    WLED_FS.remove(tmp);
+    file = "/presets.json";
+  }
+
+  bool ok = true;
+  for (uint8_t i = 0; i < pendingPresetCount; i++) {
+    DynamicJsonDocument doc(32);
+    if (pendingPresets[i].json) doc.set(serialized((const char*)pendingPresets[i].json));
+    ok = writeObjectToFileUsingId(file, pendingPresets[i].index, &doc) && ok;
+  }
+  if (doCloseFile) closeFile();
+  clearPendingPresets();
+
+  File result = WLED_FS.open(file, "r");
+  uint32_t size = result ? result.size() : 0;
+  result.close();
+  if (file == tmp && !commitTempFile(tmp, "/presets.json")) ok = false;
+  if (ok) accountWrite(size, start);
+  else persistFailures++;
+  updateFSInfo();
+}
+
+static void writeTarget(uint8_t target)
+{
+  persistTargets[target].dirty = false;
+  persistTargets[target].lastWrite = millis();
+  if (target == PERSIST_CONFIG) serializeConfig();
+  else writePresets();
+}
+
+void persistConfig()
+{
+  PERSIST_LOCK;
+  markDirty(PERSIST_CONFIG);
+  PERSIST_UNLOCK;
+}
+
+//queues writing a preset to presets.json, content nullptr or an empty document deletes it
+void persistPreset(byte index, JsonDocument* content)
+{
+  char* json = nullptr;
+  uint32_t hash = 0;
+  PERSIST_LOCK;
+  if (content && !content->isNull()) {
+    size_t len = measureJson(*content);
+    json = new (std::nothrow) char[len + 1];
+    if (!json) { //write it right away, without the copy
+      heapAllocFailed(ALLOC_SITE_PRESET);
+      flushPresets();
+      writeObjectToFileUsingId("/presets.json", index, content);
+      lastPresetIndex = 0;
+      PERSIST_UNLOCK;
+      return;
+    }
+    serializeJson(*content, json, len + 1);
+    hash = 2166136261UL;
+    for (size_t i = 0; i < len; i++) hash = (hash ^ (uint8_t)json[i]) * 16777619UL;
+  }
+
+  if (index == lastPresetIndex && hash == lastPresetHash) { //same content as the last time
+    delete[] json;
+    persistSkipped++;
+    PERSIST_UNLOCK;
+    return;
+  }
+  lastPresetIndex = index;
+  lastPresetHash = hash;
+
+  uint8_t slot = 0;
+  while (slot < pendingPresetCount && pendingPresets[slot].index != index) slot++;
+  if (slot < pendingPresetCount) { //replaces a pending write of the same preset
+    delete[] pendingPresets[slot].json;
+    persistSkipped++;
+  } else {
+    if (pendingPresetCount >= PERSIST_MAX_PRESETS) flushPresets();
+    slot = pendingPresetCount++;
+  }
+  pendingPresets[slot].index = index;
+  pendingPresets[slot].json = json;
+  markDirty(PERSIST_PRESETS);
+  PERSIST_UNLOCK;
+}
+
+void handlePersistence()
+{
+  if (fileOpPending()) { //an upload or delete, written after what is pending (also if its response was not queued)
+    flushPersistence();
+    commitFileOp();
+    return;
+  }
+  unsigned long ms = millis();
+  PERSIST_LOCK;
+  for (uint8_t i = 0; i < PERSIST_TARGETS; i++) {
+    PersistTarget& t = persistTargets[i];
+    if (!t.dirty || (t.lastWrite && ms - t.lastWrite < PERSIST_MIN_INTERVAL)) continue;
+    if (ms - t.lastChange < PERSIST_DELAY && ms - t.firstChange < PERSIST_MAX_DELAY) continue;
+    writeTarget(i);
+    break; //at most one file per loop
+  }
+  PERSIST_UNLOCK;
+}
+
+//writes pending preset changes now, before presets.json is read
+void flushPresets()
+{
+  PERSIST_LOCK;
+  if (persistTargets[PERSIST_PRESETS].dirty) writeTarget(PERSIST_PRESETS);
+  PERSIST_UNLOCK;
+}
+
+//writes everything pending now (before a reboot or a file upload)
+void flushPersistence()
+{
+  PERSIST_LOCK;
+  for (uint8_t i = 0; i < PERSIST_TARGETS; i++) {
+    if (persistTargets[i].dirty) writeTarget(i);
+  }
+  lastPresetIndex = 0; //the file may be replaced
+  PERSIST_UNLOCK;
+}
+
+//drops pending writes (factory reset)
+void clearPersistence()
+{
+  PERSIST_LOCK;
+  clearPendingPresets();
+  for (uint8_t i = 0; i < PERSIST_TARGETS; i++) persistTargets[i].dirty = false;
+  lastPresetIndex = 0;
+  PERSIST_UNLOCK;
+}
+
+//preset changes not yet written to presets.json
+bool presetsPending()
+{
+  return persistTargets[PERSIST_PRESETS].dirty;
+}
+
+//cleans up after a power cut during a write or an upload (.upl, see file.cpp), called after the file system is mounted
+void recoverFiles()
+{
+  const char* files[] = {"/cfg.json", "/wsec.json", "/presets.json"};
+  const char* exts[] = {PERSIST_TMP_EXT, ".upl"};
+  for (uint8_t i = 0; i < 6; i++) {
+    const char* path = files[i >> 1];
+    char tmp[32];
+    strcpy(tmp, path);
+    strcat(tmp, exts[i & 1]);
+    if (!WLED_FS.exists(tmp)) continue;
+    bool complete = false;
+    if (!WLED_FS.exists(path)) { //the old file was removed, the new one is complete unless it was the first write
+      File file = WLED_FS.open(tmp, "r");
+      if (file && file.size()) {
+        file.seek(file.size() - 1);
+        complete = file.read() == '}';
+      }
+      file.close();
+    }
+    DEBUG_PRINT(complete ? F("Restoring ") : F("Removing "));
+    DEBUG_PRINTLN(tmp);
+    if (complete) commitTempFile(tmp, path);
+    else WLED_FS.remove(tmp);
+  }
+}
+
+void serializePersistence(JsonObject root)
+{
+  root[F("wr")] = persistWrites;
+  root[F("skip")] = persistSkipped;   //writes saved by coalescing
+  root[F("fail")] = persistFailures;
+  root["b"] = persistBytes;
+  JsonArray lat = root.createNestedArray(F("lat")); //ms, last and max
+  lat.add(persistLastMs); lat.add(persistMaxMs);
+  root[F("sect")] = persistSectors;
+  //share of the flash endurance used since boot in ppm, assuming the file system spreads the wear evenly
+  uint32_t sectors = fsBytesTotal / PERSIST_SECTOR_SIZE;
+  if (sectors) root[F("wear")] = round((double)persistSectors * 1000000.0 / ((double)sectors * PERSIST_FLASH_CYCLES) * 100) / 100.0;
+  root[F("pend")] = (persistTargets[PERSIST_CONFIG].dirty ? 1 : 0) | (persistTargets[PERSIST_PRESETS].dirty ? 2 : 0);
+}
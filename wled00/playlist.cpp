@@ -2,92 +2,143 @@
 
 /*
  * Handles playlists, timed sequences of presets
+ * Entries are stored compactly: one byte per entry for the preset, durations and transitions only per entry
+ * if they differ, else a single value.
+ * Reading a preset from presets.json takes long enough to make the frame it happens in stutter, so the preset
+ * of the next entry is read ahead once the current one has started, and applied from memory when it is due.
+ * Finding it in presets.json is spread over loop passes (PLAYLIST_PREFETCH_CHUNK bytes each), then only the
+ * preset itself is parsed. It is not read while preset changes are pending, they are written first.
  */
 
-typedef struct PlaylistEntry {
-  uint8_t preset;
-  uint16_t dur;
-  uint16_t tr;
-} ple;
+#ifdef ESP8266
+  #define PLAYLIST_MAX_ENTRIES 250
+#else
+  #define PLAYLIST_MAX_ENTRIES 1000
+#endif
+#define PLAYLIST_PREFETCH_DELAY 1000   //ms after an entry started before the next one is read
+#define PLAYLIST_PREFETCH_CHUNK  512   //bytes of presets.json searched per loop pass
 
-int8_t   playlistRepeat = 1;
-byte     playlistEndPreset = 0;
-byte    *playlistEntries = nullptr;
-byte     playlistLen;
-int8_t   playlistIndex = -1;
-uint16_t playlistEntryDur = 0;
+int8_t    playlistRepeat = 1;
+byte      playlistEndPreset = 0;
+byte     *playlistPresets = nullptr;   //preset of each entry
+uint16_t *playlistTimes = nullptr;     //durations, then transitions (tenths of seconds)
+uint16_t  playlistDurCount, playlistTrCount; //playlistLen or 1 if equal for all entries
+uint16_t  playlistLen;
+int16_t   playlistIndex = -1;
+uint16_t  playlistEntryDur = 0;
 
+static DynamicJsonDocument* playlistNext = nullptr; //preset read ahead
+static byte playlistNextPreset = 0;
+static bool playlistPrefetched = false; //for the current entry
+static File playlistFile;               //presets.json while the next preset is searched
+static char playlistKey[8];             //"<preset>":
+static uint8_t playlistKeyMatch = 0;    //chars of the key matched
+static uint32_t playlistObjStart = 0;   //position of the preset, 0 while searching its key
+static uint8_t playlistObjDepth = 0;
+static bool playlistInString = false, playlistEscaped = false;
+static bool playlistShuffled = false;   //for the next round
+
+static uint16_t playlistDur(uint16_t i) { return playlistTimes[(playlistDurCount > 1) ? i : 0]; }
+static uint16_t playlistTr(uint16_t i)  { return playlistTimes[playlistDurCount + ((playlistTrCount > 1) ? i : 0)]; }
 
 void shufflePlaylist() {
   int currentIndex = playlistLen, randomIndex;
-
-  PlaylistEntry temporaryValue, *entries = reinterpret_cast<PlaylistEntry*>(playlistEntries);
+  uint16_t* durs = playlistTimes;
+  uint16_t* trs = playlistTimes + playlistDurCount;
 
   // While there remain elements to shuffle...
   while (currentIndex--) {
     // Pick a random element...
     randomIndex = random(0, currentIndex);
     // And swap it with the current element.
-    temporaryValue = entries[currentIndex];
-    entries[currentIndex] = entries[randomIndex];
-    entries[randomIndex] = temporaryValue;
+    byte preset = playlistPresets[currentIndex];
+    playlistPresets[currentIndex] = playlistPresets[randomIndex];
+    playlistPresets[randomIndex] = preset;
+    if (playlistDurCount > 1) {
+      uint16_t dur = durs[currentIndex]; durs[currentIndex] = durs[randomIndex]; durs[randomIndex] = dur;
+    }
+    if (playlistTrCount > 1) {
+      uint16_t tr = trs[currentIndex]; trs[currentIndex] = trs[randomIndex]; trs[randomIndex] = tr;
+    }
   }
 }
 
+static void endPlaylistPrefetch() {
+  playlistFile.close();
+  playlistPrefetched = true;
+}
+
+void invalidatePlaylistPrefetch() {
+  playlistFile.close();
+  delete playlistNext;
+  playlistNext = nullptr;
+  playlistPrefetched = false;
+}
+
 void unloadPlaylist() {
-  if (playlistEntries != nullptr) {
-    delete[] playlistEntries;
-    playlistEntries = nullptr;
-  }
+  delete[] playlistPresets;
+  playlistPresets = nullptr;
+  delete[] playlistTimes;
+  playlistTimes = nullptr;
+  invalidatePlaylistPrefetch();
+  playlistShuffled = false;
   currentPlaylist = playlistIndex = -1;
   playlistLen = playlistEntryDur = 0;
 }
 
+//number of values needed for "dur" or "transition": 1 if all entries use the same
+static uint16_t countPlaylistTimes(JsonVariant times) {
+  JsonArray arr = times.as<JsonArray>();
+  if (arr.isNull() || arr.size() < 2) return 1;
+  uint16_t first = arr[0], i = 0;
+  for (uint16_t t : arr) {
+    if (i++ >= playlistLen) break;
+    if (t != first) return playlistLen;
+  }
+  return 1;
+}
+
+//fills count values, an array shorter than the playlist is continued with its last value
+static void parsePlaylistTimes(JsonVariant times, uint16_t* dest, uint16_t count, uint16_t def) {
+  JsonArray arr = times.as<JsonArray>();
+  if (arr.isNull()) {
+    dest[0] = times | def;
+    return;
+  }
+  uint16_t i = 0, last = def;
+  for (uint16_t t : arr) {
+    if (i >= count) break;
+    dest[i++] = last = t;
+  }
+  for (; i < count; i++) dest[i] = last;
+}
+
 void loadPlaylist(JsonObject playlistObj) {
   unloadPlaylist();
-  
+
   JsonArray presets = playlistObj["ps"];
   playlistLen = presets.size();
   if (playlistLen == 0) return;
-  if (playlistLen > 100) playlistLen = 100;
-  uint16_t dataSize = sizeof(ple) * playlistLen;
-  playlistEntries = new byte[dataSize];
-  PlaylistEntry* entries = reinterpret_cast<PlaylistEntry*>(playlistEntries);
+  if (playlistLen > PLAYLIST_MAX_ENTRIES) playlistLen = PLAYLIST_MAX_ENTRIES;
 
-  byte it = 0;
+  JsonVariant durations = playlistObj["dur"];
+  JsonVariant transitions = playlistObj["transition"];
+  playlistDurCount = countPlaylistTimes(durations);
+  playlistTrCount = countPlaylistTimes(transitions);
+  playlistPresets = new (std::nothrow) byte[playlistLen];
+  playlistTimes = new (std::nothrow) uint16_t[playlistDurCount + playlistTrCount];
+  if (!playlistPresets || !playlistTimes) {
+    heapAllocFailed(ALLOC_SITE_PRESET);
+    unloadPlaylist(); return;
+  }
+
+  uint16_t it = 0;
   for (int ps : presets) {
     if (it >= playlistLen) break;
-    entries[it].preset = ps;
-    it++;
-  }
-
-  it = 0;
-  JsonArray durations = playlistObj["dur"];
-  if (durations.isNull()) {
-    entries[0].dur = playlistObj["dur"] | 100;
-    it = 1;
-  } else {
-    for (int dur : durations) {
-      if (it >= playlistLen) break;
-      entries[it].dur = dur;
-      it++;
-    }
+    playlistPresets[it++] = ps;
   }
-  for (int i = it; i < playlistLen; i++) entries[i].dur = entries[it -1].dur;
-
-  it = 0;
-  JsonArray tr = playlistObj["transition"];
-  if (tr.isNull()) {
-    entries[0].tr = playlistObj["transition"] | (transitionDelay / 100);
-    it = 1;
-  } else {
-    for (int transition : tr) {
-      if (it >= playlistLen) break;
-      entries[it].tr = transition;
-      it++;
-    }
-  }
-  for (int i = it; i < playlistLen; i++) entries[i].tr = entries[it -1].tr;
+  parsePlaylistTimes(durations, playlistTimes, playlistDurCount, 100);
+  parsePlaylistTimes(transitions, playlistTimes + playlistDurCount, playlistTrCount, transitionDelay / 100);
 
   playlistRepeat = playlistObj[F("repeat")] | 0;
   playlistEndPreset = playlistObj[F("end")] | 0;
@@ -95,37 +146,137 @@ void loadPlaylist(JsonObject playlistObj) {
   currentPlaylist = 0; //TODO here we need the preset ID where the playlist is saved
 }
 
+//preset to apply when the current entry is over, 0 if none (playlist ends without an end preset)
+static byte nextPlaylistPreset() {
+  uint16_t next = (playlistIndex + 1) % playlistLen;
+  if (next) return playlistPresets[next];
+  if (!playlistRepeat) return playlistEndPreset; //the playlist ends
+  if (playlistRepeat < 0 && !playlistShuffled) { //shuffle now to know the first preset of the next round
+    shufflePlaylist();
+    playlistShuffled = true;
+  }
+  return playlistPresets[0];
+}
+
+//starts reading the preset of the next entry, so switching to it does not have to search and parse presets.json
+static void startPlaylistPrefetch() {
+  if (presetsPending()) return; //try again once they are written
+  byte preset = nextPlaylistPreset();
+  if (!preset || getMaxFreeBlock() < JSON_BUFFER_SIZE + WLED_REQUEST_HEAP_RESERVE) { //read it when due
+    playlistPrefetched = true; return;
+  }
+  if (doCloseFile) closeFile();
+  playlistFile = WLED_FS.open("/presets.json", "r");
+  if (!playlistFile) {
+    playlistPrefetched = true; return;
+  }
+  sprintf(playlistKey, "\"%d\":", preset);
+  playlistKeyMatch = 0;
+  playlistObjStart = 0;
+  playlistObjDepth = 0;
+  playlistInString = playlistEscaped = false;
+  playlistNextPreset = preset;
+}
 
-void handlePlaylist() {
-  if (currentPlaylist < 0 || playlistEntries == nullptr || presetCyclingEnabled) return;
-  
-  if (millis() - presetCycledTime > (100*playlistEntryDur)) {
-    presetCycledTime = millis();
-    if (bri == 0 || nightlightActive) return;
-
-    ++playlistIndex %= playlistLen; // -1 at 1st run (limit to playlistLen)
-
-    if (!playlistRepeat && !playlistIndex) { //stop if repeat == 0 and restart of playlist
-      unloadPlaylist();
-      if (playlistEndPreset) applyPreset(playlistEndPreset);
-      return;
+//parses the preset found at playlistObjStart, only it is read again
+static void parsePlaylistPrefetch() {
+  DynamicJsonDocument* doc = new (std::nothrow) DynamicJsonDocument(JSON_BUFFER_SIZE);
+  if (!doc || !doc->capacity()) {
+    heapAllocFailed(ALLOC_SITE_PRESET);
+    delete doc; return;
+  }
+  playlistFile.seek(playlistObjStart);
+  if (deserializeJson(*doc, playlistFile)) {
+    delete doc; return;
+  }
+  doc->shrinkToFit(); //only the preset stays allocated until the switch
+  playlistNext = doc;
+}
+
+//searches the next PLAYLIST_PREFETCH_CHUNK bytes for the preset (like bufferedFind()) and its end
+static void prefetchPlaylistEntry() {
+  if (!playlistFile) {
+    startPlaylistPrefetch();
+    if (!playlistFile) return;
+  }
+  byte buf[256];
+  for (uint16_t read = 0; read < PLAYLIST_PREFETCH_CHUNK; ) {
+    uint16_t len = playlistFile.read(buf, sizeof(buf));
+    if (!len) { //not in the file, or cut short
+      endPlaylistPrefetch(); return;
     }
-    // playlist roll-over
-    if (!playlistIndex) {
-      if (playlistRepeat > 0) {// playlistRepeat < 0 => endless loop with shuffling presets
-        playlistRepeat--; // decrease repeat count on each index reset
-      } else {
-        shufflePlaylist();  // shuffle playlist and start over
+    read += len;
+    for (uint16_t i = 0; i < len; i++) {
+      char c = buf[i];
+      if (!playlistObjStart) {
+        if (c != playlistKey[playlistKeyMatch]) playlistKeyMatch = 0;
+        if (c == playlistKey[playlistKeyMatch] && !playlistKey[++playlistKeyMatch]) {
+          playlistObjStart = playlistFile.position() - len + i + 1;
+        }
+        continue;
+      }
+      if (playlistInString) {
+        if (playlistEscaped) playlistEscaped = false;
+        else if (c == '\\') playlistEscaped = true;
+        else if (c == '"') playlistInString = false;
+      } else if (c == '"') playlistInString = true;
+      else if (c == '{' || c == '[') playlistObjDepth++;
+      else if ((c == '}' || c == ']') && !--playlistObjDepth) {
+        parsePlaylistPrefetch();
+        endPlaylistPrefetch(); return;
       }
     }
+  }
+}
 
-    PlaylistEntry* entries = reinterpret_cast<PlaylistEntry*>(playlistEntries);
+static void applyPlaylistPreset(byte preset) {
+  DynamicJsonDocument* doc = playlistNext;
+  playlistNext = nullptr; //applying the preset may load another playlist
+  playlistFile.close();   //not found in time, it is read now
+  playlistPrefetched = false;
+  if (doc && playlistNextPreset == preset) applyPresetFrom(preset, doc);
+  else applyPreset(preset);
+  delete doc;
+}
 
-    jsonTransitionOnce = true;
-    transitionDelayTemp = entries[playlistIndex].tr * 100;
+void handlePlaylist() {
+  if (currentPlaylist < 0 || playlistPresets == nullptr || presetCyclingEnabled) return;
 
-    applyPreset(entries[playlistIndex].preset);
-    playlistEntryDur = entries[playlistIndex].dur;
-    if (playlistEntryDur == 0) playlistEntryDur = 10;
+  unsigned long elapsed = millis() - presetCycledTime;
+  if (elapsed <= 100*playlistEntryDur) {
+    if (!playlistPrefetched && playlistIndex >= 0 && elapsed > min((unsigned long)PLAYLIST_PREFETCH_DELAY, 50UL*playlistEntryDur))
+      prefetchPlaylistEntry();
+    return;
   }
+  presetCycledTime = millis();
+  if (bri == 0 || nightlightActive) return;
+
+  ++playlistIndex %= playlistLen; // -1 at 1st run (limit to playlistLen)
+
+  if (!playlistRepeat && !playlistIndex) { //stop if repeat == 0 and restart of playlist
+    byte endPreset = playlistEndPreset;
+    DynamicJsonDocument* doc = playlistNext;
+    playlistNext = nullptr;
+    unloadPlaylist();
+    playlistNext = doc;
+    if (endPreset) applyPlaylistPreset(endPreset);
+    else invalidatePlaylistPrefetch();
+    return;
+  }
+  // playlist roll-over
+  if (!playlistIndex) {
+    if (playlistRepeat > 0) {// playlistRepeat < 0 => endless loop with shuffling presets
+      playlistRepeat--; // decrease repeat count on each index reset
+    } else if (!playlistShuffled) {
+      shufflePlaylist();  // shuffle playlist and start over
+    }
+    playlistShuffled = false;
+  }
+
+  jsonTransitionOnce = true;
+  transitionDelayTemp = playlistTr(playlistIndex) * 100;
+  playlistEntryDur = playlistDur(playlistIndex);
+  if (playlistEntryDur == 0) playlistEntryDur = 10;
+
+  applyPlaylistPreset(playlistPresets[playlistIndex]);
 }
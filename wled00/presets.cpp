@@ -7,6 +7,7 @@
 bool applyPreset(byte index)
 {
   if (index == 0) return false;
+  flushPresets();
   if (fileDoc) {
     errorFlag = readObjectFromFileUsingId("/presets.json", index, fileDoc) ? ERR_NONE : ERR_FS_PLOAD;
     JsonObject fdo = fileDoc->as<JsonObject>();
@@ -18,6 +19,7 @@ bool applyPreset(byte index)
   } else {
     DEBUGFS_PRINTLN(F("Make read buf"));
     DynamicJsonDocument fDoc(JSON_BUFFER_SIZE);
+    if (!fDoc.capacity()) heapAllocFailed(ALLOC_SITE_PRESET); //reading fails below
     errorFlag = readObjectFromFileUsingId("/presets.json", index, &fDoc) ? ERR_NONE : ERR_FS_PLOAD;
     JsonObject fdo = fDoc.as<JsonObject>();
     if (fdo["ps"] == index) fdo.remove("ps");
@@ -35,6 +37,19 @@ bool applyPreset(byte index)
   return false;
 }
 
+//applies a preset read ahead (playlist.cpp)
+bool applyPresetFrom(byte index, JsonDocument* doc)
+{
+  JsonObject fdo = doc->as<JsonObject>();
+  if (fdo["ps"] == index) fdo.remove("ps"); //remove load request for same presets to prevent recursive crash
+  errorFlag = ERR_NONE;
+  deserializeState(fdo);
+  if (errorFlag) return false;
+  currentPreset = index;
+  isPreset = true;
+  return true;
+}
+
 void savePreset(byte index, bool persist, const char* pname, JsonObject saveobj)
 {
   if (index == 0 || index > 250) return;
@@ -44,13 +59,16 @@ void savePreset(byte index, bool persist, const char* pname, JsonObject saveobj)
   if (!docAlloc) {
     DEBUGFS_PRINTLN(F("Allocating saving buffer"));
     DynamicJsonDocument lDoc(JSON_BUFFER_SIZE);
+    if (!lDoc.capacity()) {
+      heapAllocFailed(ALLOC_SITE_PRESET); return;
+    }
     sObj = lDoc.to<JsonObject>();
     if (pname) sObj["n"] = pname;
     DEBUGFS_PRINTLN(F("Save current state"));
     serializeState(sObj, true);
     currentPreset = index;
 
-    writeObjectToFileUsingId("/presets.json", index, &lDoc);
+    persistPreset(index, &lDoc);
   } else { //from JSON API
     DEBUGFS_PRINTLN(F("Reuse recv buffer"));
     sObj.remove(F("psave"));
@@ -67,15 +85,18 @@ void savePreset(byte index, bool persist, const char* pname, JsonObject saveobj)
     sObj.remove(F("error"));
     sObj.remove(F("time"));
 
-    writeObjectToFileUsingId("/presets.json", index, fileDoc);
+    persistPreset(index, fileDoc);
   }
+  invalidateFastBootState();
+  invalidatePlaylistPrefetch();
   presetsModifiedTime = now(); //unix time
   updateFSInfo();
 }
 
 void deletePreset(byte index) {
-  StaticJsonDocument<24> empty;
-  writeObjectToFileUsingId("/presets.json", index, &empty);
+  persistPreset(index, nullptr);
+  invalidateFastBootState();
+  invalidatePlaylistPrefetch();
   presetsModifiedTime = now(); //unix time
   updateFSInfo();
 }
\ No newline at end of file
@@ -0,0 +1,106 @@
+#include "wled.h"
+
+/*
+ * Optional dual core operation (ESP32 only, compile with -D WLED_ENABLE_RENDER_TASK)
+ * strip.service() runs in a task pinned to the core not used by loop(), so bursts of
+ * network traffic no longer delay frames. The main loop changes the segments, brightness and
+ * transition time through the strip functions as before, they are kept apart from what the render
+ * task draws with. Once per loop pass they are handed over in a lock-free snapshot, the requests
+ * that do not fit in one (trigger(), runtime resets) through a lock-free single producer/single
+ * consumer command queue (WS2812FX::publishSettings()). The render task adopts them before each
+ * frame and publishes its own state in a lock-free snapshot.
+ * What the render task draws into is only touched by the main loop while holding the strip lock
+ * (lockStrip()), which the render task holds while a frame is rendered and shown: to rebuild the
+ * busses and the LED map, to start realtime mode (the main loop writes the pixels then) and to set
+ * individual LEDs. It is never held around network or usermod handlers.
+ * Only the main loop (WLED::loop() and functions called from it) may send commands.
+ */
+
+#ifdef WLED_ENABLE_RENDER_TASK
+
+#ifndef WLED_RENDER_TASK_CORE
+  #define WLED_RENDER_TASK_CORE 0 //loop() runs on core 1
+#endif
+#ifndef WLED_RENDER_TASK_PRIO
+  #define WLED_RENDER_TASK_PRIO 1
+#endif
+#define WLED_RENDER_TASK_STACK 8192
+#define RENDER_QUEUE_LEN 8
+
+typedef struct RenderCommand {
+  uint8_t type;
+  uint32_t arg;
+} render_command;
+
+static SpscQueue<RenderCommand, RENDER_QUEUE_LEN> renderQueue;
+static Snapshot<RenderState> renderSnapshot;
+static TaskHandle_t renderTask = nullptr;
+//recursive, as functions holding it call others that take it again
+static SemaphoreHandle_t stripMux = xSemaphoreCreateRecursiveMutex();
+
+static void renderTaskLoop(void* param)
+{
+  RenderState rs = {0};
+  for (;;) {
+    lockStrip();
+    //while realtime data is received, the main loop writes to the busses directly
+    bool output = !(realtimeMode && !realtimeOverride);
+    strip.adoptSettings(output); //before the commands, which may refer to a segment changed with them
+    RenderCommand cmd;
+    while (renderQueue.pop(cmd)) {
+      rs.cmdsDone++;
+      strip.runCommand(cmd.type, cmd.arg);
+    }
+
+    if (output) {
+      uint32_t lastShow = strip.getLastShow();
+      if (!offMode) strip.service();
+      strip.flushShow();
+      if (strip.getLastShow() != lastShow) rs.frames++;
+    }
+    unlockStrip();
+
+    rs.lastShow = strip.getLastShow();
+    rs.fps = strip.getFps();
+    rs.milliamps = strip.currentMilliamps;
+    renderSnapshot.write(rs);
+
+    vTaskDelay(1); //let the idle task on this core run (task watchdog)
+  }
+}
+
+void initRenderTask()
+{
+  if (renderTask) return;
+  strip.publishSettings(); //what setup() applied, the commands follow once the task runs
+  xTaskCreatePinnedToCore(renderTaskLoop, "render", WLED_RENDER_TASK_STACK, nullptr, WLED_RENDER_TASK_PRIO, &renderTask, WLED_RENDER_TASK_CORE);
+  DEBUG_PRINT(F("Render task on core "));
+  DEBUG_PRINTLN(WLED_RENDER_TASK_CORE);
+}
+
+//queue a command for the render task, returns false if the queue is full
+bool renderCommand(uint8_t type, uint32_t arg)
+{
+  if (!renderTask) return false;
+  RenderCommand cmd = {type, arg};
+  return renderQueue.push(cmd);
+}
+
+bool getRenderState(RenderState& rs)
+{
+  if (!renderTask) return false;
+  return renderSnapshot.read(rs);
+}
+
+//waits until the render task is done with the current frame (at most one frame), keep the section short
+void lockStrip()
+{
+  xSemaphoreTakeRecursive(stripMux, portMAX_DELAY);
+}
+
+void unlockStrip()
+{
+  xSemaphoreGiveRecursive(stripMux);
+}
+
+#endif
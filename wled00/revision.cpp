@@ -0,0 +1,261 @@
+#include "wled.h"
+
+/*
+ * State revisions and change subscriptions
+ * stateRevision increases with every change of the JSON state. Changes are found by comparing
+ * checksums of the state field groups (STATE_FIELD_*), so no code that changes the state needs to know about it.
+ * The fields changed by the last revisions are kept, so clients can ask for the changes since a revision they know:
+ * - websocket: {"sub":N} subscribes to state deltas after revision N (0 for the full state first), {"sub":false} ends it.
+ *   Subscribers no longer receive the full state and info broadcast.
+ * - HTTP long-poll: GET /json/state?since=N responds as soon as the state differs from revision N, or after 25 s.
+ * Deltas contain the changed field groups and "rev". Usermod state is not tracked.
+ */
+
+#define STATE_REV_HISTORY     16    //revisions a delta can be built for
+#define STATE_CHECK_INTERVAL  100   //ms, also catches changes made without colorUpdated()
+#define LONGPOLL_MAX          4
+#define LONGPOLL_TIMEOUT      25000
+#define WS_MAX_SUBSCRIBERS    8
+
+typedef struct LongPoll {
+  AsyncWebServerRequest* request; //nullptr if slot free or client disconnected
+  uint32_t since;
+  uint32_t start;
+} long_poll;
+
+typedef struct WsSubscriber {
+  uint32_t client; //0 if slot free
+  uint32_t rev;    //last revision sent
+} ws_subscriber;
+
+static uint8_t revMasks[STATE_REV_HISTORY]; //changed fields of the last revisions, indexed by revision
+static uint8_t revCount = 0;                //valid entries
+static uint32_t groupSums[6];
+static uint32_t lastStateCheck = 0;
+static LongPoll longPolls[LONGPOLL_MAX];
+static WsSubscriber wsSubscribers[WS_MAX_SUBSCRIBERS];
+
+#ifdef ARDUINO_ARCH_ESP32
+//long-polls are added by the async TCP task, recursive like in cmdqueue.cpp
+static SemaphoreHandle_t revisionMux = xSemaphoreCreateRecursiveMutex();
+#define REV_LOCK   xSemaphoreTakeRecursive(revisionMux, portMAX_DELAY)
+#define REV_UNLOCK xSemaphoreGiveRecursive(revisionMux)
+#else
+#define REV_LOCK
+#define REV_UNLOCK
+#endif
+
+//FNV-1a
+static uint32_t checksum(uint32_t h, const void* data, size_t len)
+{
+  const uint8_t* b = (const uint8_t*)data;
+  for (size_t i = 0; i < len; i++) h = (h ^ b[i]) * 16777619;
+  return h;
+}
+#define CHECKSUM(h, v) h = checksum(h, &(v), sizeof(v))
+
+static void stateChecksums(uint32_t* sums)
+{
+  for (uint8_t g = 0; g < 6; g++) sums[g] = 2166136261;
+  CHECKSUM(sums[0], bri); CHECKSUM(sums[0], briLast); CHECKSUM(sums[0], transitionDelay);
+  CHECKSUM(sums[1], currentPreset); CHECKSUM(sums[1], presetCyclingEnabled); CHECKSUM(sums[1], errorFlag);
+  CHECKSUM(sums[1], presetCycleMin); CHECKSUM(sums[1], presetCycleMax); CHECKSUM(sums[1], presetCycleTime);
+  CHECKSUM(sums[2], nightlightActive); CHECKSUM(sums[2], nightlightDelayMins);
+  CHECKSUM(sums[2], nightlightMode); CHECKSUM(sums[2], nightlightTargetBri);
+  CHECKSUM(sums[3], notifyDirect); CHECKSUM(sums[3], receiveNotifications);
+  CHECKSUM(sums[4], realtimeOverride);
+  CHECKSUM(sums[5], strip.mainSegment); CHECKSUM(sums[5], col); CHECKSUM(sums[5], colSec); //main segment colors are sent from col[]
+  for (uint8_t s = 0; s < strip.getMaxSegments(); s++) {
+    WS2812FX::Segment& seg = strip.getSegment(s);
+    CHECKSUM(sums[5], seg.start); CHECKSUM(sums[5], seg.stop); CHECKSUM(sums[5], seg.speed);
+    CHECKSUM(sums[5], seg.intensity); CHECKSUM(sums[5], seg.palette); CHECKSUM(sums[5], seg.mode);
+    CHECKSUM(sums[5], seg.options); CHECKSUM(sums[5], seg.grouping); CHECKSUM(sums[5], seg.spacing);
+    CHECKSUM(sums[5], seg.opacity); CHECKSUM(sums[5], seg.colors); CHECKSUM(sums[5], seg.blendMode);
+  }
+}
+
+//fields changed after revision "since", STATE_FIELD_ALL if unknown
+static uint8_t changedSince(uint32_t since)
+{
+  uint32_t behind = stateRevision - since;
+  if (behind == 0) return 0;
+  if (behind > revCount) return STATE_FIELD_ALL; //too old, from the future or from a previous boot
+  uint8_t mask = 0;
+  for (uint32_t r = since + 1; r != stateRevision + 1; r++) mask |= revMasks[r % STATE_REV_HISTORY];
+  return mask;
+}
+
+//serializes only the given field groups of the state
+void serializeStateDelta(JsonObject root, uint8_t fields)
+{
+  serializeState(root);
+  if (!(fields & STATE_FIELD_BRI))  { root.remove("on"); root.remove("bri"); root.remove(F("transition")); }
+  if (!(fields & STATE_FIELD_PS))   { root.remove(F("ps")); root.remove(F("pl")); root.remove("ccnf"); root.remove(F("error")); }
+  if (!(fields & STATE_FIELD_NL))   root.remove("nl");
+  if (!(fields & STATE_FIELD_UDPN)) root.remove("udpn");
+  if (!(fields & STATE_FIELD_LOR))  root.remove(F("lor"));
+  if (!(fields & STATE_FIELD_SEG))  { root.remove(F("mainseg")); root.remove("seg"); }
+}
+
+static void sendStateDelta(AsyncWebServerRequest* request, uint8_t fields)
+{
+  AsyncJsonResponse* response = new AsyncJsonResponse(JSON_BUFFER_SIZE);
+  if (response->getRoot().isNull()) {
+    heapAllocFailed(ALLOC_SITE_JSON);
+    delete response;
+    request->send(503, "application/json", F("{\"error\":\"Out of memory\"}"));
+    return;
+  }
+  serializeStateDelta(response->getRoot(), fields);
+  response->setLength();
+  request->send(response);
+}
+
+static void cancelLongPoll(AsyncWebServerRequest* request)
+{
+  REV_LOCK;
+  for (uint8_t i = 0; i < LONGPOLL_MAX; i++) {
+    if (longPolls[i].request == request) longPolls[i].request = nullptr;
+  }
+  REV_UNLOCK;
+}
+
+//GET /json/state?since=N
+void serveStateSince(AsyncWebServerRequest* request, uint32_t since)
+{
+  REV_LOCK;
+  uint8_t fields = changedSince(since);
+  if (fields) {
+    sendStateDelta(request, fields);
+    REV_UNLOCK;
+    return;
+  }
+  for (uint8_t i = 0; i < LONGPOLL_MAX; i++) {
+    if (longPolls[i].request) continue;
+    request->onDisconnect([request]() { cancelLongPoll(request); });
+    longPolls[i].request = request;
+    longPolls[i].since = since;
+    longPolls[i].start = millis();
+    REV_UNLOCK;
+    return; //responded by handleStateRevision()
+  }
+  REV_UNLOCK;
+  request->send(503, "application/json", F("{\"error\":\"Busy\"}"));
+}
+
+//{"sub":N} or {"sub":false} received from a websocket client
+void subscribeStateWs(uint32_t client, JsonVariant sub)
+{
+  WsSubscriber* slot = nullptr;
+  for (uint8_t i = 0; i < WS_MAX_SUBSCRIBERS; i++) {
+    if (wsSubscribers[i].client == client) {
+      if (sub.is<bool>() && !sub.as<bool>()) wsSubscribers[i].client = 0;
+      else wsSubscribers[i].rev = sub;
+      return;
+    }
+    if (!slot && !wsSubscribers[i].client) slot = &wsSubscribers[i];
+  }
+  if (!slot || (sub.is<bool>() && !sub.as<bool>())) return;
+  slot->client = client;
+  slot->rev = sub;
+}
+
+bool isStateSubscriber(uint32_t client)
+{
+  for (uint8_t i = 0; i < WS_MAX_SUBSCRIBERS; i++) {
+    if (client && wsSubscribers[i].client == client) return true;
+  }
+  return false;
+}
+
+bool hasStateSubscribers()
+{
+  for (uint8_t i = 0; i < WS_MAX_SUBSCRIBERS; i++) {
+    if (wsSubscribers[i].client) return true;
+  }
+  return false;
+}
+
+#ifdef WLED_ENABLE_WEBSOCKETS
+//one serialization per distinct set of changed fields, usually all subscribers are up to date with the same revision
+static void sendWsDeltas()
+{
+  AsyncWebSocketMessageBuffer* buffer = nullptr;
+  uint8_t bufferFields = 0;
+  for (uint8_t i = 0; i < WS_MAX_SUBSCRIBERS; i++) {
+    WsSubscriber& sub = wsSubscribers[i];
+    if (!sub.client || sub.rev == stateRevision) continue;
+    AsyncWebSocketClient* client = ws.client(sub.client);
+    if (!client) {
+      sub.client = 0; continue;
+    }
+    if (client->queueLength() > 0) continue; //try later, the delta then includes the following changes
+
+    uint8_t fields = changedSince(sub.rev);
+    if (!buffer || fields != bufferFields) {
+      DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+      if (!doc.capacity()) {
+        heapAllocFailed(ALLOC_SITE_JSON); return;
+      }
+      serializeStateDelta(doc.createNestedObject("state"), fields);
+      size_t len = measureJson(doc);
+      buffer = ws.makeBuffer(len);
+      if (!buffer) { //out of memory
+        heapAllocFailed(ALLOC_SITE_WS); return;
+      }
+      serializeJson(doc, (char *)buffer->get(), len +1);
+      bufferFields = fields;
+    }
+    client->text(buffer);
+    sub.rev = stateRevision;
+  }
+}
+#endif
+
+//called once per loop()
+void handleStateRevision()
+{
+  uint32_t now = millis();
+  if (stateCheckRequested || now - lastStateCheck > STATE_CHECK_INTERVAL) {
+    stateCheckRequested = false;
+    lastStateCheck = now;
+
+    uint32_t sums[6];
+    stateChecksums(sums);
+    if (!stateRevision) { //first run, a random start keeps revisions of a previous boot from matching
+      #ifdef ARDUINO_ARCH_ESP32
+      stateRevision = esp_random() >> 1 | 1;
+      #else
+      stateRevision = RANDOM_REG32 >> 1 | 1;
+      #endif
+      memcpy(groupSums, sums, sizeof(groupSums));
+    }
+    uint8_t fields = 0;
+    for (uint8_t g = 0; g < 6; g++) {
+      if (sums[g] != groupSums[g]) fields |= 1 << g;
+    }
+    if (fields) {
+      memcpy(groupSums, sums, sizeof(groupSums));
+      REV_LOCK;
+      stateRevision++;
+      revMasks[stateRevision % STATE_REV_HISTORY] = fields;
+      if (revCount < STATE_REV_HISTORY) revCount++;
+      REV_UNLOCK;
+    }
+  }
+
+  #ifdef WLED_ENABLE_WEBSOCKETS
+  sendWsDeltas();
+  #endif
+
+  REV_LOCK;
+  for (uint8_t i = 0; i < LONGPOLL_MAX; i++) {
+    LongPoll& lp = longPolls[i];
+    if (!lp.request) continue;
+    uint8_t fields = changedSince(lp.since);
+    if (!fields && now - lp.start < LONGPOLL_TIMEOUT) continue;
+    sendStateDelta(lp.request, fields); //on timeout only "rev"
+    lp.request = nullptr;
+  }
+  REV_UNLOCK;
+}
@@ -346,10 +346,8 @@ void handleSettingsSet(AsyncWebServerRequest *request, byte subPage)
   {
     if (request->hasArg(F("RS"))) //complete factory reset
     {
-      WLED_FS.format();
-      clearEEPROM();
       serveMessage(request, 200, F("All Settings erased."), F("Connect to WLED-AP to setup again"),255);
-      doReboot = true;
+      doFactoryReset = true;
     }
 
     bool pwdCorrect = !otaLock; //always allow access if ota not locked
@@ -399,10 +397,11 @@ void handleSettingsSet(AsyncWebServerRequest *request, byte subPage)
       t = request->arg(argname).toInt();
       DMXFixtureMap[i] = t;
     }
+    doInitDMX = true; //handleDMX() re-inits in the loop, it may be building a frame right now
   }
   #endif
 
-  if (subPage != 2 && (subPage != 6 || !doReboot)) serializeConfig(); //do not save if factory reset or LED settings (which are saved after LED re-init)
+  if (subPage != 2 && (subPage != 6 || !(doReboot || doFactoryReset))) persistConfig(); //do not save if factory reset or LED settings (which are saved after LED re-init)
   if (subPage == 4) alexaInit();
 }
 
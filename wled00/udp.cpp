@@ -22,7 +22,7 @@ void notify(byte callMode, bool followUp)
     case NOTIFIER_CALL_MODE_ALEXA:         if (!notifyAlexa)  return; break;
     default: return;
   }
-  byte udpOut[WLEDPACKETSIZE];
+  byte udpOut[WLEDPACKETSIZE + UDP_SEG_HEADER + MAX_NUM_SEGMENTS*UDP_SEG_SIZE];
   udpOut[0] = 0; //0: wled notifier protocol 1: WARLS protocol
   udpOut[1] = callMode;
   udpOut[2] = bri;
@@ -37,8 +37,8 @@ void notify(byte callMode, bool followUp)
   //compatibilityVersionByte: 
   //0: old 1: supports white 2: supports secondary color
   //3: supports FX intensity, 24 byte packet 4: supports transitionDelay 5: sup palette
-  //6: supports timebase syncing, 29 byte packet 7: supports tertiary color 
-  udpOut[11] = 7; 
+  //6: supports timebase syncing, 29 byte packet 7: supports tertiary color 8: segment records
+  udpOut[11] = 8; 
   udpOut[12] = colSec[0];
   udpOut[13] = colSec[1];
   udpOut[14] = colSec[2];
@@ -59,12 +59,14 @@ void notify(byte callMode, bool followUp)
   udpOut[26] = (t >> 16) & 0xFF;
   udpOut[27] = (t >>  8) & 0xFF;
   udpOut[28] = (t >>  0) & 0xFF;
+
+  uint16_t packetSize = WLEDPACKETSIZE + packSegments(udpOut + WLEDPACKETSIZE);
   
   IPAddress broadcastIp;
   broadcastIp = ~uint32_t(Network.subnetMask()) | uint32_t(Network.gatewayIP());
 
   notifierUdp.beginPacket(broadcastIp, udpPort);
-  notifierUdp.write(udpOut, WLEDPACKETSIZE);
+  notifierUdp.write(udpOut, packetSize);
   notifierUdp.endPacket();
   notificationSentCallMode = callMode;
   notificationSentTime = millis();
@@ -74,11 +76,16 @@ void notify(byte callMode, bool followUp)
 
 void realtimeLock(uint32_t timeoutMs, byte md)
 {
-  if (!realtimeMode && !realtimeOverride){
-    for (uint16_t i = 0; i < ledCount; i++)
-    {
-      strip.setPixelColor(i,0,0,0,0);
+  if (!realtimeMode) {
+    lockStrip(); //the render task finishes its frame and no longer draws, from here on the pixels are written directly
+    if (!realtimeOverride) {
+      for (uint16_t i = 0; i < ledCount; i++)
+      {
+        strip.setPixelColor(i,0,0,0,0);
+      }
     }
+    realtimeMode = md;
+    unlockStrip();
   }
 
   realtimeTimeout = millis() + timeoutMs;
@@ -156,8 +163,6 @@ void handleNotifications()
     } 
   }
 
-  if (!(receiveNotifications || receiveDirect)) return;
-  
   //notifier and UDP realtime
   if (!packetSize || packetSize > UDP_IN_MAXSIZE) return;
   if (!isSupp && notifierUdp.remoteIP() == Network.localIP()) return; //don't process broadcasts we send ourselves
@@ -171,41 +176,50 @@ void handleNotifications()
   if (isSupp && udpIn[0] == 255 && udpIn[1] == 1 && len >= 40) {
     if (!nodeListEnabled || notifier2Udp.remoteIP() == Network.localIP()) return;
 
-    uint8_t unit = udpIn[39];
-    NodesMap::iterator it = Nodes.find(unit);
-    if (it == Nodes.end() && Nodes.size() < WLED_MAX_NODES) { // Create a new element when not present
-      Nodes[unit].age = 0;
-      it = Nodes.find(unit);
-    }
-
-    if (it != Nodes.end()) {
-      for (byte x = 0; x < 4; x++) {
-        it->second.ip[x] = udpIn[x + 2];
-      }
-      it->second.age = 0; // reset 'age counter'
-      char tmpNodeName[33] = { 0 };
-      memcpy(&tmpNodeName[0], reinterpret_cast<byte *>(&udpIn[6]), 32);
-      tmpNodeName[32]     = 0;
-      it->second.nodeName = tmpNodeName;
-      it->second.nodeName.trim();
-      it->second.nodeType = udpIn[38];
+    uint32_t ip = udpIn[2] | (udpIn[3] << 8) | (udpIn[4] << 16) | ((uint32_t)udpIn[5] << 24); //IPAddress raw format
+    NodeStruct* node = Nodes.insert(ip);
+    if (node) {
+      node->lastSeen = millis();
+      memcpy(node->nodeName, &udpIn[6], 32);
+      node->nodeName[32] = 0;
+      for (int8_t i = 31; i >= 0 && (node->nodeName[i] == ' ' || node->nodeName[i] == 0); i--) node->nodeName[i] = 0; //trim
+      node->nodeType = udpIn[38];
       uint32_t build = 0;
       if (len >= 44)
         for (byte i=0; i<sizeof(uint32_t); i++)
           build |= udpIn[40+i]<<(8*i);
-      it->second.build = build;
+      node->build = build;
     }
     return;
   }
 
+  // node list query, answered directly to the asking node
+  if (isSupp && udpIn[0] == 255 && udpIn[1] == 2) {
+    static QueryRateLimit<WLED_NODE_QUERY_LIMIT_SLOTS> queryLimit; //a flood of queries must not saturate the network
+    IPAddress from = notifier2Udp.remoteIP();
+    if (!nodeBroadcastEnabled || from == Network.localIP() || !queryLimit.allow((uint32_t)from, millis(), WLED_NODE_QUERY_INTERVAL)) return;
+    sendSysInfoUDP(from);
+    return;
+  }
+
+  if (isSupp && handleClockSyncPacket(udpIn, len)) return;
+
+  if (!(receiveNotifications || receiveDirect)) return;
+
   //wled notifier, ignore if realtime packets active
   if (udpIn[0] == 0 && !realtimeMode && receiveNotifications)
   {
     //ignore notification if received within a second after sending a notification ourselves
     if (millis() - notificationSentTime < 1000) return;
     if (udpIn[1] > 199) return; //do not receive custom versions
+    if (udpIn[11] > 5) clockSyncSource(notifierUdp.remoteIP()); //sender supports timebase syncing
     
     bool someSel = (receiveNotificationBrightness || receiveNotificationColor || receiveNotificationEffects);
+
+    //segment layout first, the header values below apply to the (new) main segment
+    if (udpIn[11] > 7 && receiveNotificationSegments && len > WLEDPACKETSIZE) {
+      applySegments(udpIn + WLEDPACKETSIZE, len - WLEDPACKETSIZE, receiveNotificationColor || !someSel, receiveNotificationEffects || !someSel);
+    }
     //apply colors from notification
     if (receiveNotificationColor || !someSel)
     {
@@ -222,7 +236,7 @@ void handleNotifications()
           colSec[2] = udpIn[14];
           colSec[3] = udpIn[15];
         }
-        if (udpIn[11] > 5)
+        if (udpIn[11] > 5 && !clockSyncLocked()) //clock sync is more accurate
         {
           uint32_t t = (udpIn[25] << 24) | (udpIn[26] << 16) | (udpIn[27] << 8) | (udpIn[28]);
           t += 2;
@@ -392,31 +406,17 @@ void setRealtimePixel(uint16_t i, byte r, byte g, byte b, byte w)
 }
 
 /*********************************************************************************************\
-   Refresh aging for remote units, drop if too old...
+   Drop remote units that did not announce themselves for too long
 \*********************************************************************************************/
 void refreshNodeList()
 {
-  for (NodesMap::iterator it = Nodes.begin(); it != Nodes.end();) {
-    bool mustRemove = true;
-
-    if (it->second.ip[0] != 0) {
-      if (it->second.age < 10) {
-        it->second.age++;
-        mustRemove = false;
-        ++it;
-      }
-    }
-
-    if (mustRemove) {
-      it = Nodes.erase(it);
-    }
-  }
+  Nodes.expire(millis(), WLED_NODE_MAX_AGE);
 }
 
 /*********************************************************************************************\
-   Broadcast system info to other nodes. (to update node lists)
+   Broadcast system info to other nodes (to update node lists), or send it to a single node
 \*********************************************************************************************/
-void sendSysInfoUDP()
+void sendSysInfoUDP(IPAddress to)
 {
   if (!udp2Connected) return;
 
@@ -454,6 +454,18 @@ void sendSysInfoUDP()
   for (byte i=0; i<sizeof(uint32_t); i++)
     data[40+i] = (build>>(8*i)) & 0xFF;
 
+  notifier2Udp.beginPacket(to, udpPort2);
+  notifier2Udp.write(data, sizeof(data));
+  notifier2Udp.endPacket();
+}
+
+/*********************************************************************************************\
+   Ask all other nodes to announce themselves
+\*********************************************************************************************/
+void sendNodeQueryUDP()
+{
+  if (!udp2Connected || !nodeListEnabled) return;
+  uint8_t data[2] = {255, 2};
   IPAddress broadcastIP(255, 255, 255, 255);
   notifier2Udp.beginPacket(broadcastIP, udpPort2);
   notifier2Udp.write(data, sizeof(data));
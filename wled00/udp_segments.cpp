@@ -0,0 +1,85 @@
+#include "wled.h"
+
+/*
+ * Segment records appended to the UDP sync notifier packet (version 8):
+ * byte 29: number of records, 30: record size, 31: main segment id, followed by the records.
+ * Receivers skip unknown trailing bytes of larger records, so fields may be added at the end.
+ */
+#define UDP_SEG_OPTION_MASK ((1 << SEG_OPTION_SELECTED) | (1 << SEG_OPTION_REVERSED) | (1 << SEG_OPTION_ON) | (1 << SEG_OPTION_MIRROR))
+
+//writes all active segments, returns the number of bytes used
+uint16_t packSegments(byte* buf)
+{
+  byte n = 0;
+  byte* rec = buf + UDP_SEG_HEADER;
+  for (byte id = 0; id < strip.getMaxSegments(); id++) {
+    WS2812FX::Segment& seg = strip.getSegment(id);
+    if (!seg.isActive()) continue;
+    rec[0]  = id;
+    rec[1]  = seg.start >> 8; rec[2] = seg.start & 0xFF;
+    rec[3]  = seg.stop  >> 8; rec[4] = seg.stop  & 0xFF;
+    rec[5]  = seg.grouping;
+    rec[6]  = seg.spacing;
+    rec[7]  = seg.opacity;
+    rec[8]  = seg.options & UDP_SEG_OPTION_MASK;
+    rec[9]  = seg.mode;
+    rec[10] = seg.speed;
+    rec[11] = seg.intensity;
+    rec[12] = seg.palette;
+    rec[13] = seg.blendMode;
+    for (byte c = 0; c < 3; c++) { //WRGB
+      rec[14 + c*4] = seg.colors[c] >> 24; rec[15 + c*4] = seg.colors[c] >> 16;
+      rec[16 + c*4] = seg.colors[c] >>  8; rec[17 + c*4] = seg.colors[c];
+    }
+    rec += UDP_SEG_SIZE;
+    n++;
+  }
+  buf[0] = n;
+  buf[1] = UDP_SEG_SIZE;
+  buf[2] = strip.getMainSegmentId();
+  return UDP_SEG_HEADER + n * UDP_SEG_SIZE;
+}
+
+/*
+ * Mirrors the sender's segments, segments not contained in the packet are removed.
+ * Colors and effect of the main segment are applied from the packet header by the caller.
+ */
+void applySegments(const byte* buf, uint16_t len, bool applyColors, bool applyEffects)
+{
+  if (len < UDP_SEG_HEADER) return;
+  byte n = buf[0], recLen = buf[1];
+  if (recLen < UDP_SEG_SIZE || len < UDP_SEG_HEADER + n * recLen) return;
+
+  bool received[MAX_NUM_SEGMENTS] = {false};
+  const byte* rec = buf + UDP_SEG_HEADER;
+  for (byte i = 0; i < n; i++, rec += recLen) {
+    byte id = rec[0];
+    if (id >= strip.getMaxSegments()) continue;
+    uint16_t start = (rec[1] << 8) | rec[2];
+    uint16_t stop  = (rec[3] << 8) | rec[4];
+    strip.setSegment(id, start, stop, rec[5], rec[6]);
+    WS2812FX::Segment& seg = strip.getSegment(id);
+    if (!seg.isActive()) continue;
+    received[id] = true;
+    seg.options = (seg.options & ~UDP_SEG_OPTION_MASK) | (rec[8] & UDP_SEG_OPTION_MASK);
+    seg.setOpacity(rec[7], id);
+    if (rec[13] < BLEND_MODE_COUNT) seg.blendMode = rec[13];
+    if (id == buf[2]) continue;
+    if (applyColors) {
+      for (byte c = 0; c < 3; c++) {
+        const byte* col = rec + 14 + c*4;
+        seg.setColor(c, ((uint32_t)col[0] << 24) | ((uint32_t)col[1] << 16) | (col[2] << 8) | col[3], id);
+      }
+    }
+    if (applyEffects) {
+      if (rec[9] != seg.mode && rec[9] < strip.getModeCount()) strip.setMode(id, rec[9]);
+      seg.speed = rec[10];
+      seg.intensity = rec[11];
+      if (rec[12] < strip.getPaletteCount()) seg.palette = rec[12];
+    }
+  }
+  for (byte id = 0; id < strip.getMaxSegments(); id++) {
+    if (!received[id] && strip.getSegment(id).isActive() && id != buf[2]) strip.setSegment(id, 0, 0);
+  }
+  if (buf[2] < strip.getMaxSegments() && received[buf[2]]) strip.mainSegment = buf[2];
+}
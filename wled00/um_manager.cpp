@@ -4,17 +4,51 @@
  */
 
 //Usermod Manager internals
-void UsermodManager::loop()      { for (byte i = 0; i < numMods; i++) ums[i]->loop();  }
+/*
+ * Usermods with a loop interval are only called once it elapsed, so they do not have to poll millis() themselves.
+ * The execution time of each loop() is accounted like the render timing (min/avg/max per RENDER_TIMING_WINDOW)
+ * and reported in /json/info "umt", so a usermod that blocks the main loop (e.g. a sensor read) can be found.
+ */
+void UsermodManager::loop()
+{
+  unsigned long now = millis();
+  for (byte i = 0; i < numMods; i++) {
+    uint16_t interval = ums[i]->getLoopInterval();
+    if (interval && now - lastLoop[i] < interval) continue;
+    lastLoop[i] = now; //also without an interval, it may get one
+    unsigned long start = micros();
+    ums[i]->loop();
+    loopTiming[i].add(micros() - start);
+  }
+  if (now - lastTimingPublish > RENDER_TIMING_WINDOW) {
+    lastTimingPublish = now;
+    for (byte i = 0; i < numMods; i++) loopTiming[i].publish();
+  }
+}
 
 void UsermodManager::setup()     { for (byte i = 0; i < numMods; i++) ums[i]->setup(); }
 void UsermodManager::connected() { for (byte i = 0; i < numMods; i++) ums[i]->connected(); }
+void UsermodManager::addEffects() { for (byte i = 0; i < numMods; i++) ums[i]->addEffects(); }
 
 void UsermodManager::addToJsonState(JsonObject& obj)    { for (byte i = 0; i < numMods; i++) ums[i]->addToJsonState(obj); }
-void UsermodManager::addToJsonInfo(JsonObject& obj)     { for (byte i = 0; i < numMods; i++) ums[i]->addToJsonInfo(obj); }
 void UsermodManager::readFromJsonState(JsonObject& obj) { for (byte i = 0; i < numMods; i++) ums[i]->readFromJsonState(obj); }
 void UsermodManager::addToConfig(JsonObject& obj)       { for (byte i = 0; i < numMods; i++) ums[i]->addToConfig(obj); }
 void UsermodManager::readFromConfig(JsonObject& obj)    { for (byte i = 0; i < numMods; i++) ums[i]->readFromConfig(obj); }
 
+void UsermodManager::addToJsonInfo(JsonObject& obj)
+{
+  for (byte i = 0; i < numMods; i++) ums[i]->addToJsonInfo(obj);
+  if (!numMods) return;
+  JsonArray timing = obj.createNestedArray("umt");
+  for (byte i = 0; i < numMods; i++) {
+    JsonObject um = timing.createNestedObject();
+    um["id"] = ums[i]->getId();
+    um[F("iv")] = ums[i]->getLoopInterval();
+    JsonArray t = um.createNestedArray("t"); //us, min/avg/max
+    t.add(loopTiming[i].minUs); t.add(loopTiming[i].avgUs); t.add(loopTiming[i].maxUs);
+  }
+}
+
 /*
  * Enables usermods to lookup another Usermod.
  */
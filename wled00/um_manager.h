@@ -0,0 +1,73 @@
+#ifndef WLED_UM_MANAGER_H
+#define WLED_UM_MANAGER_H
+/*
+ * Usermod v2 interface and the manager calling the registered usermods (um_manager.cpp)
+ */
+
+class Usermod {
+  public:
+    virtual void loop() {}
+    virtual void setup() {}
+    virtual void connected() {}
+    virtual void addToJsonState(JsonObject& obj) {}
+    virtual void addToJsonInfo(JsonObject& obj) {}
+    virtual void readFromJsonState(JsonObject& obj) {}
+    virtual void addToConfig(JsonObject& obj) {}
+    virtual void readFromConfig(JsonObject& obj) {}
+    virtual uint16_t getId() {return USERMOD_ID_UNSPECIFIED;}
+    virtual uint16_t getLoopInterval() {return 0;} //ms between loop() calls, 0 to be called every main loop iteration
+    virtual void addEffects() {} //called before the strip is started, the place to call strip.addEffect()
+};
+
+class UsermodManager {
+  private:
+    Usermod* ums[WLED_MAX_USERMODS];
+    byte numMods = 0;
+    /*
+     * loop() execution time, accounted like WS2812FX::RenderTiming but in 32 bit,
+     * as a usermod that blocks the main loop may take longer than 65 ms
+     */
+    typedef struct LoopTiming {
+      uint32_t sum = 0;    //microseconds accumulated in the current window
+      uint32_t count = 0;
+      uint32_t winMin = UINT32_MAX, winMax = 0;
+      uint32_t minUs = 0, avgUs = 0, maxUs = 0; //results of the last completed window
+      void add(uint32_t us) {
+        sum += us; count++;
+        if (us < winMin) winMin = us;
+        if (us > winMax) winMax = us;
+      }
+      void publish() {
+        if (count) {
+          minUs = winMin; avgUs = sum / count; maxUs = winMax;
+        } else {
+          minUs = 0; avgUs = 0; maxUs = 0;
+        }
+        sum = 0; count = 0; winMin = UINT32_MAX; winMax = 0;
+      }
+    } loop_timing;
+
+    LoopTiming loopTiming[WLED_MAX_USERMODS];
+    unsigned long lastLoop[WLED_MAX_USERMODS] = {0};
+    unsigned long lastTimingPublish = 0;
+
+  public:
+    void loop();
+
+    void setup();
+    void connected();
+    void addEffects();
+
+    void addToJsonState(JsonObject& obj);
+    void addToJsonInfo(JsonObject& obj);
+    void readFromJsonState(JsonObject& obj);
+
+    void addToConfig(JsonObject& obj);
+    void readFromConfig(JsonObject& obj);
+
+    bool add(Usermod* um);
+    Usermod* lookup(uint16_t mod_id);
+    byte getModCount();
+};
+
+#endif
@@ -12,8 +12,6 @@ class UsermodPirSensor : public Usermod
 {
 private:
   // *********** PRIVATE VARIABLES ***********
-  uint32_t previousCheckTime;
-  uint32_t currentCheckTime;
   bool currentPinState;
   bool keepMovementFlag;
   bool checkAnywaysFlag;
@@ -38,9 +36,7 @@ private:
 #endif
 
 public:
-  UsermodPirSensor() : previousCheckTime(0),
-                       currentCheckTime(0),
-                       currentPinState(LOW),
+  UsermodPirSensor() : currentPinState(LOW),
                        keepMovementFlag(false),
                        checkAnywaysFlag(false),
                        keepMovementCounter(0),
@@ -65,24 +61,14 @@ public:
     if (motionSensingGlobal)
     {
       // Serial.println("motionSensingGlobal=true");
-      checkPirSensorPeriodically();
+      checkSensorState();
     }
   }
 
-  // check pir sensor state and apply preset
-  void checkPirSensorPeriodically()
+  // check pir sensor state every checkFrequencyMs
+  uint16_t getLoopInterval()
   {
-
-    currentCheckTime = millis();
-    if (currentCheckTime - previousCheckTime > checkFrequencyMs)
-    {
-      previousCheckTime = currentCheckTime;
-      checkSensorState();
-    }
-    else
-    {
-      // no need to check, not enough time passed
-    }
+    return checkFrequencyMs;
   }
 
   void checkSensorState()
@@ -28,6 +28,10 @@
 #include "../usermods/usermod_v2_mode_sort/usermod_v2_mode_sort.h"
 #endif
 
+#ifdef USERMOD_CUSTOM_EFFECT
+#include "../usermods/usermod_v2_custom_effect/usermod_v2_custom_effect.h"
+#endif
+
 // BME280 v2 usermod. Define "USERMOD_BME280" in my_config.h
 #ifdef USERMOD_BME280
 #include "../usermods/BME280_v2/usermod_bme280.h"
@@ -89,4 +93,8 @@ void registerUsermods()
 #ifdef USERMOD_DHT
 usermods.add(new UsermodDHT());
 #endif
+
+#ifdef USERMOD_CUSTOM_EFFECT
+  usermods.add(new CustomEffectUsermod());
+#endif
 }
\ No newline at end of file
@@ -76,6 +76,8 @@ ethernet_settings ethernetBoards[] = {
 // turns all LEDs off and restarts ESP
 void WLED::reset()
 {
+  flushPersistence();
+  commitFileOp();
   briT = 0;
   #ifdef WLED_ENABLE_WEBSOCKETS
   ws.closeAll(1012);
@@ -175,8 +177,15 @@ void WLED::loop()
   handleIR();        // 2nd call to function needed for ESP32 to return valid results -- should be good for ESP8266, too
   handleConnection();
   handleSerial();
+#ifdef WLED_ENABLE_RENDER_TASK
+  handleE131();
+#endif
   handleNotifications();
+  handleClockSync();
+  handleCommandQueue();
+  handleHeapTelemetry();
   handleTransitions();
+  handleStateRevision();
 #ifdef WLED_ENABLE_DMX
   handleDMX();
 #endif
@@ -192,12 +201,20 @@ void WLED::loop()
   handleOverlays();
   yield();
 
+  if (doFactoryReset) {
+    doFactoryReset = false;
+    clearPersistence();
+    WLED_FS.format();
+    clearEEPROM();
+    doReboot = true;
+  }
   if (doReboot)
     reset();
   if (doCloseFile) {
     closeFile();
     yield();
   }
+  handlePersistence();
 
   if (!realtimeMode || realtimeOverride)  // block stuff if WARLS/Adalight is enabled
   {
@@ -216,13 +233,24 @@ void WLED::loop()
 
     yield();
 
+#ifndef WLED_ENABLE_RENDER_TASK
     if (!offMode)
       strip.service();
 #ifdef ESP8266
     else if (!noWifiSleep)
       delay(1); //required to make sure ESP enters modem sleep (see #1184)
+#endif
 #endif
   }
+#ifdef WLED_ENABLE_RENDER_TASK
+  else
+#endif
+  {
+    strip.flushShow(); //frames held back by pipelined output (realtime, last frame before off)
+  }
+#ifdef WLED_ENABLE_RENDER_TASK
+  strip.publishSettings(); //what the handlers above changed, drawn with the next frame
+#endif
   yield();
 #ifdef ESP8266
   MDNS.update();
@@ -239,6 +267,7 @@ void WLED::loop()
   //This code block causes severe FPS drop on ESP32 with the original "if (busConfigs[0] != nullptr)" conditional. Investigate! 
   if (doInitBusses) {
     doInitBusses = false;
+    lockStrip();
     busses.removeAll();
     uint32_t mem = 0;
     strip.isRgbw = false;
@@ -251,8 +280,9 @@ void WLED::loop()
       delete busConfigs[i]; busConfigs[i] = nullptr;
     }
     strip.finalizeInit(ledCount, skipFirstLed);
+    unlockStrip();
     yield();
-    serializeConfig();
+    persistConfig();
   }
   
   yield();
@@ -285,8 +315,12 @@ void WLED::loop()
 
 void WLED::setup()
 {
-  Serial.begin(115200);
+  #ifdef WLED_ENABLE_ADALIGHT
+  Serial.setRxBufferSize(WLED_SERIAL_RX_BUFFER); //holds incoming frames while a frame is shown
+  #endif
+  Serial.begin(WLED_SERIAL_BAUD_RATE);
   Serial.setTimeout(50);
+  bootMark(PSTR("setup"));
   DEBUG_PRINTLN();
   DEBUG_PRINT("---WLED ");
   DEBUG_PRINT(versionString);
@@ -303,6 +337,7 @@ void WLED::setup()
   DEBUG_PRINT("heap ");
   DEBUG_PRINTLN(ESP.getFreeHeap());
   registerUsermods();
+  usermods.addEffects(); //effect IDs have to be known before presets are applied
 
   //DEBUG_PRINT(F("LEDs inited. heap usage ~"));
   //DEBUG_PRINTLN(heapPreAlloc - ESP.getFreeHeap());
@@ -321,9 +356,13 @@ void WLED::setup()
   if (!fsinit) {
     DEBUGFS_PRINTLN(F("FS failed!"));
     errorFlag = ERR_FS_BEGIN;
-  } else deEEP();
-  updateFSInfo();
+  } else {
+    recoverFiles();
+    deEEP();
+  }
+  bootMark(PSTR("fs"));
   deserializeConfig();
+  bootMark(PSTR("cfg"));
 
 #if STATUSLED
   bool lStatusLed = false;
@@ -340,8 +379,10 @@ void WLED::setup()
   //DEBUG_PRINTLN(F("Load EEPROM"));
   //loadSettingsFromEEPROM();
   beginStrip();
+  bootMark(PSTR("strip"));
   userSetup();
   usermods.setup();
+  bootMark(PSTR("um"));
   if (strcmp(clientSSID, DEFAULT_CLIENT_SSID) == 0)
     showWelcomePage = true;
   WiFi.persistent(false);
@@ -370,6 +411,8 @@ void WLED::setup()
   }
 
   strip.service();
+  bootMark(PSTR("light"));
+  updateFSInfo(); //not needed for the first light
 
 #ifndef WLED_DISABLE_OTA
   if (aOtaEnabled) {
@@ -388,6 +431,10 @@ void WLED::setup()
 #endif
   // HTTP server page init
   initServer();
+#ifdef WLED_ENABLE_RENDER_TASK
+  initRenderTask();
+#endif
+  bootMark(PSTR("server"));
 }
 
 void WLED::beginStrip()
@@ -401,7 +448,10 @@ void WLED::beginStrip()
   strip.setBrightness(0);
   strip.setShowCallback(handleOverlayDraw);
 
-  if (bootPreset > 0) applyPreset(bootPreset);
+  if (bootPreset > 0 && !loadFastBootState()) {
+    currentPlaylist = -1; //tells if the preset started a playlist
+    if (applyPreset(bootPreset)) saveFastBootState();
+  }
   if (turnOnAtBoot) {
     if (briS > 0) bri = briS;
     else if (bri == 0) bri = 128;
@@ -545,7 +595,9 @@ void WLED::initInterfaces()
     ArduinoOTA.begin();
 #endif
 
+#ifndef WLED_ENABLE_RENDER_TASK
   strip.service();
+#endif
   // Set up mDNS responder:
   if (strlen(cmDNS) > 0) {
   #ifndef WLED_DISABLE_OTA
@@ -569,6 +621,9 @@ void WLED::initInterfaces()
     if (udpConnected && udpPort2 != udpPort && udpPort2 != udpRgbPort)
       udp2Connected = notifier2Udp.begin(udpPort2);
   }
+  //new IP, let the other nodes know right away and learn about them
+  if (nodeBroadcastEnabled) sendSysInfoUDP();
+  sendNodeQueryUDP();
   if (ntpEnabled)
     ntpConnected = ntpUdp.begin(ntpLocalPort);
 
@@ -643,6 +698,9 @@ void WLED::handleConnection()
     if (!apActive && millis() - lastReconnectAttempt > 12000 && (!wasConnected || apBehavior == AP_BEHAVIOR_NO_CONN))
       initAP();
   } else if (!interfacesInited) {        // newly connected
+    static bool firstConnect = true;
+    if (firstConnect) bootMark(PSTR("net"));
+    firstConnect = false;
     DEBUG_PRINTLN("");
     DEBUG_PRINT(F("Connected! IP address: "));
     DEBUG_PRINTLN(Network.localIP());
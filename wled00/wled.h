@@ -41,6 +41,11 @@
 
 #define WLED_ENABLE_FS_EDITOR      // enable /edit page for editing FS content. Will also be disabled with OTA lock
 
+//#define WLED_ENABLE_RENDER_TASK  // ESP32 only: run effects in their own task on the second core
+#if defined(WLED_ENABLE_RENDER_TASK) && defined(ESP8266)
+  #undef WLED_ENABLE_RENDER_TASK
+#endif
+
 // to toggle usb serial debug (un)comment the following line
 //#define WLED_DEBUG
 
@@ -110,6 +115,10 @@
 #include "src/dependencies/json/AsyncJson-v6.h"
 #include "src/dependencies/json/ArduinoJson-v6.h"
 
+#ifdef WLED_ENABLE_RENDER_TASK
+  #include "lockfree.h"
+#endif
+
 #include "fcn_declare.h"
 #include "html_ui.h"
 #include "html_settings.h"
@@ -227,6 +236,7 @@ WLED_GLOBAL bool noWifiSleep _INIT(false);                         // disabling
 WLED_GLOBAL uint16_t ledCount _INIT(30);          // overcurrent prevented by ABL
 WLED_GLOBAL bool turnOnAtBoot _INIT(true);        // turn on LEDs at power-up
 WLED_GLOBAL byte bootPreset   _INIT(0);           // save preset to load after power-up
+WLED_GLOBAL bool fastBoot     _INIT(false);       // cache the state of the boot preset for a faster first light
 
 WLED_GLOBAL byte col[]    _INIT_N(({ 255, 160, 0, 0 }));  // current RGB(W) primary color. col[] should be updated if you want to change the color.
 WLED_GLOBAL byte colSec[] _INIT_N(({ 0, 0, 0, 0 }));      // current RGB(W) secondary color
@@ -246,7 +256,7 @@ WLED_GLOBAL char serverDescription[33] _INIT("WLED");  // Name of module
 WLED_GLOBAL bool syncToggleReceive     _INIT(false);   // UIs which only have a single button for sync should toggle send+receive if this is true, only send otherwise
 
 // Sync CONFIG
-WLED_GLOBAL NodesMap Nodes;
+WLED_GLOBAL NodeTable Nodes _INIT_N(((WLED_NODE_TABLE_SIZE, WLED_MAX_NODES)));
 WLED_GLOBAL bool nodeListEnabled _INIT(true);
 WLED_GLOBAL bool nodeBroadcastEnabled _INIT(true);
 
@@ -255,11 +265,13 @@ WLED_GLOBAL byte irEnabled      _INIT(0);     // Infrared receiver
 
 WLED_GLOBAL uint16_t udpPort    _INIT(21324); // WLED notifier default port
 WLED_GLOBAL uint16_t udpPort2   _INIT(65506); // WLED notifier supplemental port
+WLED_GLOBAL bool clockSyncEnabled _INIT(true);  // follow the effect clock of the node notifications are received from
 WLED_GLOBAL uint16_t udpRgbPort _INIT(19446); // Hyperion port
 
 WLED_GLOBAL bool receiveNotificationBrightness _INIT(true);       // apply brightness from incoming notifications
 WLED_GLOBAL bool receiveNotificationColor      _INIT(true);       // apply color
 WLED_GLOBAL bool receiveNotificationEffects    _INIT(true);       // apply effects setup
+WLED_GLOBAL bool receiveNotificationSegments   _INIT(false);      // mirror the sender's segments (replaces the local segment layout)
 WLED_GLOBAL bool notifyDirect _INIT(false);                       // send notification if change via UI or HTTP API
 WLED_GLOBAL bool notifyButton _INIT(false);                       // send if updated by button or infrared remote
 WLED_GLOBAL bool notifyAlexa  _INIT(false);                       // send notification if updated via Alexa
@@ -289,9 +301,9 @@ WLED_GLOBAL uint16_t e131Port _INIT(5568);                        // DMX in port
 WLED_GLOBAL byte DMXMode _INIT(DMX_MODE_MULTIPLE_RGB);            // DMX mode (s.a.)
 WLED_GLOBAL uint16_t DMXAddress _INIT(1);                         // DMX start address of fixture, a.k.a. first Channel [for E1.31 (sACN) protocol]
 WLED_GLOBAL byte DMXOldDimmer _INIT(0);                           // only update brightness on change
-WLED_GLOBAL byte e131LastSequenceNumber[E131_MAX_UNIVERSE_COUNT]; // to detect packet loss
 WLED_GLOBAL bool e131Multicast _INIT(false);                      // multicast or unicast
 WLED_GLOBAL bool e131SkipOutOfSequence _INIT(false);              // freeze instead of flickering
+WLED_GLOBAL byte e131MergeMode _INIT(E131_MERGE_LTP);              // how sources with the same E1.31 priority are merged
 
 WLED_GLOBAL bool mqttEnabled _INIT(false);
 WLED_GLOBAL char mqttDeviceTopic[33] _INIT("");            // main MQTT topic (individual per device, default is wled/mac)
@@ -301,6 +313,7 @@ WLED_GLOBAL char mqttUser[41] _INIT("");                   // optional: username
 WLED_GLOBAL char mqttPass[41] _INIT("");                   // optional: password for MQTT auth
 WLED_GLOBAL char mqttClientID[41] _INIT("");               // override the client ID
 WLED_GLOBAL uint16_t mqttPort _INIT(1883);
+WLED_GLOBAL uint16_t mqttHeapInterval _INIT(0);             // s between heap telemetry messages, 0 to disable
 
 WLED_GLOBAL bool huePollingEnabled _INIT(false);           // poll hue bridge for light state
 WLED_GLOBAL uint16_t huePollIntervalMs _INIT(2500);        // low values (< 1sec) may cause lag but offer quicker response
@@ -352,6 +365,8 @@ WLED_GLOBAL uint16_t userVar0 _INIT(0), userVar1 _INIT(0); //available for use i
   WLED_GLOBAL uint16_t DMXGap _INIT(10);          // gap between the fixtures. makes addressing easier because you don't have to memorize odd numbers when climbing up onto a rig.
   WLED_GLOBAL uint16_t DMXStart _INIT(10);        // start address of the first fixture
   WLED_GLOBAL uint16_t DMXStartLED _INIT(0);      // LED from which DMX fixtures start
+  WLED_GLOBAL byte DMXRefreshRate _INIT(30);      // max. DMX frames per second (a full universe takes 23ms to send)
+  WLED_GLOBAL bool doInitDMX _INIT(false);        // flag to re-init DMX output after the settings changed in an async handler
 #endif
 
 // internal global variable declarations
@@ -479,6 +494,8 @@ WLED_GLOBAL uint16_t tpmPayloadFrameSize _INIT(0);
 WLED_GLOBAL unsigned long lastMqttReconnectAttempt _INIT(0);
 WLED_GLOBAL unsigned long lastInterfaceUpdate _INIT(0);
 WLED_GLOBAL byte interfaceUpdateCallMode _INIT(NOTIFIER_CALL_MODE_INIT);
+WLED_GLOBAL uint32_t stateRevision _INIT(0); // incremented on every state change, see revision.cpp
+WLED_GLOBAL bool stateCheckRequested _INIT(false); // check for state changes with the next loop
 WLED_GLOBAL char mqttStatusTopic[40] _INIT("");        // this must be global because of async handlers
 
 // alexa udp
@@ -521,6 +538,7 @@ WLED_GLOBAL String messageHead, messageSub;
 WLED_GLOBAL byte optionType;
 
 WLED_GLOBAL bool doReboot _INIT(false);        // flag to initiate reboot from async handlers
+WLED_GLOBAL bool doFactoryReset _INIT(false);  // the loop erases all settings and reboots, it may be writing them right now
 WLED_GLOBAL bool doPublishMqtt _INIT(false);
 
 // server library objects
@@ -457,6 +457,7 @@ void deEEP() {
 
   EEPROM.end();
 
+  invalidateFileETag("/presets.json");
   File f = WLED_FS.open("/presets.json", "w");
   if (!f) {
     errorFlag = ERR_FS_GENERAL;
@@ -473,5 +474,5 @@ void deEEPSettings() {
   loadSettingsFromEEPROM();
   EEPROM.end();
 
-  serializeConfig();
+  persistConfig();
 }
\ No newline at end of file
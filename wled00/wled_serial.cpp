@@ -2,102 +2,143 @@
 
 /*
  * Adalight and TPM2 handler
+ * Received bytes are copied into a buffer in blocks. Headers are parsed and checked
+ * once they are complete, pixel data is applied in runs of whole pixels as it arrives,
+ * so frames may be longer than the buffer.
  */
 
-enum class AdaState {
-  Header_A,
-  Header_d,
-  Header_a,
-  Header_CountHi,
-  Header_CountLo,
-  Header_CountCheck,
-  Data_Red,
-  Data_Green,
-  Data_Blue,
-  TPM2_Header_Type,
-  TPM2_Header_CountHi,
-  TPM2_Header_CountLo
+#ifdef ESP8266
+  #define SERIAL_BUF_LEN 256
+#else
+  #define SERIAL_BUF_LEN 1024
+#endif
+#define SERIAL_MAX_BLOCKS 8  //per loop, so a continuous stream cannot starve everything else
+
+#define ADA_HEADER_LEN  6    //"Ada", count hi, count lo, checksum
+#define TPM2_HEADER_LEN 4    //0xC9, type, size hi, size lo
+#define TPM2_BLOCK_END  0x36
+
+enum class SerialState {
+  Header,     //looking for "Ada" or TPM2 start byte
+  Data,       //pixel data of a frame
+  Skip,       //TPM2 bytes not forming a whole pixel
+  TPM2_End    //TPM2 block end byte
 };
 
+#ifdef WLED_ENABLE_ADALIGHT
+static byte serialBuf[SERIAL_BUF_LEN];
+static uint16_t serialLen = 0;
+static SerialState serialState = SerialState::Header;
+static uint32_t serialPixel = 0;
+static uint32_t serialRemaining = 0;   //pixels left in the frame, Adalight counts up to 65536
+static uint16_t serialSkip = 0;        //bytes to skip after the pixel data (TPM2)
+static bool serialTPM2 = false;
+
+static void lockSerialFrame()
+{
+  if (!realtimeMode && bri == 0) strip.setBrightness(briLast);
+  realtimeLock(realtimeTimeoutMs, REALTIME_MODE_ADALIGHT);
+}
+
+static void showSerialFrame()
+{
+  lockSerialFrame();
+  if (!realtimeOverride) strip.show();
+}
+
+//returns the number of bytes consumed, 0 if more data is needed
+static uint16_t parseSerial(const byte* buf, uint16_t len)
+{
+  switch (serialState) {
+    case SerialState::Header: {
+      //skip anything until a possible start of a header
+      uint16_t i = 0;
+      while (i < len && buf[i] != 'A' && buf[i] != 0xC9) i++;
+      if (i) return i;
+
+      if (buf[0] == 'A') {
+        if (len < ADA_HEADER_LEN) return 0;
+        if (buf[1] != 'd' || buf[2] != 'a' || (buf[3] ^ buf[4] ^ 0x55) != buf[5]) return 1; //resync on the next byte
+        serialRemaining = ((buf[3] << 8) | buf[4]) + 1;
+        serialSkip = 0;
+        serialTPM2 = false;
+        serialPixel = 0;
+        serialState = SerialState::Data;
+        return ADA_HEADER_LEN;
+      }
+
+      if (len < 2) return 0;
+      if (buf[1] == 0xAA) { //TPM2 ping
+        Serial.write(0xAC);
+        return 2;
+      }
+      if (buf[1] != 0xDA) return 1; //(unsupported) TPM2 command or invalid type
+      if (len < TPM2_HEADER_LEN) return 0;
+      uint16_t size = (buf[2] << 8) | buf[3];
+      serialRemaining = size / 3;
+      serialSkip = size % 3;
+      serialTPM2 = true;
+      serialPixel = 0;
+      serialState = serialRemaining ? SerialState::Data : (serialSkip ? SerialState::Skip : SerialState::TPM2_End);
+      return TPM2_HEADER_LEN;
+    }
+
+    case SerialState::Data: {
+      uint16_t n = len / 3;
+      if (n > serialRemaining) n = serialRemaining;
+      if (!n) return 0;
+      if (!realtimeOverride && serialPixel < MAX_LEDS) { //setRealtimePixel() takes 16 bit indices
+        if (!realtimeMode) lockSerialFrame(); //the render task stops drawing before the first pixels are written
+        uint16_t shown = (serialPixel + n > MAX_LEDS) ? MAX_LEDS - serialPixel : n;
+        const byte* p = buf;
+        for (uint16_t i = 0; i < shown; i++, p += 3) setRealtimePixel(serialPixel + i, p[0], p[1], p[2], 0);
+      }
+      serialPixel += n;
+      serialRemaining -= n;
+      if (!serialRemaining) {
+        if (serialTPM2) serialState = serialSkip ? SerialState::Skip : SerialState::TPM2_End;
+        else {
+          showSerialFrame();
+          serialState = SerialState::Header;
+        }
+      }
+      return n * 3;
+    }
+
+    case SerialState::Skip: {
+      uint16_t n = (len < serialSkip) ? len : serialSkip;
+      serialSkip -= n;
+      if (!serialSkip) serialState = SerialState::TPM2_End;
+      return n;
+    }
+
+    case SerialState::TPM2_End:
+      if (buf[0] == TPM2_BLOCK_END) showSerialFrame(); //the frame is complete, else drop it
+      serialState = SerialState::Header;
+      return 1;
+  }
+  return len;
+}
+#endif
+
 void handleSerial()
 {
   #ifdef WLED_ENABLE_ADALIGHT
-  static auto state = AdaState::Header_A;
-  static uint16_t count = 0;
-  static uint16_t pixel = 0;
-  static byte check = 0x00;
-  static byte red   = 0x00;
-  static byte green = 0x00;
-  
-  while (Serial.available() > 0)
-  {
-    yield();
-    byte next = Serial.read();
-    switch (state) {
-      case AdaState::Header_A:
-        if (next == 'A') state = AdaState::Header_d;
-        else if (next == 0xC9) { //TPM2 start byte
-          state = AdaState::TPM2_Header_Type;
-        }
-        break;
-      case AdaState::Header_d:
-        if (next == 'd') state = AdaState::Header_a;
-        else             state = AdaState::Header_A;
-        break;
-      case AdaState::Header_a:
-        if (next == 'a') state = AdaState::Header_CountHi;
-        else             state = AdaState::Header_A;
-        break;
-      case AdaState::Header_CountHi:
-        pixel = 0;
-        count = next * 0x100;
-        check = next;
-        state = AdaState::Header_CountLo;
-        break;
-      case AdaState::Header_CountLo:
-        count += next + 1;
-        check = check ^ next ^ 0x55;
-        state = AdaState::Header_CountCheck;
-        break;
-      case AdaState::Header_CountCheck:
-        if (check == next) state = AdaState::Data_Red;
-        else               state = AdaState::Header_A;
-        break;
-      case AdaState::TPM2_Header_Type:
-        state = AdaState::Header_A; //(unsupported) TPM2 command or invalid type
-        if (next == 0xDA) state = AdaState::TPM2_Header_CountHi; //TPM2 data
-        else if (next == 0xAA) Serial.write(0xAC); //TPM2 ping
-        break;
-      case AdaState::TPM2_Header_CountHi:
-        pixel = 0;
-        count = (next * 0x100) /3;
-        state = AdaState::TPM2_Header_CountLo;
-        break;
-      case AdaState::TPM2_Header_CountLo:
-        count += next /3;
-        state = AdaState::Data_Red;
-        break;
-      case AdaState::Data_Red:
-        red   = next;
-        state = AdaState::Data_Green;
-        break;
-      case AdaState::Data_Green:
-        green = next;
-        state = AdaState::Data_Blue;
-        break;
-      case AdaState::Data_Blue:
-        byte blue  = next;
-        if (!realtimeOverride) setRealtimePixel(pixel++, red, green, blue, 0);
-        if (--count > 0) state = AdaState::Data_Red;
-        else {
-          if (!realtimeMode && bri == 0) strip.setBrightness(briLast);
-          realtimeLock(realtimeTimeoutMs, REALTIME_MODE_ADALIGHT);
+  for (uint8_t blocks = 0; blocks < SERIAL_MAX_BLOCKS; blocks++) {
+    int avail = Serial.available();
+    if (avail <= 0) break;
+    uint16_t space = SERIAL_BUF_LEN - serialLen;
+    serialLen += Serial.readBytes(serialBuf + serialLen, (avail < space) ? avail : space);
 
-          if (!realtimeOverride) strip.show();
-          state = AdaState::Header_A;
-        }
-        break;
+    uint16_t pos = 0;
+    while (pos < serialLen) {
+      uint16_t used = parseSerial(serialBuf + pos, serialLen - pos);
+      if (!used) break;
+      pos += used;
     }
+    //keep the incomplete rest (less than a header or a pixel) at the start of the buffer
+    serialLen -= pos;
+    if (serialLen && pos) memmove(serialBuf, serialBuf + pos, serialLen);
   }
   #endif
 }
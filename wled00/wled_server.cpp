@@ -33,6 +33,87 @@ bool captivePortal(AsyncWebServerRequest *request)
   return false;
 }
 
+/*
+ * Admission control
+ * Heavy handlers (JSON state/info, settings pages, uploads) need a JSON document or several kB of
+ * stack and strings while they run. Only a few may be in progress at once, and only while the heap
+ * can afford one more without starving realtime packets. Static content is shed first, as the
+ * browser may retry it anytime. Rejected requests get 503 with Retry-After.
+ * JSON and HTTP API commands are never limited here: the command queue bounds them, so they keep
+ * working while a page loads. A slot is held until the connection is closed (response sent).
+ */
+#define REQ_MAX_ADMITTED (WLED_MAX_HEAVY_REQUESTS + WLED_MAX_STATIC_REQUESTS)
+
+static AsyncWebServerRequest* admittedRequest[REQ_MAX_ADMITTED];
+static uint8_t admittedLane[REQ_MAX_ADMITTED];
+static uint8_t laneActive[2] = {0, 0};
+static uint32_t laneRejected[2] = {0, 0};
+
+void releaseRequest(AsyncWebServerRequest* request)
+{
+  for (uint8_t i = 0; i < REQ_MAX_ADMITTED; i++) {
+    if (admittedRequest[i] != request) continue;
+    admittedRequest[i] = nullptr;
+    laneActive[admittedLane[i]]--;
+    return;
+  }
+}
+
+bool requestAdmitted(AsyncWebServerRequest* request)
+{
+  for (uint8_t i = 0; i < REQ_MAX_ADMITTED; i++) if (admittedRequest[i] == request) return true;
+  return false;
+}
+
+void sendUnavailable(AsyncWebServerRequest* request)
+{
+  AsyncWebServerResponse *response = request->beginResponse(503, "application/json", F("{\"error\":\"Busy\"}"));
+  response->addHeader(F("Retry-After"), "1");
+  request->send(response);
+}
+
+/*
+ * Returns true if the request may be handled now. Otherwise, it was answered with 503
+ * (unless respond is false, e.g. for an upload that responds once the body was received).
+ */
+bool admitRequest(AsyncWebServerRequest* request, uint8_t lane, bool respond)
+{
+  if (requestAdmitted(request)) return true;
+  bool heapOk;
+  uint8_t limit;
+  if (lane == REQ_LANE_HEAVY) {
+    heapOk = getMaxFreeBlock() >= JSON_BUFFER_SIZE && ESP.getFreeHeap() >= JSON_BUFFER_SIZE + WLED_REQUEST_HEAP_RESERVE;
+    limit = WLED_MAX_HEAVY_REQUESTS;
+  } else {
+    heapOk = ESP.getFreeHeap() >= 2 * WLED_REQUEST_HEAP_RESERVE; //leave some room for a command or heavy handler
+    limit = WLED_MAX_STATIC_REQUESTS;
+  }
+
+  if (laneActive[lane] < limit && heapOk) {
+    for (uint8_t i = 0; i < REQ_MAX_ADMITTED; i++) {
+      if (admittedRequest[i]) continue;
+      admittedRequest[i] = request;
+      admittedLane[i] = lane;
+      laneActive[lane]++;
+      request->onDisconnect([request]() { releaseRequest(request); });
+      return true;
+    }
+  }
+  laneRejected[lane]++;
+  DEBUG_PRINTLN(F("Request rejected, busy"));
+  if (respond) sendUnavailable(request);
+  return false;
+}
+
+void serializeServerLoad(JsonObject root)
+{
+  JsonArray active = root.createNestedArray("act");
+  active.add(laneActive[REQ_LANE_HEAVY]); active.add(laneActive[REQ_LANE_STATIC]);
+  JsonArray rejected = root.createNestedArray("rej");
+  rejected.add(laneRejected[REQ_LANE_HEAVY]); rejected.add(laneRejected[REQ_LANE_STATIC]);
+  root[F("q")] = getCommandQueueLength(); //commands waiting for the main loop
+}
+
 void initServer()
 {
   //CORS compatiblity
@@ -42,31 +123,37 @@ void initServer()
 
  #ifdef WLED_ENABLE_WEBSOCKETS
     server.on("/liveview", HTTP_GET, [](AsyncWebServerRequest *request){
+      if (!admitRequest(request, REQ_LANE_STATIC)) return;
       request->send_P(200, "text/html", PAGE_liveviewws);
     });
  #else
     server.on("/liveview", HTTP_GET, [](AsyncWebServerRequest *request){
+      if (!admitRequest(request, REQ_LANE_STATIC)) return;
       request->send_P(200, "text/html", PAGE_liveview);
     });
   #endif
   
   //settings page
   server.on("/settings", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (!admitRequest(request, REQ_LANE_HEAVY)) return;
     serveSettings(request);
   });
   
   server.on("/favicon.ico", HTTP_GET, [](AsyncWebServerRequest *request){
     if(!handleFileRead(request, "/favicon.ico"))
     {
-      request->send_P(200, "image/x-icon", favicon, 156);
+      static char etag[11] = "";
+      serveStaticP(request, "image/x-icon", favicon, 156, etag, false);
     }
   });
   
   server.on("/sliders", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (!admitRequest(request, REQ_LANE_STATIC)) return;
     serveIndex(request);
   });
   
   server.on("/welcome", HTTP_GET, [](AsyncWebServerRequest *request){
+    if (!admitRequest(request, REQ_LANE_HEAVY)) return;
     serveSettings(request);
   });
   
@@ -76,6 +163,7 @@ void initServer()
   });
   
   server.on("/settings", HTTP_POST, [](AsyncWebServerRequest *request){
+    if (!admitRequest(request, REQ_LANE_HEAVY)) return;
     serveSettings(request, true);
   });
 
@@ -88,26 +176,17 @@ void initServer()
   });
 
   server.on("/json", HTTP_GET, [](AsyncWebServerRequest *request){
+    //long-polls wait without a document
+    if (!request->hasParam("since") && !admitRequest(request, REQ_LANE_HEAVY)) return;
     serveJson(request);
   });
 
   AsyncCallbackJsonWebHandler* handler = new AsyncCallbackJsonWebHandler("/json", [](AsyncWebServerRequest *request) {
-    bool verboseResponse = false;
-    { //scope JsonDocument so it releases its buffer
-      DynamicJsonDocument jsonBuffer(JSON_BUFFER_SIZE);
-      DeserializationError error = deserializeJson(jsonBuffer, (uint8_t*)(request->_tempObject));
-      JsonObject root = jsonBuffer.as<JsonObject>();
-      if (error || root.isNull()) {
-        request->send(400, "application/json", F("{\"error\":9}")); return;
-      }
-      fileDoc = &jsonBuffer;
-      verboseResponse = deserializeState(root);
-      fileDoc = nullptr;
+    const char* body = (const char*)(request->_tempObject);
+    if (!body) {
+      request->send(400, "application/json", F("{\"error\":9}")); return;
     }
-    if (verboseResponse) { //if JSON contains "v"
-      serveJson(request); return; 
-    } 
-    request->send(200, "application/json", F("{\"success\":true}"));
+    queueJsonCommand((const uint8_t*)body, request->contentLength(), request); //the body is not null-terminated, responds once applied
   });
   server.addHandler(handler);
 
@@ -137,7 +216,12 @@ void initServer()
     
   //if OTA is allowed
   if (!otaLock){
+    server.on("/upload", HTTP_POST, handleFileUploadDone, handleFileUpload);
     #ifdef WLED_ENABLE_FS_EDITOR
+    //handles the editor's uploads and deletes before the editor itself does, so the ETag is stored with the file
+    //and caches of the file are invalidated
+    server.on("/edit", HTTP_POST, handleFileUploadDone, handleFileUpload);
+    server.on("/edit", HTTP_DELETE, handleFileDelete);
      #ifdef ARDUINO_ARCH_ESP32
       server.addHandler(new SPIFFSEditor(WLED_FS));//http_username,http_password));
      #else
@@ -206,6 +290,7 @@ void initServer()
     #endif
   server.on("/", HTTP_GET, [](AsyncWebServerRequest *request){
     if (captivePortal(request)) return;
+    if (!admitRequest(request, showWelcomePage ? REQ_LANE_HEAVY : REQ_LANE_STATIC)) return;
     serveIndexOrWelcome(request);
   });
 
@@ -225,10 +310,14 @@ void initServer()
       request->send(200); return;
     }
     
-    if(handleSet(request, request->url())) return;
+    if (request->url().indexOf("win") >= 0) { //HTTP API, applied and answered by the main loop
+      queueApiCommand(request->url().c_str(), request);
+      return;
+    }
     #ifndef WLED_DISABLE_ALEXA
     if(espalexa.handleAlexaApiCall(request)) return;
     #endif
+    if (!admitRequest(request, REQ_LANE_STATIC)) return;
     if(handleFileRead(request, request->url())) return;
     request->send_P(404, "text/html", PAGE_404);
   });
@@ -244,34 +333,47 @@ void serveIndexOrWelcome(AsyncWebServerRequest *request)
   }
 }
 
-bool handleIfNoneMatchCacheHeader(AsyncWebServerRequest* request)
+bool handleIfNoneMatchCacheHeader(AsyncWebServerRequest* request, const char* etag)
 {
   AsyncWebHeader* header = request->getHeader("If-None-Match");
-  if (header && header->value() == String(VERSION)) {
-    request->send(304);
+  if (header && header->value() == etag) {
+    AsyncWebServerResponse *response = request->beginResponse(304);
+    response->addHeader(F("ETag"), etag);
+    request->send(response);
     return true;
   }
   return false;
 }
 
-void setStaticContentCacheHeaders(AsyncWebServerResponse *response)
+void setStaticContentCacheHeaders(AsyncWebServerResponse *response, const char* etag)
 {
   response->addHeader(F("Cache-Control"),"no-cache");
-  response->addHeader(F("ETag"), String(VERSION));
+  response->addHeader(F("ETag"), etag);
 }
 
-void serveIndex(AsyncWebServerRequest* request)
+//sends a PROGMEM asset, or 304 if the client has it cached
+//the ETag is a hash of the content (computed on the first request), so it survives builds that did not change the asset
+void serveStaticP(AsyncWebServerRequest* request, const char* contentType, const uint8_t* content, size_t len, char* etag, bool gzip)
 {
-  if (handleFileRead(request, "/index.htm")) return;
+  if (!etag[0]) {
+    uint32_t hash = 2166136261UL;
+    for (size_t i = 0; i < len; i++) hash = (hash ^ pgm_read_byte(content + i)) * 16777619UL;
+    sprintf_P(etag, PSTR("\"%08x\""), (unsigned)hash);
+  }
+  if (handleIfNoneMatchCacheHeader(request, etag)) return;
 
-  if (handleIfNoneMatchCacheHeader(request)) return;
+  AsyncWebServerResponse *response = request->beginResponse_P(200, contentType, content, len);
+  if (gzip) response->addHeader(F("Content-Encoding"),"gzip");
+  setStaticContentCacheHeaders(response, etag);
+  request->send(response);
+}
 
-  AsyncWebServerResponse *response = request->beginResponse_P(200, "text/html", PAGE_index, PAGE_index_L);
+void serveIndex(AsyncWebServerRequest* request)
+{
+  if (handleFileRead(request, "/index.htm")) return;
 
-  response->addHeader(F("Content-Encoding"),"gzip");
-  setStaticContentCacheHeaders(response);
-  
-  request->send(response);
+  static char etag[11] = "";
+  serveStaticP(request, "text/html", PAGE_index, PAGE_index_L, etag, true);
 }
 
 
@@ -27,21 +27,7 @@ void wsEvent(AsyncWebSocket * server, AsyncWebSocketClient * client, AwsEventTyp
       //the whole message is in a single frame and we got all of it's data (max. 1450byte)
       if(info->opcode == WS_TEXT)
       {
-        bool verboseResponse = false;
-        { //scope JsonDocument so it releases its buffer
-          DynamicJsonDocument jsonBuffer(JSON_BUFFER_SIZE);
-          DeserializationError error = deserializeJson(jsonBuffer, data, len);
-          JsonObject root = jsonBuffer.as<JsonObject>();
-          if (error || root.isNull()) return;
-
-          if (root.containsKey("lv"))
-          {
-            wsLiveClientId = root["lv"] ? client->id() : 0;
-          }
-
-          verboseResponse = deserializeState(root);
-        }
-        if (verboseResponse || millis() - lastInterfaceUpdate < 1900) sendDataWs(client); //update if it takes longer than 100ms until next "broadcast"
+        queueJsonCommand(data, len, nullptr, client->id()); //the main loop applies it and responds
       }
     } else {
       //message is comprised of multiple frames or the frame is split into multiple packets
@@ -78,20 +64,29 @@ void sendDataWs(AsyncWebSocketClient * client)
 
   { //scope JsonDocument so it releases its buffer
     DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+    if (!doc.capacity()) {
+      heapAllocFailed(ALLOC_SITE_JSON); return;
+    }
     JsonObject state = doc.createNestedObject("state");
     serializeState(state);
     JsonObject info  = doc.createNestedObject("info");
     serializeInfo(info);
     size_t len = measureJson(doc);
     buffer = ws.makeBuffer(len);
-    if (!buffer) return; //out of memory
+    if (!buffer) { //out of memory
+      heapAllocFailed(ALLOC_SITE_WS); return;
+    }
 
     serializeJson(doc, (char *)buffer->get(), len +1);
   } 
   if (client) {
     client->text(buffer);
-  } else {
+  } else if (!hasStateSubscribers()) {
     ws.textAll(buffer);
+  } else { //state delta subscribers get their updates from handleStateRevision()
+    for (const auto& c : ws.getClients()) {
+      if (c->status() == WS_CONNECTED && !isStateSubscriber(c->id())) c->text(buffer);
+    }
   }
 }
 